@@ -102,6 +102,16 @@ struct cJSON_buffer_s
   size_t len;
 };
 
+/* Input state for pulling JSON incrementally with cJSON_Stream_*(). */
+
+typedef struct cJSON_stream_s
+{
+  char (*getc_fn)(void *priv);
+  void *fn_priv;
+  int curr;
+  bool entered;
+} cJSON_stream;
+
 /* Forward declaration of the cJSON structure */
 
 typedef struct cJSON cJSON;
@@ -166,6 +176,47 @@ cJSON *cJSON_Parse_Stream(char (*getc_fn)(void *priv), void *priv);
 
 cJSON *cJSON_Parse_fd(int fd, ssize_t max_readlen, size_t *nread);
 
+/* Incremental (pull) parsing of a JSON stream. Containers are walked
+ * member by member so that callers can consume large documents without
+ * building the whole tree; any single value can still be materialized
+ * with cJSON_Stream_Value().
+ */
+
+/* Prepare stream for reading with getc_fn. */
+
+void cJSON_Stream_Init(cJSON_stream *stream, char (*getc_fn)(void *priv),
+                       void *priv);
+
+/* Return type of the next value in stream without consuming it, or -1 if
+ * input is not a valid value.
+ */
+
+int cJSON_Stream_Type(cJSON_stream *stream);
+
+/* Consume opening of the next value, which must be array or object.
+ * Returns cJSON_Array or cJSON_Object, or -1 on malformed input.
+ */
+
+int cJSON_Stream_Enter(cJSON_stream *stream);
+
+/* Advance to the next member of the container entered last. For objects,
+ * the member name is copied (truncated) to 'name'. Returns 1 when positioned
+ * at member value, 0 when the container was closed and -1 on malformed
+ * input. The member value must be consumed before calling this again.
+ */
+
+int cJSON_Stream_Next(cJSON_stream *stream, char *name, size_t namelen);
+
+/* Parse the next value in stream into a new cJSON tree. Call cJSON_Delete
+ * when finished.
+ */
+
+cJSON *cJSON_Stream_Value(cJSON_stream *stream);
+
+/* Check that stream has no trailing data after the parsed document. */
+
+bool cJSON_Stream_End(cJSON_stream *stream);
+
 char *cJSON_Print(cJSON *item);
 
 /* Render a cJSON entity to text for transfer/storage without any
@@ -46,6 +46,8 @@
 
 #include <nuttx/net/netconfig.h>
 
+#include <stdint.h>
+
 #include <netinet/in.h>
 
 /****************************************************************************
@@ -64,6 +66,21 @@
 #  endif
 #endif
 
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+/* One name of dns_query_sock_parallel() / dns_gethostip_parallel(). */
+
+struct dns_lookup_s
+{
+  FAR const char *hostname;   /* Name to look up */
+  in_addr_t ipaddr;           /* Returned address */
+  uint32_t ttl;               /* Returned time-to-live in seconds */
+  int result;                 /* OK, or negated errno; -ENOENT if name
+                               * does not exist */
+};
+
 /****************************************************************************
  * Public Function Prototypes
  ****************************************************************************/
@@ -136,6 +153,40 @@ int dns_query_sock(int sockfd, FAR const char *hostname, FAR in_addr_t *ipaddr);
 int dns_query_sock_multi(int sockfd, FAR const char *hostname,
                          FAR in_addr_t *ipaddr, size_t nipaddr);
 
+/****************************************************************************
+ * Name: dns_query_sock_multi_ttl
+ *
+ * Description:
+ *   As dns_query_sock_multi(), and also return smallest time-to-live of
+ *   the addresses, in seconds, in 'ttl'. Sets errno to ENOENT if server
+ *   reports that name does not exist.
+ *
+ * Returned Value:
+ *   Returns number of addresses read if the query was successful.
+ *
+ ****************************************************************************/
+
+int dns_query_sock_multi_ttl(int sockfd, FAR const char *hostname,
+                             FAR in_addr_t *ipaddr, size_t nipaddr,
+                             FAR uint32_t *ttl);
+
+/****************************************************************************
+ * Name: dns_query_sock_parallel
+ *
+ * Description:
+ *   Using the DNS resolver socket (sockfd), look up the IP address of each
+ *   'hostname' in 'lookups' array. Queries for all names are in flight at
+ *   the same time.
+ *
+ * Returned Value:
+ *   Returns number of names resolved. Result of each lookup is in its
+ *   'result' field.
+ *
+ ****************************************************************************/
+
+int dns_query_sock_parallel(int sockfd, FAR struct dns_lookup_s *lookups,
+                            size_t nlookups);
+
 /****************************************************************************
  * Name: dns_query
  *
@@ -284,6 +335,30 @@ int dns_gethostip(FAR const char *hostname, FAR in_addr_t *ipaddr);
 int dns_gethostip_multi(FAR const char *hostname, FAR in_addr_t *ipaddr,
                         size_t nipaddr);
 
+/****************************************************************************
+ * Name: dns_gethostip_multi_ttl
+ *
+ * Descriptions:
+ *   As dns_gethostip_multi(), and also return smallest time-to-live of the
+ *   addresses, in seconds, in 'ttl'.
+ *
+ ****************************************************************************/
+
+int dns_gethostip_multi_ttl(FAR const char *hostname, FAR in_addr_t *ipaddr,
+                            size_t nipaddr, FAR uint32_t *ttl);
+
+/****************************************************************************
+ * Name: dns_gethostip_parallel
+ *
+ * Descriptions:
+ *   Combines the operations of dns_bind_sock(), dns_query_sock_parallel(),
+ *   and dns_free_sock() to look up IP addresses of several host names with
+ *   queries in flight at the same time. Returns number of names resolved.
+ *
+ ****************************************************************************/
+
+int dns_gethostip_parallel(FAR struct dns_lookup_s *lookups, size_t nlookups);
+
 /****************************************************************************
  * Name: dns_clear_lookup_failed_count
  ****************************************************************************/
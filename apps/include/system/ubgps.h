@@ -361,6 +361,35 @@ struct gps_event_new_timer_s
   struct gps_event_s super;
 };
 
+/* GPS aiding statistics */
+
+struct gps_aiding_stats_s
+{
+  /* Number of GPS power-ups */
+
+  uint32_t starts;
+
+  /* Number of power-ups that reached fix */
+
+  uint32_t fixes;
+
+  /* Time to first fix of latest power-up in ms */
+
+  uint32_t last_ttff;
+
+  /* Average time to first fix in ms */
+
+  uint32_t avg_ttff;
+
+  /* GPS on-time of latest power-up in seconds */
+
+  uint32_t last_on_time;
+
+  /* Total GPS on-time in seconds */
+
+  uint32_t total_on_time;
+};
+
 /****************************************************************************
  * Public Function Prototypes
  ****************************************************************************/
@@ -543,6 +572,22 @@ int ubgps_give_location_hint(double const latitude,
                              int32_t const altitude,
                              uint32_t const accuracy);
 
+/****************************************************************************
+ * Name: ubgps_get_aiding_stats
+ *
+ * Description:
+ *   Get time-to-first-fix and GPS on-time statistics kept with aiding
+ *   snapshot
+ *
+ * Input Parameters:
+ *   stats       - Pointer to statistics structure to fill
+ *
+ * Returned Value:
+ *   Status
+ *
+ ****************************************************************************/
+int ubgps_get_aiding_stats(struct gps_aiding_stats_s * const stats);
+
 /****************************************************************************
  * Name: ubgps_setup_poll
  *
@@ -218,4 +218,19 @@ int ts_gps_set_aiding_params(bool const use_time,
                              int32_t const altitude,
                              uint32_t const accuracy);
 
+/****************************************************************************
+ * Name: ts_gps_get_aiding_stats
+ *
+ * Description:
+ *   Get GPS time-to-first-fix and on-time statistics
+ *
+ * Input Parameters:
+ *   stats       - Pointer to statistics structure to fill
+ *
+ * Returned Values:
+ *   Status
+ *
+ ****************************************************************************/
+int ts_gps_get_aiding_stats(struct gps_aiding_stats_s * const stats);
+
 #endif /* __APPS_INCLUDE_THINGSEE_TS_GPS_H */
@@ -41,6 +41,7 @@
  ****************************************************************************/
 
 #include <poll.h>
+#include <stdio.h>
 #include <sys/types.h>
 
 /****************************************************************************
@@ -321,6 +322,48 @@ bool ts_core_is_date_before_compile_date(time_t ctime);
  ****************************************************************************/
 void ts_core_mainloop(volatile bool *goon);
 
+#ifdef CONFIG_THINGSEE_CORE_PROFILER
+/****************************************************************************
+ * Name: ts_core_profiler_enable
+ *
+ * Description:
+ *   Start or stop collecting main loop profiling data. Collected data is
+ *   kept when profiler is stopped.
+ *
+ * Input Parameters:
+ *   enable - true to start, false to stop profiling
+ *
+ ****************************************************************************/
+void ts_core_profiler_enable(bool enable);
+
+/****************************************************************************
+ * Name: ts_core_profiler_reset
+ *
+ * Description:
+ *   Clear collected main loop profiling data
+ *
+ ****************************************************************************/
+void ts_core_profiler_reset(void);
+
+/****************************************************************************
+ * Name: ts_core_profiler_dump
+ *
+ * Description:
+ *   Print main loop iteration and wakeup counts, and execution time
+ *   histograms per file descriptor registrant and per timer callback.
+ *
+ * Input Parameters:
+ *   stream - Output stream
+ *
+ * Returned Value:
+ *   0 (OK) means the function was executed successfully
+ *  -1 (ERROR) means the function was executed unsuccessfully. Check value of
+ *  errno for more details.
+ *
+ ****************************************************************************/
+int ts_core_profiler_dump(FILE *stream);
+#endif
+
 /****************************************************************************
  * Name: ts_core_selftest
  *
@@ -42,6 +42,7 @@
  ****************************************************************************/
 
 #include <nuttx/config.h>
+#include <stddef.h>
 #include <errno.h>
 
 #include <apps/netutils/dnsclient.h>
@@ -79,6 +80,21 @@
 
 int dns_gethostip_multi(FAR const char *hostname, FAR in_addr_t *ipaddr,
                         size_t nipaddr)
+{
+  return dns_gethostip_multi_ttl(hostname, ipaddr, nipaddr, NULL);
+}
+
+/****************************************************************************
+ * Name: dns_gethostip_multi_ttl
+ *
+ * Descriptions:
+ *   As dns_gethostip_multi(), and also return smallest time-to-live of the
+ *   addresses, in seconds, in 'ttl'.
+ *
+ ****************************************************************************/
+
+int dns_gethostip_multi_ttl(FAR const char *hostname, FAR in_addr_t *ipaddr,
+                            size_t nipaddr, FAR uint32_t *ttl)
 {
   int sockfd = -1;
   int ret = ERROR;
@@ -93,7 +109,35 @@ int dns_gethostip_multi(FAR const char *hostname, FAR in_addr_t *ipaddr,
   dns_bind_sock(&sockfd);
   if (sockfd >= 0)
     {
-      ret = dns_query_sock_multi(sockfd, hostname, ipaddr, nipaddr);
+      ret = dns_query_sock_multi_ttl(sockfd, hostname, ipaddr, nipaddr, ttl);
+      err = errno;
+      dns_free_sock(&sockfd);
+      errno = err;
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: dns_gethostip_parallel
+ *
+ * Descriptions:
+ *   Combines the operations of dns_bind_sock(), dns_query_sock_parallel(),
+ *   and dns_free_sock() to look up IP addresses of several host names with
+ *   queries in flight at the same time. Returns number of names resolved.
+ *
+ ****************************************************************************/
+
+int dns_gethostip_parallel(FAR struct dns_lookup_s *lookups, size_t nlookups)
+{
+  int sockfd = -1;
+  int ret = ERROR;
+  int err;
+
+  dns_bind_sock(&sockfd);
+  if (sockfd >= 0)
+    {
+      ret = dns_query_sock_parallel(sockfd, lookups, nlookups);
       err = errno;
       dns_free_sock(&sockfd);
       errno = err;
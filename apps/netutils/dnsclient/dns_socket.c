@@ -52,6 +52,7 @@
 #include <sys/time.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <errno.h>
@@ -196,6 +197,14 @@ struct dns_queue_info_s
   struct dns_question que;
 };
 
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static int dns_whois_socket_ttl(int sockfd, FAR const char *name,
+                                FAR in_addr_t *addr, size_t naddr,
+                                FAR uint32_t *ttl);
+
 /****************************************************************************
  * Private Data
  ****************************************************************************/
@@ -496,22 +505,24 @@ static int dns_send_query(int sockfd, FAR const char *name,
 }
 
 /****************************************************************************
- * Name: dns_recv_response
+ * Name: dns_parse_response
  *
  * Description:
- *   Called when new UDP data arrives
+ *   Parse response to query 'qinfo' received from 'recvaddr'. Addresses
+ *   are returned in 'inaddr' and smallest TTL of them in 'ttl'.
  *
  ****************************************************************************/
 
 #ifdef CONFIG_NETUTILS_DNSCLIENT_IPv6
 #  error "Not implemented"
 #else
-static int dns_recv_response(int sockfd, FAR in_addr_t *inaddr, size_t naddr,
-                             FAR unsigned char *buffer, size_t buflen,
-                             struct dns_queue_info_s *qinfo)
+static int dns_parse_response(FAR const struct sockaddr_in *recvaddr,
+                              FAR in_addr_t *inaddr, size_t naddr,
+                              FAR uint32_t *ttl,
+                              FAR unsigned char *buffer, size_t buflen,
+                              struct dns_queue_info_s *qinfo)
 #endif
 {
-  struct sockaddr_in recvaddr;
   FAR unsigned char *nameptr;
   FAR unsigned char *namestart;
   FAR unsigned char *nameend;
@@ -519,21 +530,11 @@ static int dns_recv_response(int sockfd, FAR in_addr_t *inaddr, size_t naddr,
   FAR struct dns_hdr *hdr;
   uint16_t nquestions;
   uint16_t nanswers;
-  ssize_t ret;
-  socklen_t raddrlen;
+  uint32_t ans_ttl;
   int naddr_read;
   int errval;
 
-  /* Receive the response */
-
-  raddrlen = sizeof(recvaddr);
-  ret = recvfrom(sockfd, buffer, buflen, 0, (void *)&recvaddr, &raddrlen);
-  if (ret < 0)
-    {
-      return ret;
-    }
-
-  if (memcmp(&recvaddr.sin_addr, &qinfo->srv_ip, sizeof(recvaddr.sin_addr)))
+  if (memcmp(&recvaddr->sin_addr, &qinfo->srv_ip, sizeof(recvaddr->sin_addr)))
     {
       /* Not response from DNS server. */
 
@@ -542,7 +543,7 @@ static int dns_recv_response(int sockfd, FAR in_addr_t *inaddr, size_t naddr,
       return ERROR;
     }
 
-  if (recvaddr.sin_port != qinfo->srv_port)
+  if (recvaddr->sin_port != qinfo->srv_port)
     {
       /* Not response from DNS server. */
 
@@ -551,8 +552,6 @@ static int dns_recv_response(int sockfd, FAR in_addr_t *inaddr, size_t naddr,
       return ERROR;
     }
 
-  buflen = ret;
-
   if (buflen < sizeof(*hdr))
     {
       ndbg("too short DNS response (len: %d, expect at least: %d)\n",
@@ -571,14 +570,6 @@ static int dns_recv_response(int sockfd, FAR in_addr_t *inaddr, size_t naddr,
        htons(hdr->numquestions), htons(hdr->numanswers),
        htons(hdr->numauthrr), htons(hdr->numextrarr));
 
-  /* Check for error. If so, call callback to inform */
-
-  if ((hdr->flags2 & DNS_FLAG2_ERR_MASK) != 0)
-    {
-      errno = EHOSTUNREACH;
-      return ERROR;
-    }
-
   /* Check for matching ID. */
 
   if (hdr->id != qinfo->id)
@@ -590,6 +581,23 @@ static int dns_recv_response(int sockfd, FAR in_addr_t *inaddr, size_t naddr,
       return ERROR;
     }
 
+  /* Check for error. Non-existent name is reported with ENOENT, so that
+   * caller can tell it apart from failure to get an answer. */
+
+  if ((hdr->flags2 & DNS_FLAG2_ERR_MASK) != 0)
+    {
+      if ((hdr->flags2 & DNS_FLAG2_ERR_MASK) == DNS_FLAG2_ERR_NAME)
+        {
+          errno = ENOENT;
+        }
+      else
+        {
+          errno = EHOSTUNREACH;
+        }
+
+      return ERROR;
+    }
+
   /* We only care about the question(s) and the answers. The authrr
    * and the extrarr are simply discarded.
    */
@@ -720,9 +728,9 @@ static int dns_recv_response(int sockfd, FAR in_addr_t *inaddr, size_t naddr,
         }
 
       ans = (struct dns_answer *)nameptr;
+      ans_ttl = ((uint32_t)htons(ans->ttl[0]) << 16) | htons(ans->ttl[1]);
       ndbg("Answer: type %x, class %x, ttl %x, length %x \n", /* 0x%08X\n", */
-           htons(ans->type), htons(ans->class),
-           (htons(ans->ttl[0]) << 16) | htons(ans->ttl[1]),
+           htons(ans->type), htons(ans->class), ans_ttl,
            htons(ans->len) /* , ans->ipaddr.s_addr */);
 
       /* Check for IP address type and Internet class. Others are discarded. */
@@ -751,6 +759,11 @@ static int dns_recv_response(int sockfd, FAR in_addr_t *inaddr, size_t naddr,
                (a_addr >> 16 ) & 0xff,
                (a_addr >> 24 ) & 0xff);
 
+          if (ttl && (naddr_read == 0 || ans_ttl < *ttl))
+            {
+              *ttl = ans_ttl;
+            }
+
           inaddr[naddr_read++] = a_addr;
 
           if (naddr_read >= naddr)
@@ -787,6 +800,233 @@ static int dns_recv_response(int sockfd, FAR in_addr_t *inaddr, size_t naddr,
   return ERROR;
 }
 
+/****************************************************************************
+ * Name: dns_recv_response
+ *
+ * Description:
+ *   Called when new UDP data arrives
+ *
+ ****************************************************************************/
+
+static int dns_recv_response(int sockfd, FAR in_addr_t *inaddr, size_t naddr,
+                             FAR uint32_t *ttl,
+                             FAR unsigned char *buffer, size_t buflen,
+                             struct dns_queue_info_s *qinfo)
+{
+  struct sockaddr_in recvaddr;
+  socklen_t raddrlen;
+  ssize_t ret;
+
+  /* Receive the response */
+
+  raddrlen = sizeof(recvaddr);
+  ret = recvfrom(sockfd, buffer, buflen, 0, (void *)&recvaddr, &raddrlen);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  return dns_parse_response(&recvaddr, inaddr, naddr, ttl, buffer, ret,
+                            qinfo);
+}
+
+/****************************************************************************
+ * Name: dns_whois_socket_parallel
+ *
+ * Description:
+ *   Get the bindings for all pending 'lookups' using the DNS server
+ *   accessed via 'sockfd'. Queries for all names are sent before waiting
+ *   for responses, so that lookups take one round-trip instead of one per
+ *   name. Returns number of names resolved.
+ *
+ ****************************************************************************/
+
+static int dns_whois_socket_parallel(int sockfd,
+                                     FAR struct dns_lookup_s *lookups,
+                                     size_t nlookups)
+{
+  FAR struct dns_queue_info_s *qinfo;
+  FAR unsigned char *buffer;
+  size_t buflen = RECV_BUFFER_SIZE;
+  struct sockaddr_in recvaddr;
+  struct timespec deadline;
+  struct timespec now;
+  socklen_t raddrlen;
+  uint16_t id;
+  size_t pending;
+  size_t i;
+  int nanswered = 0;
+  int nresolved = 0;
+  int retries;
+  ssize_t ret;
+  int err = ETIMEDOUT;
+
+  if (buflen < SEND_BUFFER_SIZE)
+    buflen = SEND_BUFFER_SIZE;
+
+  buffer = malloc(buflen);
+  qinfo = calloc(nlookups, sizeof(*qinfo));
+  if (!buffer || !qinfo)
+    {
+      free(buffer);
+      free(qinfo);
+      errno = ENOMEM;
+      return ERROR;
+    }
+
+  for (retries = 0; retries < CONFIG_NETUTILS_DNSCLIENT_RETRIES; retries++)
+    {
+#ifdef CONFIG_NETUTILS_DNSCLIENT_IPv6
+      struct sockaddr_in6 dnsserver = {};
+#else
+      struct sockaddr_in dnsserver = {};
+#endif
+
+      if (dns_getserver_sockaddr(&dnsserver) < 0)
+        {
+          err = ENETDOWN;
+          break;
+        }
+
+      /* Send queries for names still without an answer. */
+
+      pending = 0;
+      for (i = 0; i < nlookups; i++)
+        {
+          if (lookups[i].result != -EINPROGRESS)
+            {
+              continue;
+            }
+
+          ret = dns_send_query(sockfd, lookups[i].hostname, &dnsserver,
+                               buffer, buflen, &qinfo[i]);
+          if (ret >= 0)
+            {
+              pending++;
+            }
+          else if (errno != EAGAIN && errno != ETIMEDOUT)
+            {
+              lookups[i].result = -errno;
+            }
+        }
+
+      /* Collect responses, in whatever order they arrive. Stray datagrams
+       * are dropped, but do not extend the wait. */
+
+      clock_gettime(CLOCK_MONOTONIC, &deadline);
+      deadline.tv_sec += CONFIG_NETUTILS_DNSCLIENT_RECV_TIMEOUT;
+
+      while (pending > 0)
+        {
+          clock_gettime(CLOCK_MONOTONIC, &now);
+          if (now.tv_sec > deadline.tv_sec ||
+              (now.tv_sec == deadline.tv_sec &&
+               now.tv_nsec >= deadline.tv_nsec))
+            {
+              err = ETIMEDOUT;
+              break;
+            }
+
+          raddrlen = sizeof(recvaddr);
+          ret = recvfrom(sockfd, buffer, buflen, 0, (void *)&recvaddr,
+                         &raddrlen);
+          if (ret < 0)
+            {
+              err = errno;
+              break;
+            }
+
+          if ((size_t)ret < sizeof(struct dns_hdr))
+            {
+              continue;
+            }
+
+          id = ((FAR struct dns_hdr *)buffer)->id;
+          for (i = 0; i < nlookups; i++)
+            {
+              if (qinfo[i].qname && qinfo[i].id == id)
+                {
+                  break;
+                }
+            }
+
+          if (i == nlookups)
+            {
+              ndbg("response to unknown query (ID %d).\n", id);
+              continue;
+            }
+
+          if (memcmp(&recvaddr.sin_addr, &qinfo[i].srv_ip,
+                     sizeof(recvaddr.sin_addr)) ||
+              recvaddr.sin_port != qinfo[i].srv_port)
+            {
+              /* Not response from DNS server, keep waiting for it. */
+
+              ndbg("packet from wrong address\n");
+              continue;
+            }
+
+          ret = dns_parse_response(&recvaddr, &lookups[i].ipaddr, 1,
+                                   &lookups[i].ttl, buffer, ret, &qinfo[i]);
+          lookups[i].result = (ret > 0) ? OK : -errno;
+          if (ret > 0)
+            {
+              nresolved++;
+            }
+
+          if (ret > 0 || errno != EBADMSG)
+            {
+              nanswered++;
+            }
+
+          free(qinfo[i].qname);
+          qinfo[i].qname = NULL;
+          pending--;
+        }
+
+      for (i = 0; i < nlookups; i++)
+        {
+          free(qinfo[i].qname);
+          qinfo[i].qname = NULL;
+        }
+
+      if (pending == 0 || (err != EAGAIN && err != ETIMEDOUT))
+        {
+          break;
+        }
+
+      if (retries + 1 < CONFIG_NETUTILS_DNSCLIENT_RETRIES)
+        {
+          dns_increase_lookup_failed_count();
+        }
+    }
+
+  for (i = 0; i < nlookups; i++)
+    {
+      if (lookups[i].result == -EINPROGRESS)
+        {
+          lookups[i].result = -err;
+        }
+    }
+
+  free(qinfo);
+  free(buffer);
+
+  /* Any answer from server shows that DNS works, even if it tells that
+   * some of the names do not exist. */
+
+  if (nanswered > 0)
+    {
+      dns_clear_lookup_failed_count();
+    }
+  else
+    {
+      dns_increase_lookup_failed_count();
+    }
+
+  return nresolved;
+}
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -919,6 +1159,25 @@ int dns_query_sock(int sockfd, FAR const char *hostname, FAR in_addr_t *ipaddr)
 
 int dns_query_sock_multi(int sockfd, FAR const char *hostname,
                          FAR in_addr_t *ipaddr, size_t nipaddr)
+{
+  return dns_query_sock_multi_ttl(sockfd, hostname, ipaddr, nipaddr, NULL);
+}
+
+/****************************************************************************
+ * Name: dns_query_sock_multi_ttl
+ *
+ * Description:
+ *   As dns_query_sock_multi(), and also return smallest time-to-live of
+ *   the addresses, in seconds, in 'ttl'. TTL of IP address string is zero.
+ *
+ * Returned Value:
+ *   Returns number of addresses read if the query was successful.
+ *
+ ****************************************************************************/
+
+int dns_query_sock_multi_ttl(int sockfd, FAR const char *hostname,
+                             FAR in_addr_t *ipaddr, size_t nipaddr,
+                             FAR uint32_t *ttl)
 {
   int ret;
 
@@ -936,7 +1195,7 @@ int dns_query_sock_multi(int sockfd, FAR const char *hostname,
        *  the host name to an IP address.
        */
 
-      ret = dns_whois_socket_multi(sockfd, hostname, ipaddr, nipaddr);
+      ret = dns_whois_socket_ttl(sockfd, hostname, ipaddr, nipaddr, ttl);
       if (ret < 0)
         {
           /* Needs to set the errno here */
@@ -946,12 +1205,76 @@ int dns_query_sock_multi(int sockfd, FAR const char *hostname,
     }
   else
     {
+      if (ttl)
+        {
+          *ttl = 0;
+        }
+
       ret = 1;
     }
 
   return ret;
 }
 
+/****************************************************************************
+ * Name: dns_query_sock_parallel
+ *
+ * Description:
+ *   Using the DNS resolver socket (sockfd), look up the IP address of each
+ *   'hostname' in 'lookups' array. Queries for all names are in flight at
+ *   the same time.
+ *
+ * Returned Value:
+ *   Returns number of names resolved. Result of each lookup is in its
+ *   'result' field.
+ *
+ ****************************************************************************/
+
+int dns_query_sock_parallel(int sockfd, FAR struct dns_lookup_s *lookups,
+                            size_t nlookups)
+{
+  size_t npending = 0;
+  int nresolved = 0;
+  size_t i;
+  int ret;
+
+  if (!lookups || nlookups == 0)
+    {
+      errno = EINVAL;
+      return ERROR;
+    }
+
+  for (i = 0; i < nlookups; i++)
+    {
+      lookups[i].ttl = 0;
+
+      if (netlib_ipaddrconv(lookups[i].hostname,
+                            (FAR uint8_t *)&lookups[i].ipaddr))
+        {
+          lookups[i].result = OK;
+          nresolved++;
+        }
+      else
+        {
+          lookups[i].result = -EINPROGRESS;
+          npending++;
+        }
+    }
+
+  if (npending == 0)
+    {
+      return nresolved;
+    }
+
+  ret = dns_whois_socket_parallel(sockfd, lookups, nlookups);
+  if (ret < 0)
+    {
+      return ERROR;
+    }
+
+  return nresolved + ret;
+}
+
 /****************************************************************************
  * Name: dns_clear_lookup_failed_count
  ****************************************************************************/
@@ -1211,6 +1534,22 @@ int dns_whois_socket(int sockfd, FAR const char *name,
 
 int dns_whois_socket_multi(int sockfd, FAR const char *name,
                            FAR in_addr_t *addr, size_t naddr)
+{
+  return dns_whois_socket_ttl(sockfd, name, addr, naddr, NULL);
+}
+
+/****************************************************************************
+ * Name: dns_whois_socket_ttl
+ *
+ * Description:
+ *   Get the binding for 'name' and smallest TTL of returned addresses
+ *   using the DNS server accessed via 'sockfd'.
+ *
+ ****************************************************************************/
+
+static int dns_whois_socket_ttl(int sockfd, FAR const char *name,
+                                FAR in_addr_t *addr, size_t naddr,
+                                FAR uint32_t *ttl)
 {
   FAR unsigned char *buffer;
   size_t buflen = RECV_BUFFER_SIZE;
@@ -1254,7 +1593,8 @@ int dns_whois_socket_multi(int sockfd, FAR const char *name,
                            &qinfo);
       if (ret >= 0)
         {
-          ret = dns_recv_response(sockfd, addr, naddr, buffer, buflen, &qinfo);
+          ret = dns_recv_response(sockfd, addr, naddr, ttl, buffer, buflen,
+                                  &qinfo);
           if (ret >= 0)
             {
               /* Response received successfully */
@@ -1296,7 +1636,17 @@ int dns_whois_socket_multi(int sockfd, FAR const char *name,
   err = EHOSTUNREACH;
 err_out:
   free(buffer);
-  dns_increase_lookup_failed_count();
+  if (err == ENOENT)
+    {
+      /* Server answered, name just does not exist. */
+
+      dns_clear_lookup_failed_count();
+    }
+  else
+    {
+      dns_increase_lookup_failed_count();
+    }
+
   errno = err;
   return ERROR;
 }
@@ -64,12 +64,7 @@
  * Private Types
  ****************************************************************************/
 
-typedef struct cJSON_instream_s
-{
-  char (*getc_fn)(void *priv);
-  void *fn_priv;
-  int curr;
-} cJSON_instream;
+typedef cJSON_stream cJSON_instream;
 
 struct parse_fd_priv_s
 {
@@ -991,38 +986,181 @@ static char getc_fd(void *priv)
 
 cJSON *cJSON_Parse_Stream(char (*getc_fn)(void *priv), void *priv)
 {
-  struct stream_parse_value value;
-  cJSON_instream stream = {};
+  cJSON_instream stream;
   cJSON *c;
 
-  stream.getc_fn = getc_fn;
-  stream.fn_priv = priv;
-  stream.curr = -1;
+  cJSON_Stream_Init(&stream, getc_fn, priv);
 
-  if (!stream_parse_value(&value, skip(&stream)))
+  c = cJSON_Stream_Value(&stream);
+  if (!c)
     {
       return NULL;
     }
 
-  c = stream_parse_create_item(&value, NULL);
-  if (!c)
+  if (!cJSON_Stream_End(&stream))
     {
-      /* Memory fail */
+      /* Malformed at end. */
+
+      cJSON_Delete(c);
       return NULL;
     }
 
-#ifndef CONFIG_NETUTILS_JSON_PARSE_IGNORE_MISSING_NULL_TERMINATOR
-  skip(&stream);
-  if (stream_get(&stream))
+  return c;
+}
+
+/* Prepare stream for incremental parsing. */
+
+void cJSON_Stream_Init(cJSON_stream *stream, char (*getc_fn)(void *priv),
+                       void *priv)
+{
+  stream->getc_fn = getc_fn;
+  stream->fn_priv = priv;
+  stream->curr = -1;
+  stream->entered = false;
+}
+
+/* Peek type of next value in stream. */
+
+int cJSON_Stream_Type(cJSON_stream *stream)
+{
+  char c = stream_peek(skip(stream));
+
+  switch (c)
     {
-      /* Malformed at end. */
+    case '{':
+      return cJSON_Object;
 
-      cJSON_Delete(c);
+    case '[':
+      return cJSON_Array;
+
+    case '\"':
+      return cJSON_String;
+
+    case 'n':
+      return cJSON_NULL;
+
+    case 't':
+      return cJSON_True;
+
+    case 'f':
+      return cJSON_False;
+
+    default:
+      if (c == '-' || (c >= '0' && c <= '9'))
+        {
+          return cJSON_Number;
+        }
+
+      return -1;
+    }
+}
+
+/* Enter array or object, positioned before its first member. */
+
+int cJSON_Stream_Enter(cJSON_stream *stream)
+{
+  int type = cJSON_Stream_Type(stream);
+
+  if (type != cJSON_Object && type != cJSON_Array)
+    {
+      return -1;
+    }
+
+  (void)stream_get(stream);
+
+  /* No member separator is expected before the first member. */
+
+  stream->entered = true;
+  return type;
+}
+
+/* Move to the value of next container member. */
+
+int cJSON_Stream_Next(cJSON_stream *stream, char *name, size_t namelen)
+{
+  struct stream_parse_value value;
+  bool first = stream->entered;
+  char c;
+
+  stream->entered = false;
+
+  c = stream_peek(skip(stream));
+  if (c == '}' || c == ']')
+    {
+      (void)stream_get(stream);
+      return 0;
+    }
+
+  if (!first)
+    {
+      if (c != ',')
+        {
+          return -1;
+        }
+
+      (void)stream_get(stream);
+      c = stream_peek(skip(stream));
+    }
+
+  if (!name)
+    {
+      /* Array member, value follows directly. */
+
+      return c ? 1 : -1;
+    }
+
+  if (!stream_parse_string(&value, stream))
+    {
+      return -1;
+    }
+
+  if (namelen > 0)
+    {
+      strncpy(name, value.u.valuestring, namelen - 1);
+      name[namelen - 1] = '\0';
+    }
+
+  free(value.u.valuestring);
+
+  if (stream_peek(skip(stream)) != ':')
+    {
+      return -1;
+    }
+
+  (void)stream_get(stream);
+  (void)skip(stream);
+  return 1;
+}
+
+/* Parse next value from stream - create a new root, and populate. */
+
+cJSON *cJSON_Stream_Value(cJSON_stream *stream)
+{
+  struct stream_parse_value value;
+
+  if (!stream_parse_value(&value, skip(stream)))
+    {
       return NULL;
     }
+
+  /* Returns NULL on memory fail. */
+
+  return stream_parse_create_item(&value, NULL);
+}
+
+/* Check for end of input. */
+
+bool cJSON_Stream_End(cJSON_stream *stream)
+{
+#ifndef CONFIG_NETUTILS_JSON_PARSE_IGNORE_MISSING_NULL_TERMINATOR
+  skip(stream);
+  if (stream_get(stream))
+    {
+      return false;
+    }
 #endif
 
-  return c;
+  return true;
 }
 
 /* Parse an object from input string - create a new root, and populate. */
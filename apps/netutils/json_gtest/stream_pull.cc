@@ -0,0 +1,113 @@
+#include <string.h>
+#include "gtest/gtest.h"
+extern "C" {
+#include "cJSON.h"
+}
+
+static char getc_str(void *priv)
+{
+  const char **pstr = (const char **)priv;
+  char c = **pstr;
+
+  if (c)
+    (*pstr)++;
+  return c;
+}
+
+class StreamPull : public ::testing::Test
+{
+public:
+  cJSON_stream stream;
+  const char *input;
+
+  void Open(const char *json)
+  {
+    input = json;
+    cJSON_Stream_Init(&stream, getc_str, &input);
+  }
+};
+
+TEST_F(StreamPull, WalksObjectMembers)
+{
+  char name[8];
+  cJSON *value;
+
+  Open(" { \"a\" : 1 , \"bb\":[1,2], \"c\" : {\"d\":\"x\"} } ");
+  ASSERT_EQ(cJSON_Object, cJSON_Stream_Enter(&stream));
+
+  ASSERT_EQ(1, cJSON_Stream_Next(&stream, name, sizeof(name)));
+  ASSERT_STREQ("a", name);
+  ASSERT_EQ(cJSON_Number, cJSON_Stream_Type(&stream));
+  value = cJSON_Stream_Value(&stream);
+  ASSERT_EQ(1, cJSON_int(value));
+  cJSON_Delete(value);
+
+  ASSERT_EQ(1, cJSON_Stream_Next(&stream, name, sizeof(name)));
+  ASSERT_STREQ("bb", name);
+  ASSERT_EQ(cJSON_Array, cJSON_Stream_Enter(&stream));
+  ASSERT_EQ(1, cJSON_Stream_Next(&stream, NULL, 0));
+  value = cJSON_Stream_Value(&stream);
+  ASSERT_EQ(1, cJSON_int(value));
+  cJSON_Delete(value);
+  ASSERT_EQ(1, cJSON_Stream_Next(&stream, NULL, 0));
+  value = cJSON_Stream_Value(&stream);
+  ASSERT_EQ(2, cJSON_int(value));
+  cJSON_Delete(value);
+  ASSERT_EQ(0, cJSON_Stream_Next(&stream, NULL, 0));
+
+  ASSERT_EQ(1, cJSON_Stream_Next(&stream, name, sizeof(name)));
+  ASSERT_STREQ("c", name);
+  value = cJSON_Stream_Value(&stream);
+  ASSERT_STREQ("x", cJSON_string(cJSON_GetObjectItem(value, "d")));
+  cJSON_Delete(value);
+
+  ASSERT_EQ(0, cJSON_Stream_Next(&stream, name, sizeof(name)));
+  ASSERT_TRUE(cJSON_Stream_End(&stream));
+}
+
+TEST_F(StreamPull, EmptyContainers)
+{
+  Open("[{},[]]");
+  ASSERT_EQ(cJSON_Array, cJSON_Stream_Enter(&stream));
+  ASSERT_EQ(1, cJSON_Stream_Next(&stream, NULL, 0));
+  ASSERT_EQ(cJSON_Object, cJSON_Stream_Enter(&stream));
+  ASSERT_EQ(0, cJSON_Stream_Next(&stream, NULL, 0));
+  ASSERT_EQ(1, cJSON_Stream_Next(&stream, NULL, 0));
+  ASSERT_EQ(cJSON_Array, cJSON_Stream_Enter(&stream));
+  ASSERT_EQ(0, cJSON_Stream_Next(&stream, NULL, 0));
+  ASSERT_EQ(0, cJSON_Stream_Next(&stream, NULL, 0));
+  ASSERT_TRUE(cJSON_Stream_End(&stream));
+}
+
+TEST_F(StreamPull, TruncatesLongNames)
+{
+  char name[4];
+
+  Open("{\"abcdef\":true}");
+  ASSERT_EQ(cJSON_Object, cJSON_Stream_Enter(&stream));
+  ASSERT_EQ(1, cJSON_Stream_Next(&stream, name, sizeof(name)));
+  ASSERT_STREQ("abc", name);
+  ASSERT_EQ(cJSON_True, cJSON_Stream_Type(&stream));
+}
+
+TEST_F(StreamPull, RejectsMalformed)
+{
+  char name[4];
+
+  Open("{\"a\":1 \"b\":2}");
+  ASSERT_EQ(cJSON_Object, cJSON_Stream_Enter(&stream));
+  ASSERT_EQ(1, cJSON_Stream_Next(&stream, name, sizeof(name)));
+  cJSON_Delete(cJSON_Stream_Value(&stream));
+  ASSERT_EQ(-1, cJSON_Stream_Next(&stream, name, sizeof(name)));
+
+  Open("{\"a\" 1}");
+  ASSERT_EQ(cJSON_Object, cJSON_Stream_Enter(&stream));
+  ASSERT_EQ(-1, cJSON_Stream_Next(&stream, name, sizeof(name)));
+
+  Open("\"a\"");
+  ASSERT_EQ(-1, cJSON_Stream_Enter(&stream));
+
+  Open("{} x");
+  cJSON_Delete(cJSON_Stream_Value(&stream));
+  ASSERT_FALSE(cJSON_Stream_End(&stream));
+}
@@ -0,0 +1,105 @@
+/****************************************************************************
+ * apps/system/tsprof/tsprof.c
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <apps/thingsee/ts_core.h>
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static void show_usage(const char *progname)
+{
+  fprintf(stderr, "USAGE: %s [on|off|reset|show]\n", progname);
+  fprintf(stderr, "  on     Start profiling Thingsee core main loop\n");
+  fprintf(stderr, "  off    Stop profiling, collected data is kept\n");
+  fprintf(stderr, "  reset  Clear collected data\n");
+  fprintf(stderr, "  show   Print collected data (default)\n");
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+#ifdef CONFIG_BUILD_KERNEL
+int main(int argc, FAR char *argv[])
+#else
+int tsprof_main(int argc, char *argv[])
+#endif
+{
+  const char *cmd = (argc > 1) ? argv[1] : "show";
+
+  if (argc > 2)
+    {
+      show_usage(argv[0]);
+      return 1;
+    }
+
+  if (!strcmp(cmd, "on"))
+    {
+      ts_core_profiler_enable(true);
+    }
+  else if (!strcmp(cmd, "off"))
+    {
+      ts_core_profiler_enable(false);
+    }
+  else if (!strcmp(cmd, "reset"))
+    {
+      ts_core_profiler_reset();
+    }
+  else if (!strcmp(cmd, "show"))
+    {
+      if (ts_core_profiler_dump(stdout) != OK)
+        {
+          fprintf(stderr, "%s: out of memory\n", argv[0]);
+          return 1;
+        }
+    }
+  else
+    {
+      show_usage(argv[0]);
+      return 1;
+    }
+
+  return 0;
+}
@@ -172,9 +172,9 @@ struct ubgps_s *ubgps_initialize(void)
   board_gps_pm_set_next_message_time(&ts);
 #endif
 
-  /* Set file blocking */
+  /* Set file non-blocking, receiver reads all available data at once */
 
-  ret = ubgps_set_nonblocking(gps, false);
+  ret = ubgps_set_nonblocking(gps, true);
   if (ret < 0)
     return NULL;
 
@@ -197,6 +197,12 @@ struct ubgps_s *ubgps_initialize(void)
   gps->state.init_timer_id = -1;
   gps->state.location_timer_id = -1;
 
+  /* Initialize location filter */
+
+  ubgps_filter_init(&gps->filter, CONFIG_UBGPS_ACCURACY_FILTER_THRESHOLD,
+                    CONFIG_UBGPS_ACCURACY_FILTER_MIN_SAMPLES,
+                    CONFIG_UBGPS_ACCURACY_FILTER_ACCEL);
+
   /* Initialize UBX receiver */
 
   ret = ubx_initialize(gps, ubx_callback, gps);
@@ -230,6 +236,12 @@ struct ubgps_s *ubgps_initialize(void)
   ubgps_set_aiding_params(false, "", 1, false, 0, 0, 0, 0);
 #endif
 
+#ifdef CONFIG_UBGPS_AID_SNAPSHOT
+  /* Load aiding snapshot stored at previous fix or power-off. */
+
+  (void)ubgps_snapshot_load(gps);
+#endif
+
   /* Construct and provess state machine entry event */
 
   event.id = SM_EVENT_ENTRY;
@@ -872,3 +884,30 @@ int ubgps_give_location_hint(double const latitude,
 
   return OK;
 }
+
+/****************************************************************************
+ * Name: ubgps_get_aiding_stats
+ *
+ * Description:
+ *   Get time-to-first-fix and GPS on-time statistics kept with aiding
+ *   snapshot
+ *
+ * Input Parameters:
+ *   stats       - Pointer to statistics structure to fill
+ *
+ * Returned Value:
+ *   Status
+ *
+ ****************************************************************************/
+
+int ubgps_get_aiding_stats(struct gps_aiding_stats_s * const stats)
+{
+  DEBUGASSERT(stats);
+
+#ifdef CONFIG_UBGPS_AID_SNAPSHOT
+  return ubgps_snapshot_get_stats(stats);
+#else
+  errno = ENOSYS;
+  return ERROR;
+#endif
+}
@@ -365,6 +365,9 @@ static int http_parse_response(char *inbuf, size_t *len,
       if (updater.fd == NULL)
         {
           updater.write_cnt = 0;
+#ifdef CONFIG_UBGPS_AID_SNAPSHOT
+          ubgps_snapshot_alp_invalidate();
+#endif
           updater.fd = fopen(ALP_FILE_PATH, "w");
           if (!updater.fd)
             {
@@ -0,0 +1,453 @@
+/****************************************************************************
+ * apps/system/ubgps/ubgps_filter.c
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "ubgps_filter.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* Meters per 1e-7 degree of latitude (WGS-84 equatorial radius) */
+
+#define FILTER_METERS_PER_E7      (6378137.0 * M_PI / 180.0 / 1e7)
+
+/* Lower bound for longitude scale, to stay finite near poles */
+
+#define FILTER_MIN_LON_SCALE      1e-3f
+
+/* Full circle in 1e-7 degrees, for longitude wrap-around */
+
+#define FILTER_E7_CIRCLE          3600000000LL
+
+/* Estimate is restarted if locations are not received in this time [ms] */
+
+#define FILTER_MAX_GAP_MS         (60 * 1000)
+
+/* Gate for normalized innovation squared of position, chi-square with two
+ * degrees of freedom at 99.9%. Locations outside gate are rejected. */
+
+#define FILTER_GATE               13.8f
+
+/* Estimate is restarted after this many consecutive rejected locations */
+
+#define FILTER_MAX_REJECTS        3
+
+/* Receiver errors are partly correlated over time and do not average out.
+ * Accuracy of estimate includes this share of receiver's own accuracy. */
+
+#define FILTER_CORRELATED_ACC_DIV 2
+
+/* Velocity variance used when receiver does not give speed accuracy and
+ * lower bound of speed accuracy [m/s] */
+
+#define FILTER_DEFAULT_VEL_VAR    (10.0f * 10.0f)
+#define FILTER_MIN_SPEED_ACC      0.05f
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: filter_axis_init
+ ****************************************************************************/
+static void filter_axis_init(struct ubgps_filter_axis_s * const axis,
+                             float const p, float const pos_var,
+                             float const v, float const vel_var)
+{
+  axis->p = p;
+  axis->v = v;
+  axis->pp = pos_var;
+  axis->pv = 0.0f;
+  axis->vv = vel_var;
+}
+
+/****************************************************************************
+ * Name: filter_axis_predict
+ *
+ * Description:
+ *   Constant velocity model with white acceleration noise.
+ *
+ ****************************************************************************/
+static void filter_axis_predict(struct ubgps_filter_axis_s * const axis,
+                                float const dt, float const accel_var)
+{
+  float const dt2 = dt * dt;
+
+  axis->p += axis->v * dt;
+
+  axis->pp += 2.0f * dt * axis->pv + dt2 * axis->vv +
+              accel_var * dt2 * dt2 / 4.0f;
+  axis->pv += dt * axis->vv + accel_var * dt2 * dt / 2.0f;
+  axis->vv += accel_var * dt2;
+}
+
+/****************************************************************************
+ * Name: filter_axis_update_pos
+ ****************************************************************************/
+static void filter_axis_update_pos(struct ubgps_filter_axis_s * const axis,
+                                   float const z, float const r)
+{
+  float const y = z - axis->p;
+  float const s = axis->pp + r;
+  float const kp = axis->pp / s;
+  float const kv = axis->pv / s;
+
+  axis->p += kp * y;
+  axis->v += kv * y;
+
+  axis->vv -= kv * axis->pv;
+  axis->pv *= 1.0f - kp;
+  axis->pp *= 1.0f - kp;
+}
+
+/****************************************************************************
+ * Name: filter_axis_update_vel
+ ****************************************************************************/
+static void filter_axis_update_vel(struct ubgps_filter_axis_s * const axis,
+                                   float const z, float const r)
+{
+  float const y = z - axis->v;
+  float const s = axis->vv + r;
+  float const kp = axis->pv / s;
+  float const kv = axis->vv / s;
+
+  axis->p += kp * y;
+  axis->v += kv * y;
+
+  axis->pp -= kp * axis->pv;
+  axis->pv *= 1.0f - kv;
+  axis->vv *= 1.0f - kv;
+}
+
+/****************************************************************************
+ * Name: filter_to_local
+ *
+ * Description:
+ *   Convert location to north / east meters from reference point.
+ *
+ ****************************************************************************/
+static void filter_to_local(struct ubgps_filter_s const * const filter,
+                            struct gps_location_s const * const location,
+                            float * const north, float * const east)
+{
+  int64_t dlon = (int64_t)location->longitude - filter->ref_longitude;
+
+  if (dlon > FILTER_E7_CIRCLE / 2)
+    dlon -= FILTER_E7_CIRCLE;
+  else if (dlon < -FILTER_E7_CIRCLE / 2)
+    dlon += FILTER_E7_CIRCLE;
+
+  *north = (float)(((int64_t)location->latitude - filter->ref_latitude) *
+                   FILTER_METERS_PER_E7);
+  *east = (float)(dlon * FILTER_METERS_PER_E7) * filter->lon_scale;
+}
+
+/****************************************************************************
+ * Name: filter_velocity
+ *
+ * Description:
+ *   Get north / east velocity [m/s] and its variance from location.
+ *
+ ****************************************************************************/
+static float filter_velocity(struct gps_location_s const * const location,
+                             float * const north, float * const east)
+{
+  float const speed = location->ground_speed / 1000.0f;
+  float const heading = location->heading * (float)(M_PI / 180.0 / 1e5);
+  float speed_acc;
+
+  *north = speed * cosf(heading);
+  *east = speed * sinf(heading);
+
+  if (location->ground_speed_accuracy == 0)
+    return FILTER_DEFAULT_VEL_VAR;
+
+  speed_acc = location->ground_speed_accuracy / 1000.0f;
+  if (speed_acc < FILTER_MIN_SPEED_ACC)
+    speed_acc = FILTER_MIN_SPEED_ACC;
+
+  return speed_acc * speed_acc;
+}
+
+/****************************************************************************
+ * Name: filter_start
+ *
+ * Description:
+ *   Restart estimate from location.
+ *
+ ****************************************************************************/
+static void filter_start(struct ubgps_filter_s * const filter,
+                         struct gps_location_s const * const location,
+                         float const pos_var, uint32_t const time_ms)
+{
+  float vel_var;
+  float vn;
+  float ve;
+
+  filter->initialized = true;
+  filter->ref_latitude = location->latitude;
+  filter->ref_longitude = location->longitude;
+  filter->lon_scale = cosf(location->latitude * (float)(M_PI / 180.0 / 1e7));
+  if (filter->lon_scale < FILTER_MIN_LON_SCALE)
+    filter->lon_scale = FILTER_MIN_LON_SCALE;
+  filter->time_ms = time_ms;
+  filter->samples = 1;
+  filter->rejects = 0;
+
+  vel_var = filter_velocity(location, &vn, &ve);
+
+  filter_axis_init(&filter->north, 0.0f, pos_var, vn, vel_var);
+  filter_axis_init(&filter->east, 0.0f, pos_var, ve, vel_var);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ubgps_filter_init
+ *
+ * Description:
+ *   Initialize location filter.
+ *
+ ****************************************************************************/
+void ubgps_filter_init(struct ubgps_filter_s * const filter,
+                       uint32_t const threshold, uint16_t const min_samples,
+                       uint32_t const accel)
+{
+  DEBUGASSERT(filter);
+
+  memset(filter, 0, sizeof(*filter));
+
+  filter->threshold = threshold;
+  filter->min_samples = min_samples > 0 ? min_samples : 1;
+  filter->accel_var = (float)accel * accel;
+}
+
+/****************************************************************************
+ * Name: ubgps_filter_reset
+ *
+ * Description:
+ *   Drop current estimate, next location restarts filter.
+ *
+ ****************************************************************************/
+void ubgps_filter_reset(struct ubgps_filter_s * const filter)
+{
+  DEBUGASSERT(filter);
+
+  filter->initialized = false;
+  filter->samples = 0;
+  filter->rejects = 0;
+}
+
+/****************************************************************************
+ * Name: ubgps_filter_update
+ *
+ * Description:
+ *   Predict estimate to given time and merge location weighted by its
+ *   reported accuracy.
+ *
+ ****************************************************************************/
+int ubgps_filter_update(struct ubgps_filter_s * const filter,
+                        struct gps_location_s const * const location,
+                        uint32_t const time_ms)
+{
+  float const acc = location->horizontal_accuracy / 1000.0f;
+  float pos_var;
+  float vel_var;
+  float zn, ze;
+  float vn, ve;
+  float yn, ye;
+  float d2;
+  float dt;
+
+  DEBUGASSERT(filter && location);
+
+  /* Horizontal accuracy is split evenly to north and east axis */
+
+  pos_var = acc * acc / 2.0f;
+  if (pos_var < 1e-2f)
+    pos_var = 1e-2f;
+
+  filter->last = *location;
+
+  if (!filter->initialized ||
+      (uint32_t)(time_ms - filter->time_ms) > FILTER_MAX_GAP_MS)
+    {
+      filter_start(filter, location, pos_var, time_ms);
+      return UBGPS_FILTER_INITIALIZED;
+    }
+
+  /* Predict to time of location */
+
+  dt = (uint32_t)(time_ms - filter->time_ms) / 1000.0f;
+  filter->time_ms = time_ms;
+
+  filter_axis_predict(&filter->north, dt, filter->accel_var);
+  filter_axis_predict(&filter->east, dt, filter->accel_var);
+
+  /* Check that location is consistent with estimate */
+
+  filter_to_local(filter, location, &zn, &ze);
+
+  yn = zn - filter->north.p;
+  ye = ze - filter->east.p;
+  d2 = yn * yn / (filter->north.pp + pos_var) +
+       ye * ye / (filter->east.pp + pos_var);
+
+  if (d2 > FILTER_GATE)
+    {
+      filter->samples = 0;
+
+      if (++filter->rejects >= FILTER_MAX_REJECTS)
+        {
+          /* Estimate has diverged from receiver, follow receiver */
+
+          filter_start(filter, location, pos_var, time_ms);
+          return UBGPS_FILTER_INITIALIZED;
+        }
+
+      return UBGPS_FILTER_REJECTED;
+    }
+
+  /* Merge position and velocity */
+
+  filter_axis_update_pos(&filter->north, zn, pos_var);
+  filter_axis_update_pos(&filter->east, ze, pos_var);
+
+  vel_var = filter_velocity(location, &vn, &ve);
+
+  filter_axis_update_vel(&filter->north, vn, vel_var);
+  filter_axis_update_vel(&filter->east, ve, vel_var);
+
+  filter->rejects = 0;
+  if (filter->samples < UINT16_MAX)
+    filter->samples++;
+
+  return UBGPS_FILTER_UPDATED;
+}
+
+/****************************************************************************
+ * Name: ubgps_filter_accuracy
+ *
+ * Description:
+ *   Get horizontal accuracy of estimate [mm].
+ *
+ ****************************************************************************/
+uint32_t ubgps_filter_accuracy(struct ubgps_filter_s const * const filter)
+{
+  float corr;
+  float acc;
+
+  DEBUGASSERT(filter);
+
+  if (!filter->initialized)
+    return UINT32_MAX;
+
+  corr = filter->last.horizontal_accuracy /
+         (FILTER_CORRELATED_ACC_DIV * 1000.0f);
+
+  acc = sqrtf(filter->north.pp + filter->east.pp + corr * corr) * 1000.0f;
+  if (acc >= (float)UINT32_MAX)
+    return UINT32_MAX;
+
+  return (uint32_t)acc;
+}
+
+/****************************************************************************
+ * Name: ubgps_filter_converged
+ *
+ * Description:
+ *   Check whether estimate has converged: enough consecutive consistent
+ *   locations and horizontal accuracy below threshold.
+ *
+ ****************************************************************************/
+bool ubgps_filter_converged(struct ubgps_filter_s const * const filter)
+{
+  DEBUGASSERT(filter);
+
+  if (!filter->initialized || filter->samples < filter->min_samples)
+    return false;
+
+  return ubgps_filter_accuracy(filter) / 1000 < filter->threshold;
+}
+
+/****************************************************************************
+ * Name: ubgps_filter_get_location
+ *
+ * Description:
+ *   Get filtered location. Position and horizontal accuracy come from
+ *   estimate, other fields from latest location given to filter.
+ *
+ ****************************************************************************/
+int ubgps_filter_get_location(struct ubgps_filter_s const * const filter,
+                              struct gps_location_s * const location)
+{
+  int64_t lon;
+
+  DEBUGASSERT(filter && location);
+
+  if (!filter->initialized)
+    return ERROR;
+
+  *location = filter->last;
+
+  location->latitude = filter->ref_latitude +
+      (int32_t)roundf(filter->north.p / (float)FILTER_METERS_PER_E7);
+
+  lon = filter->ref_longitude +
+      (int64_t)roundf(filter->east.p / filter->lon_scale /
+                       (float)FILTER_METERS_PER_E7);
+  if (lon > FILTER_E7_CIRCLE / 2)
+    lon -= FILTER_E7_CIRCLE;
+  else if (lon < -FILTER_E7_CIRCLE / 2)
+    lon += FILTER_E7_CIRCLE;
+
+  location->longitude = lon;
+  location->horizontal_accuracy = ubgps_filter_accuracy(filter);
+
+  return OK;
+}
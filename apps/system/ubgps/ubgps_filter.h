@@ -0,0 +1,196 @@
+/****************************************************************************
+ * apps/system/ubgps/ubgps_filter.h
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#ifndef __THINGSEE_GPS_UBGPS_FILTER_H
+#define __THINGSEE_GPS_UBGPS_FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <poll.h>
+#include <apps/system/ubgps.h>
+
+/****************************************************************************
+ * Public Defines
+ ****************************************************************************/
+
+/* Location filter update results */
+
+#define UBGPS_FILTER_INITIALIZED      0 /* Filter (re)started from location */
+#define UBGPS_FILTER_UPDATED          1 /* Location merged to estimate */
+#define UBGPS_FILTER_REJECTED         2 /* Location inconsistent with estimate */
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+/* Position / velocity estimate along one horizontal axis [m, m/s] with
+ * symmetric covariance matrix [pp pv; pv vv]. */
+
+struct ubgps_filter_axis_s
+{
+  float p;
+  float v;
+  float pp;
+  float pv;
+  float vv;
+};
+
+/* Location filter state */
+
+struct ubgps_filter_s
+{
+  /* Convergence threshold [m], minimum number of consistent locations and
+   * process noise as acceleration [m/s^2] */
+
+  uint32_t threshold;
+  uint16_t min_samples;
+  float accel_var;
+
+  /* Estimate is kept in local north / east coordinates [m] relative to
+   * reference point [1e-7 deg] */
+
+  bool initialized;
+  int32_t ref_latitude;
+  int32_t ref_longitude;
+  float lon_scale;
+
+  /* Time of latest update [ms] */
+
+  uint32_t time_ms;
+
+  /* North and east axis */
+
+  struct ubgps_filter_axis_s north;
+  struct ubgps_filter_axis_s east;
+
+  /* Latest location given to filter */
+
+  struct gps_location_s last;
+
+  /* Consecutive consistent and rejected locations */
+
+  uint16_t samples;
+  uint8_t rejects;
+};
+
+/****************************************************************************
+ * Public Function Prototypes
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ubgps_filter_init
+ *
+ * Description:
+ *   Initialize location filter.
+ *
+ * Input Parameters:
+ *   filter      - Filter object
+ *   threshold   - Convergence threshold for horizontal accuracy [m]
+ *   min_samples - Consistent locations needed for convergence
+ *   accel       - Expected acceleration of receiver [m/s^2]
+ *
+ ****************************************************************************/
+
+void ubgps_filter_init(struct ubgps_filter_s * const filter,
+                       uint32_t const threshold, uint16_t const min_samples,
+                       uint32_t const accel);
+
+/****************************************************************************
+ * Name: ubgps_filter_reset
+ *
+ * Description:
+ *   Drop current estimate, next location restarts filter.
+ *
+ ****************************************************************************/
+
+void ubgps_filter_reset(struct ubgps_filter_s * const filter);
+
+/****************************************************************************
+ * Name: ubgps_filter_update
+ *
+ * Description:
+ *   Predict estimate to given time and merge location weighted by its
+ *   reported accuracy.
+ *
+ * Input Parameters:
+ *   filter      - Filter object
+ *   location    - Location from receiver
+ *   time_ms     - Time of location [ms], monotonic
+ *
+ * Returned Values:
+ *   UBGPS_FILTER_INITIALIZED, UBGPS_FILTER_UPDATED or UBGPS_FILTER_REJECTED
+ *
+ ****************************************************************************/
+
+int ubgps_filter_update(struct ubgps_filter_s * const filter,
+                        struct gps_location_s const * const location,
+                        uint32_t const time_ms);
+
+/****************************************************************************
+ * Name: ubgps_filter_accuracy
+ *
+ * Description:
+ *   Get horizontal accuracy of estimate [mm].
+ *
+ ****************************************************************************/
+
+uint32_t ubgps_filter_accuracy(struct ubgps_filter_s const * const filter);
+
+/****************************************************************************
+ * Name: ubgps_filter_converged
+ *
+ * Description:
+ *   Check whether estimate has converged: enough consecutive consistent
+ *   locations and horizontal accuracy below threshold.
+ *
+ ****************************************************************************/
+
+bool ubgps_filter_converged(struct ubgps_filter_s const * const filter);
+
+/****************************************************************************
+ * Name: ubgps_filter_get_location
+ *
+ * Description:
+ *   Get filtered location. Position and horizontal accuracy come from
+ *   estimate, other fields from latest location given to filter.
+ *
+ * Returned Values:
+ *   Status
+ *
+ ****************************************************************************/
+
+int ubgps_filter_get_location(struct ubgps_filter_s const * const filter,
+                              struct gps_location_s * const location);
+
+#endif /* __THINGSEE_GPS_UBGPS_FILTER_H */
@@ -143,12 +143,34 @@ static void utctime_to_gpstime(const struct timespec *ts, uint16_t *week,
   *wmsec = gps_secs * 1000 + ts->tv_nsec / (1000 * 1000);
 }
 
+/****************************************************************************
+ * Name: ubgps_publish_filtered_location
+ *
+ * Description:
+ *   Publish location event with current location estimate.
+ *
+ ****************************************************************************/
+static void ubgps_publish_filtered_location(struct ubgps_s * const gps)
+{
+  struct gps_event_location_s levent;
+
+  if (ubgps_filter_get_location(&gps->filter, &gps->filt_location) != OK)
+    return;
+
+  levent.super.id = GPS_EVENT_LOCATION;
+  levent.time = &gps->time;
+  levent.location = &gps->filt_location;
+
+  ubgps_publish_event(gps, (struct gps_event_s *)&levent);
+}
+
 /****************************************************************************
  * Name: ubgps_filter_location
  *
  * Description:
- *   Filter location events and publish until horizontal accuracy is below
- *   defined threshold or location filter timeout occurs.
+ *   Merge location to position / velocity estimate and publish estimate as
+ *   soon as it has converged. If estimate does not converge within filter
+ *   duration, current estimate is published on timeout.
  *
  * Input Parameters:
  *   gps         - GPS object
@@ -160,26 +182,34 @@ static void utctime_to_gpstime(const struct timespec *ts, uint16_t *week,
 static void ubgps_filter_location(struct ubgps_s * const gps,
   struct gps_event_location_s const * const levent)
 {
-#ifdef CONFIG_UBGPS_ACCURACY_FILTER_DURATION
-  const int accuracy_filter_duration = CONFIG_UBGPS_ACCURACY_FILTER_DURATION;
-#else
-  const int accuracy_filter_duration = 10;
-#endif
-#ifdef CONFIG_UBGPS_ACCURACY_FILTER_THRESHOLD
-  const int accuracy_filter_threshold = CONFIG_UBGPS_ACCURACY_FILTER_THRESHOLD;
-#else
-  const int accuracy_filter_threshold = 100;
-#endif
+  struct timespec ts;
+  uint32_t time_ms;
+  int ret;
 
   DEBUGASSERT(gps && levent);
 
-  if (accuracy_filter_duration == 0 ||
-      (levent->location->horizontal_accuracy / 1000 <
-       accuracy_filter_threshold))
+  if (CONFIG_UBGPS_ACCURACY_FILTER_DURATION == 0)
     {
-      /* Filter disabled or accuracy below threshold */
+      /* Filter disabled */
 
       ubgps_publish_event(gps, (struct gps_event_s *)levent);
+      return;
+    }
+
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  time_ms = ts.tv_sec * 1000 + ts.tv_nsec / (1000 * 1000);
+
+  ret = ubgps_filter_update(&gps->filter, levent->location, time_ms);
+
+  dbg_int("location filter: %s, acc:%um, samples:%u\n",
+          ret == UBGPS_FILTER_REJECTED ? "rejected" :
+          ret == UBGPS_FILTER_INITIALIZED ? "started" : "updated",
+          ubgps_filter_accuracy(&gps->filter) / 1000, gps->filter.samples);
+  (void)ret;
+
+  if (ubgps_filter_converged(&gps->filter))
+    {
+      /* Estimate is good enough, publish without waiting for timeout */
 
       if (gps->state.location_timer_id >= 0)
         {
@@ -188,28 +218,17 @@ static void ubgps_filter_location(struct ubgps_s * const gps,
           gps->state.location_timer_id = -1;
         }
 
-      gps->filt_location.horizontal_accuracy = 0;
+      ubgps_publish_filtered_location(gps);
 
       return;
     }
 
-  if (gps->filt_location.horizontal_accuracy == 0)
+  if (gps->state.location_timer_id < 0)
     {
-      /* The first location event that is not below threshold,
-         start timeout timer to collect location events. */
+      /* Start timeout timer for publishing unconverged estimate. */
 
       gps->state.location_timer_id = __ubgps_set_timer(gps,
-        accuracy_filter_duration * 1000, ubgps_timeout, gps);
-    }
-
-  if (gps->filt_location.horizontal_accuracy == 0 ||
-      (levent->location->horizontal_accuracy <
-      gps->filt_location.horizontal_accuracy))
-    {
-      /* More accurate location than previous one, update location data. */
-
-      memcpy(&gps->filt_location, levent->location, sizeof(*levent->location));
-      return;
+        CONFIG_UBGPS_ACCURACY_FILTER_DURATION * 1000, ubgps_timeout, gps);
     }
 }
 
@@ -523,65 +542,70 @@ int ubx_callback(struct ubx_receiver_s const * const receiver,
  *
  * Input Parameters:
  *   gps         - GPS object
- *   data        - NMEA data (one character)
+ *   data        - NMEA data
+ *   len         - Length of NMEA data
  *
  * Returned Values:
  *   Status
  *
  ****************************************************************************/
-int nmea_receiver(struct ubgps_s * const gps, uint8_t const data)
+int nmea_receiver(struct ubgps_s * const gps, uint8_t const * data,
+                  size_t len)
 {
-  bool nmea_send = false;
-
   /* Check if NMEA line buffer is allocated */
 
   if (!gps->nmea.line)
     return OK;
 
-
-  if (data == '\r' || data == '\n')
+  while (len--)
     {
-      if (gps->nmea.current_len)
+      uint8_t const ch = *data++;
+      bool nmea_send = false;
+
+      if (ch == '\r' || ch == '\n')
         {
-          /* Add string NULL termination */
+          if (gps->nmea.current_len)
+            {
+              /* Add string NULL termination */
 
-          if (gps->nmea.line[(gps->nmea.current_len - 1)])
-            gps->nmea.line[gps->nmea.current_len++] = '\0';
+              if (gps->nmea.line[(gps->nmea.current_len - 1)])
+                gps->nmea.line[gps->nmea.current_len++] = '\0';
 
-          nmea_send = true;
+              nmea_send = true;
+            }
         }
-    }
-  else
-    {
-      /* Add NMEA data to line buffer */
+      else
+        {
+          /* Add NMEA data to line buffer */
 
-      gps->nmea.line[gps->nmea.current_len++] = data;
+          gps->nmea.line[gps->nmea.current_len++] = ch;
 
-      /* Check if buffer is full */
+          /* Check if buffer is full */
 
-      if (gps->nmea.current_len == (gps->nmea.line_size - 1))
-        {
-          gps->nmea.line[gps->nmea.current_len++] = '\0';
+          if (gps->nmea.current_len == (gps->nmea.line_size - 1))
+            {
+              gps->nmea.line[gps->nmea.current_len++] = '\0';
 
-          nmea_send = true;
+              nmea_send = true;
+            }
         }
-    }
 
-  /* Send NMEA data */
+      /* Send NMEA data */
 
-  if (nmea_send && gps->nmea.current_len > 1)
-    {
-      struct gps_event_nmea_data_s nmea;
+      if (nmea_send && gps->nmea.current_len > 1)
+        {
+          struct gps_event_nmea_data_s nmea;
 
-      /* Construct and publish NMEA event */
+          /* Construct and publish NMEA event */
 
-      nmea.super.id = GPS_EVENT_NMEA_DATA;
-      nmea.line = gps->nmea.line;
-      ubgps_publish_event(gps, (struct gps_event_s *)&nmea);
+          nmea.super.id = GPS_EVENT_NMEA_DATA;
+          nmea.line = gps->nmea.line;
+          ubgps_publish_event(gps, (struct gps_event_s *)&nmea);
 
-      /* Reset NMEA line length */
+          /* Reset NMEA line length */
 
-      gps->nmea.current_len = 0;
+          gps->nmea.current_len = 0;
+        }
     }
 
   return OK;
@@ -604,58 +628,21 @@ int nmea_receiver(struct ubgps_s * const gps, uint8_t const data)
 int ubgps_receiver(const struct pollfd * const pfd, void * const priv)
 {
   struct ubgps_s * const gps = (struct ubgps_s *)priv;
-  uint8_t input_buffer[32];
-  ssize_t input_bytes;
-  uint8_t * input;
-  int ret;
-
-  while (1)
-    {
-      /* Set file non-blocking */
-
-      ret = ubgps_set_nonblocking(gps, true);
-      if (ret < 0)
-        return ERROR;
+  ssize_t ret;
 
-      /* Read bytes from GPS module */
+  /* File is non-blocking, read until all available data is consumed */
 
-      input_bytes = read(pfd->fd, input_buffer, sizeof(input_buffer));
-      if (input_bytes <= 0)
-        break;
-
-      /* Set file blocking */
-
-      ret = ubgps_set_nonblocking(gps, false);
+  do
+    {
+      ret = ubx_msg_receive(gps, pfd->fd);
       if (ret < 0)
         return ERROR;
 
-      /* Send bytes to UBX message receiver */
-
-      input = input_buffer;
-      while (input_bytes--)
-        {
-          uint8_t data = *input++;
-
-          /* Pass data to UBX receiver */
-
-          if (ubx_msg_receive(gps, data) == ERROR)
-            {
-              /* Pass data to NMEA receiver */
-
-              nmea_receiver(gps, data);
-            }
-        }
-
       /* Run garbage collector. */
 
       __ubgps_gc_callbacks(gps);
     }
-
-  /* Set file blocking */
-
-  ret = ubgps_set_nonblocking(gps, false);
-  if (ret < 0)
-    return ERROR;
+  while (ret > 0);
 
   return OK;
 }
@@ -728,6 +715,29 @@ int ubgps_timeout(const int timer_id, void * const priv)
   return OK;
 }
 
+/****************************************************************************
+ * Name: ubgps_location_filter_timeout
+ *
+ * Description:
+ *   Publish current location estimate when location filter has not
+ *   converged within filter duration.
+ *
+ * Input Parameters:
+ *   gps         - GPS object
+ *
+ ****************************************************************************/
+void ubgps_location_filter_timeout(struct ubgps_s * const gps)
+{
+  DEBUGASSERT(gps);
+
+  gps->state.location_timer_id = -1;
+
+  dbg_int("location filter timeout, acc:%um\n",
+          ubgps_filter_accuracy(&gps->filter) / 1000);
+
+  ubgps_publish_filtered_location(gps);
+}
+
 /****************************************************************************
  * Name: ubgps_set_new_state
  *
@@ -1416,6 +1426,8 @@ int ubgps_send_aid_ini(struct ubgps_s * const gps)
   uint16_t gps_week = 0;
   uint32_t gps_week_msec = 0;
   uint32_t flags = 0;
+  int32_t clock_drift = 0;
+  uint32_t clock_drift_acc = 0;
   int status;
 
   DEBUGASSERT(gps);
@@ -1501,6 +1513,18 @@ int ubgps_send_aid_ini(struct ubgps_s * const gps)
         }
     }
 
+#ifdef CONFIG_UBGPS_AID_SNAPSHOT
+  if (ubgps_snapshot_get_clock_drift(&clock_drift, &clock_drift_acc))
+    {
+      dbg_int("Using stored clock drift: %dns/s, acc:%ups/s\n", clock_drift,
+              clock_drift_acc);
+
+      /* Clock drift is valid */
+
+      flags |= (1 << 4);
+    }
+#endif
+
   /* Allocate and setup AID-INI message */
 
   msg = UBX_MSG_ALLOC(AID, INI);
@@ -1517,8 +1541,8 @@ int ubgps_send_aid_ini(struct ubgps_s * const gps)
   UBX_SET_I4(msg, 24, 0);         /* Fractional part of time of week */
   UBX_SET_U4(msg, 28, 10000);     /* Milliseconds part of time accuracy */
   UBX_SET_U4(msg, 32, 0);         /* Nanoseconds part of time accuracy */
-  UBX_SET_I4(msg, 36, 0);         /* Clock drift or frequency */
-  UBX_SET_U4(msg, 40, 0);         /* Accuracy of clock drift or frequency */
+  UBX_SET_I4(msg, 36, clock_drift); /* Clock drift or frequency */
+  UBX_SET_U4(msg, 40, clock_drift_acc); /* Accuracy of clock drift or frequency */
 
   /* Time is valid, Altitude is invalid and Time is in UTC format */
 
@@ -1827,6 +1851,13 @@ int ubgps_handle_nav_pvt(struct ubgps_s * const gps, struct ubx_msg_s const * co
       ubgps_set_new_state(gps, GPS_STATE_FIX_ACQUIRED);
     }
 
+#ifdef CONFIG_UBGPS_AID_SNAPSHOT
+  /* Update aiding snapshot with new fix */
+
+  if (gps->location.fix_type > GPS_FIX_NOT_AVAILABLE)
+    ubgps_snapshot_fix(gps);
+#endif
+
   /* Publish time event only when date and/or time is known */
 
   if (gps->time.validity.date ||
@@ -1883,6 +1914,10 @@ int ubgps_handle_aid_alp(struct ubgps_s * const gps, struct ubx_msg_s const * co
       UBX_GET_U4(msg, 0), UBX_GET_U4(msg, 4), age/3600, age,
       UBX_GET_U2(msg, 14), UBX_GET_U1(msg, 20));
 
+#ifdef CONFIG_UBGPS_AID_SNAPSHOT
+  ubgps_snapshot_alp_age(age);
+#endif
+
   event.super.id = SM_EVENT_AID_STATUS;
   event.age = age;
   ubgps_sm_process(gps, (struct sm_event_s *)&event);
@@ -1935,7 +1970,13 @@ int ubgps_handle_aid_alpsrv(struct ubgps_s * const gps, struct ubx_msg_s const *
       return OK;
     }
 
+#ifdef CONFIG_UBGPS_AID_SNAPSHOT
+  /* Content of file is checked only once after it has changed */
+
+  if (!ubgps_snapshot_check_alp_file(gps->assist->alp_file))
+#else
   if (!ubgps_check_alp_file_validity(gps->assist->alp_file))
+#endif
     {
       free(gps->assist->alp_file);
       gps->assist->alp_file = NULL;
@@ -2147,11 +2188,22 @@ size_t __ubgps_full_write(int gps_fd, const void *buf, size_t writelen)
       nwritten = write(gps_fd, writebuf, writelen);
       if (nwritten == ERROR)
         {
+          struct pollfd pfd;
           int error = get_errno();
           if (error != EAGAIN)
             {
               return ERROR;
             }
+
+          /* File is non-blocking, wait until there is room in TX buffer */
+
+          pfd.fd = gps_fd;
+          pfd.events = POLLOUT;
+          pfd.revents = 0;
+          if (poll(&pfd, 1, UBGPS_WRITE_TIMEOUT) <= 0)
+            {
+              return ERROR;
+            }
           nwritten = 0;
         }
       writebuf += nwritten;
@@ -45,6 +45,7 @@
 
 #include "ubgps_events.h"
 #include "ubx.h"
+#include "ubgps_filter.h"
 
 /****************************************************************************
  * Public Defines
@@ -58,6 +59,10 @@
 
 #define DEFAULT_NAVIGATION_RATE       1000
 
+/* Maximum time to wait for room in GPS UART TX buffer [ms] */
+
+#define UBGPS_WRITE_TIMEOUT           1000
+
 /* How fast location hint accuracy degrades over time. */
 
 #define HINT_LOCATION_ACCURACY_DEGRADE_SPEED_KPH 50               /* km/h */
@@ -72,6 +77,24 @@
 
 #define HINT_LOCATION_MINIMUM_NEW_ACCURACY      INT_MAX           /* meters */
 
+/* Location filter configuration */
+
+#ifndef CONFIG_UBGPS_ACCURACY_FILTER_DURATION
+#  define CONFIG_UBGPS_ACCURACY_FILTER_DURATION   10                /* seconds */
+#endif
+
+#ifndef CONFIG_UBGPS_ACCURACY_FILTER_THRESHOLD
+#  define CONFIG_UBGPS_ACCURACY_FILTER_THRESHOLD  100               /* meters */
+#endif
+
+#ifndef CONFIG_UBGPS_ACCURACY_FILTER_MIN_SAMPLES
+#  define CONFIG_UBGPS_ACCURACY_FILTER_MIN_SAMPLES 3
+#endif
+
+#ifndef CONFIG_UBGPS_ACCURACY_FILTER_ACCEL
+#  define CONFIG_UBGPS_ACCURACY_FILTER_ACCEL      3                 /* m/s^2 */
+#endif
+
 /****************************************************************************
  * Public Types
  ****************************************************************************/
@@ -295,6 +318,10 @@ struct ubgps_s {
 
   struct gps_location_s filt_location;
 
+  /* Location filter */
+
+  struct ubgps_filter_s filter;
+
   /* NMEA line buffer */
 
   struct nmea_data_s nmea;
@@ -413,13 +440,15 @@ int ubx_callback(struct ubx_receiver_s const * const receiver,
  *
  * Input Parameters:
  *   gps         - GPS object
- *   data        - NMEA data (one character)
+ *   data        - NMEA data
+ *   len         - Length of NMEA data
  *
  * Returned Values:
  *   Status
  *
  ****************************************************************************/
-int nmea_receiver(struct ubgps_s * const gps, uint8_t const data);
+int nmea_receiver(struct ubgps_s * const gps, uint8_t const * data,
+                  size_t len);
 
 /****************************************************************************
  * Name: gps_receiver
@@ -832,6 +861,17 @@ void __ubgps_remove_timer(struct ubgps_s * const gps, uint16_t id);
 
 void __ubgps_gc_callbacks(struct ubgps_s * const gps);
 
+/****************************************************************************
+ * Name: ubgps_location_filter_timeout
+ *
+ * Description:
+ *   Publish current location estimate when location filter has not
+ *   converged within filter duration.
+ *
+ ****************************************************************************/
+
+void ubgps_location_filter_timeout(struct ubgps_s * const gps);
+
 /****************************************************************************
  * Name: ubgps_check_alp_file_validity
  *
@@ -848,6 +888,127 @@ bool ubgps_check_alp_file_validity(const char *filepath);
 
 size_t __ubgps_full_write(int gps_fd, const void *buf, size_t writelen);
 
+#ifdef CONFIG_UBGPS_AID_SNAPSHOT
+
+/****************************************************************************
+ * Name: ubgps_snapshot_load
+ *
+ * Description:
+ *   Load aiding snapshot from file and give stored fix as location hint.
+ *
+ ****************************************************************************/
+
+int ubgps_snapshot_load(struct ubgps_s * const gps);
+
+/****************************************************************************
+ * Name: ubgps_snapshot_inject
+ *
+ * Description:
+ *   Send stored ephemeris and almanac to receiver in one burst.
+ *
+ * Returned Values:
+ *   Number of messages sent or ERROR
+ *
+ ****************************************************************************/
+
+int ubgps_snapshot_inject(struct ubgps_s * const gps);
+
+/****************************************************************************
+ * Name: ubgps_snapshot_get_clock_drift
+ *
+ * Description:
+ *   Get stored receiver clock drift [ns/s] and its accuracy [ps/s].
+ *
+ ****************************************************************************/
+
+bool ubgps_snapshot_get_clock_drift(int32_t * const drift,
+                                    uint32_t * const accuracy);
+
+/****************************************************************************
+ * Name: ubgps_snapshot_power_on
+ *
+ * Description:
+ *   Mark GPS power-on for TTFF and on-time statistics.
+ *
+ ****************************************************************************/
+
+void ubgps_snapshot_power_on(struct ubgps_s * const gps);
+
+/****************************************************************************
+ * Name: ubgps_snapshot_power_off
+ *
+ * Description:
+ *   Update on-time statistics and write snapshot to file.
+ *
+ ****************************************************************************/
+
+int ubgps_snapshot_power_off(struct ubgps_s * const gps);
+
+/****************************************************************************
+ * Name: ubgps_snapshot_fix
+ *
+ * Description:
+ *   Store current fix, update TTFF and refresh ephemeris / almanac if
+ *   stored ones are getting old.
+ *
+ ****************************************************************************/
+
+void ubgps_snapshot_fix(struct ubgps_s * const gps);
+
+/****************************************************************************
+ * Name: ubgps_snapshot_handle_msg
+ *
+ * Description:
+ *   Handle NAV-CLOCK, AID-EPH and AID-ALM poll responses.
+ *
+ ****************************************************************************/
+
+int ubgps_snapshot_handle_msg(struct ubgps_s * const gps,
+                              struct ubx_msg_s const * const msg);
+
+/****************************************************************************
+ * Name: ubgps_snapshot_alp_age
+ *
+ * Description:
+ *   Store AlmanacPlus data age reported by AID-ALP.
+ *
+ ****************************************************************************/
+
+void ubgps_snapshot_alp_age(int32_t const age);
+
+/****************************************************************************
+ * Name: ubgps_snapshot_alp_invalidate
+ *
+ * Description:
+ *   Drop AlmanacPlus validity index, called when ALP file is rewritten.
+ *
+ ****************************************************************************/
+
+void ubgps_snapshot_alp_invalidate(void);
+
+/****************************************************************************
+ * Name: ubgps_snapshot_check_alp_file
+ *
+ * Description:
+ *   Check ALP file validity. File content is checked only if file has
+ *   changed since last successful check.
+ *
+ ****************************************************************************/
+
+bool ubgps_snapshot_check_alp_file(const char *filepath);
+
+/****************************************************************************
+ * Name: ubgps_snapshot_get_stats
+ *
+ * Description:
+ *   Get TTFF and GPS on-time statistics.
+ *
+ ****************************************************************************/
+
+int ubgps_snapshot_get_stats(struct gps_aiding_stats_s * const stats);
+
+#endif /* CONFIG_UBGPS_AID_SNAPSHOT */
+
 #ifdef CONFIG_UBGPS_ASSIST_UPDATER
 
 /****************************************************************************
@@ -0,0 +1,958 @@
+/****************************************************************************
+ * apps/system/ubgps/ubgps_snapshot.c
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <debug.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <crc32.h>
+
+#include "ubgps_internal.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#ifdef CONFIG_SYSTEM_UBGPS_DEBUG
+ #define dbg_snap(...) dbg(__VA_ARGS__)
+#else
+  #define dbg_snap(...)
+#endif
+
+#ifndef CONFIG_UBGPS_AID_SNAPSHOT_PATH
+  #define CONFIG_UBGPS_AID_SNAPSHOT_PATH    "/media/GPS/snapshot.bin"
+#endif
+
+#ifndef CONFIG_UBGPS_AID_SNAPSHOT_REFRESH
+  #define CONFIG_UBGPS_AID_SNAPSHOT_REFRESH (30*60)
+#endif
+
+#define SNAPSHOT_PATH         CONFIG_UBGPS_AID_SNAPSHOT_PATH
+#define SNAPSHOT_TMP_PATH     CONFIG_UBGPS_AID_SNAPSHOT_PATH ".tmp"
+
+#define SNAPSHOT_MAGIC        0x53504755 /* "UGPS" */
+#define SNAPSHOT_VERSION      1
+
+/* Snapshot content flags */
+
+#define SNAPSHOT_HAVE_FIX     (1 << 0)
+#define SNAPSHOT_HAVE_CLOCK   (1 << 1)
+#define SNAPSHOT_HAVE_ALP     (1 << 2)
+
+/* Number of GPS satellites reported by AID-EPH and AID-ALM polls */
+
+#define SNAPSHOT_NUM_SV       32
+
+/* Time in seconds stored data is used for aiding. Broadcast ephemeris is
+ * valid for four hours around its reference time, almanac for weeks. */
+
+#define SNAPSHOT_EPH_VALIDITY   (2*60*60)
+#define SNAPSHOT_ALM_VALIDITY   (30*24*60*60)
+#define SNAPSHOT_CLOCK_VALIDITY (24*60*60)
+
+/* Degradation of clock drift accuracy over time [ps/s per hour] */
+
+#define SNAPSHOT_CLOCK_ACC_DEGRADE  1000
+
+/* Largest stored record (AID-EPH with ephemeris) */
+
+#define SNAPSHOT_RECORD_MAX_LEN (sizeof(struct ubx_msg_s) + UBX_AID_EPH_LEN)
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* Snapshot file header. Header is followed by 'num_records' AID-EPH and
+ * AID-ALM messages stored as is (struct ubx_msg_s and payload). */
+
+struct snapshot_hdr_s
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t flags;
+
+  /* Stored AID-EPH / AID-ALM messages and their CRC */
+
+  uint16_t num_records;
+  uint16_t reserved;
+  uint32_t records_crc;
+
+  /* Last fix, position in 1e-7 degrees, altitude and accuracy in meters,
+   * time in UTC seconds */
+
+  int32_t latitude;
+  int32_t longitude;
+  int32_t altitude;
+  uint32_t accuracy;
+  uint32_t fix_time;
+
+  /* Receiver clock drift [ns/s] and its accuracy [ps/s] */
+
+  int32_t clock_drift;
+  uint32_t clock_drift_acc;
+  uint32_t clock_time;
+
+  /* Poll time of stored ephemeris and almanac, and satellites present */
+
+  uint32_t eph_time;
+  uint32_t alm_time;
+  uint32_t eph_mask;
+  uint32_t alm_mask;
+
+  /* AlmanacPlus validity index: size and modification time of file that
+   * passed validity check, and latest age reported by AID-ALP */
+
+  uint32_t alp_size;
+  uint32_t alp_mtime;
+  int32_t alp_age;
+  uint32_t alp_age_time;
+
+  /* TTFF and on-time statistics */
+
+  struct gps_aiding_stats_s stats;
+
+  /* CRC of header up to this field */
+
+  uint32_t crc;
+};
+
+/* Snapshot runtime state */
+
+struct snapshot_state_s
+{
+  /* Header of snapshot file */
+
+  struct snapshot_hdr_s hdr;
+
+  /* GPS power-on time and whether fix was acquired after it */
+
+  struct timespec power_on_ts;
+  bool powered:1;
+  bool fix_acquired:1;
+
+  /* Ephemeris / almanac poll in progress, records are written to
+   * temporary file until all responses are received. Header is updated
+   * only when poll completes. */
+
+  int poll_fd;
+  uint32_t poll_time;
+  uint16_t poll_records;
+  uint32_t poll_crc;
+  uint32_t poll_eph_mask;
+  uint32_t poll_alm_mask;
+  uint8_t poll_eph_count;
+  uint8_t poll_alm_count;
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct snapshot_state_s g_snapshot = { .poll_fd = -1 };
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: snapshot_utc_now
+ *
+ * Description:
+ *   Get current UTC time, if system time has been set.
+ *
+ ****************************************************************************/
+static bool snapshot_utc_now(uint32_t * const now)
+{
+  struct timespec ts;
+
+  if (!board_rtc_time_is_set(NULL))
+    return false;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  *now = ts.tv_sec;
+
+  return true;
+}
+
+/****************************************************************************
+ * Name: snapshot_elapsed_ms
+ *
+ * Description:
+ *   Milliseconds since GPS power-on.
+ *
+ ****************************************************************************/
+static uint32_t snapshot_elapsed_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec - g_snapshot.power_on_ts.tv_sec) * 1000 +
+         (ts.tv_nsec - g_snapshot.power_on_ts.tv_nsec) / (1000 * 1000);
+}
+
+/****************************************************************************
+ * Name: snapshot_hdr_crc
+ ****************************************************************************/
+static uint32_t snapshot_hdr_crc(struct snapshot_hdr_s const * const hdr)
+{
+  return crc32((uint8_t const *)hdr, offsetof(struct snapshot_hdr_s, crc));
+}
+
+/****************************************************************************
+ * Name: snapshot_read_record
+ *
+ * Description:
+ *   Read next stored UBX message from snapshot file.
+ *
+ * Returned Values:
+ *   Size of record, 0 at end of file or ERROR for invalid record.
+ *
+ ****************************************************************************/
+static ssize_t snapshot_read_record(int fd, struct ubx_msg_s * const msg)
+{
+  ssize_t ret;
+
+  ret = read(fd, msg, sizeof(struct ubx_msg_s));
+  if (ret == 0)
+    return 0;
+
+  if (ret != sizeof(struct ubx_msg_s))
+    return ERROR;
+
+  if (msg->class_id != UBX_CLASS_AID ||
+      !((msg->msg_id == UBX_AID_EPH && msg->length == UBX_AID_EPH_LEN) ||
+        (msg->msg_id == UBX_AID_ALM && msg->length == UBX_AID_ALM_LEN)))
+    return ERROR;
+
+  ret = read(fd, msg->payload, msg->length);
+  if (ret != msg->length)
+    return ERROR;
+
+  return sizeof(struct ubx_msg_s) + msg->length;
+}
+
+/****************************************************************************
+ * Name: snapshot_write_hdr
+ *
+ * Description:
+ *   Write snapshot header to start of file.
+ *
+ ****************************************************************************/
+static int snapshot_write_hdr(int fd)
+{
+  struct snapshot_hdr_s * const hdr = &g_snapshot.hdr;
+  ssize_t ret;
+
+  hdr->magic = SNAPSHOT_MAGIC;
+  hdr->version = SNAPSHOT_VERSION;
+  hdr->crc = snapshot_hdr_crc(hdr);
+
+  if (lseek(fd, 0, SEEK_SET) < 0)
+    return ERROR;
+
+  ret = write(fd, hdr, sizeof(*hdr));
+  if (ret != sizeof(*hdr))
+    return ERROR;
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: snapshot_poll_abort
+ *
+ * Description:
+ *   Drop ephemeris / almanac poll in progress. Snapshot file and header
+ *   keep records of previous complete poll.
+ *
+ ****************************************************************************/
+static void snapshot_poll_abort(void)
+{
+  if (g_snapshot.poll_fd < 0)
+    return;
+
+  close(g_snapshot.poll_fd);
+  g_snapshot.poll_fd = -1;
+  (void)unlink(SNAPSHOT_TMP_PATH);
+}
+
+/****************************************************************************
+ * Name: snapshot_poll_finish
+ *
+ * Description:
+ *   Complete ephemeris / almanac poll and replace snapshot file with
+ *   temporary file containing new records.
+ *
+ ****************************************************************************/
+static int snapshot_poll_finish(void)
+{
+  struct snapshot_hdr_s * const hdr = &g_snapshot.hdr;
+  struct snapshot_hdr_s const prev = *hdr;
+  int ret;
+
+  if (g_snapshot.poll_fd < 0)
+    return OK;
+
+  hdr->num_records = g_snapshot.poll_records;
+  hdr->records_crc = g_snapshot.poll_crc;
+  hdr->eph_mask = g_snapshot.poll_eph_mask;
+  hdr->alm_mask = g_snapshot.poll_alm_mask;
+  hdr->eph_time = g_snapshot.poll_time;
+  hdr->alm_time = g_snapshot.poll_time;
+
+  ret = snapshot_write_hdr(g_snapshot.poll_fd);
+  if (ret != OK)
+    {
+      dbg("Aiding snapshot write failed: %d\n", get_errno());
+
+      /* Previous snapshot file is still intact */
+
+      snapshot_poll_abort();
+      *hdr = prev;
+      return ERROR;
+    }
+
+  close(g_snapshot.poll_fd);
+  g_snapshot.poll_fd = -1;
+
+  (void)unlink(SNAPSHOT_PATH);
+  if (rename(SNAPSHOT_TMP_PATH, SNAPSHOT_PATH) != OK)
+    {
+      dbg("Aiding snapshot rename failed: %d\n", get_errno());
+
+      /* Previous records are gone with old file */
+
+      (void)unlink(SNAPSHOT_TMP_PATH);
+      *hdr = prev;
+      hdr->num_records = 0;
+      hdr->eph_mask = 0;
+      hdr->alm_mask = 0;
+      hdr->eph_time = 0;
+      hdr->alm_time = 0;
+      return ERROR;
+    }
+
+  dbg_snap("Aiding snapshot: %u records, eph:0x%08x, alm:0x%08x\n",
+           hdr->num_records, hdr->eph_mask, hdr->alm_mask);
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: snapshot_poll_start
+ *
+ * Description:
+ *   Poll receiver clock, ephemeris and almanac for snapshot.
+ *
+ ****************************************************************************/
+static int snapshot_poll_start(struct ubgps_s * const gps, uint32_t now)
+{
+  struct snapshot_hdr_s empty = {};
+  struct ubx_msg_s * msg;
+  int status;
+
+  g_snapshot.poll_fd = open(SNAPSHOT_TMP_PATH, O_WRONLY | O_CREAT | O_TRUNC,
+                            0666);
+  if (g_snapshot.poll_fd < 0)
+    {
+      dbg("Aiding snapshot open failed: %d\n", get_errno());
+      return ERROR;
+    }
+
+  /* Reserve space for header */
+
+  if (write(g_snapshot.poll_fd, &empty, sizeof(empty)) != sizeof(empty))
+    goto errout;
+
+  g_snapshot.poll_time = now;
+  g_snapshot.poll_records = 0;
+  g_snapshot.poll_crc = 0;
+  g_snapshot.poll_eph_mask = 0;
+  g_snapshot.poll_alm_mask = 0;
+  g_snapshot.poll_eph_count = 0;
+  g_snapshot.poll_alm_count = 0;
+
+  /* Poll messages, responses arrive through ubgps_snapshot_handle_msg */
+
+  msg = UBX_MSG_ALLOC(NAV, CLOCK_POLL);
+  if (!msg)
+    goto errout;
+
+  status = ubx_msg_send(gps, gps->fd, msg);
+  UBX_MSG_FREE(msg);
+  if (status != OK)
+    goto errout;
+
+  msg = UBX_MSG_ALLOC(AID, EPH_POLL);
+  if (!msg)
+    goto errout;
+
+  status = ubx_msg_send(gps, gps->fd, msg);
+  UBX_MSG_FREE(msg);
+  if (status != OK)
+    goto errout;
+
+  msg = UBX_MSG_ALLOC(AID, ALM_POLL);
+  if (!msg)
+    goto errout;
+
+  status = ubx_msg_send(gps, gps->fd, msg);
+  UBX_MSG_FREE(msg);
+  if (status != OK)
+    goto errout;
+
+  return OK;
+
+errout:
+  snapshot_poll_abort();
+
+  return ERROR;
+}
+
+/****************************************************************************
+ * Name: snapshot_add_record
+ *
+ * Description:
+ *   Append AID-EPH or AID-ALM message to snapshot being polled.
+ *
+ ****************************************************************************/
+static int snapshot_add_record(struct ubx_msg_s const * const msg)
+{
+  size_t const len = sizeof(struct ubx_msg_s) + msg->length;
+
+  if (write(g_snapshot.poll_fd, msg, len) != len)
+    {
+      dbg("Aiding snapshot write failed: %d\n", get_errno());
+
+      snapshot_poll_abort();
+      return ERROR;
+    }
+
+  g_snapshot.poll_crc = crc32part((uint8_t const *)msg, len,
+                                  g_snapshot.poll_crc);
+  g_snapshot.poll_records++;
+
+  return OK;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: ubgps_snapshot_load
+ *
+ * Description:
+ *   Load aiding snapshot from file and give stored fix as location hint.
+ *
+ ****************************************************************************/
+int ubgps_snapshot_load(struct ubgps_s * const gps)
+{
+  struct snapshot_hdr_s * const hdr = &g_snapshot.hdr;
+  struct ubx_msg_s * msg;
+  uint32_t crc = 0;
+  uint32_t now;
+  ssize_t len;
+  int count;
+  int fd;
+
+  DEBUGASSERT(gps);
+
+  memset(hdr, 0, sizeof(*hdr));
+
+  fd = open(SNAPSHOT_PATH, O_RDONLY);
+  if (fd < 0)
+    {
+      dbg_snap("No aiding snapshot\n");
+      return ERROR;
+    }
+
+  if (read(fd, hdr, sizeof(*hdr)) != sizeof(*hdr) ||
+      hdr->magic != SNAPSHOT_MAGIC || hdr->version != SNAPSHOT_VERSION ||
+      hdr->crc != snapshot_hdr_crc(hdr))
+    {
+      dbg("Invalid aiding snapshot\n");
+
+      memset(hdr, 0, sizeof(*hdr));
+      close(fd);
+      return ERROR;
+    }
+
+  /* Verify stored messages once, so that they can be injected at power-on
+   * without further checks. */
+
+  msg = malloc(SNAPSHOT_RECORD_MAX_LEN);
+  if (!msg)
+    {
+      hdr->num_records = 0;
+      close(fd);
+      return ERROR;
+    }
+
+  for (count = 0; count < hdr->num_records; count++)
+    {
+      len = snapshot_read_record(fd, msg);
+      if (len <= 0)
+        break;
+
+      crc = crc32part((uint8_t const *)msg, len, crc);
+    }
+
+  if (count != hdr->num_records || crc != hdr->records_crc)
+    {
+      dbg("Aiding snapshot records corrupted\n");
+
+      /* Drop records and refresh them on next fix */
+
+      hdr->num_records = 0;
+      hdr->eph_mask = 0;
+      hdr->alm_mask = 0;
+      hdr->eph_time = 0;
+      hdr->alm_time = 0;
+    }
+
+  free(msg);
+  close(fd);
+
+  dbg_snap("Aiding snapshot: flags:0x%x, records:%u, starts:%u, fixes:%u, "
+           "avg TTFF:%ums\n", hdr->flags, hdr->num_records,
+           hdr->stats.starts, hdr->stats.fixes, hdr->stats.avg_ttff);
+
+  /* Give last fix as location hint, degraded by its age. */
+
+  if ((hdr->flags & SNAPSHOT_HAVE_FIX) && snapshot_utc_now(&now) &&
+      now >= hdr->fix_time)
+    {
+      uint64_t accuracy;
+
+      accuracy = hdr->accuracy;
+      accuracy += (uint64_t)HINT_LOCATION_ACCURACY_DEGRADE_SPEED_MPS *
+                  (now - hdr->fix_time);
+
+      if (accuracy <= HINT_LOCATION_MAX_ACCURACY)
+        {
+          (void)ubgps_give_location_hint((double)hdr->latitude / 1e7,
+                                         (double)hdr->longitude / 1e7,
+                                         hdr->altitude, accuracy);
+        }
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ubgps_snapshot_inject
+ *
+ * Description:
+ *   Send stored ephemeris and almanac to receiver in one burst.
+ *
+ ****************************************************************************/
+int ubgps_snapshot_inject(struct ubgps_s * const gps)
+{
+  struct snapshot_hdr_s const * const hdr = &g_snapshot.hdr;
+  struct ubx_msg_s * msg;
+  bool use_eph;
+  bool use_alm;
+  uint32_t now;
+  int sent = 0;
+  int count;
+  int fd;
+
+  DEBUGASSERT(gps);
+
+  if (hdr->num_records == 0 || !snapshot_utc_now(&now))
+    return 0;
+
+  use_eph = (now - hdr->eph_time) < SNAPSHOT_EPH_VALIDITY;
+  use_alm = (now - hdr->alm_time) < SNAPSHOT_ALM_VALIDITY;
+  if (!use_eph && !use_alm)
+    return 0;
+
+  fd = open(SNAPSHOT_PATH, O_RDONLY);
+  if (fd < 0)
+    return ERROR;
+
+  msg = malloc(SNAPSHOT_RECORD_MAX_LEN);
+  if (!msg)
+    {
+      close(fd);
+      return ERROR;
+    }
+
+  if (lseek(fd, sizeof(*hdr), SEEK_SET) < 0)
+    goto out;
+
+  for (count = 0; count < hdr->num_records; count++)
+    {
+      if (snapshot_read_record(fd, msg) <= 0)
+        break;
+
+      if ((msg->msg_id == UBX_AID_EPH && !use_eph) ||
+          (msg->msg_id == UBX_AID_ALM && !use_alm))
+        continue;
+
+      if (ubx_msg_send(gps, gps->fd, msg) != OK)
+        break;
+
+      sent++;
+    }
+
+  dbg_snap("Injected %d aiding messages (eph:%d, alm:%d)\n", sent, use_eph,
+           use_alm);
+
+out:
+  free(msg);
+  close(fd);
+
+  return sent;
+}
+
+/****************************************************************************
+ * Name: ubgps_snapshot_get_clock_drift
+ *
+ * Description:
+ *   Get stored receiver clock drift [ns/s] and its accuracy [ps/s].
+ *
+ ****************************************************************************/
+bool ubgps_snapshot_get_clock_drift(int32_t * const drift,
+                                    uint32_t * const accuracy)
+{
+  struct snapshot_hdr_s const * const hdr = &g_snapshot.hdr;
+  uint32_t now;
+  uint32_t age;
+
+  if (!(hdr->flags & SNAPSHOT_HAVE_CLOCK) || !snapshot_utc_now(&now))
+    return false;
+
+  age = now - hdr->clock_time;
+  if (age >= SNAPSHOT_CLOCK_VALIDITY)
+    return false;
+
+  /* Oscillator drift changes with temperature, degrade accuracy by age. */
+
+  *drift = hdr->clock_drift;
+  *accuracy = hdr->clock_drift_acc +
+              (age / (60 * 60) + 1) * SNAPSHOT_CLOCK_ACC_DEGRADE;
+
+  return true;
+}
+
+/****************************************************************************
+ * Name: ubgps_snapshot_power_on
+ *
+ * Description:
+ *   Mark GPS power-on for TTFF and on-time statistics.
+ *
+ ****************************************************************************/
+void ubgps_snapshot_power_on(struct ubgps_s * const gps)
+{
+  clock_gettime(CLOCK_MONOTONIC, &g_snapshot.power_on_ts);
+  g_snapshot.powered = true;
+  g_snapshot.fix_acquired = false;
+  g_snapshot.hdr.stats.starts++;
+}
+
+/****************************************************************************
+ * Name: ubgps_snapshot_power_off
+ *
+ * Description:
+ *   Update on-time statistics and write snapshot to file.
+ *
+ ****************************************************************************/
+int ubgps_snapshot_power_off(struct ubgps_s * const gps)
+{
+  struct snapshot_hdr_s * const hdr = &g_snapshot.hdr;
+  int ret;
+  int fd;
+
+  if (g_snapshot.powered)
+    {
+      hdr->stats.last_on_time = snapshot_elapsed_ms() / 1000;
+      hdr->stats.total_on_time += hdr->stats.last_on_time;
+      g_snapshot.powered = false;
+    }
+
+  /* Partial poll would replace complete set of records with fewer ones,
+   * drop it and retry after next power-on. */
+
+  snapshot_poll_abort();
+
+  /* Update header of existing file */
+
+  fd = open(SNAPSHOT_PATH, O_WRONLY | O_CREAT, 0666);
+  if (fd < 0)
+    {
+      dbg("Aiding snapshot open failed: %d\n", get_errno());
+      return ERROR;
+    }
+
+  ret = snapshot_write_hdr(fd);
+  close(fd);
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: ubgps_snapshot_fix
+ *
+ * Description:
+ *   Store current fix, update TTFF and refresh ephemeris / almanac if
+ *   stored ones are getting old.
+ *
+ ****************************************************************************/
+void ubgps_snapshot_fix(struct ubgps_s * const gps)
+{
+  struct snapshot_hdr_s * const hdr = &g_snapshot.hdr;
+  struct gps_aiding_stats_s * const stats = &hdr->stats;
+  uint32_t now;
+
+  DEBUGASSERT(gps);
+
+  if (g_snapshot.powered && !g_snapshot.fix_acquired)
+    {
+      g_snapshot.fix_acquired = true;
+
+      stats->fixes++;
+      stats->last_ttff = snapshot_elapsed_ms();
+      stats->avg_ttff += ((int32_t)stats->last_ttff - (int32_t)stats->avg_ttff) /
+                         (int32_t)stats->fixes;
+
+      dbg_snap("TTFF: %ums, average: %ums\n", stats->last_ttff,
+               stats->avg_ttff);
+    }
+
+  if (!snapshot_utc_now(&now))
+    return;
+
+  hdr->flags |= SNAPSHOT_HAVE_FIX;
+  hdr->latitude = gps->location.latitude;
+  hdr->longitude = gps->location.longitude;
+  hdr->altitude = gps->location.height / 1000;
+  hdr->accuracy = gps->location.horizontal_accuracy / 1000;
+  hdr->fix_time = now;
+
+  /* Refresh ephemeris and almanac. Responses are handled only in states
+   * reached after initialization. */
+
+  if (g_snapshot.poll_fd < 0 &&
+      (hdr->eph_time == 0 ||
+       now - hdr->eph_time >= CONFIG_UBGPS_AID_SNAPSHOT_REFRESH) &&
+      (gps->state.current_state == GPS_STATE_SEARCHING_FIX ||
+       gps->state.current_state == GPS_STATE_FIX_ACQUIRED) &&
+      !ubx_busy(&gps->state.ubx_receiver))
+    {
+      (void)snapshot_poll_start(gps, now);
+    }
+}
+
+/****************************************************************************
+ * Name: ubgps_snapshot_handle_msg
+ *
+ * Description:
+ *   Handle NAV-CLOCK, AID-EPH and AID-ALM poll responses.
+ *
+ ****************************************************************************/
+int ubgps_snapshot_handle_msg(struct ubgps_s * const gps,
+                              struct ubx_msg_s const * const msg)
+{
+  struct snapshot_hdr_s * const hdr = &g_snapshot.hdr;
+  uint32_t now;
+  uint32_t svid;
+
+  DEBUGASSERT(gps && msg);
+
+  if (msg->class_id == UBX_CLASS_NAV && msg->msg_id == UBX_NAV_CLOCK)
+    {
+      if (msg->length != UBX_NAV_CLOCK_LEN || !snapshot_utc_now(&now))
+        return OK;
+
+      hdr->flags |= SNAPSHOT_HAVE_CLOCK;
+      hdr->clock_drift = UBX_GET_I4(msg, 8);
+      hdr->clock_drift_acc = UBX_GET_U4(msg, 16);
+      hdr->clock_time = now;
+
+      dbg_snap("Clock drift: %dns/s, acc:%ups/s\n", hdr->clock_drift,
+               hdr->clock_drift_acc);
+
+      return OK;
+    }
+
+  if (g_snapshot.poll_fd < 0 || msg->class_id != UBX_CLASS_AID ||
+      msg->length < 8)
+    return OK;
+
+  svid = UBX_GET_U4(msg, 0);
+
+  /* Responses without data (8 bytes) are counted, but not stored */
+
+  if (msg->msg_id == UBX_AID_EPH)
+    {
+      g_snapshot.poll_eph_count++;
+
+      if (msg->length == UBX_AID_EPH_LEN && svid >= 1 &&
+          svid <= SNAPSHOT_NUM_SV && UBX_GET_U4(msg, 4) != 0)
+        {
+          if (snapshot_add_record(msg) != OK)
+            return ERROR;
+
+          g_snapshot.poll_eph_mask |= 1 << (svid - 1);
+        }
+    }
+  else if (msg->msg_id == UBX_AID_ALM)
+    {
+      g_snapshot.poll_alm_count++;
+
+      if (msg->length == UBX_AID_ALM_LEN && svid >= 1 &&
+          svid <= SNAPSHOT_NUM_SV && UBX_GET_U4(msg, 4) != 0)
+        {
+          if (snapshot_add_record(msg) != OK)
+            return ERROR;
+
+          g_snapshot.poll_alm_mask |= 1 << (svid - 1);
+        }
+    }
+
+  if (g_snapshot.poll_eph_count >= SNAPSHOT_NUM_SV &&
+      g_snapshot.poll_alm_count >= SNAPSHOT_NUM_SV)
+    {
+      return snapshot_poll_finish();
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ubgps_snapshot_alp_age
+ *
+ * Description:
+ *   Store AlmanacPlus data age reported by AID-ALP.
+ *
+ ****************************************************************************/
+void ubgps_snapshot_alp_age(int32_t const age)
+{
+  uint32_t now;
+
+  if (age < 0 || !snapshot_utc_now(&now))
+    return;
+
+  g_snapshot.hdr.alp_age = age;
+  g_snapshot.hdr.alp_age_time = now;
+}
+
+/****************************************************************************
+ * Name: ubgps_snapshot_alp_invalidate
+ *
+ * Description:
+ *   Drop AlmanacPlus validity index, called when ALP file is rewritten.
+ *
+ ****************************************************************************/
+void ubgps_snapshot_alp_invalidate(void)
+{
+  g_snapshot.hdr.flags &= ~SNAPSHOT_HAVE_ALP;
+}
+
+/****************************************************************************
+ * Name: ubgps_snapshot_check_alp_file
+ *
+ * Description:
+ *   Check ALP file validity. File content is checked only if file has
+ *   changed since last successful check.
+ *
+ ****************************************************************************/
+bool ubgps_snapshot_check_alp_file(const char *filepath)
+{
+  struct snapshot_hdr_s * const hdr = &g_snapshot.hdr;
+  struct stat st;
+
+  if (stat(filepath, &st) < 0)
+    {
+      hdr->flags &= ~SNAPSHOT_HAVE_ALP;
+      return false;
+    }
+
+  if ((hdr->flags & SNAPSHOT_HAVE_ALP) &&
+      hdr->alp_size == st.st_size && hdr->alp_mtime == st.st_mtime)
+    {
+      return true;
+    }
+
+  if (!ubgps_check_alp_file_validity(filepath))
+    {
+      hdr->flags &= ~SNAPSHOT_HAVE_ALP;
+      return false;
+    }
+
+  hdr->flags |= SNAPSHOT_HAVE_ALP;
+  hdr->alp_size = st.st_size;
+  hdr->alp_mtime = st.st_mtime;
+
+  return true;
+}
+
+/****************************************************************************
+ * Name: ubgps_snapshot_get_stats
+ *
+ * Description:
+ *   Get TTFF and GPS on-time statistics.
+ *
+ ****************************************************************************/
+int ubgps_snapshot_get_stats(struct gps_aiding_stats_s * const stats)
+{
+  DEBUGASSERT(stats);
+
+  *stats = g_snapshot.hdr.stats;
+
+  if (g_snapshot.powered)
+    {
+      /* Include current power-on period */
+
+      stats->last_on_time = snapshot_elapsed_ms() / 1000;
+      stats->total_on_time += stats->last_on_time;
+    }
+
+  return OK;
+}
@@ -215,6 +215,12 @@ static int ubgps_sm_poweroff(struct ubgps_s * const gps, struct sm_event_s const
           dbg_sm("SM_EVENT_ENTRY\n");
           if (gps->state.powered)
             {
+#ifdef CONFIG_UBGPS_AID_SNAPSHOT
+              /* Store aiding snapshot for next power-up */
+
+              (void)ubgps_snapshot_power_off(gps);
+#endif
+
               /* Power down GPS chip */
 
               board_gps_power(false);
@@ -232,9 +238,9 @@ static int ubgps_sm_poweroff(struct ubgps_s * const gps, struct sm_event_s const
 
           ubgps_report_target_state(gps, false);
 
-          /* Reset PSM accuracy filter */
+          /* Reset location filter */
 
-          gps->filt_location.horizontal_accuracy = 0;
+          ubgps_filter_reset(&gps->filter);
 
           /* Make sure that timers are not running */
 
@@ -327,6 +333,10 @@ static int ubgps_sm_poweroff(struct ubgps_s * const gps, struct sm_event_s const
               /* Mark GPS power up */
 
               gps->state.powered = true;
+
+#ifdef CONFIG_UBGPS_AID_SNAPSHOT
+              ubgps_snapshot_power_on(gps);
+#endif
             }
 
 #if defined(BOARD_HAS_GPS_PM_SET_NEXT_MESSAGE_TIME)
@@ -454,6 +464,12 @@ static int ubgps_sm_global(struct ubgps_s * const gps, struct sm_event_s const *
 
               return ubgps_send_aid_alp_poll(gps);
             }
+          else if (timeout->timer_id == gps->state.location_timer_id)
+            {
+              /* Location filter did not converge in time */
+
+              ubgps_location_filter_timeout(gps);
+            }
 
           return OK;
         }
@@ -476,6 +492,14 @@ static int ubgps_sm_global(struct ubgps_s * const gps, struct sm_event_s const *
             {
               return ubgps_handle_aid_alp(gps, msg);
             }
+#ifdef CONFIG_UBGPS_AID_SNAPSHOT
+          else if ((msg->class_id == UBX_CLASS_NAV && msg->msg_id == UBX_NAV_CLOCK) ||
+                   (msg->class_id == UBX_CLASS_AID && msg->msg_id == UBX_AID_EPH) ||
+                   (msg->class_id == UBX_CLASS_AID && msg->msg_id == UBX_AID_ALM))
+            {
+              return ubgps_snapshot_handle_msg(gps, msg);
+            }
+#endif
 
           dbg_sm("Unhandled UBX message, class:0x%02x, msg:0x%02x, len:%d.\n",
               ubx_msg->msg->class_id, ubx_msg->msg->msg_id, ubx_msg->msg->length);
@@ -973,6 +997,13 @@ static int ubgps_init_process_phase(struct ubgps_s * const gps, bool next)
 
               if (status == OK)
                 {
+#ifdef CONFIG_UBGPS_AID_SNAPSHOT
+                  /* Inject stored ephemeris and almanac after time and
+                   * position */
+
+                  (void)ubgps_snapshot_inject(gps);
+#endif
+
                   /* Move to next state */
 
                   gps->state.init_phase++;
@@ -1000,8 +1031,13 @@ static int ubgps_init_process_phase(struct ubgps_s * const gps, bool next)
                   ret = pthread_mutex_trylock(&g_aid_mutex);
                   if (ret == 0)
                     {
+#ifdef CONFIG_UBGPS_AID_SNAPSHOT
+                      if (gps->assist->alp_file && gps->assist->alp_file_id &&
+                          ubgps_snapshot_check_alp_file(gps->assist->alp_file))
+#else
                       if (gps->assist->alp_file && gps->assist->alp_file_id &&
                           ubgps_check_alp_file_validity(gps->assist->alp_file))
+#endif
                         {
                           alpsrv_enabled = true;
                         }
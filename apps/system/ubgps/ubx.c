@@ -39,7 +39,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <unistd.h>
 #include <errno.h>
 #include <debug.h>
 
@@ -113,30 +115,230 @@ static int ubx_timeout(const int timer_id, void * const priv)
 
   else if (timer_id == receiver->receive_timer_id)
     {
-      dbg_ubx("GPS UBX receiver reset due to timeout, state:%u\n",
-          receiver->state.state);
+      dbg_ubx("GPS UBX receiver reset due to timeout, %u bytes pending\n",
+          receiver->state.rx_len);
 
       /* Reset timer ID */
 
       receiver->receive_timer_id = -1;
 
-      /* Free pending UBX message */
+      /* Drop partially received frame */
 
-      if (receiver->state.state >= UBX_STATE_MSG_PAYLOAD)
+      receiver->state.rx_len = 0;
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: ubx_checksum
+ *
+ * Description:
+ *   Calculate UBX checksum (8-Bit Fletcher Algorithm) over 'len' bytes,
+ *   continuing from 'ck'.
+ *
+ ****************************************************************************/
+static void ubx_checksum(uint8_t const * data, size_t len, uint8_t ck[2])
+{
+  uint8_t ck_a = ck[0];
+  uint8_t ck_b = ck[1];
+
+  while (len >= 4)
+    {
+      ck_a += data[0];
+      ck_b += ck_a;
+      ck_a += data[1];
+      ck_b += ck_a;
+      ck_a += data[2];
+      ck_b += ck_a;
+      ck_a += data[3];
+      ck_b += ck_a;
+      data += 4;
+      len -= 4;
+    }
+
+  while (len--)
+    {
+      ck_a += *data++;
+      ck_b += ck_a;
+    }
+
+  ck[0] = ck_a;
+  ck[1] = ck_b;
+}
+
+/****************************************************************************
+ * Name: ubx_msg_dispatch
+ *
+ * Description:
+ *   Handle acknowledgment and deliver received UBX message to callback
+ *
+ ****************************************************************************/
+static void ubx_msg_dispatch(struct ubgps_s * const gps,
+                             struct ubx_receiver_s * const receiver,
+                             struct ubx_msg_s const * msg)
+{
+  struct ubx_msg_s * copy = NULL;
+#ifdef UBX_DEBUG
+  uint16_t i;
+#endif
+
+  dbg_ubx("Class:0x%02x, msg:0x%02x, length:%d\n",
+      msg->class_id, msg->msg_id, msg->length);
+
+  /* Payload is accessed with word loads, so deliver message in place only
+   * when payload is suitably aligned in receive buffer. */
+
+  if (((uintptr_t)msg->payload & (sizeof(uint32_t) - 1)) != 0)
+    {
+      copy = malloc(sizeof(struct ubx_msg_s) + msg->length);
+      if (!copy)
         {
-          /* Free allocated message buffer */
+          dbg_ubx("Unable to allocate memory for GPS UBX message. " \
+              "Class:0x%02x, msg:0x%02x. Payload:%d\n",
+              msg->class_id, msg->msg_id, msg->length);
+          return;
+        }
+
+      memcpy(copy, msg, sizeof(struct ubx_msg_s) + msg->length);
+      msg = copy;
+    }
+
+  /* Check if we are waiting for UBX message acknowledgment */
 
-          free(receiver->state.msg);
+  if (receiver->send_timer_id >= 0)
+    {
+      /* Check that message is ACK-ACK or ACK-NAK */
+
+      if (msg->length == UBX_ACK_ACK_LEN &&
+          msg->class_id == UBX_CLASS_ACK &&
+          (msg->msg_id == UBX_ACK_ACK ||
+           msg->msg_id == UBX_ACK_NAK))
+        {
+          uint8_t class_id = UBX_GET_U1(msg, 0);
+          uint8_t msg_id = UBX_GET_U1(msg, 1);
+
+          /* Check if ACK-ACK or ACK-NAK is for correct message */
+
+          if (class_id == receiver->state.waiting_ack.class_id &&
+              msg_id == receiver->state.waiting_ack.msg_id)
+            {
+              /* Stop send timeout timer */
+              __ubgps_remove_timer(gps, receiver->send_timer_id);
+
+              /* Reset timer ID */
+
+              receiver->send_timer_id = -1;
+            }
         }
+    }
 
-      /* Reset UBX receiver state */
+#ifdef UBX_DEBUG
+  printf("payload:");
+  for(i=0; i<msg->length; i++)
+    {
+      if (i%10 == 0) printf("\n");
+      printf("%02X", msg->payload[i]);
+    }
+  printf("\n");
+#endif /* UBX_DEBUG */
 
-      receiver->state.state = UBX_STATE_MSG_WAIT;
-      receiver->state.ck_a = 0;
-      receiver->state.ck_b = 0;
+  /* Deliver UBX message to callback */
+
+  receiver->callback(receiver, receiver->priv, msg, false);
+
+  free(copy);
+}
+
+/****************************************************************************
+ * Name: ubx_frame_scan
+ *
+ * Description:
+ *   Find UBX frames in 'buf' and deliver them. Data between frames is
+ *   passed to NMEA receiver.
+ *
+ * Returned Values:
+ *   Number of bytes consumed. Rest of buffer starts with incomplete frame.
+ *
+ ****************************************************************************/
+static size_t ubx_frame_scan(struct ubgps_s * const gps,
+                             struct ubx_receiver_s * const receiver,
+                             uint8_t * const buf, size_t const len)
+{
+  uint8_t * frame;
+  uint8_t ck[2];
+  size_t pos = 0;
+  size_t frame_len;
+  uint16_t payload_len;
+
+  while (pos < len)
+    {
+      /* Locate next sync character, anything before it is NMEA */
+
+      frame = memchr(&buf[pos], UBX_SYNC_CHAR_1, len - pos);
+      if (frame != &buf[pos])
+        {
+          size_t nmea_len = (frame ? frame - buf : len) - pos;
+
+          nmea_receiver(gps, &buf[pos], nmea_len);
+          pos += nmea_len;
+
+          if (!frame)
+            break;
+        }
+
+      if (len - pos < 2)
+        break;
+
+      if (frame[1] != UBX_SYNC_CHAR_2)
+        {
+          /* Not a frame, resynchronize from next byte */
+
+          pos++;
+          continue;
+        }
+
+      if (len - pos < UBX_FRAME_HEADER_LEN)
+        break;
+
+      payload_len = frame[4] | (frame[5] << 8);
+      if (payload_len > UBX_MSG_MAX_PAYLOAD_LENGTH)
+        {
+          dbg_ubx("Ignoring too long GPS UBX message.\n");
+
+          pos++;
+          continue;
+        }
+
+      frame_len = UBX_FRAME_HEADER_LEN + payload_len + UBX_FRAME_CHECKSUM_LEN;
+      if (len - pos < frame_len)
+        break;
+
+      /* Checksum covers message header and payload */
+
+      ck[0] = 0;
+      ck[1] = 0;
+      ubx_checksum(&frame[2], frame_len - 2 - UBX_FRAME_CHECKSUM_LEN, ck);
+
+      if (ck[0] != frame[frame_len - 2] || ck[1] != frame[frame_len - 1])
+        {
+          dbg_ubx("Invalid checksum (got %02x%02x, expected %02x%02x).\n",
+              frame[frame_len - 2], frame[frame_len - 1], ck[0], ck[1]);
+
+          pos++;
+          continue;
+        }
+
+      ubx_msg_dispatch(gps, receiver, (struct ubx_msg_s *)&frame[2]);
+      pos += frame_len;
+
+      /* Stop if receiver was reset by callback */
+
+      if (receiver->state.rx_len == 0)
+        break;
     }
 
-  return OK;
+  return pos;
 }
 
 /****************************************************************************
@@ -168,15 +370,20 @@ int ubx_initialize(struct ubgps_s * const gps, ubx_callback_t callback, void * c
 
   /* Initialize UBX receiver */
 
-  receiver->state.state = UBX_STATE_MSG_WAIT;
   receiver->send_timer_id = -1;
   receiver->receive_timer_id = -1;
   receiver->callback = callback;
   receiver->priv = priv;
 
-  /* Clear pending UBX message */
+  /* Allocate receive buffer. Buffer is offset by two bytes, so that
+   * payload of frame at start of buffer is word aligned. */
+
+  receiver->state.rx_len = 0;
+  receiver->state.rx_buf = malloc(UBX_RX_BUFFER_SIZE + 2);
+  if (!receiver->state.rx_buf)
+    return ERROR;
 
-  memset(&receiver->state.header, 0, sizeof(receiver->state.header));
+  receiver->state.rx_buf += 2;
 
   return OK;
 }
@@ -198,11 +405,22 @@ int ubx_initialize(struct ubgps_s * const gps, ubx_callback_t callback, void * c
 int ubx_deinitialize(struct ubgps_s * const gps)
 {
   struct ubx_receiver_s * const receiver = &gps->state.ubx_receiver;
+  int ret;
 
   if (!receiver)
     return ERROR;
 
-  return ubx_reset(gps);
+  ret = ubx_reset(gps);
+
+  /* Free receive buffer */
+
+  if (receiver->state.rx_buf)
+    {
+      free(receiver->state.rx_buf - 2);
+      receiver->state.rx_buf = NULL;
+    }
+
+  return ret;
 }
 
 /****************************************************************************
@@ -263,9 +481,6 @@ int ubx_msg_send(struct ubgps_s * const gps, const int fd, struct ubx_msg_s cons
   struct ubx_receiver_s * const receiver = &gps->state.ubx_receiver;
   uint8_t header[2] = { UBX_SYNC_CHAR_1, UBX_SYNC_CHAR_2 };
   uint8_t checksum[2];
-  uint8_t ck_a = 0;
-  uint8_t ck_b = 0;
-  uint8_t * data;
   size_t msg_len;
   int ret;
 #ifdef UBX_DEBUG
@@ -315,20 +530,14 @@ int ubx_msg_send(struct ubgps_s * const gps, const int fd, struct ubx_msg_s cons
   if (ret != msg_len)
     return ERROR;
 
-  /* Calculate checksum (8-Bit Fletcher Algorithm) */
+  /* Calculate checksum */
 
-  data = (uint8_t *)msg;
-  while (msg_len--)
-    {
-      ck_a += *data++;
-      ck_b += ck_a;
-    }
+  checksum[0] = 0;
+  checksum[1] = 0;
+  ubx_checksum((uint8_t const *)msg, msg_len, checksum);
 
   /* Send checksum */
 
-  checksum[0] = ck_a;
-  checksum[1] = ck_b;
-
   ret = __ubgps_full_write(fd, checksum, sizeof(checksum));
   if (ret != sizeof(checksum))
     return ERROR;
@@ -359,274 +568,69 @@ int ubx_msg_send(struct ubgps_s * const gps, const int fd, struct ubx_msg_s cons
  * Name: ubx_msg_receive
  *
  * Description:
- *   Receive UBX messages
+ *   Read available data from non-blocking file descriptor to receive buffer
+ *   and deliver complete UBX messages to callback. Data between UBX frames
+ *   is passed to NMEA receiver.
  *
  * Input Parameters:
  *   gps         - Pointer to GPS structure
- *   data        - Received data
+ *   fd          - File descriptor to read data
  *
  * Returned Values:
- *   0 (OK) means the data was accepted by receiver
- *  -1 (ERROR) means the data was ignored by receiver and can be sent to next receiver
+ *   Number of bytes read, 0 if no data was available.
+ *  -1 (ERROR) means the function was executed unsuccessfully. Check value of
+ *  errno for more details.
  *
  ****************************************************************************/
-int ubx_msg_receive(struct ubgps_s * const gps, const uint8_t data)
+ssize_t ubx_msg_receive(struct ubgps_s * const gps, const int fd)
 {
-  bool invalid;
   struct ubx_receiver_s * const receiver = &gps->state.ubx_receiver;
-#ifdef UBX_DEBUG
-  uint16_t i;
-#endif
-
-  if (!receiver)
-    return ERROR;
-
-try_again:
+  uint8_t * const rx_buf = receiver->state.rx_buf;
+  ssize_t nread;
+  size_t used;
 
-  invalid = false;
-
-  if (receiver->state.state >= UBX_STATE_MSG_HEADER &&
-      receiver->state.state <= UBX_STATE_MSG_PAYLOAD)
+  if (!receiver || !rx_buf)
     {
-      /* Update checksum (8-Bit Fletcher Algorithm) */
-
-      receiver->state.ck_a += data;
-      receiver->state.ck_b += receiver->state.ck_a;
+      set_errno(EINVAL);
+      return ERROR;
     }
 
-  switch (receiver->state.state)
-    {
-      case UBX_STATE_MSG_WAIT:
-        {
-          if (data == UBX_SYNC_CHAR_1)
-            {
-
-              dbg_ubx("UBX sync character received.\n");
-
-              /* Prepare to receive second UBX sync character */
-
-              receiver->state.state = UBX_STATE_MSG_SYNC;
-
-              /* Start UBX message receive timeout */
-              receiver->receive_timer_id = __ubgps_set_timer(gps,
-                                                             UBX_MSG_RECV_TIMEOUT,
-                                                             ubx_timeout,
-                                                             receiver);
-
-              /* Retrieve next byte */
-
-              return OK;
-            }
-
-          /* Pass data to NMEA parser */
-
-          return ERROR;
-        }
-
-      case UBX_STATE_MSG_SYNC:
-        {
-          if (data != UBX_SYNC_CHAR_2)
-            {
-              invalid = true;
-
-              /* Break out and reset UBX receiver */
-
-              break;
-            }
-
-          /* Reset receiver offset for header data */
-
-          receiver->state.offset = 0;
-
-          /* Prepare to receive UBX header (class id, message id and length) */
-
-          receiver->state.state = UBX_STATE_MSG_HEADER;
-
-          /* Retrieve next byte */
-
-          return OK;
-        }
-
-      case UBX_STATE_MSG_HEADER:
-        {
-          uint8_t *rbuf = (uint8_t *)&receiver->state.header;
-
-          rbuf[receiver->state.offset++] = data;
-          if (receiver->state.offset < sizeof(struct ubx_msg_s))
-            {
-              /* Retrieve next byte */
-
-              return OK;
-            }
-
-          dbg_ubx("Class:0x%02x, msg:0x%02x, length:%d\n",
-              receiver->state.header.class_id,
-              receiver->state.header.msg_id,
-              receiver->state.header.length);
-
-          /* Limit UBX message length */
-
-          if (receiver->state.header.length > UBX_MSG_MAX_PAYLOAD_LENGTH)
-            {
-              dbg_ubx("Ignoring too long GPS UBX message.\n");
-
-              invalid = true;
-
-              /* Break out and reset UBX receiver */
-
-              break;
-            }
-
-          /* Allocate memory for UBX message */
-
-          receiver->state.msg = malloc(sizeof(struct ubx_msg_s) + receiver->state.header.length);
-          if (!receiver->state.msg)
-            {
-              dbg_ubx("Unable to allocate memory for GPS UBX message. " \
-                  "Class:0x%02x, msg:0x%02x. Payload:%d\n",
-                  receiver->state.header.class_id,
-                  receiver->state.header.msg_id,
-                  receiver->state.header.length);
-
-              /* Break out and reset UBX receiver */
-
-              break;
-            }
-
-          /* Copy header to UBX message */
-
-          memcpy(receiver->state.msg, &receiver->state.header, sizeof(struct ubx_msg_s));
-
-          if (receiver->state.header.length > 0)
-            {
-              /* Reset receiver offset for payload data */
-
-              receiver->state.offset = 0;
-
-              /* Prepare to receive message payload */
-
-              receiver->state.state = UBX_STATE_MSG_PAYLOAD;
-            }
-          else
-            {
-              /* Prepare to receive checksum */
-
-              receiver->state.state = UBX_STATE_MSG_CHECKSUM1;
-            }
-
-          /* Retrieve next byte */
+  DEBUGASSERT(receiver->state.rx_len < UBX_RX_BUFFER_SIZE);
 
-          return OK;
-        }
-
-      case UBX_STATE_MSG_PAYLOAD:
-        {
-          receiver->state.msg->payload[receiver->state.offset++] = data;
-
-          if (receiver->state.offset >= receiver->state.msg->length)
-            {
-              /* Prepare to receive message checksum */
-
-              receiver->state.state = UBX_STATE_MSG_CHECKSUM1;
-            }
-
-          /* Retrieve next byte */
-
-          return OK;
-        }
-
-      case UBX_STATE_MSG_CHECKSUM1:
-        {
-          if (receiver->state.ck_a != data)
-            {
-              dbg_ubx("Invalid CK_A checksum (got %02x, expected %02x).\n",
-                  data, receiver->state.ck_a);
-
-              invalid = true;
-
-              /* Break out and reset UBX receiver */
+  nread = read(fd, &rx_buf[receiver->state.rx_len],
+               UBX_RX_BUFFER_SIZE - receiver->state.rx_len);
+  if (nread <= 0)
+    {
+      if (nread < 0 && get_errno() != EAGAIN)
+        return ERROR;
 
-              break;
-            }
+      return 0;
+    }
 
-          /* Receive second checksum byte */
+  receiver->state.rx_len += nread;
 
-          receiver->state.state = UBX_STATE_MSG_CHECKSUM2;
+  /* Deliver complete frames and move incomplete one to start of buffer */
 
-          /* Retrieve next byte */
+  used = ubx_frame_scan(gps, receiver, rx_buf, receiver->state.rx_len);
+  if (used > 0 && receiver->state.rx_len > 0)
+    {
+      receiver->state.rx_len -= used;
+      memmove(rx_buf, &rx_buf[used], receiver->state.rx_len);
+    }
 
-          return OK;
-        }
+  /* Drop incomplete frame if rest of it does not arrive in time */
 
-      case UBX_STATE_MSG_CHECKSUM2:
+  if (receiver->state.rx_len > 0)
+    {
+      if (receiver->receive_timer_id < 0)
         {
-          if (receiver->state.ck_b != data)
-            {
-              dbg_ubx("Invalid CK_B checksum (got %02x, expected %02x).\n",
-                  data, receiver->state.ck_b);
-
-              invalid = true;
-
-              /* Break out and reset UBX receiver */
-
-              break;
-            }
-
-          /* Check if we are waiting for UBX message acknowledgment */
-
-          if (receiver->send_timer_id >= 0)
-            {
-              /* Check that message is ACK-ACK or ACK-NAK */
-
-              if (receiver->state.msg->length == UBX_ACK_ACK_LEN &&
-                  receiver->state.msg->class_id == UBX_CLASS_ACK &&
-                  (receiver->state.msg->msg_id == UBX_ACK_ACK ||
-                   receiver->state.msg->msg_id == UBX_ACK_NAK))
-                {
-                  uint8_t class_id = UBX_GET_U1(receiver->state.msg, 0);
-                  uint8_t msg_id = UBX_GET_U1(receiver->state.msg, 1);
-
-                  /* Check if ACK-ACK or ACK-NAK is for correct message */
-
-                  if (class_id == receiver->state.waiting_ack.class_id &&
-                      msg_id == receiver->state.waiting_ack.msg_id)
-                    {
-                      /* Stop send timeout timer */
-                      __ubgps_remove_timer(gps, receiver->send_timer_id);
-
-                      /* Reset timer ID */
-
-                      receiver->send_timer_id = -1;
-                    }
-                }
-            }
-
-#ifdef UBX_DEBUG
-          printf("payload:");
-          for(i=0; i<receiver->state.msg->length; i++)
-            {
-              if (i%10 == 0) printf("\n");
-              printf("%02X", receiver->state.msg->payload[i]);
-            }
-          printf("\n");
-#endif /* UBX_DEBUG */
-
-          /* Deliver UBX message to callback */
-
-          receiver->callback(receiver,
-                             receiver->priv,
-                             receiver->state.msg,
-                             false);
-
-          /* Break out and reset UBX receiver */
-
-          break;
+          receiver->receive_timer_id = __ubgps_set_timer(gps,
+                                                         UBX_MSG_RECV_TIMEOUT,
+                                                         ubx_timeout,
+                                                         receiver);
         }
     }
-
-  /* Stop receive timeout timer */
-
-  if (receiver->receive_timer_id >= 0)
+  else if (receiver->receive_timer_id >= 0)
     {
       __ubgps_remove_timer(gps, receiver->receive_timer_id);
 
@@ -635,25 +639,7 @@ try_again:
       receiver->receive_timer_id = -1;
     }
 
-  /* Free pending UBX message */
-
-  if (receiver->state.state >= UBX_STATE_MSG_PAYLOAD)
-    {
-      /* Free allocated message buffer */
-
-      free(receiver->state.msg);
-    }
-
-  /* Reset UBX receiver state */
-
-  receiver->state.state = UBX_STATE_MSG_WAIT;
-  receiver->state.ck_a = 0;
-  receiver->state.ck_b = 0;
-
-  if (invalid)
-    goto try_again;
-
-  return OK;
+  return nread;
 }
 
 /****************************************************************************
@@ -700,20 +686,9 @@ int ubx_reset(struct ubgps_s * const gps)
       receiver->receive_timer_id = -1;
     }
 
-  /* Free pending UBX message */
-
-  if (receiver->state.state >= UBX_STATE_MSG_PAYLOAD)
-    {
-      /* Free allocated message buffer */
-
-      free(receiver->state.msg);
-    }
-
-  /* Reset UBX receiver state */
+  /* Drop partially received frame */
 
-  receiver->state.state = UBX_STATE_MSG_WAIT;
-  receiver->state.ck_a = 0;
-  receiver->state.ck_b = 0;
+  receiver->state.rx_len = 0;
 
   return OK;
 }
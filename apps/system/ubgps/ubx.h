@@ -36,6 +36,7 @@
 #ifndef __THINGSEE_GPS_UBX_H
 #define __THINGSEE_GPS_UBX_H
 
+#include <sys/types.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <nuttx/compiler.h>
@@ -206,6 +207,9 @@
 
 #define UBX_NAV_AOPSTATUS             0x60
 #define UBX_NAV_CLOCK                 0x22
+#define UBX_NAV_CLOCK_LEN             20
+#define UBX_NAV_CLOCK_POLL            UBX_NAV_CLOCK
+#define UBX_NAV_CLOCK_POLL_LEN        0
 #define UBX_NAV_DGPS                  0x31
 #define UBX_NAV_DOP                   0x04
 #define UBX_NAV_POSECEF               0x01
@@ -233,6 +237,9 @@
 /* UBX AID class (0x0B) message id's */
 
 #define UBX_AID_ALM                   0x30
+#define UBX_AID_ALM_LEN               40
+#define UBX_AID_ALM_POLL              UBX_AID_ALM
+#define UBX_AID_ALM_POLL_LEN          0
 #define UBX_AID_ALPSRV                0x32
 #define UBX_AID_ALPSRV_LEN            16
 
@@ -248,35 +255,11 @@
 #define UBX_AID_AOP                   0x33
 #define UBX_AID_DATA                  0x10
 #define UBX_AID_EPH                   0x31
+#define UBX_AID_EPH_LEN               104
+#define UBX_AID_EPH_POLL              UBX_AID_EPH
+#define UBX_AID_EPH_POLL_LEN          0
 #define UBX_AID_HUI                   0x02
 
-/* UBX protocol state */
-
-enum ubx_state_e
-{
-  /* Waiting for UBX message */
-
-  UBX_STATE_MSG_WAIT = 0,
-
-  /* Synchronization characters */
-
-  UBX_STATE_MSG_SYNC,
-
-  /* Message header (class id, msg id and length) */
-
-  UBX_STATE_MSG_HEADER,
-
-  /* Receiving UBX message payload */
-
-  UBX_STATE_MSG_PAYLOAD,
-
-  /* Checksum */
-
-  UBX_STATE_MSG_CHECKSUM1,
-  UBX_STATE_MSG_CHECKSUM2,
-};
-typedef enum ubx_state_e ubx_state_t;
-
 /* UBX message acknowledgment timeout in milliseconds */
 
 #define UBX_MSG_ACK_TIMEOUT           200
@@ -289,6 +272,18 @@ typedef enum ubx_state_e ubx_state_t;
 
 #define UBX_MSG_MAX_PAYLOAD_LENGTH    1024
 
+/* UBX frame: sync characters, message header, payload and checksum */
+
+#define UBX_FRAME_HEADER_LEN          6
+#define UBX_FRAME_CHECKSUM_LEN        2
+#define UBX_FRAME_MAX_LENGTH          (UBX_FRAME_HEADER_LEN + \
+                                       UBX_MSG_MAX_PAYLOAD_LENGTH + \
+                                       UBX_FRAME_CHECKSUM_LEN)
+
+/* Receive buffer size, holds at least one frame of maximum length */
+
+#define UBX_RX_BUFFER_SIZE            UBX_FRAME_MAX_LENGTH
+
 /****************************************************************************
  * Public Types
  ****************************************************************************/
@@ -331,30 +326,18 @@ typedef int (*ubx_callback_t)(struct ubx_receiver_s const * const receiver,
 
 struct ubx_state_s
 {
-  /* UBX receiver state */
-
-  ubx_state_t state;
-
   /* UBX message waiting for acknowledgment (header only) */
 
   struct ubx_msg_s waiting_ack;
 
-  /* Currently received UBX message header */
-
-  struct ubx_msg_s header;
+  /* Receive buffer for data read from GPS module, until it forms whole
+   * UBX frames */
 
-  /* UBX message */
+  uint8_t * rx_buf;
 
-  struct ubx_msg_s * msg;
+  /* Number of bytes in receive buffer */
 
-  /* Current receiving offset */
-
-  size_t offset;
-
-  /* Checksum */
-
-  uint8_t ck_a;
-  uint8_t ck_b;
+  size_t rx_len;
 };
 
 /* UBX receiver */
@@ -498,18 +481,21 @@ int ubx_msg_send(struct ubgps_s * const gps, const int fd, struct ubx_msg_s cons
  * Name: ubx_msg_receive
  *
  * Description:
- *   Receive UBX messages
+ *   Read available data from non-blocking file descriptor to receive buffer
+ *   and deliver complete UBX messages to callback. Data between UBX frames
+ *   is passed to NMEA receiver.
  *
  * Input Parameters:
- *   receiver    - Pointer to UBX receiver structure
- *   data        - Received data
+ *   gps         - Pointer to GPS structure
+ *   fd          - File descriptor to read data
  *
  * Returned Values:
- *   0 (OK) means the data was accepted by receiver
- *  -1 (ERROR) means the data was ignored by receiver and can be sent to next receiver
+ *   Number of bytes read, 0 if no data was available.
+ *  -1 (ERROR) means the function was executed unsuccessfully. Check value of
+ *  errno for more details.
  *
  ****************************************************************************/
-int ubx_msg_receive(struct ubgps_s * const gps, const uint8_t data);
+ssize_t ubx_msg_receive(struct ubgps_s * const gps, const int fd);
 
 /****************************************************************************
  * Name: ubx_reset
@@ -0,0 +1,50 @@
+/****************************************************************************
+ * apps/system/ubgps_gtest/host/arch/board/board-gps.h
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+/* Host stand-in for board GPS interface. GPS library modules built for host
+ * tests talk to a file descriptor set up by the test instead.
+ */
+
+#ifndef __APPS_SYSTEM_UBGPS_GTEST_HOST_ARCH_BOARD_BOARD_GPS_H
+#define __APPS_SYSTEM_UBGPS_GTEST_HOST_ARCH_BOARD_BOARD_GPS_H
+
+#include <stdbool.h>
+#include <time.h>
+
+void board_gps_power(bool on);
+int board_gps_initialize(void);
+int board_gps_deinitialize(int fd);
+void board_gps_pm_set_next_message_time(const struct timespec *msg_abstime);
+bool board_gps_tx_buffer_empty(int fd);
+
+#endif
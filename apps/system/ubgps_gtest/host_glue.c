@@ -0,0 +1,313 @@
+/****************************************************************************
+ * apps/system/ubgps_gtest/host_glue.c
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ubgps_internal.h"
+#include "ubx.h"
+
+#include "host_glue.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define HOST_MAX_TIMERS 8
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct host_timer_s
+{
+  bool armed;
+  ubgps_timer_fn_t cb;
+  void *priv;
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct host_timer_s g_timers[HOST_MAX_TIMERS];
+
+/****************************************************************************
+ * Public Data
+ ****************************************************************************/
+
+struct ubgps_host_msg_s ubgps_host_msgs[UBGPS_HOST_MAX_MSGS];
+int ubgps_host_msg_count;
+
+uint8_t ubgps_host_nmea[1024];
+size_t ubgps_host_nmea_len;
+
+int ubgps_host_reset_at_msg;
+
+int ubgps_host_timers;
+
+long ubgps_host_time_offset;
+bool ubgps_host_rtc_set = true;
+
+int ubgps_host_hints;
+double ubgps_host_hint_latitude;
+double ubgps_host_hint_longitude;
+uint32_t ubgps_host_hint_accuracy;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static int host_ubx_callback(struct ubx_receiver_s const * const receiver,
+                             void * const priv,
+                             struct ubx_msg_s const * const msg,
+                             bool const timeout)
+{
+  struct ubgps_s * const gps = priv;
+  struct ubgps_host_msg_s *rec;
+  size_t len;
+
+  if (timeout || ubgps_host_msg_count >= UBGPS_HOST_MAX_MSGS)
+    return OK;
+
+  rec = &ubgps_host_msgs[ubgps_host_msg_count++];
+  rec->class_id = msg->class_id;
+  rec->msg_id = msg->msg_id;
+  rec->length = msg->length;
+  rec->aligned = ((uintptr_t)msg->payload & (sizeof(uint32_t) - 1)) == 0;
+  rec->in_place = (uint8_t const *)msg >= receiver->state.rx_buf &&
+                  (uint8_t const *)msg < receiver->state.rx_buf +
+                                         UBX_RX_BUFFER_SIZE;
+
+  len = msg->length < sizeof(rec->payload) ? msg->length :
+                                             sizeof(rec->payload);
+  memcpy(rec->payload, msg->payload, len);
+
+  if (ubgps_host_msg_count == ubgps_host_reset_at_msg)
+    (void)ubx_reset(gps);
+
+  return OK;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+void ubgps_host_clear(void)
+{
+  memset(ubgps_host_msgs, 0, sizeof(ubgps_host_msgs));
+  ubgps_host_msg_count = 0;
+  ubgps_host_nmea_len = 0;
+  ubgps_host_reset_at_msg = 0;
+  ubgps_host_hints = 0;
+}
+
+struct ubgps_s *ubgps_host_create(int fd)
+{
+  struct ubgps_s *gps;
+
+  gps = calloc(1, sizeof(*gps));
+  if (!gps)
+    return NULL;
+
+  gps->fd = fd;
+
+  if (ubx_initialize(gps, host_ubx_callback, gps) != OK)
+    {
+      free(gps);
+      return NULL;
+    }
+
+  return gps;
+}
+
+void ubgps_host_destroy(struct ubgps_s *gps)
+{
+  (void)ubx_deinitialize(gps);
+  free(gps);
+}
+
+ssize_t ubgps_host_receive(struct ubgps_s *gps)
+{
+  return ubx_msg_receive(gps, gps->fd);
+}
+
+size_t ubgps_host_rx_pending(struct ubgps_s *gps)
+{
+  return gps->state.ubx_receiver.state.rx_len;
+}
+
+void ubgps_host_fire_timers(void)
+{
+  int id;
+
+  for (id = 0; id < HOST_MAX_TIMERS; id++)
+    {
+      if (g_timers[id].armed)
+        {
+          g_timers[id].armed = false;
+          ubgps_host_timers--;
+          (void)g_timers[id].cb(id, g_timers[id].priv);
+        }
+    }
+}
+
+void ubgps_host_set_fix(struct ubgps_s *gps, int32_t latitude,
+                        int32_t longitude)
+{
+  gps->state.current_state = GPS_STATE_FIX_ACQUIRED;
+  gps->location.latitude = latitude;
+  gps->location.longitude = longitude;
+  gps->location.height = 25 * 1000;
+  gps->location.horizontal_accuracy = 10 * 1000;
+}
+
+int ubgps_host_snapshot_msg(struct ubgps_s *gps, uint8_t class_id,
+                            uint8_t msg_id, const void *payload,
+                            uint16_t length)
+{
+  struct ubx_msg_s *msg;
+  int ret;
+
+  msg = ubx_msg_allocate(class_id, msg_id, length);
+  if (!msg)
+    return ERROR;
+
+  memcpy(msg->payload, payload, length);
+  ret = ubgps_snapshot_handle_msg(gps, msg);
+  UBX_MSG_FREE(msg);
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: __wrap_clock_gettime
+ *
+ * Description:
+ *   Linker wrapper for clock_gettime(). Lets tests move system time.
+ *
+ ****************************************************************************/
+
+int __real_clock_gettime(clockid_t clk, struct timespec *ts);
+
+int __wrap_clock_gettime(clockid_t clk, struct timespec *ts)
+{
+  int ret = __real_clock_gettime(clk, ts);
+
+  ts->tv_sec += ubgps_host_time_offset;
+  return ret;
+}
+
+/* Board and GPS library services normally provided by board code,
+ * ubgps.c / ubgps_internal.c and nmea.c. */
+
+bool board_rtc_time_is_set(time_t *when_was_set)
+{
+  return ubgps_host_rtc_set;
+}
+
+int ubgps_give_location_hint(double const latitude,
+                             double const longitude,
+                             int32_t const altitude,
+                             uint32_t const accuracy)
+{
+  ubgps_host_hints++;
+  ubgps_host_hint_latitude = latitude;
+  ubgps_host_hint_longitude = longitude;
+  ubgps_host_hint_accuracy = accuracy;
+
+  return OK;
+}
+
+bool ubgps_check_alp_file_validity(const char *filepath)
+{
+  return false;
+}
+
+int __ubgps_set_timer(struct ubgps_s *gps,
+                      uint32_t timeout_msec, ubgps_timer_fn_t timer_cb,
+                      void *cb_priv)
+{
+  int id;
+
+  for (id = 0; id < HOST_MAX_TIMERS; id++)
+    {
+      if (!g_timers[id].armed)
+        {
+          g_timers[id].armed = true;
+          g_timers[id].cb = timer_cb;
+          g_timers[id].priv = cb_priv;
+          ubgps_host_timers++;
+          return id;
+        }
+    }
+
+  return ERROR;
+}
+
+void __ubgps_remove_timer(struct ubgps_s * const gps, uint16_t id)
+{
+  if (id < HOST_MAX_TIMERS && g_timers[id].armed)
+    {
+      g_timers[id].armed = false;
+      ubgps_host_timers--;
+    }
+}
+
+size_t __ubgps_full_write(int gps_fd, const void *buf, size_t writelen)
+{
+  ssize_t ret = write(gps_fd, buf, writelen);
+
+  return ret < 0 ? 0 : ret;
+}
+
+int nmea_receiver(struct ubgps_s * const gps, uint8_t const * data,
+                  size_t const len)
+{
+  size_t space = sizeof(ubgps_host_nmea) - ubgps_host_nmea_len;
+  size_t n = len < space ? len : space;
+
+  memcpy(&ubgps_host_nmea[ubgps_host_nmea_len], data, n);
+  ubgps_host_nmea_len += n;
+
+  return OK;
+}
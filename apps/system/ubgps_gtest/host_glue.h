@@ -0,0 +1,128 @@
+/****************************************************************************
+ * apps/system/ubgps_gtest/host_glue.h
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+#ifndef __APPS_SYSTEM_UBGPS_GTEST_HOST_GLUE_H
+#define __APPS_SYSTEM_UBGPS_GTEST_HOST_GLUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ubgps_s;
+
+/* UBX message delivered to receiver callback. */
+
+struct ubgps_host_msg_s
+{
+  uint8_t class_id;
+  uint8_t msg_id;
+  uint16_t length;
+  bool aligned;         /* Payload was word aligned in callback */
+  bool in_place;        /* Message was delivered from receive buffer */
+  uint8_t payload[64];  /* Start of payload */
+};
+
+#define UBGPS_HOST_MAX_MSGS 16
+
+extern struct ubgps_host_msg_s ubgps_host_msgs[UBGPS_HOST_MAX_MSGS];
+extern int ubgps_host_msg_count;
+
+/* Data passed to NMEA receiver. */
+
+extern uint8_t ubgps_host_nmea[1024];
+extern size_t ubgps_host_nmea_len;
+
+/* When non-zero, UBX receiver is reset from callback on delivery of this
+ * many'th message. */
+
+extern int ubgps_host_reset_at_msg;
+
+/* Number of armed library timers. */
+
+extern int ubgps_host_timers;
+
+/* Seconds added to system time, and whether RTC time counts as set. */
+
+extern long ubgps_host_time_offset;
+extern bool ubgps_host_rtc_set;
+
+/* Location hints given by GPS library. */
+
+extern int ubgps_host_hints;
+extern double ubgps_host_hint_latitude;
+extern double ubgps_host_hint_longitude;
+extern uint32_t ubgps_host_hint_accuracy;
+
+/* Clear recorded messages, NMEA data and callback options. */
+
+void ubgps_host_clear(void);
+
+/* Allocate GPS structure talking to 'fd', with UBX receiver initialized
+ * and recording callback installed. */
+
+struct ubgps_s *ubgps_host_create(int fd);
+void ubgps_host_destroy(struct ubgps_s *gps);
+
+/* Read from GPS fd through UBX receiver. */
+
+ssize_t ubgps_host_receive(struct ubgps_s *gps);
+
+/* Bytes of incomplete frame held by UBX receiver. */
+
+size_t ubgps_host_rx_pending(struct ubgps_s *gps);
+
+/* Fire all armed timers. */
+
+void ubgps_host_fire_timers(void);
+
+/* Set GPS to fix acquired state at given location [1e-7 degrees]. */
+
+void ubgps_host_set_fix(struct ubgps_s *gps, int32_t latitude,
+                        int32_t longitude);
+
+/* Pass UBX message to snapshot message handler. */
+
+int ubgps_host_snapshot_msg(struct ubgps_s *gps, uint8_t class_id,
+                            uint8_t msg_id, const void *payload,
+                            uint16_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __APPS_SYSTEM_UBGPS_GTEST_HOST_GLUE_H */
@@ -0,0 +1,729 @@
+/****************************************************************************
+ * apps/system/ubgps_gtest/nav_pvt_replay_test.cc
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+/* Location filter tests replaying UBX NAV-PVT streams. Streams are
+ * generated from a ground truth trajectory with time-correlated receiver
+ * errors, encoded as UBX frames and decoded back like the receiver path
+ * does. Set UBGPS_NAV_PVT_LOG to replay a UBX log captured from receiver.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "gtest/gtest.h"
+extern "C" {
+#include "ubgps_filter.h"
+}
+
+namespace {
+
+const double kMetersPerE7 = 6378137.0 * M_PI / 180.0 / 1e7;
+const int32_t kOriginLat = 601699000; /* 60.1699 N */
+const int32_t kOriginLon = 249384000; /* 24.9384 E */
+
+const uint8_t kClassNav = 0x01;
+const uint8_t kNavPvt = 0x07;
+const uint16_t kNavPvtLen = 92;
+
+/* Ground truth and receiver error for one navigation epoch */
+
+struct Epoch
+{
+  uint32_t itow;
+  double north;
+  double east;
+  double vn;
+  double ve;
+  double err_north;
+  double err_east;
+  uint32_t hacc;
+  uint32_t sacc;
+  bool fix;
+};
+
+/* Deterministic gaussian noise */
+
+class Noise
+{
+public:
+  explicit Noise(uint64_t seed)
+  {
+    /* Scramble seed (splitmix64), xorshift output is poor for small seeds */
+
+    seed += 0x9E3779B97F4A7C15ULL;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+    state_ = (seed ^ (seed >> 31)) | 1;
+  }
+
+  double Gauss()
+  {
+    double u1 = (Next() + 1.0) / 18446744073709551617.0;
+    double u2 = Next() / 18446744073709551616.0;
+
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+  }
+
+private:
+  uint64_t Next()
+  {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 7;
+    state_ ^= state_ << 17;
+    return state_;
+  }
+
+  uint64_t state_;
+};
+
+/* Receiver error: Gauss-Markov bias (correlation time 'tau') carrying a
+ * quarter of error variance and white noise carrying the rest, together
+ * giving reported accuracy. */
+
+const double kWhiteShare = 0.8660254037844386; /* sqrt(3/4) */
+
+void AddReceiverErrors(std::vector<Epoch> &epochs, uint64_t seed,
+                       double tau = 30.0)
+{
+  Noise noise(seed);
+  double bias_n = 0;
+  double bias_e = 0;
+
+  for (size_t i = 0; i < epochs.size(); i++)
+    {
+      Epoch &e = epochs[i];
+      double sigma = e.hacc / 1000.0 / sqrt(2.0);
+      double dt = i ? (e.itow - epochs[i - 1].itow) / 1000.0 : 0;
+      double a = i ? exp(-dt / tau) : 0;
+      double b = sqrt(1.0 - a * a);
+
+      /* Bias is kept normalized so that it shrinks with reported accuracy */
+
+      bias_n = a * bias_n + b * noise.Gauss();
+      bias_e = a * bias_e + b * noise.Gauss();
+
+      e.err_north = sigma * (0.5 * bias_n + kWhiteShare * noise.Gauss());
+      e.err_east = sigma * (0.5 * bias_e + kWhiteShare * noise.Gauss());
+    }
+}
+
+/* Static receiver, accuracy converging from 'hacc0' to 'hacc_end' [m] */
+
+std::vector<Epoch> ColdStart(unsigned int secs, double hacc0,
+                             double hacc_end, double tau)
+{
+  std::vector<Epoch> epochs;
+
+  for (unsigned int t = 0; t < secs; t++)
+    {
+      Epoch e = {};
+
+      e.itow = 100000000 + t * 1000;
+      e.hacc = (hacc_end + (hacc0 - hacc_end) * exp(-(double)t / tau)) * 1000;
+      e.sacc = 500;
+      e.fix = true;
+      epochs.push_back(e);
+    }
+
+  return epochs;
+}
+
+/* Receiver moving at constant velocity */
+
+std::vector<Epoch> Drive(unsigned int secs, double speed, double heading,
+                         double hacc)
+{
+  std::vector<Epoch> epochs;
+
+  for (unsigned int t = 0; t < secs; t++)
+    {
+      Epoch e = {};
+
+      e.itow = 200000000 + t * 1000;
+      e.vn = speed * cos(heading * M_PI / 180.0);
+      e.ve = speed * sin(heading * M_PI / 180.0);
+      e.north = e.vn * t;
+      e.east = e.ve * t;
+      e.hacc = hacc * 1000;
+      e.sacc = 300;
+      e.fix = true;
+      epochs.push_back(e);
+    }
+
+  return epochs;
+}
+
+/* UBX encoding / decoding */
+
+void Put(std::vector<uint8_t> &buf, size_t off, uint32_t val, int len)
+{
+  for (int i = 0; i < len; i++)
+    buf[off + i] = val >> (8 * i);
+}
+
+uint32_t Get(const uint8_t *buf, size_t off, int len)
+{
+  uint32_t val = 0;
+
+  for (int i = 0; i < len; i++)
+    val |= (uint32_t)buf[off + i] << (8 * i);
+
+  return val;
+}
+
+int32_t ToE7Lat(double north)
+{
+  return kOriginLat + (int32_t)lround(north / kMetersPerE7);
+}
+
+int32_t ToE7Lon(double east)
+{
+  return kOriginLon + (int32_t)lround(east / kMetersPerE7 /
+                                      cos(kOriginLat * M_PI / 180.0 / 1e7));
+}
+
+void ToLocal(int32_t lat, int32_t lon, double *north, double *east)
+{
+  *north = (lat - kOriginLat) * kMetersPerE7;
+  *east = (lon - kOriginLon) * kMetersPerE7 *
+          cos(kOriginLat * M_PI / 180.0 / 1e7);
+}
+
+void AppendNavPvt(std::vector<uint8_t> &stream, const Epoch &e)
+{
+  std::vector<uint8_t> frame(6 + kNavPvtLen + 2, 0);
+  double speed = sqrt(e.vn * e.vn + e.ve * e.ve);
+  double heading = atan2(e.ve, e.vn) * 180.0 / M_PI;
+  uint8_t ck_a = 0;
+  uint8_t ck_b = 0;
+
+  if (heading < 0)
+    heading += 360.0;
+
+  frame[0] = 0xB5;
+  frame[1] = 0x62;
+  frame[2] = kClassNav;
+  frame[3] = kNavPvt;
+  Put(frame, 4, kNavPvtLen, 2);
+
+  Put(frame, 6 + 0, e.itow, 4);
+  Put(frame, 6 + 11, 0x07, 1);                  /* Date/time valid */
+  Put(frame, 6 + 20, e.fix ? 3 : 0, 1);         /* 3D fix */
+  Put(frame, 6 + 21, e.fix ? 0x01 : 0, 1);      /* gnssFixOK */
+  Put(frame, 6 + 23, e.fix ? 8 : 0, 1);
+  Put(frame, 6 + 24, ToE7Lon(e.east + e.err_east), 4);
+  Put(frame, 6 + 28, ToE7Lat(e.north + e.err_north), 4);
+  Put(frame, 6 + 36, 15000, 4);
+  Put(frame, 6 + 40, e.hacc, 4);
+  Put(frame, 6 + 44, e.hacc * 2, 4);
+  Put(frame, 6 + 48, (int32_t)lround(e.vn * 1000), 4);
+  Put(frame, 6 + 52, (int32_t)lround(e.ve * 1000), 4);
+  Put(frame, 6 + 60, (int32_t)lround(speed * 1000), 4);
+  Put(frame, 6 + 64, (int32_t)lround(heading * 1e5), 4);
+  Put(frame, 6 + 68, e.sacc, 4);
+  Put(frame, 6 + 72, 180 * 100000, 4);
+
+  for (size_t i = 2; i < 6 + kNavPvtLen; i++)
+    {
+      ck_a += frame[i];
+      ck_b += ck_a;
+    }
+
+  frame[6 + kNavPvtLen] = ck_a;
+  frame[6 + kNavPvtLen + 1] = ck_b;
+
+  stream.insert(stream.end(), frame.begin(), frame.end());
+}
+
+std::vector<uint8_t> Record(const std::vector<Epoch> &epochs)
+{
+  std::vector<uint8_t> stream;
+
+  for (size_t i = 0; i < epochs.size(); i++)
+    AppendNavPvt(stream, epochs[i]);
+
+  return stream;
+}
+
+/* Decoded NAV-PVT, location fields as in ubgps_parse_nav_pvt() */
+
+struct NavPvt
+{
+  uint32_t itow;
+  struct gps_location_s location;
+};
+
+std::vector<NavPvt> Replay(const std::vector<uint8_t> &stream)
+{
+  std::vector<NavPvt> out;
+  size_t pos = 0;
+
+  while (pos + 8 <= stream.size())
+    {
+      const uint8_t *p = &stream[pos];
+      uint16_t len;
+      uint8_t ck_a = 0;
+      uint8_t ck_b = 0;
+
+      if (p[0] != 0xB5 || p[1] != 0x62)
+        {
+          pos++;
+          continue;
+        }
+
+      len = Get(p, 4, 2);
+      if (pos + 8 + len > stream.size())
+        break;
+
+      for (size_t i = 2; i < 6u + len; i++)
+        {
+          ck_a += p[i];
+          ck_b += ck_a;
+        }
+
+      if (ck_a != p[6 + len] || ck_b != p[7 + len])
+        {
+          pos++;
+          continue;
+        }
+
+      if (p[2] == kClassNav && p[3] == kNavPvt && len == kNavPvtLen)
+        {
+          const uint8_t *pl = p + 6;
+          NavPvt pvt = {};
+
+          pvt.itow = Get(pl, 0, 4);
+          pvt.location.fix_type = (gps_fix_t)Get(pl, 20, 1);
+          if (!(Get(pl, 21, 1) & 0x01))
+            pvt.location.fix_type = GPS_FIX_NOT_AVAILABLE;
+          pvt.location.num_of_used_satellites = Get(pl, 23, 1);
+          pvt.location.longitude = Get(pl, 24, 4);
+          pvt.location.latitude = Get(pl, 28, 4);
+          pvt.location.horizontal_accuracy = Get(pl, 40, 4);
+          pvt.location.height = Get(pl, 36, 4);
+          pvt.location.vertical_accuracy = Get(pl, 44, 4);
+          pvt.location.ground_speed = Get(pl, 60, 4);
+          pvt.location.ground_speed_accuracy = Get(pl, 68, 4);
+          pvt.location.heading = Get(pl, 64, 4);
+          pvt.location.heading_accuracy = Get(pl, 72, 4);
+          out.push_back(pvt);
+        }
+
+      pos += 8 + len;
+    }
+
+  return out;
+}
+
+/* Published location */
+
+struct Published
+{
+  uint32_t itow;
+  struct gps_location_s location;
+};
+
+/* Publishing policy of ubgps_filter_location(): publish estimate when
+ * converged, otherwise at end of filter duration. */
+
+std::vector<Published> RunFilter(const std::vector<NavPvt> &fixes,
+                                 uint32_t threshold, uint32_t duration_ms,
+                                 std::vector<int> *results = NULL)
+{
+  std::vector<Published> out;
+  struct ubgps_filter_s filter;
+  bool timer = false;
+  uint32_t deadline = 0;
+
+  ubgps_filter_init(&filter, threshold, 3, 3);
+
+  for (size_t i = 0; i < fixes.size(); i++)
+    {
+      const NavPvt &fix = fixes[i];
+      Published pub;
+      int ret;
+
+      if (fix.location.fix_type == GPS_FIX_NOT_AVAILABLE)
+        continue;
+
+      if (timer && (int32_t)(fix.itow - deadline) >= 0)
+        {
+          timer = false;
+          pub.itow = deadline;
+          if (ubgps_filter_get_location(&filter, &pub.location) == OK)
+            out.push_back(pub);
+        }
+
+      ret = ubgps_filter_update(&filter, &fix.location, fix.itow);
+      if (results)
+        results->push_back(ret);
+
+      if (ubgps_filter_converged(&filter))
+        {
+          timer = false;
+          pub.itow = fix.itow;
+          EXPECT_EQ(OK, ubgps_filter_get_location(&filter, &pub.location));
+          out.push_back(pub);
+        }
+      else if (!timer)
+        {
+          timer = true;
+          deadline = fix.itow + duration_ms;
+        }
+    }
+
+  return out;
+}
+
+/* Previous policy: publish location below threshold right away, otherwise
+ * most accurate location at end of filter duration. */
+
+std::vector<Published> RunBestOfWindow(const std::vector<NavPvt> &fixes,
+                                       uint32_t threshold,
+                                       uint32_t duration_ms)
+{
+  std::vector<Published> out;
+  Published best = {};
+  bool timer = false;
+  uint32_t deadline = 0;
+
+  for (size_t i = 0; i < fixes.size(); i++)
+    {
+      const NavPvt &fix = fixes[i];
+
+      if (fix.location.fix_type == GPS_FIX_NOT_AVAILABLE)
+        continue;
+
+      if (timer && (int32_t)(fix.itow - deadline) >= 0)
+        {
+          timer = false;
+          best.itow = deadline;
+          out.push_back(best);
+        }
+
+      if (fix.location.horizontal_accuracy / 1000 < threshold)
+        {
+          Published pub = { fix.itow, fix.location };
+
+          timer = false;
+          out.push_back(pub);
+          continue;
+        }
+
+      if (!timer)
+        {
+          timer = true;
+          deadline = fix.itow + duration_ms;
+          best.location.horizontal_accuracy = UINT32_MAX;
+        }
+
+      if (fix.location.horizontal_accuracy < best.location.horizontal_accuracy)
+        best.location = fix.location;
+    }
+
+  return out;
+}
+
+const Epoch &TruthAt(const std::vector<Epoch> &epochs, uint32_t itow)
+{
+  for (size_t i = 1; i < epochs.size(); i++)
+    {
+      if (epochs[i].itow > itow)
+        return epochs[i - 1];
+    }
+
+  return epochs.back();
+}
+
+double ErrorOf(const std::vector<Epoch> &epochs, const Published &pub)
+{
+  const Epoch &truth = TruthAt(epochs, pub.itow);
+  double north, east;
+
+  ToLocal(pub.location.latitude, pub.location.longitude, &north, &east);
+
+  return hypot(north - truth.north, east - truth.east);
+}
+
+const Published &FirstAccurate(const std::vector<Published> &published,
+                               uint32_t threshold)
+{
+  for (size_t i = 0; i < published.size(); i++)
+    {
+      if (published[i].location.horizontal_accuracy / 1000 < threshold)
+        return published[i];
+    }
+
+  ADD_FAILURE() << "no location below " << threshold << " m";
+  return published.back();
+}
+
+void Metric(const char *name, double value, const char *unit)
+{
+  printf("[  METRIC  ] %s: %.1f %s\n", name, value, unit);
+  ::testing::Test::RecordProperty(name, (int)value);
+}
+
+} /* namespace */
+
+TEST(NavPvtReplay, StreamRoundTrip)
+{
+  std::vector<Epoch> epochs = Drive(10, 10.0, 30.0, 5.0);
+  std::vector<uint8_t> stream;
+  std::vector<NavPvt> fixes;
+
+  AddReceiverErrors(epochs, 1);
+  stream = Record(epochs);
+
+  /* Garbage between frames is skipped */
+
+  stream.insert(stream.begin() + 100, 0xB5);
+  fixes = Replay(stream);
+
+  ASSERT_EQ(epochs.size(), fixes.size());
+  for (size_t i = 0; i < fixes.size(); i++)
+    {
+      double north, east;
+
+      ToLocal(fixes[i].location.latitude, fixes[i].location.longitude,
+              &north, &east);
+
+      EXPECT_EQ(epochs[i].itow, fixes[i].itow);
+      EXPECT_NEAR(epochs[i].north + epochs[i].err_north, north, 0.05);
+      EXPECT_NEAR(epochs[i].east + epochs[i].err_east, east, 0.05);
+      EXPECT_EQ(10000, fixes[i].location.ground_speed);
+    }
+}
+
+TEST(NavPvtReplay, ColdStartPublishesEarlierThanBestOfWindow)
+{
+  const uint32_t threshold = 20;
+  const uint32_t duration_ms = 10000;
+  double filter_ms = 0;
+  double window_ms = 0;
+  double filter_err = 0;
+  double window_err = 0;
+  const int runs = 20;
+
+  for (int run = 0; run < runs; run++)
+    {
+      std::vector<Epoch> epochs = ColdStart(60, 120.0, 4.0, 8.0);
+      std::vector<NavPvt> fixes;
+      std::vector<Published> filtered;
+      std::vector<Published> window;
+
+      AddReceiverErrors(epochs, 1000 + run);
+      fixes = Replay(Record(epochs));
+
+      filtered = RunFilter(fixes, threshold, duration_ms);
+      window = RunBestOfWindow(fixes, threshold, duration_ms);
+
+      /* First location accurate enough for engine to power off receiver */
+
+      const Published &f = FirstAccurate(filtered, threshold);
+      const Published &w = FirstAccurate(window, threshold);
+
+      filter_ms += f.itow - fixes[0].itow;
+      window_ms += w.itow - fixes[0].itow;
+      filter_err += ErrorOf(epochs, f);
+      window_err += ErrorOf(epochs, w);
+
+      EXPECT_LE(f.itow, w.itow);
+    }
+
+  Metric("cold_start_filter_time_to_accurate_ms", filter_ms / runs, "ms");
+  Metric("cold_start_window_time_to_accurate_ms", window_ms / runs, "ms");
+  Metric("cold_start_filter_accurate_error_m", filter_err / runs, "m");
+  Metric("cold_start_window_accurate_error_m", window_err / runs, "m");
+
+  EXPECT_LT(filter_ms, window_ms);
+  EXPECT_LT(filter_err / runs, threshold);
+}
+
+TEST(NavPvtReplay, DriveTracksTruth)
+{
+  std::vector<Epoch> epochs = Drive(120, 15.0, 45.0, 5.0);
+  std::vector<NavPvt> fixes;
+  std::vector<Published> filtered;
+  std::vector<int> results;
+  size_t rejects = 0;
+  double raw_sq = 0;
+  double filt_sq = 0;
+  size_t n = 0;
+
+  AddReceiverErrors(epochs, 7, 5.0);
+  fixes = Replay(Record(epochs));
+  filtered = RunFilter(fixes, 100, 10000, &results);
+
+  ASSERT_EQ(fixes.size(), results.size());
+  EXPECT_EQ(UBGPS_FILTER_INITIALIZED, results[0]);
+
+  /* Correlated receiver error may get single location gated out, but
+   * estimate must keep tracking without restarts */
+
+  for (size_t i = 1; i < results.size(); i++)
+    {
+      EXPECT_NE(UBGPS_FILTER_INITIALIZED, results[i]) << "at " << i;
+      rejects += results[i] == UBGPS_FILTER_REJECTED;
+    }
+
+  EXPECT_LE(rejects, fixes.size() / 50);
+  ASSERT_GE(filtered.size(), fixes.size() * 9 / 10);
+
+  for (size_t i = 0; i < filtered.size(); i++)
+    {
+      const Epoch &truth = TruthAt(epochs, filtered[i].itow);
+      double e = ErrorOf(epochs, filtered[i]);
+
+      filt_sq += e * e;
+      raw_sq += truth.err_north * truth.err_north +
+                truth.err_east * truth.err_east;
+      n++;
+    }
+
+  Metric("drive_raw_rms_error_m", sqrt(raw_sq / n), "m");
+  Metric("drive_filter_rms_error_m", sqrt(filt_sq / n), "m");
+
+  EXPECT_LT(sqrt(filt_sq / n), sqrt(raw_sq / n));
+}
+
+TEST(NavPvtReplay, OutlierIsRejected)
+{
+  std::vector<Epoch> epochs = ColdStart(40, 5.0, 5.0, 1.0);
+  std::vector<NavPvt> fixes;
+  std::vector<Published> filtered;
+  std::vector<int> results;
+
+  AddReceiverErrors(epochs, 3);
+  epochs[20].err_north += 200.0;
+  fixes = Replay(Record(epochs));
+  filtered = RunFilter(fixes, 100, 10000, &results);
+
+  EXPECT_EQ(UBGPS_FILTER_REJECTED, results[20]);
+  EXPECT_EQ(UBGPS_FILTER_UPDATED, results[21]);
+
+  for (size_t i = 0; i < filtered.size(); i++)
+    EXPECT_LT(ErrorOf(epochs, filtered[i]), 10.0) << "at " << i;
+}
+
+TEST(NavPvtReplay, PersistentJumpRestartsFilter)
+{
+  std::vector<Epoch> epochs = ColdStart(40, 5.0, 5.0, 1.0);
+  std::vector<NavPvt> fixes;
+  std::vector<Published> filtered;
+  std::vector<int> results;
+
+  AddReceiverErrors(epochs, 4);
+  for (size_t i = 20; i < epochs.size(); i++)
+    epochs[i].north += 500.0;
+  fixes = Replay(Record(epochs));
+  filtered = RunFilter(fixes, 100, 10000, &results);
+
+  EXPECT_EQ(UBGPS_FILTER_REJECTED, results[20]);
+  EXPECT_EQ(UBGPS_FILTER_REJECTED, results[21]);
+  EXPECT_EQ(UBGPS_FILTER_INITIALIZED, results[22]);
+
+  ASSERT_FALSE(filtered.empty());
+  EXPECT_LT(ErrorOf(epochs, filtered.back()), 10.0);
+}
+
+TEST(NavPvtReplay, GapRestartsFilter)
+{
+  std::vector<Epoch> epochs = ColdStart(40, 5.0, 5.0, 1.0);
+  std::vector<NavPvt> fixes;
+  std::vector<int> results;
+
+  for (size_t i = 20; i < epochs.size(); i++)
+    epochs[i].itow += 120 * 1000;
+
+  AddReceiverErrors(epochs, 5);
+  fixes = Replay(Record(epochs));
+  RunFilter(fixes, 100, 10000, &results);
+
+  EXPECT_EQ(UBGPS_FILTER_UPDATED, results[19]);
+  EXPECT_EQ(UBGPS_FILTER_INITIALIZED, results[20]);
+}
+
+TEST(NavPvtReplay, NoFixIsNotPublished)
+{
+  std::vector<Epoch> epochs = ColdStart(20, 50.0, 5.0, 3.0);
+  std::vector<NavPvt> fixes;
+
+  for (size_t i = 0; i < epochs.size(); i++)
+    epochs[i].fix = false;
+
+  fixes = Replay(Record(epochs));
+
+  ASSERT_EQ(epochs.size(), fixes.size());
+  EXPECT_TRUE(RunFilter(fixes, 100, 10000).empty());
+}
+
+TEST(NavPvtReplay, RecordedLog)
+{
+  const char *path = getenv("UBGPS_NAV_PVT_LOG");
+  std::vector<uint8_t> stream;
+  std::vector<NavPvt> fixes;
+  std::vector<Published> filtered;
+  std::vector<Published> window;
+  uint8_t buf[4096];
+  size_t len;
+  FILE *f;
+
+  if (!path)
+    GTEST_SKIP() << "UBGPS_NAV_PVT_LOG not set";
+
+  f = fopen(path, "rb");
+  ASSERT_TRUE(f != NULL) << path;
+  while ((len = fread(buf, 1, sizeof(buf), f)) > 0)
+    stream.insert(stream.end(), buf, buf + len);
+  fclose(f);
+
+  fixes = Replay(stream);
+  ASSERT_FALSE(fixes.empty());
+
+  filtered = RunFilter(fixes, 100, 10000);
+  window = RunBestOfWindow(fixes, 100, 10000);
+
+  Metric("log_nav_pvt_messages", fixes.size(), "");
+  Metric("log_filter_published", filtered.size(), "");
+  Metric("log_window_published", window.size(), "");
+  if (!filtered.empty())
+    Metric("log_filter_first_publish_ms", filtered[0].itow - fixes[0].itow,
+           "ms");
+  if (!window.empty())
+    Metric("log_window_first_publish_ms", window[0].itow - fixes[0].itow,
+           "ms");
+}
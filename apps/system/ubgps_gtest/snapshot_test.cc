@@ -0,0 +1,425 @@
+/****************************************************************************
+ * apps/system/ubgps_gtest/snapshot_test.cc
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+/* Aiding snapshot tests. Snapshot is saved to host file system; messages
+ * sent to receiver are read back from other end of a socket pair standing
+ * in for GPS serial device.
+ */
+
+#include <nuttx/config.h>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+#include "gtest/gtest.h"
+#include "host_glue.h"
+
+extern "C" {
+int ubgps_snapshot_load(struct ubgps_s *gps);
+int ubgps_snapshot_inject(struct ubgps_s *gps);
+bool ubgps_snapshot_get_clock_drift(int32_t *drift, uint32_t *accuracy);
+void ubgps_snapshot_power_on(struct ubgps_s *gps);
+int ubgps_snapshot_power_off(struct ubgps_s *gps);
+void ubgps_snapshot_fix(struct ubgps_s *gps);
+}
+
+namespace {
+
+typedef std::vector<uint8_t> Bytes;
+
+const char *kPath = CONFIG_UBGPS_AID_SNAPSHOT_PATH;
+const char *kTmpPath = CONFIG_UBGPS_AID_SNAPSHOT_PATH ".tmp";
+
+const uint8_t kClassNav = 0x01;
+const uint8_t kNavClock = 0x22;
+const uint8_t kClassAid = 0x0b;
+const uint8_t kAidAlm = 0x30;
+const uint8_t kAidEph = 0x31;
+
+const uint16_t kEphLen = 104;
+const uint16_t kAlmLen = 40;
+const int kNumSv = 32;
+
+const long kHour = 60 * 60;
+const long kRefresh = 30 * 60 + 60;
+
+struct Msg
+{
+  uint8_t class_id;
+  uint8_t msg_id;
+  Bytes payload;
+};
+
+/* AID-EPH / AID-ALM poll response. Satellites without data get 8 byte
+ * response. */
+
+Bytes AidPayload(uint32_t svid, uint16_t len, uint8_t seed)
+{
+  Bytes p(len);
+
+  memcpy(&p[0], &svid, sizeof(svid));
+
+  if (len > 8)
+    {
+      uint32_t how = 0x1000 + svid;
+
+      memcpy(&p[4], &how, sizeof(how));
+      for (size_t i = 8; i < len; i++)
+        p[i] = (uint8_t)(seed * 31 + svid * 7 + i);
+    }
+
+  return p;
+}
+
+class SnapshotTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    int sv[2];
+
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+    ASSERT_EQ(0, fcntl(sv[1], F_SETFL, O_NONBLOCK));
+    gps_fd_ = sv[0];
+    peer_fd_ = sv[1];
+
+    (void)unlink(kPath);
+    (void)unlink(kTmpPath);
+
+    ubgps_host_clear();
+    ubgps_host_time_offset = 0;
+    ubgps_host_rtc_set = true;
+
+    gps_ = ubgps_host_create(gps_fd_);
+    ASSERT_TRUE(gps_ != NULL);
+
+    /* No snapshot yet, clears state left by previous test */
+
+    EXPECT_EQ(-1, ubgps_snapshot_load(gps_));
+  }
+
+  void TearDown() override
+  {
+    (void)ubgps_snapshot_power_off(gps_);
+    ubgps_host_destroy(gps_);
+    close(gps_fd_);
+    close(peer_fd_);
+    (void)unlink(kPath);
+    (void)unlink(kTmpPath);
+  }
+
+  /* UBX messages sent to receiver since last call */
+
+  std::vector<Msg> Sent()
+  {
+    std::vector<Msg> out;
+    Bytes buf;
+    uint8_t tmp[4096];
+    ssize_t n;
+    size_t pos = 0;
+
+    while ((n = read(peer_fd_, tmp, sizeof(tmp))) > 0)
+      buf.insert(buf.end(), tmp, tmp + n);
+
+    while (pos + 8 <= buf.size())
+      {
+        uint16_t len = buf[pos + 4] | (buf[pos + 5] << 8);
+        Msg m;
+
+        EXPECT_EQ(0xb5, buf[pos]);
+        EXPECT_EQ(0x62, buf[pos + 1]);
+        m.class_id = buf[pos + 2];
+        m.msg_id = buf[pos + 3];
+        m.payload.assign(buf.begin() + pos + 6, buf.begin() + pos + 6 + len);
+        out.push_back(m);
+        pos += 8 + len;
+      }
+
+    EXPECT_EQ(buf.size(), pos);
+    return out;
+  }
+
+  /* Start session with fix and expect refresh poll to be sent or not */
+
+  void StartWithFix(bool expect_poll)
+  {
+    std::vector<Msg> sent;
+
+    ubgps_snapshot_power_on(gps_);
+    ubgps_host_set_fix(gps_, 601699000, 249384000);
+    ubgps_snapshot_fix(gps_);
+
+    sent = Sent();
+    if (!expect_poll)
+      {
+        EXPECT_EQ(0u, sent.size());
+        return;
+      }
+
+    ASSERT_EQ(3u, sent.size());
+    EXPECT_EQ(kClassNav, sent[0].class_id);
+    EXPECT_EQ(kNavClock, sent[0].msg_id);
+    EXPECT_EQ(kClassAid, sent[1].class_id);
+    EXPECT_EQ(kAidEph, sent[1].msg_id);
+    EXPECT_EQ(0u, sent[1].payload.size());
+    EXPECT_EQ(kClassAid, sent[2].class_id);
+    EXPECT_EQ(kAidAlm, sent[2].msg_id);
+    EXPECT_EQ(0u, sent[2].payload.size());
+  }
+
+  /* Answer poll: ephemeris for first 'eph_sv' satellites, almanac for first
+   * 'alm_sv'. Returns records expected in snapshot. */
+
+  std::vector<Msg> AnswerPoll(uint8_t seed, int eph_sv, int alm_sv,
+                              int count = kNumSv)
+  {
+    std::vector<Msg> stored;
+    int32_t drift = -1234;
+    uint32_t drift_acc = 5000;
+    Bytes clk(20);
+    int sv;
+
+    memcpy(&clk[8], &drift, sizeof(drift));
+    memcpy(&clk[16], &drift_acc, sizeof(drift_acc));
+    EXPECT_EQ(0, ubgps_host_snapshot_msg(gps_, kClassNav, kNavClock,
+                                         clk.data(), clk.size()));
+
+    for (sv = 1; sv <= count; sv++)
+      {
+        Bytes p = AidPayload(sv, sv <= eph_sv ? kEphLen : 8, seed);
+
+        EXPECT_EQ(0, ubgps_host_snapshot_msg(gps_, kClassAid, kAidEph,
+                                             p.data(), p.size()));
+        if (sv <= eph_sv)
+          stored.push_back(Msg{ kClassAid, kAidEph, p });
+      }
+
+    for (sv = 1; sv <= count; sv++)
+      {
+        Bytes p = AidPayload(sv, sv <= alm_sv ? kAlmLen : 8, seed);
+
+        EXPECT_EQ(0, ubgps_host_snapshot_msg(gps_, kClassAid, kAidAlm,
+                                             p.data(), p.size()));
+        if (sv <= alm_sv)
+          stored.push_back(Msg{ kClassAid, kAidAlm, p });
+      }
+
+    return stored;
+  }
+
+  std::vector<Msg> MakeSnapshot(uint8_t seed, int eph_sv, int alm_sv)
+  {
+    std::vector<Msg> stored;
+
+    StartWithFix(true);
+    stored = AnswerPoll(seed, eph_sv, alm_sv);
+    EXPECT_EQ(0, access(kPath, F_OK));
+    EXPECT_NE(0, access(kTmpPath, F_OK));
+    EXPECT_EQ(0, ubgps_snapshot_power_off(gps_));
+
+    return stored;
+  }
+
+  void ExpectInjected(const std::vector<Msg> &expected)
+  {
+    std::vector<Msg> sent;
+    size_t i;
+
+    EXPECT_EQ((int)expected.size(), ubgps_snapshot_inject(gps_));
+    sent = Sent();
+
+    ASSERT_EQ(expected.size(), sent.size());
+    for (i = 0; i < expected.size(); i++)
+      {
+        EXPECT_EQ(expected[i].class_id, sent[i].class_id);
+        EXPECT_EQ(expected[i].msg_id, sent[i].msg_id);
+        EXPECT_EQ(expected[i].payload, sent[i].payload) << "record " << i;
+      }
+  }
+
+  static std::vector<Msg> Only(const std::vector<Msg> &msgs, uint8_t msg_id)
+  {
+    std::vector<Msg> out;
+
+    for (const Msg &m : msgs)
+      if (m.msg_id == msg_id)
+        out.push_back(m);
+
+    return out;
+  }
+
+  void CorruptByte(long offset)
+  {
+    FILE *f = fopen(kPath, "r+b");
+    int c;
+
+    ASSERT_TRUE(f != NULL);
+    ASSERT_EQ(0, fseek(f, offset, offset < 0 ? SEEK_END : SEEK_SET));
+    c = fgetc(f);
+    ASSERT_EQ(0, fseek(f, -1, SEEK_CUR));
+    fputc(c ^ 0x55, f);
+    fclose(f);
+  }
+
+  struct ubgps_s *gps_;
+  int gps_fd_;
+  int peer_fd_;
+};
+
+TEST_F(SnapshotTest, SaveLoadRoundTrip)
+{
+  std::vector<Msg> stored = MakeSnapshot(1, 5, 7);
+  int32_t drift;
+  uint32_t drift_acc;
+
+  EXPECT_EQ(0, ubgps_snapshot_load(gps_));
+
+  /* Last fix is given as location hint */
+
+  EXPECT_EQ(1, ubgps_host_hints);
+  EXPECT_NEAR(60.1699, ubgps_host_hint_latitude, 1e-6);
+  EXPECT_NEAR(24.9384, ubgps_host_hint_longitude, 1e-6);
+  EXPECT_EQ(10u, ubgps_host_hint_accuracy);
+
+  ASSERT_TRUE(ubgps_snapshot_get_clock_drift(&drift, &drift_acc));
+  EXPECT_EQ(-1234, drift);
+  EXPECT_EQ(5000u + 1000u, drift_acc);
+
+  ExpectInjected(stored);
+}
+
+TEST_F(SnapshotTest, CorruptedRecordIsRejected)
+{
+  MakeSnapshot(1, 5, 7);
+
+  /* Header stays valid, record CRC does not match */
+
+  CorruptByte(-3);
+  EXPECT_EQ(0, ubgps_snapshot_load(gps_));
+  EXPECT_EQ(0, ubgps_snapshot_inject(gps_));
+  EXPECT_EQ(0u, Sent().size());
+
+  /* Records are refreshed on next fix */
+
+  StartWithFix(true);
+}
+
+TEST_F(SnapshotTest, CorruptedHeaderIsRejected)
+{
+  MakeSnapshot(1, 5, 7);
+
+  CorruptByte(12);
+  EXPECT_EQ(-1, ubgps_snapshot_load(gps_));
+  EXPECT_EQ(0, ubgps_snapshot_inject(gps_));
+  EXPECT_EQ(0, ubgps_host_hints);
+}
+
+TEST_F(SnapshotTest, InjectHonoursValidityWindows)
+{
+  std::vector<Msg> stored = MakeSnapshot(1, 5, 7);
+
+  EXPECT_EQ(0, ubgps_snapshot_load(gps_));
+
+  /* Ephemeris and almanac */
+
+  ubgps_host_time_offset = 2 * kHour - 60;
+  ExpectInjected(stored);
+
+  /* Almanac only */
+
+  ubgps_host_time_offset = 2 * kHour;
+  ExpectInjected(Only(stored, kAidAlm));
+
+  ubgps_host_time_offset = 30 * 24 * kHour - 60;
+  ExpectInjected(Only(stored, kAidAlm));
+
+  /* Nothing */
+
+  ubgps_host_time_offset = 30 * 24 * kHour;
+  ExpectInjected(std::vector<Msg>());
+
+  /* Nothing without system time */
+
+  ubgps_host_time_offset = 0;
+  ubgps_host_rtc_set = false;
+  ExpectInjected(std::vector<Msg>());
+}
+
+TEST_F(SnapshotTest, NoRefreshBeforeInterval)
+{
+  MakeSnapshot(1, 5, 7);
+
+  ubgps_host_time_offset = kRefresh - 2 * 60;
+  StartWithFix(false);
+}
+
+TEST_F(SnapshotTest, InterruptedPollKeepsPreviousSnapshot)
+{
+  std::vector<Msg> stored = MakeSnapshot(1, 5, 7);
+  std::vector<Msg> refreshed;
+
+  /* Refresh poll interrupted by power-off after some responses */
+
+  ubgps_host_time_offset = kRefresh;
+  StartWithFix(true);
+  AnswerPoll(2, 12, 0, 12);
+  EXPECT_EQ(0, access(kTmpPath, F_OK));
+
+  EXPECT_EQ(0, ubgps_snapshot_power_off(gps_));
+  EXPECT_NE(0, access(kTmpPath, F_OK));
+
+  /* Previous records are intact */
+
+  EXPECT_EQ(0, ubgps_snapshot_load(gps_));
+  ExpectInjected(stored);
+
+  /* Poll time was not updated, refresh is retried on next fix */
+
+  StartWithFix(true);
+  refreshed = AnswerPoll(3, 8, 4);
+  EXPECT_EQ(0, ubgps_snapshot_power_off(gps_));
+
+  EXPECT_EQ(0, ubgps_snapshot_load(gps_));
+  ExpectInjected(refreshed);
+
+  /* Stored ephemeris is aged from completed poll */
+
+  ubgps_host_time_offset = kRefresh + 2 * kHour - 60;
+  ExpectInjected(refreshed);
+}
+
+} // namespace
@@ -0,0 +1,327 @@
+/****************************************************************************
+ * apps/system/ubgps_gtest/ubx_scan_test.cc
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+/* UBX frame scanner tests. Receiver reads from a pipe standing in for GPS
+ * serial device; timers and NMEA receiver are stubbed by host glue.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "host_glue.h"
+
+namespace {
+
+typedef std::vector<uint8_t> Bytes;
+
+const uint8_t kClassNav = 0x01;
+const uint8_t kNavPvt = 0x07;
+const uint8_t kNavClock = 0x22;
+
+Bytes Frame(uint8_t class_id, uint8_t msg_id, const Bytes &payload)
+{
+  Bytes f = { 0xb5, 0x62, class_id, msg_id,
+              (uint8_t)(payload.size() & 0xff),
+              (uint8_t)(payload.size() >> 8) };
+  uint8_t ck_a = 0;
+  uint8_t ck_b = 0;
+
+  f.insert(f.end(), payload.begin(), payload.end());
+
+  for (size_t i = 2; i < f.size(); i++)
+    {
+      ck_a += f[i];
+      ck_b += ck_a;
+    }
+
+  f.push_back(ck_a);
+  f.push_back(ck_b);
+  return f;
+}
+
+Bytes Payload(size_t len, uint8_t seed)
+{
+  Bytes p(len);
+
+  for (size_t i = 0; i < len; i++)
+    p[i] = (uint8_t)(seed + i);
+
+  return p;
+}
+
+Bytes Text(const char *s)
+{
+  return Bytes(s, s + strlen(s));
+}
+
+Bytes Cat(std::initializer_list<Bytes> parts)
+{
+  Bytes out;
+
+  for (const Bytes &p : parts)
+    out.insert(out.end(), p.begin(), p.end());
+
+  return out;
+}
+
+class UbxScanTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    int fds[2];
+
+    ASSERT_EQ(0, pipe(fds));
+    ASSERT_EQ(0, fcntl(fds[0], F_SETFL, O_NONBLOCK));
+    rfd_ = fds[0];
+    wfd_ = fds[1];
+
+    ubgps_host_clear();
+    gps_ = ubgps_host_create(rfd_);
+    ASSERT_TRUE(gps_ != NULL);
+  }
+
+  void TearDown() override
+  {
+    ubgps_host_destroy(gps_);
+    close(rfd_);
+    close(wfd_);
+    EXPECT_EQ(0, ubgps_host_timers);
+  }
+
+  /* Feed bytes to receiver as one read */
+
+  void Feed(const Bytes &data)
+  {
+    ASSERT_EQ((ssize_t)data.size(), write(wfd_, data.data(), data.size()));
+    EXPECT_EQ((ssize_t)data.size(), ubgps_host_receive(gps_));
+  }
+
+  std::string Nmea() const
+  {
+    return std::string((const char *)ubgps_host_nmea, ubgps_host_nmea_len);
+  }
+
+  void ExpectMsg(int idx, uint8_t class_id, uint8_t msg_id,
+                 const Bytes &payload)
+  {
+    const struct ubgps_host_msg_s &m = ubgps_host_msgs[idx];
+    size_t n = payload.size() < sizeof(m.payload) ? payload.size() :
+                                                    sizeof(m.payload);
+
+    ASSERT_LT(idx, ubgps_host_msg_count);
+    EXPECT_EQ(class_id, m.class_id);
+    EXPECT_EQ(msg_id, m.msg_id);
+    EXPECT_EQ(payload.size(), m.length);
+    EXPECT_TRUE(m.aligned);
+    EXPECT_EQ(0, memcmp(payload.data(), m.payload, n));
+  }
+
+  struct ubgps_s *gps_;
+  int rfd_;
+  int wfd_;
+};
+
+TEST_F(UbxScanTest, NmeaPassedThroughBetweenFrames)
+{
+  const char *gga = "$GPGGA,,,,,,0,00,99.99,,,,,,*48\r\n";
+  const char *rmc = "$GPRMC,,V,,,,,,,,,,N*53\r\n";
+  Bytes pvt = Payload(92, 1);
+  Bytes clk = Payload(20, 7);
+
+  Feed(Cat({ Text(gga), Frame(kClassNav, kNavPvt, pvt), Text(rmc),
+             Frame(kClassNav, kNavClock, clk), Text(gga) }));
+
+  EXPECT_EQ(std::string(gga) + rmc + gga, Nmea());
+  ASSERT_EQ(2, ubgps_host_msg_count);
+  ExpectMsg(0, kClassNav, kNavPvt, pvt);
+  ExpectMsg(1, kClassNav, kNavClock, clk);
+  EXPECT_EQ(0u, ubgps_host_rx_pending(gps_));
+}
+
+TEST_F(UbxScanTest, FalseSyncResynchronisesOneByteLater)
+{
+  Bytes clk = Payload(20, 3);
+
+  /* Sync character not followed by second sync character */
+
+  Feed(Cat({ Bytes{ 0xb5 }, Frame(kClassNav, kNavClock, clk) }));
+
+  ASSERT_EQ(1, ubgps_host_msg_count);
+  ExpectMsg(0, kClassNav, kNavClock, clk);
+  EXPECT_EQ(0u, ubgps_host_nmea_len);
+  EXPECT_EQ(0u, ubgps_host_rx_pending(gps_));
+}
+
+TEST_F(UbxScanTest, OversizeLengthResynchronisesOneByteLater)
+{
+  Bytes clk = Payload(20, 3);
+
+  /* Header claiming too long payload, real frame follows */
+
+  Feed(Cat({ Bytes{ 0xb5, 0x62, kClassNav, kNavPvt, 0xff, 0xff },
+             Frame(kClassNav, kNavClock, clk) }));
+
+  ASSERT_EQ(1, ubgps_host_msg_count);
+  ExpectMsg(0, kClassNav, kNavClock, clk);
+  EXPECT_EQ(0u, ubgps_host_rx_pending(gps_));
+}
+
+TEST_F(UbxScanTest, BadChecksumResynchronisesOneByteLater)
+{
+  Bytes clk = Payload(20, 3);
+  Bytes inner = Frame(kClassNav, kNavClock, clk);
+  Bytes outer = Frame(kClassNav, kNavPvt, inner);
+
+  /* Corrupted frame whose payload happens to contain valid frame: bytes
+   * after false start must be rescanned, not skipped. */
+
+  outer.back() ^= 0xff;
+  Feed(outer);
+
+  ASSERT_EQ(1, ubgps_host_msg_count);
+  ExpectMsg(0, kClassNav, kNavClock, clk);
+  EXPECT_EQ(0u, ubgps_host_rx_pending(gps_));
+}
+
+TEST_F(UbxScanTest, FrameSplitAcrossReads)
+{
+  Bytes pvt = Payload(92, 5);
+  Bytes frame = Frame(kClassNav, kNavPvt, pvt);
+  size_t i;
+
+  /* Header split */
+
+  Feed(Bytes(frame.begin(), frame.begin() + 3));
+  EXPECT_EQ(0, ubgps_host_msg_count);
+  EXPECT_EQ(3u, ubgps_host_rx_pending(gps_));
+  EXPECT_EQ(1, ubgps_host_timers);
+
+  /* Payload split */
+
+  Feed(Bytes(frame.begin() + 3, frame.begin() + 50));
+  EXPECT_EQ(0, ubgps_host_msg_count);
+  EXPECT_EQ(50u, ubgps_host_rx_pending(gps_));
+  EXPECT_EQ(1, ubgps_host_timers);
+
+  Feed(Bytes(frame.begin() + 50, frame.end()));
+  ASSERT_EQ(1, ubgps_host_msg_count);
+  ExpectMsg(0, kClassNav, kNavPvt, pvt);
+  EXPECT_TRUE(ubgps_host_msgs[0].in_place);
+  EXPECT_EQ(0u, ubgps_host_rx_pending(gps_));
+  EXPECT_EQ(0, ubgps_host_timers);
+
+  /* One byte at a time */
+
+  for (i = 0; i < frame.size(); i++)
+    Feed(Bytes(1, frame[i]));
+
+  ASSERT_EQ(2, ubgps_host_msg_count);
+  ExpectMsg(1, kClassNav, kNavPvt, pvt);
+  EXPECT_EQ(0u, ubgps_host_nmea_len);
+}
+
+TEST_F(UbxScanTest, UnalignedFrameIsCopied)
+{
+  Bytes clk = Payload(20, 9);
+
+  /* Frame following single NMEA byte has misaligned payload in receive
+   * buffer */
+
+  Feed(Cat({ Text("\n"), Frame(kClassNav, kNavClock, clk),
+             Frame(kClassNav, kNavClock, clk) }));
+
+  ASSERT_EQ(2, ubgps_host_msg_count);
+  ExpectMsg(0, kClassNav, kNavClock, clk);
+  ExpectMsg(1, kClassNav, kNavClock, clk);
+  EXPECT_FALSE(ubgps_host_msgs[0].in_place);
+  EXPECT_FALSE(ubgps_host_msgs[1].in_place);
+  EXPECT_EQ("\n", Nmea());
+
+  /* Frame at start of buffer is delivered in place */
+
+  Feed(Frame(kClassNav, kNavClock, clk));
+
+  ASSERT_EQ(3, ubgps_host_msg_count);
+  ExpectMsg(2, kClassNav, kNavClock, clk);
+  EXPECT_TRUE(ubgps_host_msgs[2].in_place);
+}
+
+TEST_F(UbxScanTest, ResetFromCallbackStopsScan)
+{
+  Bytes clk = Payload(20, 1);
+  Bytes pvt = Payload(92, 2);
+
+  ubgps_host_reset_at_msg = 1;
+
+  /* Rest of buffer is dropped, including incomplete frame at end */
+
+  Feed(Cat({ Frame(kClassNav, kNavClock, clk),
+             Frame(kClassNav, kNavPvt, pvt), Text("$GP"),
+             Bytes{ 0xb5, 0x62, kClassNav } }));
+
+  ASSERT_EQ(1, ubgps_host_msg_count);
+  ExpectMsg(0, kClassNav, kNavClock, clk);
+  EXPECT_EQ(0u, ubgps_host_nmea_len);
+  EXPECT_EQ(0u, ubgps_host_rx_pending(gps_));
+  EXPECT_EQ(0, ubgps_host_timers);
+
+  /* Receiver continues from next read */
+
+  Feed(Frame(kClassNav, kNavPvt, pvt));
+
+  ASSERT_EQ(2, ubgps_host_msg_count);
+  ExpectMsg(1, kClassNav, kNavPvt, pvt);
+}
+
+TEST_F(UbxScanTest, ReceiveTimeoutDropsIncompleteFrame)
+{
+  Bytes clk = Payload(20, 4);
+  Bytes frame = Frame(kClassNav, kNavClock, clk);
+
+  Feed(Bytes(frame.begin(), frame.begin() + 10));
+  EXPECT_EQ(10u, ubgps_host_rx_pending(gps_));
+
+  ubgps_host_fire_timers();
+  EXPECT_EQ(0u, ubgps_host_rx_pending(gps_));
+
+  Feed(frame);
+  ASSERT_EQ(1, ubgps_host_msg_count);
+  ExpectMsg(0, kClassNav, kNavClock, clk);
+}
+
+} // namespace
@@ -65,6 +65,10 @@
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
 #endif
 
+/* Chunk size for streaming raw data from file descriptor to modem. */
+
+#define MODEM_RAW_FD_CHUNK_LEN 128
+
 /****************************************************************************
  * Private Types
  ****************************************************************************/
@@ -85,6 +89,52 @@
  * Private Functions
  ****************************************************************************/
 
+/****************************************************************************
+ * Name: modem_write_raw
+ *
+ * Description:
+ *   Write raw buffer to non-blocking modem serial, give trace output.
+ *
+ ****************************************************************************/
+
+static int modem_write_raw(struct ubmodem_s *modem, const void *buf,
+                           size_t buflen)
+{
+  ssize_t nwritten;
+  const char *writebuf;
+  size_t writelen;
+
+  writebuf = buf;
+  writelen = buflen;
+  do
+    {
+      nwritten = write(modem->serial_fd, writebuf, writelen);
+      if (nwritten == ERROR)
+        {
+          int error = get_errno();
+
+          if (error != EAGAIN)
+            {
+              dbg("modem write error, errno: %d\n", error);
+
+              return ERROR;
+            }
+          nwritten = 0;
+        }
+      writebuf += nwritten;
+      writelen -= nwritten;
+    }
+  while (writelen > 0);
+
+  /* Give trace output if active. */
+
+  if (modem->active_events & UBMODEM_EVENT_FLAG_TRACE_DATA_TO_MODEM)
+    __ubmodem_publish_event(modem, UBMODEM_EVENT_FLAG_TRACE_DATA_TO_MODEM,
+                        buf, buflen);
+
+  return OK;
+}
+
 static int modem_send_cmd_vfmt(struct ubmodem_s *modem,
                                const struct at_cmd_def_s *cmd,
                                const modem_response_callback_t callback,
@@ -96,6 +146,7 @@ static int modem_send_cmd_vfmt(struct ubmodem_s *modem,
   size_t pos;
   ssize_t nwritten;
   size_t total;
+  va_list vargs_len;
   int err;
 
   /* Prepare parser for new command. */
@@ -107,7 +158,9 @@ static int modem_send_cmd_vfmt(struct ubmodem_s *modem,
 
   total = 0;
   total += snprintf(NULL, 0, "AT%s", cmd->name);
-  total += vsnprintf(NULL, 0, fmt, vargs);
+  va_copy(vargs_len, vargs);
+  total += vsnprintf(NULL, 0, fmt, vargs_len);
+  va_end(vargs_len);
   total += 1;
 
   if (total > 0)
@@ -341,10 +394,6 @@ int __ubmodem_send_raw(struct ubmodem_s *modem,
                    const modem_response_callback_t callback,
                    void *callback_priv, const void *buf, size_t buflen)
 {
-
-  ssize_t nwritten;
-  const char *writebuf;
-  size_t writelen;
   int err;
 
   /* Prepare parser for new command. */
@@ -360,38 +409,103 @@ int __ubmodem_send_raw(struct ubmodem_s *modem,
 
   /* Write buffer to modem. */
 
-  writebuf = buf;
-  writelen = buflen;
-  do
+  err = modem_write_raw(modem, buf, buflen);
+  if (err != OK)
+    return ERROR;
+
+  /* Setup timeout for command response. */
+
+  err = __ubparser_setup_command_timeout(&modem->parser);
+  assert(err == OK);
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: __ubmodem_send_raw_from_fd
+ *
+ * Description:
+ *   Send raw data to modem AT prompt directly from file descriptor, prepare
+ *   parser for handling result code and other responses. Data is passed
+ *   to modem in small chunks as it is read, without buffering whole data.
+ *
+ * Input Parameters:
+ *   cmd           : AT command definition for parser (response format, etc).
+ *   callback      : Callback function for results
+ *   callback_priv : Callback private data
+ *   fd            : File descriptor to read data from
+ *   buflen        : Length of data
+ *
+ * Returned Values:
+ *   Number of bytes read from 'fd'. If reading fails before 'buflen' bytes
+ *   has been read, rest of data prompt is filled with zeros to keep modem
+ *   in sync; caller must then discard the connection, as padding is passed
+ *   on to peer.
+ *   ERROR if failed to write to modem.
+ *
+ ****************************************************************************/
+
+ssize_t __ubmodem_send_raw_from_fd(struct ubmodem_s *modem,
+                                   const struct at_cmd_def_s *cmd,
+                                   const modem_response_callback_t callback,
+                                   void *callback_priv, int fd, size_t buflen)
+{
+  uint8_t chunk[MODEM_RAW_FD_CHUNK_LEN];
+  size_t nread = 0;
+  size_t pos = 0;
+  ssize_t rlen;
+  size_t len;
+  int err;
+
+  /* Prepare parser for new command. */
+
+  __ubparser_register_response_handler(&modem->parser, cmd, callback,
+                                       callback_priv, false);
+
+  /* Set serial as non-blocking. */
+
+  err = __ubmodem_set_nonblocking(modem, true);
+  if (err != OK)
+    return ERROR;
+
+  /* Pass data from file descriptor to modem. */
+
+  while (pos < buflen)
     {
-      nwritten = write(modem->serial_fd, writebuf, writelen);
-      if (nwritten == ERROR)
-        {
-          int error = get_errno();
+      len = buflen - pos;
+      if (len > sizeof(chunk))
+        len = sizeof(chunk);
 
-          if (error != EAGAIN)
+      if (nread == pos)
+        {
+          rlen = read(fd, chunk, len);
+          if (rlen > 0)
             {
-              dbg("modem write error, errno: %d\n", error);
+              nread += rlen;
+              len = rlen;
+            }
+          else
+            {
+              dbg("Error reading %d bytes: ret=%d, errno=%d\n", len,
+                  (int)rlen, rlen < 0 ? get_errno() : 0);
 
-              return ERROR;
+              /* Read failed, pad rest of data with zeros. */
+
+              memset(chunk, 0, sizeof(chunk));
             }
-          nwritten = 0;
         }
-      writebuf += nwritten;
-      writelen -= nwritten;
-    }
-  while (writelen > 0);
 
-  /* Give trace output if active. */
+      err = modem_write_raw(modem, chunk, len);
+      if (err != OK)
+        return ERROR;
 
-  if (modem->active_events & UBMODEM_EVENT_FLAG_TRACE_DATA_TO_MODEM)
-    __ubmodem_publish_event(modem, UBMODEM_EVENT_FLAG_TRACE_DATA_TO_MODEM,
-                        buf, buflen);
+      pos += len;
+    }
 
   /* Setup timeout for command response. */
 
   err = __ubparser_setup_command_timeout(&modem->parser);
   assert(err == OK);
 
-  return OK;
+  return nread;
 }
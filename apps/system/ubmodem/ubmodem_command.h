@@ -140,5 +140,32 @@ int __ubmodem_send_raw(struct ubmodem_s *modem,
                    const modem_response_callback_t callback,
                    void *callback_priv, const void *buf, size_t buflen);
 
+/****************************************************************************
+ * Name: __ubmodem_send_raw_from_fd
+ *
+ * Description:
+ *   Send raw data to modem AT prompt directly from file descriptor, prepare
+ *   parser for handling result code and other responses.
+ *
+ * Input Parameters:
+ *   modem         : Modem module structure
+ *   cmd           : AT command definition for parser (response format, etc).
+ *   callback      : Callback function for results
+ *   callback_priv : Callback private data
+ *   fd            : File descriptor to read data from
+ *   buflen        : Length of data
+ *
+ * Returned Values:
+ *   Number of bytes read from 'fd'. If less than 'buflen', rest of data
+ *   prompt has been filled with zeros, which modem passes on to peer.
+ *   ERROR if failed.
+ *
+ ****************************************************************************/
+
+ssize_t __ubmodem_send_raw_from_fd(struct ubmodem_s *modem,
+                                   const struct at_cmd_def_s *cmd,
+                                   const modem_response_callback_t callback,
+                                   void *callback_priv, int fd, size_t buflen);
+
 #endif /* __SYSTEM_UBMODEM_UBMODEM_INTERNAL_H_ */
 
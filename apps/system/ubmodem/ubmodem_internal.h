@@ -70,6 +70,25 @@
 
 #define MODEM_MAX_BINARY_SOCKET_READ_BYTES 1024
 
+/* Socket read-ahead buffer pool, shared by all sockets. */
+
+#ifndef CONFIG_UBMODEM_USRSOCK_RECV_IOBS
+#  define CONFIG_UBMODEM_USRSOCK_RECV_IOBS 16
+#endif
+
+#ifndef CONFIG_UBMODEM_USRSOCK_RECV_IOB_SIZE
+#  define CONFIG_UBMODEM_USRSOCK_RECV_IOB_SIZE 128
+#endif
+
+/* Modem TCP TX window for unacknowledged bytes accounting, and minimum
+ * write to issue when window is nearly full. */
+
+#ifndef CONFIG_UBMODEM_USRSOCK_TX_WINDOW
+#  define CONFIG_UBMODEM_USRSOCK_TX_WINDOW 4096
+#endif
+
+#define UBMODEM_USRSOCK_TX_WINDOW_MIN_WRITE 256
+
 /* Limit for UDP packet payload size. */
 
 #define UBMODEM_USRSOCK_UDP_MAX_PACKET_PAYLOAD 1024
@@ -218,6 +237,19 @@ typedef const ubmodem_send_config_func_t *(* ubmodem_configs_func_t)(
 typedef void (*modem_check_cmee_func_t)(struct ubmodem_s *modem, bool cmee_ok,
                                         int cmee_setting, void *priv);
 
+#ifdef CONFIG_UBMODEM_USRSOCK
+/* Socket read-ahead buffer. Buffers are taken from pool in modem structure
+ * and chained per socket, in the manner of NuttX I/O buffers (IOBs). */
+
+struct ubmodem_recv_iob_s
+{
+  sq_entry_t node;
+  uint16_t len;                     /* Length of data in buffer. */
+  uint16_t offset;                  /* Read position in buffer. */
+  uint8_t data[CONFIG_UBMODEM_USRSOCK_RECV_IOB_SIZE];
+};
+#endif
+
 /* Modem module data structure */
 
 struct ubmodem_s {
@@ -364,6 +396,11 @@ struct ubmodem_s {
     struct ubmodem_event_ip_address_s ipcfg;
     uint8_t poll_off_count; /* usrsock poll enabled when count is zero. */
     uint8_t poll_off_list[MODEM_MAX_SOCKETS_OPEN + 1];
+#if CONFIG_UBMODEM_USRSOCK_RECV_IOBS > 0
+    uint16_t recv_iob_nfree;
+    sq_queue_t recv_iob_free;
+    struct ubmodem_recv_iob_s recv_iobs[CONFIG_UBMODEM_USRSOCK_RECV_IOBS];
+#endif
   } sockets;
 #endif
 
@@ -66,6 +66,11 @@
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
 #endif
 
+/* FNV-1a parameters for response name hashing. */
+
+#define PARSER_NAME_HASH_INIT  2166136261U
+#define PARSER_NAME_HASH_PRIME 16777619U
+
 /****************************************************************************
  * Private Types
  ****************************************************************************/
@@ -76,7 +81,7 @@
 
 static struct at_response_handler_s *
 parser_find_response_handler_by_name(struct at_parser_s *parser,
-                                     const char *name);
+                                     const char *name, uint32_t name_hash);
 static struct at_response_handler_s *
 parser_find_response_handler_for_active_command(struct at_parser_s *parser);
 static bool parse_parameter_byte(struct at_parser_s *parser, char cur_char,
@@ -121,6 +126,42 @@ static void rotate_charbuf(char *buf, size_t len, size_t n)
 }
 #endif
 
+/****************************************************************************
+ * Name: parser_name_hash_step
+ *
+ * Description:
+ *   Add character to case-insensitive hash of response name. Response names
+ *   are hashed while being received, so that handler lookup only needs to
+ *   compare strings of handlers with matching hash.
+ *
+ ****************************************************************************/
+
+static inline uint32_t parser_name_hash_step(uint32_t hash, char c)
+{
+  if (c >= 'a' && c <= 'z')
+    c -= 'a' - 'A';
+
+  return (hash ^ (uint8_t)c) * PARSER_NAME_HASH_PRIME;
+}
+
+/****************************************************************************
+ * Name: parser_name_hash
+ *
+ * Description:
+ *   Calculate case-insensitive hash of response name.
+ *
+ ****************************************************************************/
+
+static uint32_t parser_name_hash(const char *name)
+{
+  uint32_t hash = PARSER_NAME_HASH_INIT;
+
+  while (*name)
+    hash = parser_name_hash_step(hash, *name++);
+
+  return hash;
+}
+
 /****************************************************************************
  * Name: is_visible_at_ascii
  *
@@ -399,7 +440,8 @@ static bool parser_found_response_name(struct at_parser_s *parser,
     {
       /* Check valid responses for active command */
 
-      if (!active->cmd->flag_plain && strcmp(resp_name, active->cmd->name) == 0)
+      if (!active->cmd->flag_plain && active->name_hash == parser->name_hash &&
+          strcmp(resp_name, active->cmd->name) == 0)
         {
           parser_resp_trace(parser, active->cmd->name);
 
@@ -540,7 +582,8 @@ static bool parser_found_response_name(struct at_parser_s *parser,
     {
       /* Check if response name is known URC. */
 
-      urc = parser_find_response_handler_by_name(parser, resp_name);
+      urc = parser_find_response_handler_by_name(parser, resp_name,
+                                                 parser->name_hash);
 
       if (urc && urc != plain)
         {
@@ -1113,6 +1156,7 @@ restart:
       /* Initial state for parser, should be beginning of line. */
 
       parser->statebufpos = 0;
+      parser->name_hash = PARSER_NAME_HASH_INIT;
       parser->handler = NULL;
       parser->state = PARSER_STATE_READ_RESPONSE_NAME;
 
@@ -1139,6 +1183,8 @@ restart:
             {
               parser->statebuf[0] = cur_char;
               parser->statebufpos = 1;
+              parser->name_hash = parser_name_hash_step(PARSER_NAME_HASH_INIT,
+                                                        cur_char);
             }
           else if (parser->statebufpos == 0)
             {
@@ -1200,6 +1246,8 @@ restart:
           if (parser->statebufpos < sizeof(parser->statebuf))
             {
               parser->statebuf[parser->statebufpos++] = cur_char;
+              parser->name_hash = parser_name_hash_step(parser->name_hash,
+                                                        cur_char);
             }
         }
 
@@ -1267,6 +1315,146 @@ restart:
     }
 }
 
+/****************************************************************************
+ * Name: parser_find_eol
+ *
+ * Description:
+ *   Find first end-of-line character, or 'stop' character if not '\0'.
+ *
+ * Returned Values:
+ *   Number of bytes before found character, or 'buflen' if not found.
+ *
+ ****************************************************************************/
+
+static size_t parser_find_eol(const uint8_t *buf, size_t buflen, char stop)
+{
+  const uint8_t *end;
+  size_t len = buflen;
+
+  end = memchr(buf, '\r', len);
+  if (end)
+    len = end - buf;
+
+  end = memchr(buf, '\n', len);
+  if (end)
+    len = end - buf;
+
+  if (stop != '\0')
+    {
+      end = memchr(buf, stop, len);
+      if (end)
+        len = end - buf;
+    }
+
+  return len;
+}
+
+/****************************************************************************
+ * Name: parse_bulk
+ *
+ * Description:
+ *   Fast path for parser state machine. In states where run of input bytes
+ *   has no effect other than being copied to response stream or skipped
+ *   (payload of quoted data buffer, content of strings, rest of unknown
+ *   line), pass the whole run at once instead of byte-by-byte.
+ *
+ * Input Parameters:
+ *   parser      : Parser structure
+ *   buf         : Input buffer
+ *   buflen      : Length of input buffer
+ *
+ * Returned Values:
+ *   Number of bytes consumed. Zero if next byte needs to be handled by
+ *   'parse_byte'.
+ *
+ ****************************************************************************/
+
+static size_t parse_bulk(struct at_parser_s *parser, const uint8_t *buf,
+                         size_t buflen)
+{
+  size_t len;
+  size_t space;
+
+  if (parser->state == PARSER_STATE_SKIP_TO_EOL)
+    {
+      len = parser_find_eol(buf, buflen, '\0');
+      goto out;
+    }
+
+  if (parser->state != PARSER_STATE_DO_READ_PARAM ||
+      parser->param.stream_strlen_pos == NULL)
+    {
+      return 0;
+    }
+
+  switch ((enum at_resp_format_e)parser->param.fmt)
+    {
+    case RESP_FMT_QUOTED_DATABUF:
+      /* Data buffer content is opaque, only length matters. */
+
+      if (parser->param.quotes != 1)
+        return 0;
+
+      len = parser->response.datalen;
+      if (len > buflen)
+        len = buflen;
+
+      parser->response.datalen -= len;
+      break;
+
+    case RESP_FMT_QUOTED_STRING:
+      /* Quoted string is ended by quote or end-of-line. */
+
+      if (parser->param.quotes != 1)
+        return 0;
+
+      len = parser_find_eol(buf, buflen, '\"');
+      break;
+
+    case RESP_FMT_STRING:
+    case RESP_FMT_STRING_TO_EOL:
+      /* Plain string is ended by end-of-line (or ','). Leading spaces are
+       * skipped byte-by-byte. */
+
+      if (parser->param.strlen == 0)
+        return 0;
+
+      len = parser_find_eol(buf, buflen,
+                            parser->param.fmt == RESP_FMT_STRING ? ',' : '\0');
+      break;
+
+    default:
+      return 0;
+    }
+
+  /* Copy run to response stream. Overflowing characters are dropped, as
+   * with 'modem_stream_put_int8'. */
+
+  space = sizeof(parser->stream.buf) - parser->stream.pos;
+  if (space > len)
+    space = len;
+
+  memcpy(&parser->stream.buf[parser->stream.pos], buf, space);
+  parser->stream.pos += space;
+  parser->param.strlen += space;
+
+out:
+#ifdef CONFIG_UBMODEM_PARSER_DEBUG
+  {
+    size_t i;
+
+    for (i = 0; i < len; i++)
+      {
+        parser->last_received[parser->last_received_pos++] = buf[i];
+        if (parser->last_received_pos == sizeof(parser->last_received))
+          parser->last_received_pos = 0;
+      }
+  }
+#endif
+
+  return len;
+}
+
 /****************************************************************************
  * Name: parser_find_response_handler_by_name
  *
@@ -1276,12 +1464,13 @@ restart:
  * Input Parameters:
  *   parser   : Parser structure
  *   name     : Name of command
+ *   name_hash: Hash of name, from 'parser_name_hash'
  *
  ****************************************************************************/
 
 static struct at_response_handler_s *
 parser_find_response_handler_by_name(struct at_parser_s *parser,
-                                     const char *name)
+                                     const char *name, uint32_t name_hash)
 {
   uint32_t i;
 
@@ -1292,6 +1481,11 @@ parser_find_response_handler_by_name(struct at_parser_s *parser,
       if (!parser->commands[i].active)
         continue;
 
+      /* Names with different hash cannot match. */
+
+      if (parser->commands[i].name_hash != name_hash)
+        continue;
+
       DEBUGASSERT(parser->commands[i].cmd != NULL);
       DEBUGASSERT(parser->commands[i].cmd->name != NULL);
 
@@ -1406,7 +1600,8 @@ static int modem_command_timeout_callback(struct ubmodem_s *modem,
  * Name: __ubparse_buffer
  *
  * Description:
- *   Pass buffer byte-by-byte to parser state machine.
+ *   Pass buffer to parser state machine. Runs of payload bytes are handled
+ *   in bulk, rest byte-by-byte.
  *
  * Input Parameters:
  *   parser   : Parser structure
@@ -1418,9 +1613,20 @@ static int modem_command_timeout_callback(struct ubmodem_s *modem,
 void __ubparse_buffer(struct at_parser_s *parser, const void *buf, size_t buflen)
 {
   const uint8_t *pbuf = buf;
+  size_t len;
+
+  while (buflen > 0)
+    {
+      len = parse_bulk(parser, pbuf, buflen);
+      if (len == 0)
+        {
+          parse_byte(parser, *pbuf);
+          len = 1;
+        }
 
-  while (buflen--)
-    parse_byte(parser, *pbuf++);
+      pbuf += len;
+      buflen -= len;
+    }
 }
 
 /****************************************************************************
@@ -1492,7 +1698,8 @@ __ubparser_unregister_response_handler(struct at_parser_s *parser,
 
   /* Find matching command. */
 
-  handler = parser_find_response_handler_by_name(parser, name);
+  handler = parser_find_response_handler_by_name(parser, name,
+                                                 parser_name_hash(name));
   if (!handler)
     {
       ubdbg("response handler: '%s' not found!\n", name);
@@ -1593,6 +1800,7 @@ void __ubparser_register_response_handler(struct at_parser_s *parser,
     .cmd           = cmd,
     .callback      = callback,
     .callback_priv = callback_priv,
+    .name_hash     = parser_name_hash(cmd->name),
   };
 
   if (!unsolicited)
@@ -2946,6 +3154,188 @@ static void do_parser_selftest(struct at_parser_s *parser)
     }
 }
 
+#ifdef CONFIG_UBMODEM_PARSER_BENCHMARK
+
+#define PARSER_BENCH_DATALEN    1024
+#define PARSER_BENCH_ROUNDS     256
+
+static const struct at_cmd_def_s parser_bench_usord_cmd = {
+  .name = "+USORD",
+  .resp_format =
+    (const uint8_t[]){
+      RESP_FMT_INT8,
+      RESP_FMT_DATALEN,
+      RESP_FMT_QUOTED_DATABUF,
+    },
+  .resp_num = 3,
+};
+
+static const struct at_cmd_def_s parser_bench_uusord_cmd = {
+  .name = "+UUSORD",
+  .resp_format =
+    (const uint8_t[]){
+      RESP_FMT_INT8,
+      RESP_FMT_INT32,
+    },
+  .resp_num = 2,
+};
+
+struct parser_bench_priv_s {
+  const uint8_t *payload;
+  unsigned int responses;
+  unsigned int urcs;
+  bool had_error;
+};
+
+static void
+parser_bench_usord_callback(struct ubmodem_s *modem,
+                            const struct at_cmd_def_s *cmd,
+                            const struct at_resp_info_s *info,
+                            const uint8_t *resp_stream,
+                            size_t stream_len, void *priv)
+{
+  struct parser_bench_priv_s *bench = priv;
+  const char *data;
+  uint16_t datalen;
+  int8_t sockid;
+
+  bench->responses++;
+
+  /* Data length parameter is not stored to stream, only string length. */
+
+  if (info->status != RESP_STATUS_OK ||
+      !__ubmodem_stream_get_int8(&resp_stream, &stream_len, &sockid) ||
+      !__ubmodem_stream_get_string(&resp_stream, &stream_len, &data,
+                                   &datalen) ||
+      datalen != PARSER_BENCH_DATALEN ||
+      memcmp(data, bench->payload, datalen) != 0)
+    {
+      bench->had_error = true;
+    }
+}
+
+static void
+parser_bench_uusord_callback(struct ubmodem_s *modem,
+                             const struct at_cmd_def_s *cmd,
+                             const struct at_resp_info_s *info,
+                             const uint8_t *resp_stream,
+                             size_t stream_len, void *priv)
+{
+  struct parser_bench_priv_s *bench = priv;
+
+  bench->urcs++;
+
+  if (info->status != RESP_STATUS_URC || info->num_params != 2)
+    bench->had_error = true;
+}
+
+/****************************************************************************
+ * Name: __ubmodem_parser_benchmark
+ *
+ * Description:
+ *   Measure parser throughput with socket read responses carrying binary
+ *   data (including quotes and line-feeds), interleaved with URCs. Input is
+ *   passed to parser in CONFIG_UBMODEM_READ_BUFFER_SIZE sized chunks, as
+ *   with reads from modem.
+ *
+ ****************************************************************************/
+
+int __ubmodem_parser_benchmark(uint64_t *bytes_per_sec)
+{
+  static const char head[] = "+USORD: 0,1024,\"";
+  static const char tail[] = "\"\r\nOK\r\n+UUSORD: 0,512\r\n";
+  struct parser_bench_priv_s bench = {};
+  struct timespec start, end;
+  struct ubmodem_s *modem;
+  struct at_parser_s *parser;
+  uint8_t *payload;
+  uint8_t *input;
+  size_t inputlen;
+  size_t pos;
+  size_t len;
+  unsigned int i;
+  uint64_t usecs;
+  uint64_t total;
+
+  inputlen = sizeof(head) - 1 + PARSER_BENCH_DATALEN + sizeof(tail) - 1;
+  input = malloc(inputlen);
+  if (!input)
+    return ERROR;
+
+  modem = zalloc(sizeof(*modem));
+  if (!modem)
+    {
+      free(input);
+      return ERROR;
+    }
+
+  parser = &modem->parser;
+
+  payload = &input[sizeof(head) - 1];
+  memcpy(input, head, sizeof(head) - 1);
+  for (i = 0; i < PARSER_BENCH_DATALEN; i++)
+    payload[i] = (i * 7 + i / 3) & 0xff;
+  memcpy(&payload[PARSER_BENCH_DATALEN], tail, sizeof(tail) - 1);
+
+  bench.payload = payload;
+
+  __ubparser_register_response_handler(parser, &parser_bench_uusord_cmd,
+                                       parser_bench_uusord_callback, &bench,
+                                       true);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (i = 0; i < PARSER_BENCH_ROUNDS; i++)
+    {
+      __ubparser_register_response_handler(parser, &parser_bench_usord_cmd,
+                                           parser_bench_usord_callback,
+                                           &bench, false);
+
+      for (pos = 0; pos < inputlen; pos += len)
+        {
+          len = inputlen - pos;
+          if (len > CONFIG_UBMODEM_READ_BUFFER_SIZE)
+            len = CONFIG_UBMODEM_READ_BUFFER_SIZE;
+
+          __ubparse_buffer(parser, &input[pos], len);
+        }
+    }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  __ubparser_unregister_response_handler(parser,
+                                         parser_bench_uusord_cmd.name);
+
+  usecs = (uint64_t)(end.tv_sec - start.tv_sec) * 1000 * 1000;
+  usecs += end.tv_nsec / 1000;
+  usecs -= start.tv_nsec / 1000;
+  if (usecs == 0)
+    usecs = 1;
+
+  total = (uint64_t)inputlen * PARSER_BENCH_ROUNDS;
+
+  free(modem);
+  free(input);
+
+  if (bench.had_error || bench.responses != PARSER_BENCH_ROUNDS ||
+      bench.urcs != PARSER_BENCH_ROUNDS)
+    {
+      dbg("Modem parser benchmark failed! responses: %u, urcs: %u\n",
+          bench.responses, bench.urcs);
+      return ERROR;
+    }
+
+  *bytes_per_sec = total * 1000 * 1000 / usecs;
+
+  syslog(LOG_INFO, "Modem parser: %llu bytes in %llu usecs, %llu bytes/sec\n",
+         (unsigned long long)total, (unsigned long long)usecs,
+         (unsigned long long)*bytes_per_sec);
+
+  return OK;
+}
+
+#endif /* CONFIG_UBMODEM_PARSER_BENCHMARK */
+
 void __ubmodem_parser_selftest(void)
 {
   struct ubmodem_s *modem;
@@ -2964,6 +3354,14 @@ void __ubmodem_parser_selftest(void)
   do_parser_selftest(parser);
 
   free(modem);
+
+#ifdef CONFIG_UBMODEM_PARSER_BENCHMARK
+  {
+    uint64_t bytes_per_sec;
+
+    (void)__ubmodem_parser_benchmark(&bytes_per_sec);
+  }
+#endif
 }
 
 #else
@@ -210,6 +210,8 @@ struct at_response_handler_s
   const struct at_cmd_def_s *cmd;       /* Command definition */
   modem_response_callback_t callback;   /* Callback function */
   void *callback_priv;                  /* Callback private data */
+  uint32_t name_hash;                   /* Hash of command name, see
+                                           'parser_name_hash_step' */
 } packed_struct;
 
 struct modem_response_stream_s
@@ -223,6 +225,8 @@ struct at_parser_s
   enum at_parser_state_e state;         /* Main state for parser */
   char statebuf[32];                    /* Temporary state-buffer */
   uint8_t statebufpos;
+  uint32_t name_hash;                   /* Hash of response name in
+                                           'statebuf' */
 
   /* Parameter sub-state */
 
@@ -577,4 +581,22 @@ void __ubparse_buffer(struct at_parser_s *parser, const void *buf,
 
 void __ubmodem_parser_selftest(void);
 
+#ifdef CONFIG_UBMODEM_PARSER_BENCHMARK
+/****************************************************************************
+ * Name: __ubmodem_parser_benchmark
+ *
+ * Description:
+ *   Run parser throughput benchmark.
+ *
+ * Input Parameters:
+ *   bytes_per_sec : Measured throughput, set on success
+ *
+ * Returned Values:
+ *   OK if parser produced expected responses, ERROR otherwise.
+ *
+ ****************************************************************************/
+
+int __ubmodem_parser_benchmark(uint64_t *bytes_per_sec);
+#endif
+
 #endif /* __SYSTEM_UBMODEM_UBMODEM_PARSER_H_ */
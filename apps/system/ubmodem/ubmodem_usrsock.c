@@ -288,6 +288,19 @@ static void modem_socket_complete_error(struct ubmodem_s *modem,
 
         break;
 
+      case MODEM_SOCKET_STATE_RECEIVING:
+        if (!sock->is_waiting_recv)
+          {
+            /* Read-ahead failed, no request to report error for. Do not
+             * retry until modem reports data again. */
+
+            sock->recv.avail = 0;
+            __ubsocket_work_done(sock);
+            return;
+          }
+
+        break;
+
       case MODEM_SOCKET_STATE_CONNECTING:
         /* Connecting socket failed, adjust error message. */
 
@@ -383,11 +396,17 @@ static void urc_socket_read_handler(struct ubmodem_s *modem,
   /* Update sockets with new available data length. */
 
   sock->recv.avail = datalen;
+  if (sock->state == MODEM_SOCKET_STATE_RECEIVING)
+    sock->recv.avail_updated = true;
 
   /* Inform usrsock link about available data. */
 
   (void)__ubmodem_usrsock_send_event(sock, USRSOCK_EVENT_RECVFROM_AVAIL);
 
+  /* Start read-ahead if socket is idle. */
+
+  __ubsocket_update_state(sock);
+
   /* Wake-up main state machine. */
 
   __ubmodem_wake_waiting_state(modem, false);
@@ -452,9 +471,13 @@ static void urc_socket_close_handler(struct ubmodem_s *modem,
   sock->is_closed = true;
   sock->modem_sd = -1;
 
-  /* Inform usrsock link about closure. */
+  /* Inform usrsock link about closure. If there is data left in read-ahead
+   * buffers, closure is reported after data has been read. */
 
-  (void)__ubmodem_usrsock_send_event(sock, USRSOCK_EVENT_REMOTE_CLOSED);
+  if (sock->recv.buffered > 0)
+    sock->is_remote_close_pending = true;
+  else
+    (void)__ubmodem_usrsock_send_event(sock, USRSOCK_EVENT_REMOTE_CLOSED);
 
   /* Continue processing. */
 
@@ -871,6 +894,14 @@ void __ubsocket_update_state(struct modem_socket_s *sock)
       goto new_state;
     }
 
+  if (__ubmodem_recvfrom_has_readahead(sock))
+    {
+      /* Data at modem to be read ahead. */
+
+      sock->state = MODEM_SOCKET_STATE_RECEIVING;
+      goto new_state;
+    }
+
   return;
 
 new_state:
@@ -1043,6 +1074,7 @@ void __ubmodem_do_usrsock_work(struct ubmodem_s *modem)
         /* Remove item from list and free. */
 
         sq_rem(&sock->node, &modem->sockets.list);
+        __ubmodem_recvfrom_free_iobs(sock);
         free(sock);
 
         /* Update main state machine. */
@@ -1218,6 +1250,7 @@ void __ubmodem_usrsock_initialize(struct ubmodem_s *modem,
 {
   modem->sockets.ipcfg = *ipcfg;
   modem->sockets.poll_off_count = 0;
+  __ubmodem_recvfrom_initialize_iobs(modem);
 
   /* Register sockets URC handlers if not already. */
 
@@ -1299,6 +1332,7 @@ void __ubmodem_usrsock_uninitialize(struct ubmodem_s *modem)
           __ubmodem_remove_timer(modem, sock->timerid);
         }
 
+      __ubmodem_recvfrom_free_iobs(sock);
       free(sock);
 
       /* Socket freed, inform power-management of low activity decrease. */
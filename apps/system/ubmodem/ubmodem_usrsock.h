@@ -164,6 +164,7 @@ struct modem_socket_s
   bool tx_buf_full_recheck:1;       /* Rechecking if tx-buffer is full.*/
   bool is_socket_config_pending:1;  /* Pending getsock/setsock/bind operation. */
   bool is_freeing_pending:1;        /* Pending socket freeing operation. */
+  bool is_remote_close_pending:1;   /* Remote close not yet reported, read-ahead data left. */
 
   struct usrsock_request_common_s req;
 
@@ -181,6 +182,8 @@ struct modem_socket_s
     struct sockaddr_in toaddr;
     uint16_t buflen;
     int32_t num_unack_start;
+    int32_t num_unack;              /* Unacknowledged bytes at modem, local accounting. */
+    bool is_read_failed;            /* Write data not fully read from usrsock. */
   } send;
 
   /* Rx state for socket */
@@ -190,6 +193,10 @@ struct modem_socket_s
     uint16_t avail;
     uint16_t max_addrlen;
     uint16_t max_buflen;
+    uint16_t buffered;              /* Bytes in read-ahead chain. */
+    bool to_iobs:1;                 /* Current read goes to read-ahead chain. */
+    bool avail_updated:1;           /* +UUSORD received during current read. */
+    sq_queue_t iobq;                /* Read-ahead chain (struct ubmodem_recv_iob_s). */
   } recv;
 
   union
@@ -365,6 +372,16 @@ void __ubmodem_open_socket(struct modem_socket_s *sock);
 
 void __ubmodem_close_socket(struct modem_socket_s *sock);
 
+/****************************************************************************
+ * Name: __ubmodem_abort_socket
+ *
+ * Description:
+ *   Close socket at modem after unrecoverable error and report it to
+ *   usrsock link as closed by remote.
+ ****************************************************************************/
+
+void __ubmodem_abort_socket(struct modem_socket_s *sock);
+
 /****************************************************************************
  * Name: __ubmodem_connect_socket
  *
@@ -383,6 +400,34 @@ void __ubmodem_connect_socket(struct modem_socket_s *sock);
 
 void __ubmodem_recvfrom_socket(struct modem_socket_s *sock);
 
+/****************************************************************************
+ * Name: __ubmodem_recvfrom_has_readahead
+ *
+ * Description:
+ *   Check if socket has data at modem that can be read ahead to local
+ *   buffers before usrsock link requests it.
+ ****************************************************************************/
+
+bool __ubmodem_recvfrom_has_readahead(struct modem_socket_s *sock);
+
+/****************************************************************************
+ * Name: __ubmodem_recvfrom_free_iobs
+ *
+ * Description:
+ *   Release read-ahead buffer chain of socket back to modem buffer pool.
+ ****************************************************************************/
+
+void __ubmodem_recvfrom_free_iobs(struct modem_socket_s *sock);
+
+/****************************************************************************
+ * Name: __ubmodem_recvfrom_initialize_iobs
+ *
+ * Description:
+ *   Fill free list of socket read-ahead buffer pool.
+ ****************************************************************************/
+
+void __ubmodem_recvfrom_initialize_iobs(struct ubmodem_s *modem);
+
 /****************************************************************************
  * Name: __ubmodem_sendto_socket
  *
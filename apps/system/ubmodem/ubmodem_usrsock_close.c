@@ -164,6 +164,43 @@ static void close_socket_handler(struct ubmodem_s *modem,
 #endif
 }
 
+/****************************************************************************
+ * Name: abort_socket_handler
+ *
+ * Description:
+ *   Handler for result of socket close command issued after failed write.
+ ****************************************************************************/
+
+static void abort_socket_handler(struct ubmodem_s *modem,
+                                 const struct at_cmd_def_s *cmd,
+                                 const struct at_resp_info_s *info,
+                                 const uint8_t *resp_stream,
+                                 size_t stream_len, void *priv)
+{
+  struct modem_socket_s *sock = priv;
+  int ret;
+
+  MODEM_DEBUGASSERT(modem, cmd == &cmd_ATpUSOCL);
+
+  /* Socket is closed now, whatever the result. Usrsock link still holds
+   * the socket, so report closure as remote close. */
+
+  sock->is_closed = true;
+  sock->modem_sd = -1;
+
+  __ubsocket_work_done(sock);
+
+  (void)__ubmodem_usrsock_send_event(sock, USRSOCK_EVENT_REMOTE_CLOSED);
+
+  if (info->status == RESP_STATUS_TIMEOUT)
+    {
+      /* Prepare task for bringing modem alive from stuck state. */
+
+      ret = __ubmodem_recover_stuck_hardware(modem);
+      MODEM_DEBUGASSERT(modem, ret != ERROR);
+    }
+}
+
 /****************************************************************************
  * Public Internal Functions
  ****************************************************************************/
@@ -208,6 +245,32 @@ void __ubmodem_close_socket(struct modem_socket_s *sock)
   MODEM_DEBUGASSERT(modem, err == OK);
 }
 
+/****************************************************************************
+ * Name: __ubmodem_abort_socket
+ *
+ * Description:
+ *   Send close socket AT command for socket that cannot be used anymore,
+ *   and report remote close to usrsock link once done.
+ ****************************************************************************/
+
+void __ubmodem_abort_socket(struct modem_socket_s *sock)
+{
+  struct ubmodem_s *modem = sock->modem;
+  int err;
+
+  if (sock->is_closed || sock->modem_sd < 0)
+    {
+      /* Already closed (by network disconnection / +UUSOCL). */
+
+      __ubsocket_work_done(sock);
+      return;
+    }
+
+  err = __ubmodem_send_cmd(modem, &cmd_ATpUSOCL, abort_socket_handler, sock,
+                           "=%d", sock->modem_sd);
+  MODEM_DEBUGASSERT(modem, err == OK);
+}
+
 /****************************************************************************
  * Name: __ubmodem_usrsock_handle_close_request
  *
@@ -94,6 +94,214 @@ static const struct at_cmd_def_s cmd_ATpUSORF =
  * Private Functions
  ****************************************************************************/
 
+/****************************************************************************
+ * Name: send_data_response_header
+ *
+ * Description:
+ *   Send data response header and peer address to usrsock link. Caller
+ *   writes 'buflen' bytes of data after header.
+ ****************************************************************************/
+
+static void send_data_response_header(struct modem_socket_s *sock,
+                                      const struct sockaddr_in *addr,
+                                      uint16_t buflen)
+{
+  struct usrsock_message_datareq_ack_s resp = {};
+  struct ubmodem_s *modem = sock->modem;
+  size_t wlen;
+
+  resp.reqack.xid = sock->req.xid;
+  resp.reqack.head.msgid = USRSOCK_MESSAGE_RESPONSE_DATA_ACK;
+  resp.reqack.head.flags = 0;
+  resp.reqack.result = buflen;
+  resp.valuelen_nontrunc = sizeof(struct sockaddr_in);
+  resp.valuelen = resp.valuelen_nontrunc;
+  if (resp.valuelen > sock->recv.max_addrlen)
+    {
+      resp.valuelen = sock->recv.max_addrlen;
+    }
+
+  /* Give debug trace if active. */
+
+  if (modem->active_events & UBMODEM_EVENT_FLAG_TRACE_USRSOCK)
+    {
+      int tmp[4] = {
+        UBMODEM_TRACE_USRSOCK_DATARESP,
+        resp.reqack.xid,
+        resp.reqack.result,
+        resp.valuelen
+      };
+
+      __ubmodem_publish_event(modem, UBMODEM_EVENT_FLAG_TRACE_USRSOCK,
+                              tmp, sizeof(tmp));
+    }
+
+  /* Send response header. */
+
+  wlen = write(modem->sockets.usrsockfd, &resp, sizeof(resp));
+  MODEM_DEBUGASSERT(modem, wlen == sizeof(resp));
+
+  if (resp.valuelen > 0)
+    {
+      /* Send address. */
+
+      wlen = write(modem->sockets.usrsockfd, addr, resp.valuelen);
+      MODEM_DEBUGASSERT(modem, wlen == resp.valuelen);
+    }
+}
+
+/****************************************************************************
+ * Name: recvfrom_complete_error
+ *
+ * Description:
+ *   Complete current read with error. Error is reported only if usrsock
+ *   link is waiting for data, failed read-ahead is silently dropped.
+ ****************************************************************************/
+
+static void recvfrom_complete_error(struct modem_socket_s *sock, int err)
+{
+  if (sock->is_waiting_recv)
+    {
+      (void)__ubmodem_usrsock_send_response(sock->modem, &sock->req, false,
+                                            err);
+    }
+  else
+    {
+      sock->recv.avail = 0;
+    }
+
+  __ubsocket_work_done(sock);
+}
+
+#if CONFIG_UBMODEM_USRSOCK_RECV_IOBS > 0
+/****************************************************************************
+ * Name: recv_iob_space
+ *
+ * Description:
+ *   Get number of bytes that can be added to read-ahead chain of socket.
+ ****************************************************************************/
+
+static size_t recv_iob_space(struct modem_socket_s *sock)
+{
+  struct ubmodem_recv_iob_s *tail = (void *)sock->recv.iobq.tail;
+  size_t space;
+
+  space = (size_t)sock->modem->sockets.recv_iob_nfree *
+          CONFIG_UBMODEM_USRSOCK_RECV_IOB_SIZE;
+  if (tail)
+    space += CONFIG_UBMODEM_USRSOCK_RECV_IOB_SIZE - tail->len;
+
+  return space;
+}
+
+/****************************************************************************
+ * Name: recv_iob_append
+ *
+ * Description:
+ *   Append data to read-ahead chain of socket.
+ ****************************************************************************/
+
+static void recv_iob_append(struct modem_socket_s *sock, const uint8_t *buf,
+                            size_t buflen)
+{
+  struct ubmodem_s *modem = sock->modem;
+  struct ubmodem_recv_iob_s *iob = (void *)sock->recv.iobq.tail;
+  size_t chunk;
+
+  while (buflen > 0)
+    {
+      if (!iob || iob->len == CONFIG_UBMODEM_USRSOCK_RECV_IOB_SIZE)
+        {
+          /* Take new buffer from pool. Read length was limited by free
+           * space, so pool cannot run out here. */
+
+          iob = (void *)sq_remfirst(&modem->sockets.recv_iob_free);
+          MODEM_DEBUGASSERT(modem, iob != NULL);
+          if (!iob)
+            return;
+
+          modem->sockets.recv_iob_nfree--;
+          iob->len = 0;
+          iob->offset = 0;
+          sq_addlast(&iob->node, &sock->recv.iobq);
+        }
+
+      chunk = CONFIG_UBMODEM_USRSOCK_RECV_IOB_SIZE - iob->len;
+      if (chunk > buflen)
+        chunk = buflen;
+
+      memcpy(&iob->data[iob->len], buf, chunk);
+      iob->len += chunk;
+      buf += chunk;
+      buflen -= chunk;
+      sock->recv.buffered += chunk;
+    }
+}
+
+/****************************************************************************
+ * Name: recv_iob_send_data
+ *
+ * Description:
+ *   Complete pending recvfrom request with data from read-ahead chain.
+ ****************************************************************************/
+
+static void recv_iob_send_data(struct modem_socket_s *sock)
+{
+  struct ubmodem_s *modem = sock->modem;
+  struct ubmodem_recv_iob_s *iob;
+  uint16_t buflen;
+  size_t chunk;
+  size_t wlen;
+
+  buflen = sock->recv.buffered;
+  if (buflen > sock->recv.max_buflen)
+    buflen = sock->recv.max_buflen;
+
+  send_data_response_header(sock, &sock->connect.peeraddr, buflen);
+
+  /* Send data, releasing drained buffers back to pool. */
+
+  sock->recv.buffered -= buflen;
+
+  while (buflen > 0)
+    {
+      iob = (void *)sq_peek(&sock->recv.iobq);
+      MODEM_DEBUGASSERT(modem, iob != NULL);
+
+      chunk = iob->len - iob->offset;
+      if (chunk > buflen)
+        chunk = buflen;
+
+      wlen = write(modem->sockets.usrsockfd, &iob->data[iob->offset], chunk);
+      MODEM_DEBUGASSERT(modem, wlen == chunk);
+
+      iob->offset += chunk;
+      buflen -= chunk;
+
+      if (iob->offset == iob->len)
+        {
+          sq_remfirst(&sock->recv.iobq);
+          sq_addlast(&iob->node, &modem->sockets.recv_iob_free);
+          modem->sockets.recv_iob_nfree++;
+        }
+    }
+
+  /* usrsock link clears receive availability after data response, restore
+   * it if there is more to read. Delayed remote close is reported once all
+   * buffered data has been passed on. */
+
+  if (sock->recv.buffered > 0 || (sock->recv.avail > 0 && !sock->is_closed))
+    {
+      (void)__ubmodem_usrsock_send_event(sock, USRSOCK_EVENT_RECVFROM_AVAIL);
+    }
+  else if (sock->is_remote_close_pending)
+    {
+      sock->is_remote_close_pending = false;
+      (void)__ubmodem_usrsock_send_event(sock, USRSOCK_EVENT_REMOTE_CLOSED);
+    }
+}
+#endif
+
 /****************************************************************************
  * Name: socket_recvfrom_handler
  ****************************************************************************/
@@ -104,7 +312,6 @@ static void socket_recvfrom_handler(struct ubmodem_s *modem,
                                     const uint8_t *resp_stream,
                                     size_t stream_len, void *priv)
 {
-  struct usrsock_message_datareq_ack_s resp = {};
   struct modem_socket_s *sock = priv;
   uint16_t buflen;
   int8_t sockid;
@@ -123,8 +330,7 @@ static void socket_recvfrom_handler(struct ubmodem_s *modem,
     {
       /* Socket has been closed, report error. */
 
-      (void)__ubmodem_usrsock_send_response(modem, &sock->req, false, -EPIPE);
-      __ubsocket_work_done(sock);
+      recvfrom_complete_error(sock, -EPIPE);
       return;
     }
 
@@ -144,8 +350,7 @@ static void socket_recvfrom_handler(struct ubmodem_s *modem,
       /* Reading failed? This should not happen as we read only if modem
        * reported that there is data to be read. */
 
-      (void)__ubmodem_usrsock_send_response(modem, &sock->req, false, -EPIPE);
-      __ubsocket_work_done(sock);
+      recvfrom_complete_error(sock, -EPIPE);
 
       return;
     }
@@ -160,8 +365,7 @@ static void socket_recvfrom_handler(struct ubmodem_s *modem,
       dbg("Invalid %s response, %s, stream_len: %d\n", cmd->name, "no sockid",
           stream_len);
 
-      (void)__ubmodem_usrsock_send_response(modem, &sock->req, false, -EPIPE);
-      __ubsocket_work_done(sock);
+      recvfrom_complete_error(sock, -EPIPE);
 
       return;
     }
@@ -173,8 +377,7 @@ static void socket_recvfrom_handler(struct ubmodem_s *modem,
       dbg("Invalid %s response, sockid mismatch, got: %d, expect: %d\n",
           cmd->name, sockid, sock->modem_sd);
 
-      (void)__ubmodem_usrsock_send_response(modem, &sock->req, false, -EPIPE);
-      __ubsocket_work_done(sock);
+      recvfrom_complete_error(sock, -EPIPE);
       return;
     }
 
@@ -192,8 +395,7 @@ static void socket_recvfrom_handler(struct ubmodem_s *modem,
           dbg("Invalid %s response, %s, stream_len: %d\n", cmd->name, "no address",
               stream_len);
 
-          (void)__ubmodem_usrsock_send_response(modem, &sock->req, false, -EPIPE);
-          __ubsocket_work_done(sock);
+          recvfrom_complete_error(sock, -EPIPE);
 
           return;
         }
@@ -205,8 +407,7 @@ static void socket_recvfrom_handler(struct ubmodem_s *modem,
           dbg("Invalid %s response, %s, stream_len: %d\n", cmd->name, "no port",
               stream_len);
 
-          (void)__ubmodem_usrsock_send_response(modem, &sock->req, false, -EPIPE);
-          __ubsocket_work_done(sock);
+          recvfrom_complete_error(sock, -EPIPE);
 
           return;
         }
@@ -231,57 +432,57 @@ static void socket_recvfrom_handler(struct ubmodem_s *modem,
       dbg("Invalid %s response, %s, stream_len: %d\n", cmd->name, "no buflen",
           stream_len);
 
-      (void)__ubmodem_usrsock_send_response(modem, &sock->req, false, -EPIPE);
-      __ubsocket_work_done(sock);
+      recvfrom_complete_error(sock, -EPIPE);
 
       return;
     }
 
-  /* Stream now has data, feed data into usrsock link. */
+  /* Update count of data left at modem. If modem reported new length while
+   * reading, keep the reported value. */
 
-  resp.reqack.xid = sock->req.xid;
-  resp.reqack.head.msgid = USRSOCK_MESSAGE_RESPONSE_DATA_ACK;
-  resp.reqack.head.flags = 0;
-  resp.reqack.result = buflen;
-  resp.valuelen_nontrunc = sizeof(struct sockaddr_in);
-  resp.valuelen = resp.valuelen_nontrunc;
-  if (resp.valuelen > sock->recv.max_addrlen)
+  if (sock->type == SOCK_STREAM && !sock->recv.avail_updated)
     {
-      resp.valuelen = sock->recv.max_addrlen;
+      if (buflen == 0 || buflen > sock->recv.avail)
+        sock->recv.avail = 0;
+      else
+        sock->recv.avail -= buflen;
     }
 
-  /* Give debug trace if active. */
-
-  if (modem->active_events & UBMODEM_EVENT_FLAG_TRACE_USRSOCK)
+#if CONFIG_UBMODEM_USRSOCK_RECV_IOBS > 0
+  if (sock->recv.to_iobs)
     {
-      int tmp[4] = {
-        UBMODEM_TRACE_USRSOCK_DATARESP,
-        resp.reqack.xid,
-        resp.reqack.result,
-        resp.valuelen
-      };
+      /* Read-ahead, store data to socket buffer chain. */
 
-      __ubmodem_publish_event(modem, UBMODEM_EVENT_FLAG_TRACE_USRSOCK,
-                              tmp, sizeof(tmp));
-    }
+      recv_iob_append(sock, (const uint8_t *)buf, buflen);
 
-  /* Send response header. */
-
-  wlen = write(modem->sockets.usrsockfd, &resp, sizeof(resp));
-  MODEM_DEBUGASSERT(modem, wlen == sizeof(resp));
+      if (sock->is_waiting_recv)
+        {
+          if (sock->recv.buffered > 0)
+            {
+              recv_iob_send_data(sock);
+            }
+          else
+            {
+              (void)__ubmodem_usrsock_send_response(modem, &sock->req, false,
+                                                    -EAGAIN);
+            }
+        }
 
-  if (resp.valuelen > 0)
-    {
-      /* Send address. */
+      /* Done reading. */
 
-      wlen = write(modem->sockets.usrsockfd, &addr, resp.valuelen);
-      MODEM_DEBUGASSERT(modem, wlen == resp.valuelen);
+      __ubsocket_work_done(sock);
+      return;
     }
+#endif
+
+  /* Stream now has data, feed data into usrsock link. */
+
+  send_data_response_header(sock, &addr, buflen);
 
   /* Send data. */
 
-  wlen = write(modem->sockets.usrsockfd, buf, resp.reqack.result);
-  MODEM_DEBUGASSERT(modem, wlen == resp.reqack.result);
+  wlen = write(modem->sockets.usrsockfd, buf, buflen);
+  MODEM_DEBUGASSERT(modem, wlen == buflen);
 
   /* Done reading. */
 
@@ -311,15 +512,42 @@ void __ubmodem_recvfrom_socket(struct modem_socket_s *sock)
     {
       /* Socket closed! */
 
-      (void)__ubmodem_usrsock_send_response(modem, &sock->req, false, -EPIPE);
-      __ubsocket_work_done(sock);
+      recvfrom_complete_error(sock, -EPIPE);
       return;
     }
 
   inlen = sock->recv.avail;
 
-  if (inlen > sock->recv.max_buflen)
-    inlen = sock->recv.max_buflen;
+  /* Stream data is read to read-ahead chain when there is space left, so
+   * that read size is not limited by pending request. Datagrams are passed
+   * directly to avoid merging packets. */
+
+  sock->recv.to_iobs = false;
+  sock->recv.avail_updated = false;
+
+#if CONFIG_UBMODEM_USRSOCK_RECV_IOBS > 0
+  if (sock->type == SOCK_STREAM && recv_iob_space(sock) > 0)
+    {
+      sock->recv.to_iobs = true;
+
+      if (inlen > recv_iob_space(sock))
+        inlen = recv_iob_space(sock);
+    }
+#endif
+
+  if (!sock->recv.to_iobs)
+    {
+      if (!sock->is_waiting_recv)
+        {
+          /* Out of read-ahead buffers, wait for request from usrsock. */
+
+          __ubsocket_work_done(sock);
+          return;
+        }
+
+      if (inlen > sock->recv.max_buflen)
+        inlen = sock->recv.max_buflen;
+    }
 
   if (sock->type == SOCK_DGRAM)
     {
@@ -359,6 +587,72 @@ void __ubmodem_recvfrom_socket(struct modem_socket_s *sock)
     }
 }
 
+/****************************************************************************
+ * Name: __ubmodem_recvfrom_has_readahead
+ *
+ * Description:
+ *   Check if socket has data at modem that can be read ahead to local
+ *   buffers before usrsock link requests it.
+ ****************************************************************************/
+
+bool __ubmodem_recvfrom_has_readahead(struct modem_socket_s *sock)
+{
+#if CONFIG_UBMODEM_USRSOCK_RECV_IOBS > 0
+  return sock->type == SOCK_STREAM && !sock->is_closed &&
+         sock->modem_sd >= 0 && sock->recv.avail > 0 &&
+         recv_iob_space(sock) > 0;
+#else
+  return false;
+#endif
+}
+
+/****************************************************************************
+ * Name: __ubmodem_recvfrom_free_iobs
+ *
+ * Description:
+ *   Release read-ahead buffer chain of socket back to modem buffer pool.
+ ****************************************************************************/
+
+void __ubmodem_recvfrom_free_iobs(struct modem_socket_s *sock)
+{
+#if CONFIG_UBMODEM_USRSOCK_RECV_IOBS > 0
+  struct ubmodem_s *modem = sock->modem;
+  sq_entry_t *iob;
+
+  while ((iob = sq_remfirst(&sock->recv.iobq)) != NULL)
+    {
+      sq_addlast(iob, &modem->sockets.recv_iob_free);
+      modem->sockets.recv_iob_nfree++;
+    }
+
+  sock->recv.buffered = 0;
+#endif
+}
+
+/****************************************************************************
+ * Name: __ubmodem_recvfrom_initialize_iobs
+ *
+ * Description:
+ *   Fill free list of socket read-ahead buffer pool.
+ ****************************************************************************/
+
+void __ubmodem_recvfrom_initialize_iobs(struct ubmodem_s *modem)
+{
+#if CONFIG_UBMODEM_USRSOCK_RECV_IOBS > 0
+  int i;
+
+  sq_init(&modem->sockets.recv_iob_free);
+
+  for (i = 0; i < CONFIG_UBMODEM_USRSOCK_RECV_IOBS; i++)
+    {
+      sq_addlast(&modem->sockets.recv_iobs[i].node,
+                 &modem->sockets.recv_iob_free);
+    }
+
+  modem->sockets.recv_iob_nfree = CONFIG_UBMODEM_USRSOCK_RECV_IOBS;
+#endif
+}
+
 /****************************************************************************
  * Name: __ubmodem_usrsock_handle_recvfrom_request
  *
@@ -386,6 +680,29 @@ int __ubmodem_usrsock_handle_recvfrom_request(struct ubmodem_s *modem,
 
   MODEM_DEBUGASSERT(modem, sock->type == SOCK_DGRAM || sock->type == SOCK_STREAM);
 
+#if CONFIG_UBMODEM_USRSOCK_RECV_IOBS > 0
+  if (sock->recv.buffered > 0 && !sock->is_waiting_recv)
+    {
+      /* Data already read ahead, complete request from local buffers. */
+
+      sock->req = req->head;
+      sock->recv.max_addrlen = req->max_addrlen;
+      sock->recv.max_buflen = req->max_buflen;
+
+      err = __ubmodem_usrsock_send_response(modem, reqbuf, true, -EINPROGRESS);
+      if (err < 0)
+        return err;
+
+      recv_iob_send_data(sock);
+
+      /* Buffers released, continue read-ahead. */
+
+      __ubsocket_update_state(sock);
+      __ubmodem_wake_waiting_state(modem, false);
+      return OK;
+    }
+#endif
+
   /* Check if sockets is closed. */
 
   if (sock->is_closed || sock->modem_sd < 0)
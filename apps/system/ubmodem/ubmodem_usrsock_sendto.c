@@ -129,6 +129,22 @@ static void modem_setup_sendto_buffer_full_timer(struct modem_socket_s *sock);
  * Private Functions
  ****************************************************************************/
 
+/****************************************************************************
+ * Name: sendto_window_space
+ *
+ * Description:
+ *   Get free space in modem TX window based on local accounting of
+ *   unacknowledged bytes.
+ ****************************************************************************/
+
+static int32_t sendto_window_space(struct modem_socket_s *sock)
+{
+  if (CONFIG_UBMODEM_USRSOCK_TX_WINDOW <= 0)
+    return 0;
+
+  return CONFIG_UBMODEM_USRSOCK_TX_WINDOW - sock->send.num_unack;
+}
+
 /****************************************************************************
  * Name: socket_write_handler
  ****************************************************************************/
@@ -232,6 +248,23 @@ static void socket_write_handler(struct ubmodem_s *modem,
       return;
     }
 
+  if (sock->send.is_read_failed)
+    {
+      /* Data for write was not fully read from usrsock link and modem was
+       * given padding instead. Peer got bytes that application never sent,
+       * so connection cannot be used anymore. Close socket at modem. */
+
+      (void)__ubmodem_usrsock_send_response(modem, &sock->req, false, -EPIPE);
+      __ubmodem_abort_socket(sock);
+
+      return;
+    }
+
+  /* Account written data as unacknowledged until next check from modem. */
+
+  if (sock->type == SOCK_STREAM)
+    sock->send.num_unack += buflen;
+
   /* Report work as done. */
 
   (void)__ubmodem_usrsock_send_response(modem, &sock->req, false,
@@ -246,38 +279,6 @@ static void socket_write_handler(struct ubmodem_s *modem,
   (void)__ubmodem_usrsock_send_event(sock, USRSOCK_EVENT_SENDTO_READY);
 }
 
-/****************************************************************************
- * Name: get_sendto_tmpbuf
- ****************************************************************************/
-
-static void *get_sendto_tmpbuf(struct modem_socket_s *sock, size_t *length)
-{
-  struct ubmodem_s *modem = sock->modem;
-
-  /* Reuse response stream buffer for reading data buffer from usrsock link.
-   *
-   * This is safe because stream buffer cannot be in use at this stage; Last
-   * character received from modem was '@' and serial line is now in
-   * data prompt mode. Modem will not send any URC events in data prompt mode.
-   */
-
-  *length = sizeof(modem->parser.stream.buf);
-  return modem->parser.stream.buf;
-}
-
-/****************************************************************************
- * Name: get_sendto_tmpbuf_length
- ****************************************************************************/
-
-static size_t get_sendto_tmpbuf_length(struct modem_socket_s *sock)
-{
-  size_t length;
-
-  (void)get_sendto_tmpbuf(sock, &length);
-
-  return length;
-}
-
 /****************************************************************************
  * Name: data_prompt_delay_handler
  ****************************************************************************/
@@ -286,10 +287,8 @@ static int data_prompt_delay_handler(struct ubmodem_s *modem,
                                      int timer_id, void * const arg)
 {
   struct modem_socket_s *sock = arg;
-  int err;
+  const struct at_cmd_def_s *cmd;
   ssize_t rlen;
-  size_t tmpbuflen;
-  uint8_t *tmpbuf;
 
   ubmodem_pm_set_activity(modem, UBMODEM_PM_ACTIVITY_HIGH, false);
 
@@ -299,51 +298,30 @@ static int data_prompt_delay_handler(struct ubmodem_s *modem,
    * Data prompt is active and we have waited for 50 msec.
    */
 
-  tmpbuf = get_sendto_tmpbuf(sock, &tmpbuflen);
-  MODEM_DEBUGASSERT(modem, tmpbuf != NULL);
-  MODEM_DEBUGASSERT(modem, modem->parser.stream.pos == 0);
-  MODEM_DEBUGASSERT(modem, tmpbuflen >= sock->send.buflen);
+  cmd = (sock->type == SOCK_DGRAM) ? &cmd_ATpUSOST_data : &cmd_ATpUSOWR_data;
 
-  /* Read data buffer from usrsock link. */
+  /* Pass data buffer from usrsock link directly to modem. */
 
-  rlen = read(modem->sockets.usrsockfd, tmpbuf, sock->send.buflen);
-  if (rlen < 0)
-    {
-      dbg("Error reading %d bytes of request: ret=%d, errno=%d\n",
-          sock->send.buflen, (int)rlen, errno);
+  rlen = __ubmodem_send_raw_from_fd(modem, cmd, socket_write_handler, sock,
+                                    modem->sockets.usrsockfd,
+                                    sock->send.buflen);
+  MODEM_DEBUGASSERT(modem, rlen != ERROR);
 
-      (void)__ubmodem_usrsock_send_response(modem, &sock->req, false, -EPIPE);
-      __ubsocket_work_done(sock);
-      return OK;
-    }
-  else if (rlen != sock->send.buflen)
+  if (rlen != sock->send.buflen)
     {
-      dbg("Error got partial read %d (expected %d)\n", (int)rlen, sock->send.buflen);
+      dbg("Error got partial read %d (expected %d)\n", (int)rlen,
+          sock->send.buflen);
 
-      (void)__ubmodem_usrsock_send_response(modem, &sock->req, false, -EPIPE);
-      __ubsocket_work_done(sock);
-      return OK;
+      /* Modem got padded data, close socket once write completes. */
+
+      sock->send.is_read_failed = true;
     }
 
   /* Data has been read, inform usrsock link that request is being processed.
    */
 
   (void)__ubmodem_usrsock_send_response(modem, &sock->req, true, -EINPROGRESS);
-
-  if (sock->type == SOCK_DGRAM)
-    {
-      err = __ubmodem_send_raw(modem, &cmd_ATpUSOST_data, socket_write_handler,
-                               sock, tmpbuf, sock->send.buflen);
-      MODEM_DEBUGASSERT(modem, err == OK);
-      return OK;
-    }
-  else
-    {
-      err = __ubmodem_send_raw(modem, &cmd_ATpUSOWR_data, socket_write_handler,
-                               sock, tmpbuf, sock->send.buflen);
-      MODEM_DEBUGASSERT(modem, err == OK);
-      return OK;
-    }
+  return OK;
 }
 
 /****************************************************************************
@@ -442,40 +420,27 @@ static void modem_setup_sendto_buffer_full_timer(struct modem_socket_s *sock)
 }
 
 /****************************************************************************
- * Name: socket_write_handler
+ * Name: parse_tcp_unack_bytes
+ *
+ * Description:
+ *   Parse +USOCTL=<sock>,11 response, number of unacknowledged bytes.
  ****************************************************************************/
 
-static void get_tcp_unack_bytes_handler(struct ubmodem_s *modem,
-                                        const struct at_cmd_def_s *cmd,
-                                        const struct at_resp_info_s *info,
-                                        const uint8_t *resp_stream,
-                                        size_t stream_len, void *priv)
+static bool parse_tcp_unack_bytes(struct modem_socket_s *sock,
+                                  const struct at_cmd_def_s *cmd,
+                                  const struct at_resp_info_s *info,
+                                  const uint8_t *resp_stream,
+                                  size_t stream_len, int32_t *nbytes_unacked)
 {
-  struct modem_socket_s *sock = priv;
   int8_t sockid;
   int8_t ctlreqid;
-  int32_t nbytes_unacked;
-
-  /*
-   * Response handler for +USOCTL=<sock>,11
-   */
-
-  MODEM_DEBUGASSERT(modem, cmd == &cmd_ATpUSOCTL_get_tcp_unack_bytes);
-
-  if (sock->is_closed || sock->modem_sd < 0)
-    {
-      /* Socket has been closed, do not continue polling send buffer. */
-
-      __ubsocket_work_done(sock);
-      return;
-    }
 
   if (resp_status_is_error_or_timeout(info->status) ||
       info->status != RESP_STATUS_OK)
     {
       dbg("%s error, status: %d\n", cmd->name, info->status);
 
-      goto err_sendto_ready;
+      return false;
     }
 
   /* Read the sockets number. */
@@ -485,7 +450,7 @@ static void get_tcp_unack_bytes_handler(struct ubmodem_s *modem,
       dbg("Invalid %s response, %s, stream_len: %d\n", cmd->name, "no sockid",
           stream_len);
 
-      goto err_sendto_ready;
+      return false;
     }
 
   if (sockid != sock->modem_sd)
@@ -493,7 +458,7 @@ static void get_tcp_unack_bytes_handler(struct ubmodem_s *modem,
       dbg("Invalid %s response, sockid mismatch, got: %d, expect: %d\n",
           cmd->name, sockid, sock->modem_sd);
 
-      goto err_sendto_ready;
+      return false;
     }
 
   /* Read the sockets control request identifier (should be 11). */
@@ -503,7 +468,7 @@ static void get_tcp_unack_bytes_handler(struct ubmodem_s *modem,
       dbg("Invalid %s response, %s, stream_len: %d\n", cmd->name, "no ctlreqid",
           stream_len);
 
-      goto err_sendto_ready;
+      return false;
     }
 
   if (ctlreqid != 11)
@@ -511,16 +476,56 @@ static void get_tcp_unack_bytes_handler(struct ubmodem_s *modem,
       dbg("Invalid %s response, ctlreqid mismatch, got: %d, expect: %d\n",
           cmd->name, ctlreqid, 11);
 
-      goto err_sendto_ready;
+      return false;
     }
 
   /* Read the number of unacknowledged bytes buffered. */
 
-  if (!__ubmodem_stream_get_int32(&resp_stream, &stream_len, &nbytes_unacked))
+  if (!__ubmodem_stream_get_int32(&resp_stream, &stream_len, nbytes_unacked))
     {
       dbg("Invalid %s response, %s, stream_len: %d\n", cmd->name, "no nbytes_unacked",
           stream_len);
 
+      return false;
+    }
+
+  /* Resynchronize local unacknowledged bytes accounting. */
+
+  sock->send.num_unack = *nbytes_unacked;
+
+  return true;
+}
+
+/****************************************************************************
+ * Name: get_tcp_unack_bytes_handler
+ ****************************************************************************/
+
+static void get_tcp_unack_bytes_handler(struct ubmodem_s *modem,
+                                        const struct at_cmd_def_s *cmd,
+                                        const struct at_resp_info_s *info,
+                                        const uint8_t *resp_stream,
+                                        size_t stream_len, void *priv)
+{
+  struct modem_socket_s *sock = priv;
+  int32_t nbytes_unacked;
+
+  /*
+   * Response handler for +USOCTL=<sock>,11
+   */
+
+  MODEM_DEBUGASSERT(modem, cmd == &cmd_ATpUSOCTL_get_tcp_unack_bytes);
+
+  if (sock->is_closed || sock->modem_sd < 0)
+    {
+      /* Socket has been closed, do not continue polling send buffer. */
+
+      __ubsocket_work_done(sock);
+      return;
+    }
+
+  if (!parse_tcp_unack_bytes(sock, cmd, info, resp_stream, stream_len,
+                             &nbytes_unacked))
+    {
       goto err_sendto_ready;
     }
 
@@ -533,6 +538,7 @@ static void get_tcp_unack_bytes_handler(struct ubmodem_s *modem,
     }
 
   if (nbytes_unacked == 0 || sock->send.num_unack_start - nbytes_unacked >=
+      MODEM_MAX_BINARY_SOCKET_WRITE_BYTES || sendto_window_space(sock) >=
       MODEM_MAX_BINARY_SOCKET_WRITE_BYTES)
     {
       /* We now have enough space for maximum sized write buffer at the modem
@@ -571,6 +577,97 @@ err_sendto_ready:
   __ubsocket_work_done(sock);
 }
 
+/****************************************************************************
+ * Name: sendto_open_data_prompt
+ ****************************************************************************/
+
+static void sendto_open_data_prompt(struct modem_socket_s *sock)
+{
+  struct ubmodem_s *modem = sock->modem;
+  int err;
+
+  sock->send.is_read_failed = false;
+
+  if (sock->type == SOCK_DGRAM)
+    {
+      const uint8_t *ip = (const uint8_t *)&sock->send.toaddr.sin_addr;
+
+      /* Open data prompt for outputting UDP binary data. */
+
+      err = __ubmodem_send_cmd(modem, &cmd_ATpUSOST_binary, data_prompt_handler,
+                               sock, "=%d,\"%d.%d.%d.%d\",%d,%d",
+                               sock->modem_sd, ip[0], ip[1], ip[2], ip[3],
+                               ntohs(sock->send.toaddr.sin_port),
+                               sock->send.buflen);
+      MODEM_DEBUGASSERT(modem, err == OK);
+    }
+  else
+    {
+      /* Open data prompt for outputting TCP binary data. */
+
+      err = __ubmodem_send_cmd(modem, &cmd_ATpUSOWR_binary, data_prompt_handler,
+                               sock, "=%d,%d", sock->modem_sd,
+                               sock->send.buflen);
+      MODEM_DEBUGASSERT(modem, err == OK);
+    }
+}
+
+/****************************************************************************
+ * Name: sendto_window_unack_bytes_handler
+ ****************************************************************************/
+
+static void sendto_window_unack_bytes_handler(struct ubmodem_s *modem,
+                                              const struct at_cmd_def_s *cmd,
+                                              const struct at_resp_info_s *info,
+                                              const uint8_t *resp_stream,
+                                              size_t stream_len, void *priv)
+{
+  struct modem_socket_s *sock = priv;
+  int32_t nbytes_unacked;
+  int32_t space;
+
+  /*
+   * Response handler for +USOCTL=<sock>,11 when local accounting reached
+   * end of TX window.
+   */
+
+  MODEM_DEBUGASSERT(modem, cmd == &cmd_ATpUSOCTL_get_tcp_unack_bytes);
+
+  if (sock->is_closed || sock->modem_sd < 0)
+    {
+      /* Socket has been closed, report error. */
+
+      (void)__ubmodem_usrsock_send_response(modem, &sock->req, false, -EPIPE);
+      __ubsocket_work_done(sock);
+      return;
+    }
+
+  if (!parse_tcp_unack_bytes(sock, cmd, info, resp_stream, stream_len,
+                             &nbytes_unacked))
+    {
+      /* Could not check, attempt write and let modem decide. */
+
+      sock->send.num_unack = 0;
+    }
+
+  space = sendto_window_space(sock);
+  if (space < UBMODEM_USRSOCK_TX_WINDOW_MIN_WRITE &&
+      space < sock->send.buflen)
+    {
+      /* TX window is full. Start polling modem for space. */
+
+      __ubmodem_handle_sendto_buffer_full(sock);
+      (void)__ubmodem_usrsock_send_response(modem, &sock->req, false, -EAGAIN);
+      __ubsocket_work_done(sock);
+      return;
+    }
+
+  if (sock->send.buflen > space)
+    sock->send.buflen = space;
+
+  sendto_open_data_prompt(sock);
+}
+
 /****************************************************************************
  * Public Internal Functions
  ****************************************************************************/
@@ -628,7 +725,7 @@ void __ubmodem_handle_sendto_buffer_full(struct modem_socket_s *sock)
 void __ubmodem_sendto_socket(struct modem_socket_s *sock)
 {
   struct ubmodem_s *modem = sock->modem;
-  size_t tmpbuflen;
+  int32_t space;
   int err;
 
   if (sock->is_closed)
@@ -641,40 +738,34 @@ void __ubmodem_sendto_socket(struct modem_socket_s *sock)
       return;
     }
 
-  /* Adjust buffer size to temporary buffer max-length. */
-
-  tmpbuflen = get_sendto_tmpbuf_length(sock);
-  if (sock->send.buflen > tmpbuflen)
-    sock->send.buflen = tmpbuflen;
-
   /* Sendto commands have hard-limit for how long buffers allowed
    * per one command. */
 
   if (sock->send.buflen > MODEM_MAX_BINARY_SOCKET_WRITE_BYTES)
     sock->send.buflen = MODEM_MAX_BINARY_SOCKET_WRITE_BYTES;
 
-  if (sock->type == SOCK_DGRAM)
+  if (sock->type == SOCK_STREAM && CONFIG_UBMODEM_USRSOCK_TX_WINDOW > 0)
     {
-      const uint8_t *ip = (const uint8_t *)&sock->send.toaddr.sin_addr;
+      /* Keep writing while local accounting of unacknowledged bytes shows
+       * room in modem TX window. Once window is full, check actual state
+       * from modem before writing more. */
 
-      /* Open data prompt for outputting UDP binary data. */
+      space = sendto_window_space(sock);
+      if (space < UBMODEM_USRSOCK_TX_WINDOW_MIN_WRITE &&
+          space < sock->send.buflen)
+        {
+          err = __ubmodem_send_cmd(modem, &cmd_ATpUSOCTL_get_tcp_unack_bytes,
+                                   sendto_window_unack_bytes_handler,
+                                   sock, "=%d,11", sock->modem_sd);
+          MODEM_DEBUGASSERT(modem, err == OK);
+          return;
+        }
 
-      err = __ubmodem_send_cmd(modem, &cmd_ATpUSOST_binary, data_prompt_handler,
-                               sock, "=%d,\"%d.%d.%d.%d\",%d,%d",
-                               sock->modem_sd, ip[0], ip[1], ip[2], ip[3],
-                               ntohs(sock->send.toaddr.sin_port),
-                               sock->send.buflen);
-      MODEM_DEBUGASSERT(modem, err == OK);
+      if (sock->send.buflen > space)
+        sock->send.buflen = space;
     }
-  else
-    {
-      /* Open data prompt for outputting TCP binary data. */
 
-      err = __ubmodem_send_cmd(modem, &cmd_ATpUSOWR_binary, data_prompt_handler,
-                               sock, "=%d,%d", sock->modem_sd,
-                               sock->send.buflen);
-      MODEM_DEBUGASSERT(modem, err == OK);
-    }
+  sendto_open_data_prompt(sock);
 }
 
 /****************************************************************************
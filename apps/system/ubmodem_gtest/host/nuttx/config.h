@@ -0,0 +1,75 @@
+/****************************************************************************
+ * apps/system/ubmodem_gtest/host/nuttx/config.h
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+/* Stand-in for the generated NuttX configuration when compiling the modem
+ * library for the host emulator tests. Pulls in the host headers that
+ * NuttX headers provide transitively.
+ */
+
+#ifndef __APPS_SYSTEM_UBMODEM_GTEST_HOST_NUTTX_CONFIG_H
+#define __APPS_SYSTEM_UBMODEM_GTEST_HOST_NUTTX_CONFIG_H
+
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE 1 /* vasprintf */
+#endif
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <syslog.h>
+#include <time.h>
+#include <queue.h>
+
+#define CONFIG_SYSTEM_UBMODEM 1
+#define CONFIG_UBMODEM_USRSOCK 1
+#define CONFIG_UBMODEM_FTP_ENABLED 1
+#define CONFIG_UBMODEM_PARSER_BENCHMARK 1
+#define CONFIG_NET_USRSOCK 1
+#define CONFIG_CLOCK_MONOTONIC 1
+#define CONFIG_UBMODEM_DEBUG_VERBOSE 1 /* Output enabled at run-time */
+
+#ifndef DEBUGASSERT
+#  define DEBUGASSERT(f) assert(f)
+#endif
+
+#define get_errno() errno
+
+typedef void *(*pthread_startroutine_t)(void *);
+
+void *zalloc(size_t size);
+
+#endif
@@ -0,0 +1,107 @@
+/****************************************************************************
+ * apps/system/ubmodem_gtest/host_glue.c
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <sys/types.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "host_glue.h"
+
+/****************************************************************************
+ * Public Data
+ ****************************************************************************/
+
+int ubmodem_host_verbose;
+int ubmodem_host_usrsock_fd = -1;
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+void *zalloc(size_t size)
+{
+  return calloc(1, size);
+}
+
+bool netlib_ipaddrconv(const char *addrstr, uint8_t *ipaddr)
+{
+  return inet_pton(AF_INET, addrstr, ipaddr) == 1;
+}
+
+/****************************************************************************
+ * Name: __wrap_open
+ *
+ * Description:
+ *   Linker wrapper for open(). Opening "/dev/usrsock" returns duplicate of
+ *   modem library end of usrsock socket pair; all other paths go to libc.
+ *
+ ****************************************************************************/
+
+int __real_open(const char *path, int flags, ...);
+
+int __wrap_open(const char *path, int flags, ...)
+{
+  mode_t mode = 0;
+  va_list ap;
+
+  if (strcmp(path, "/dev/usrsock") == 0)
+    {
+      if (ubmodem_host_usrsock_fd < 0)
+        {
+          errno = ENODEV;
+          return -1;
+        }
+
+      return dup(ubmodem_host_usrsock_fd);
+    }
+
+  if (flags & O_CREAT)
+    {
+      va_start(ap, flags);
+      mode = va_arg(ap, int);
+      va_end(ap);
+    }
+
+  return __real_open(path, flags, mode);
+}
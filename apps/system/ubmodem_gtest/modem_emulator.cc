@@ -0,0 +1,1250 @@
+/****************************************************************************
+ * apps/system/ubmodem_gtest/modem_emulator.cc
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "modem_emulator.h"
+
+/* Modem identification returned for ATI0 and AT+CGMR. */
+
+static const char kOrderCode[] = "SARA-U270-00S";
+static const char kFirmware[] = "23.41";
+
+/* Addresses reported for PDP context. */
+
+static const char kLocalAddr[] = "10.10.0.2";
+static const char kDns1Addr[] = "10.10.0.1";
+static const char kDns2Addr[] = "8.8.8.8";
+
+/* Largest read chunk for +USORD/+USORF, as on SARA-U2. */
+
+static const size_t kMaxReadLen = 1024;
+
+/* Commands that are accepted with plain OK response. */
+
+static const char *const kAcceptedCommands[] =
+{
+  "E0", "&K3\\Q3", "+UMWI", "+UHSDUPA", "+UFDAC", "+UPSV", "+UPSD",
+  "+ULOC", "+ULOCCELL", "+ULOCAID", "+UGPIOC", "+UGPIOW", "+CLIP", "+CRC",
+  "+USOSO", "+UFTP", "+CMGF", "+CGSMS", "+CSCA", "+UDOPN",
+};
+
+static std::vector<std::string> split_args(const std::string &args)
+{
+  std::vector<std::string> out;
+  std::string cur;
+  bool quoted = false;
+  size_t pos = 0;
+
+  if (!args.empty() && args[0] == '=')
+    pos = 1;
+
+  for (; pos < args.size(); pos++)
+    {
+      char c = args[pos];
+
+      if (c == '"')
+        quoted = !quoted;
+      else if (c == ',' && !quoted)
+        {
+          out.push_back(cur);
+          cur.clear();
+        }
+      else
+        cur += c;
+    }
+
+  if (pos > 0 || !cur.empty())
+    out.push_back(cur);
+
+  return out;
+}
+
+static int arg_int(const std::vector<std::string> &args, size_t idx,
+                   int defval = -1)
+{
+  if (idx >= args.size() || args[idx].empty())
+    return defval;
+  return atoi(args[idx].c_str());
+}
+
+static std::string strip_slashes(const std::string &path)
+{
+  size_t start = path.find_first_not_of('/');
+  size_t end = path.find_last_not_of('/');
+
+  if (start == std::string::npos)
+    return "";
+  return path.substr(start, end - start + 1);
+}
+
+ModemEmulator::ModemEmulator()
+  : running_(false),
+    master_fd_(-1),
+    powered_(false),
+    powering_off_(false),
+    echo_(true),
+    cmee_(0),
+    cfun_(1),
+    creg_urc_(0),
+    creg_stat_(0),
+    cgatt_(false),
+    pdp_active_(false),
+    echo_server_(false),
+    baudrate_(0),
+    latency_msecs_(5),
+    registration_msecs_(300),
+    ftp_rate_(0),
+    data_len_(0),
+    data_sd_(-1),
+    data_udp_(false),
+    in_data_mode_(false),
+    replay_(false),
+    replay_pos_(0),
+    bytes_to_modem_(0),
+    bytes_from_modem_(0)
+{
+  wake_fd_[0] = -1;
+  wake_fd_[1] = -1;
+
+  for (int i = 0; i < NUM_SOCKETS; i++)
+    sockets_[i] = Socket();
+
+  trace_prev_ = Clock::now();
+  line_free_ = trace_prev_;
+}
+
+ModemEmulator::~ModemEmulator()
+{
+  Stop();
+}
+
+int ModemEmulator::Start()
+{
+  struct termios tio;
+  int slave_fd;
+
+  master_fd_ = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master_fd_ < 0)
+    return -1;
+
+  if (grantpt(master_fd_) < 0 || unlockpt(master_fd_) < 0)
+    goto err_close;
+
+  slave_fd = open(ptsname(master_fd_), O_RDWR | O_NOCTTY);
+  if (slave_fd < 0)
+    goto err_close;
+
+  /* Modem library expects raw 8-bit serial line. */
+
+  tcgetattr(slave_fd, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(slave_fd, TCSANOW, &tio);
+
+  fcntl(master_fd_, F_SETFL, fcntl(master_fd_, F_GETFL) | O_NONBLOCK);
+
+  if (pipe(wake_fd_) < 0)
+    {
+      close(slave_fd);
+      goto err_close;
+    }
+
+  trace_prev_ = Clock::now();
+  replay_prev_ = trace_prev_;
+  running_ = true;
+  thread_ = std::thread(&ModemEmulator::Run, this);
+
+  return slave_fd;
+
+err_close:
+  close(master_fd_);
+  master_fd_ = -1;
+  return -1;
+}
+
+void ModemEmulator::Stop()
+{
+  if (!running_)
+    return;
+
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    running_ = false;
+  }
+
+  Wake();
+  thread_.join();
+
+  close(wake_fd_[0]);
+  close(wake_fd_[1]);
+  close(master_fd_);
+  wake_fd_[0] = wake_fd_[1] = master_fd_ = -1;
+}
+
+void ModemEmulator::Wake()
+{
+  char c = 0;
+
+  if (wake_fd_[1] >= 0)
+    (void)!write(wake_fd_[1], &c, 1);
+}
+
+void ModemEmulator::SetPower(bool on)
+{
+  std::lock_guard<std::mutex> guard(lock_);
+
+  if (powered_ == on)
+    return;
+
+  powered_ = on;
+  powering_off_ = false;
+
+  /* Power cycle resets modem state and drops pending output. */
+
+  echo_ = true;
+  cmee_ = 0;
+  cfun_ = 1;
+  creg_urc_ = 0;
+  creg_stat_ = 0;
+  cgatt_ = false;
+  pdp_active_ = false;
+  line_.clear();
+  in_data_mode_ = false;
+  output_.clear();
+  wire_.clear();
+  for (int i = 0; i < NUM_SOCKETS; i++)
+    sockets_[i] = Socket();
+}
+
+bool ModemEmulator::IsPowered()
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  return powered_;
+}
+
+void ModemEmulator::SetBaudrate(unsigned int bps)
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  baudrate_ = bps;
+}
+
+void ModemEmulator::SetResponseLatency(unsigned int msecs)
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  latency_msecs_ = msecs;
+}
+
+void ModemEmulator::SetRegistrationDelay(unsigned int msecs)
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  registration_msecs_ = msecs;
+}
+
+void ModemEmulator::SetFtpRate(unsigned int bytes_per_sec)
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  ftp_rate_ = bytes_per_sec;
+}
+
+void ModemEmulator::SetEchoServer(bool echo)
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  echo_server_ = echo;
+}
+
+void ModemEmulator::AddFtpFile(const std::string &path,
+                               const std::string &content)
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  ftp_files_[strip_slashes(path)] = content;
+}
+
+bool ModemEmulator::GetModemFile(const std::string &name,
+                                 std::string *content)
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  auto it = modem_files_.find(name);
+
+  if (it == modem_files_.end())
+    return false;
+  if (content)
+    *content = it->second;
+  return true;
+}
+
+void ModemEmulator::RemoteSend(int sd, const std::string &data)
+{
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    DoRemoteSend(sd, data);
+  }
+  Wake();
+}
+
+void ModemEmulator::RemoteClose(int sd)
+{
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    Socket *sock = GetSocket(sd);
+
+    if (!sock || !sock->connected)
+      return;
+
+    sock->connected = false;
+    Urc("+UUSOCL: " + std::to_string(sd));
+  }
+  Wake();
+}
+
+std::string ModemEmulator::RemoteReceived(int sd)
+{
+  std::lock_guard<std::mutex> guard(lock_);
+
+  if (sd < 0 || sd >= NUM_SOCKETS)
+    return "";
+  return sockets_[sd].received;
+}
+
+size_t ModemEmulator::RemoteReceivedLen(int sd)
+{
+  std::lock_guard<std::mutex> guard(lock_);
+
+  if (sd < 0 || sd >= NUM_SOCKETS)
+    return 0;
+  return sockets_[sd].received.size();
+}
+
+std::vector<std::string> ModemEmulator::Commands()
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  return commands_;
+}
+
+unsigned int ModemEmulator::CommandCount(const std::string &name)
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  unsigned int count = 0;
+
+  for (const std::string &cmd : commands_)
+    {
+      if (cmd.compare(0, name.size(), name) == 0)
+        count++;
+    }
+
+  return count;
+}
+
+std::string ModemEmulator::Trace()
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  return trace_;
+}
+
+bool ModemEmulator::SaveTrace(const std::string &path)
+{
+  std::ofstream file(path.c_str());
+
+  file << Trace();
+  return file.good();
+}
+
+bool ModemEmulator::LoadTrace(const std::string &trace)
+{
+  std::istringstream in(trace);
+  std::vector<TraceEntry> entries;
+  std::string line;
+
+  while (std::getline(in, line))
+    {
+      TraceEntry entry;
+      size_t sp;
+
+      if (line.empty() || line[0] == '#')
+        continue;
+
+      if (line.size() < 4 || (line[0] != '>' && line[0] != '<') ||
+          line[1] != ' ')
+        return false;
+
+      sp = line.find(' ', 2);
+      if (sp == std::string::npos)
+        return false;
+
+      entry.to_modem = (line[0] == '>');
+      entry.msecs = strtoul(line.c_str() + 2, NULL, 10);
+      if (!Unescape(line.substr(sp + 1), &entry.data) || entry.data.empty())
+        return false;
+
+      entries.push_back(entry);
+    }
+
+  std::lock_guard<std::mutex> guard(lock_);
+
+  replay_ = true;
+  replay_entries_ = entries;
+  replay_pos_ = 0;
+  replay_input_.clear();
+  replay_prev_ = Clock::now();
+  return true;
+}
+
+bool ModemEmulator::LoadTraceFile(const std::string &path)
+{
+  std::ifstream file(path.c_str());
+  std::stringstream content;
+
+  if (!file.good())
+    return false;
+
+  content << file.rdbuf();
+  return LoadTrace(content.str());
+}
+
+bool ModemEmulator::ReplayDone()
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  return replay_ && replay_pos_ == replay_entries_.size();
+}
+
+std::vector<std::string> ModemEmulator::Errors()
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  return errors_;
+}
+
+uint64_t ModemEmulator::BytesToModem()
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  return bytes_to_modem_;
+}
+
+uint64_t ModemEmulator::BytesFromModem()
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  return bytes_from_modem_;
+}
+
+std::string ModemEmulator::Escape(const std::string &data)
+{
+  std::string out;
+  char hex[5];
+
+  for (unsigned char c : data)
+    {
+      switch (c)
+        {
+          case '\\': out += "\\\\"; break;
+          case '\r': out += "\\r"; break;
+          case '\n': out += "\\n"; break;
+          case '\t': out += "\\t"; break;
+          default:
+            if (c < 0x20 || c >= 0x7f)
+              {
+                snprintf(hex, sizeof(hex), "\\x%02x", c);
+                out += hex;
+              }
+            else
+              out += (char)c;
+            break;
+        }
+    }
+
+  return out;
+}
+
+bool ModemEmulator::Unescape(const std::string &text, std::string *data)
+{
+  data->clear();
+
+  for (size_t i = 0; i < text.size(); i++)
+    {
+      if (text[i] != '\\')
+        {
+          *data += text[i];
+          continue;
+        }
+
+      if (++i >= text.size())
+        return false;
+
+      switch (text[i])
+        {
+          case '\\': *data += '\\'; break;
+          case 'r': *data += '\r'; break;
+          case 'n': *data += '\n'; break;
+          case 't': *data += '\t'; break;
+          case 'x':
+            if (i + 2 >= text.size() || !isxdigit(text[i + 1]) ||
+                !isxdigit(text[i + 2]))
+              return false;
+            *data += (char)strtoul(text.substr(i + 1, 2).c_str(), NULL, 16);
+            i += 2;
+            break;
+          default:
+            return false;
+        }
+    }
+
+  return true;
+}
+
+/****************************************************************************
+ * Emulator thread
+ ****************************************************************************/
+
+void ModemEmulator::Run()
+{
+  std::unique_lock<std::mutex> guard(lock_);
+
+  while (running_)
+    {
+      struct pollfd pfd[2];
+      char buf[512];
+      int timeout;
+      ssize_t len;
+
+      timeout = NextTimeout(Clock::now());
+
+      pfd[0].fd = master_fd_;
+      pfd[0].events = POLLIN | (pending_write_.empty() ? 0 : POLLOUT);
+      pfd[0].revents = 0;
+      pfd[1].fd = wake_fd_[0];
+      pfd[1].events = POLLIN;
+      pfd[1].revents = 0;
+
+      guard.unlock();
+      poll(pfd, 2, timeout);
+      guard.lock();
+
+      if (pfd[1].revents & POLLIN)
+        (void)!read(wake_fd_[0], buf, sizeof(buf));
+
+      if (pfd[0].revents & POLLIN)
+        {
+          len = read(master_fd_, buf, sizeof(buf));
+          if (len > 0 && powered_)
+            {
+              bytes_to_modem_ += len;
+              if (replay_)
+                HandleReplayInput(buf, len);
+              else
+                HandleInput(buf, len);
+            }
+        }
+
+      if (replay_)
+        ReplayOutput(Clock::now());
+
+      FlushOutput(Clock::now());
+    }
+}
+
+int ModemEmulator::NextTimeout(Clock::time_point now)
+{
+  Clock::time_point due = now + std::chrono::seconds(1);
+
+  if (!output_.empty())
+    due = std::min(due, output_.front().due);
+  if (!wire_.empty())
+    due = std::min(due, wire_.front().due);
+
+  if (replay_ && replay_pos_ < replay_entries_.size() &&
+      !replay_entries_[replay_pos_].to_modem)
+    {
+      due = std::min(due, replay_prev_ + std::chrono::milliseconds(
+                            replay_entries_[replay_pos_].msecs));
+    }
+
+  if (due <= now)
+    return 0;
+
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+           due - now).count() + 1;
+}
+
+void ModemEmulator::Record(bool to_modem, const std::string &data)
+{
+  Clock::time_point now = Clock::now();
+  long msecs;
+
+  msecs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            now - trace_prev_).count();
+  trace_prev_ = now;
+
+  trace_ += to_modem ? "> " : "< ";
+  trace_ += std::to_string(msecs) + " " + Escape(data) + "\n";
+}
+
+void ModemEmulator::Emit(const std::string &data, unsigned int delay_msecs)
+{
+  Output out;
+
+  out.due = Clock::now() + std::chrono::milliseconds(delay_msecs);
+  out.data = data;
+
+  /* Keep scheduled output in due order; output with same due time is sent
+   * in order of emitting. */
+
+  output_.insert(std::upper_bound(output_.begin(), output_.end(), out,
+                                  [](const Output &a, const Output &b)
+                                  {
+                                    return a.due < b.due;
+                                  }),
+                 out);
+}
+
+void ModemEmulator::FlushOutput(Clock::time_point now)
+{
+  /* Move due output to serial line. With baudrate set, chunk is delivered
+   * once it has been fully transmitted over emulated line. */
+
+  while (!output_.empty() && output_.front().due <= now)
+    {
+      Output out = output_.front();
+
+      output_.erase(output_.begin());
+      if (!powered_)
+        continue;
+
+      if (baudrate_ > 0)
+        {
+          line_free_ = std::max(now, line_free_) +
+                       std::chrono::microseconds(
+                         (uint64_t)out.data.size() * 10 * 1000000 /
+                         baudrate_);
+          out.due = line_free_;
+        }
+
+      wire_.push_back(out);
+    }
+
+  while (!wire_.empty() && wire_.front().due <= now)
+    {
+      Record(false, wire_.front().data);
+      pending_write_ += wire_.front().data;
+      bytes_from_modem_ += wire_.front().data.size();
+      wire_.pop_front();
+    }
+
+  if (powering_off_ && output_.empty() && wire_.empty())
+    {
+      powering_off_ = false;
+      powered_ = false;
+    }
+
+  while (!pending_write_.empty())
+    {
+      ssize_t ret = write(master_fd_, pending_write_.data(),
+                          pending_write_.size());
+
+      if (ret <= 0)
+        break;
+
+      pending_write_.erase(0, ret);
+    }
+}
+
+/****************************************************************************
+ * Replay mode
+ ****************************************************************************/
+
+void ModemEmulator::HandleReplayInput(const char *buf, size_t len)
+{
+  replay_input_.append(buf, len);
+
+  while (!replay_input_.empty())
+    {
+      const TraceEntry *entry;
+      size_t cmplen;
+
+      if (replay_pos_ >= replay_entries_.size() ||
+          !replay_entries_[replay_pos_].to_modem)
+        {
+          errors_.push_back("unexpected input '" + Escape(replay_input_) +
+                            "' at trace entry " +
+                            std::to_string(replay_pos_));
+          replay_input_.clear();
+          return;
+        }
+
+      entry = &replay_entries_[replay_pos_];
+      cmplen = std::min(entry->data.size(), replay_input_.size());
+
+      if (entry->data.compare(0, cmplen, replay_input_, 0, cmplen) != 0)
+        {
+          errors_.push_back("input '" + Escape(replay_input_) +
+                            "' does not match '" + Escape(entry->data) +
+                            "' at trace entry " +
+                            std::to_string(replay_pos_));
+          replay_input_.clear();
+          return;
+        }
+
+      if (cmplen < entry->data.size())
+        return; /* Wait for rest of entry. */
+
+      Record(true, entry->data);
+      replay_input_.erase(0, cmplen);
+      replay_pos_++;
+      replay_prev_ = Clock::now();
+    }
+}
+
+void ModemEmulator::ReplayOutput(Clock::time_point now)
+{
+  while (replay_pos_ < replay_entries_.size() &&
+         !replay_entries_[replay_pos_].to_modem)
+    {
+      const TraceEntry &entry = replay_entries_[replay_pos_];
+      Clock::time_point due;
+
+      due = replay_prev_ + std::chrono::milliseconds(entry.msecs);
+      if (due > now)
+        return;
+
+      Emit(entry.data);
+      replay_pos_++;
+      replay_prev_ = due;
+    }
+}
+
+/****************************************************************************
+ * Model mode
+ ****************************************************************************/
+
+void ModemEmulator::HandleInput(const char *buf, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+    {
+      char c = buf[i];
+
+      if (in_data_mode_)
+        {
+          size_t n = std::min(len - i, data_len_ - data_.size());
+
+          data_.append(buf + i, n);
+          i += n - 1;
+
+          if (data_.size() == data_len_)
+            {
+              Record(true, data_);
+              in_data_mode_ = false;
+              HandleData();
+              data_.clear();
+            }
+          continue;
+        }
+
+      if (c == '\n' && line_.empty())
+        continue;
+
+      line_ += c;
+
+      if (c != '\r')
+        continue;
+
+      Record(true, line_);
+
+      if (echo_)
+        Emit(line_);
+
+      if (line_.size() > 3 &&
+          (line_.compare(0, 2, "AT") == 0 || line_.compare(0, 2, "at") == 0))
+        HandleCommand(line_.substr(2, line_.size() - 3));
+
+      line_.clear();
+    }
+}
+
+void ModemEmulator::Respond(const std::vector<std::string> &lines)
+{
+  std::string out;
+  unsigned int delay = latency_msecs_;
+
+  for (const std::string &line : lines)
+    out += "\r\n" + line + "\r\n";
+
+  out += "\r\nOK\r\n";
+
+  /* Account command transmission time from DTE. */
+
+  if (baudrate_ > 0 && !commands_.empty())
+    delay += (commands_.back().size() + 3) * 10 * 1000 / baudrate_;
+
+  Emit(out, delay);
+}
+
+void ModemEmulator::RespondError(int code)
+{
+  if (cmee_ == 1)
+    Emit("\r\n+CME ERROR: " + std::to_string(code) + "\r\n", latency_msecs_);
+  else
+    Emit("\r\nERROR\r\n", latency_msecs_);
+}
+
+void ModemEmulator::Urc(const std::string &line, unsigned int delay_msecs)
+{
+  Emit("\r\n" + line + "\r\n", delay_msecs);
+}
+
+void ModemEmulator::HandleCommand(const std::string &cmdline)
+{
+  std::string name;
+  std::string args;
+  size_t pos;
+
+  commands_.push_back(cmdline);
+
+  if (!cmdline.empty() && cmdline[0] == '+')
+    {
+      pos = cmdline.find_first_of("=?");
+      name = cmdline.substr(0, pos);
+      if (pos != std::string::npos)
+        args = cmdline.substr(pos);
+    }
+  else
+    name = cmdline;
+
+  if (name == "E0")
+    echo_ = false;
+
+  if (name == "I0")
+    return Respond({ kOrderCode });
+  if (name == "+CGMR")
+    return Respond({ kFirmware });
+  if (name == "+CMEE")
+    {
+      if (args == "?")
+        return Respond({ "+CMEE: " + std::to_string(cmee_) });
+      cmee_ = arg_int(split_args(args), 0, 0);
+      return Respond({});
+    }
+  if (name == "+CPIN")
+    return Respond({ "+CPIN: READY" });
+  if (name == "+CSQ")
+    return Respond({ "+CSQ: 18,99" });
+  if (name == "+CGSN")
+    return Respond({ "352848021234567" });
+  if (name == "+CFUN")
+    return CmdCfun(args);
+  if (name == "+COPS")
+    return CmdCops(args);
+  if (name == "+CREG")
+    return CmdCreg(args);
+  if (name == "+CGATT")
+    return CmdCgatt(args);
+  if (name == "+UPSDA")
+    return CmdUpsda(args);
+  if (name == "+UPSND")
+    return CmdUpsnd(args);
+  if (name == "+USOCR")
+    return CmdUsocr(args);
+  if (name == "+USOCO")
+    return CmdUsoco(args);
+  if (name == "+USOWR")
+    return CmdUsowr(args, false);
+  if (name == "+USOST")
+    return CmdUsowr(args, true);
+  if (name == "+USORD")
+    return CmdUsord(args, false);
+  if (name == "+USORF")
+    return CmdUsord(args, true);
+  if (name == "+USOCL")
+    return CmdUsocl(args);
+  if (name == "+USOCTL")
+    return CmdUsoctl(args);
+  if (name == "+USOER")
+    return Respond({ "+USOER: 0" });
+  if (name == "+UFTPC")
+    return CmdUftpc(args);
+  if (name == "+UDELFILE")
+    return CmdUdelfile(args);
+  if (name == "+CPWROFF")
+    {
+      /* Modem powers off after response has been sent. */
+
+      Respond({});
+      powering_off_ = true;
+      return;
+    }
+
+  for (const char *accepted : kAcceptedCommands)
+    {
+      if (name == accepted)
+        return Respond({});
+    }
+
+  /* Unknown command, also answer for +INVALIDCOMMANDTEST. */
+
+  RespondError(100);
+}
+
+void ModemEmulator::SetRegistered(bool registered)
+{
+  int stat = registered ? 1 : 0;
+
+  if (creg_stat_ == stat)
+    return;
+
+  creg_stat_ = stat;
+  if (creg_urc_ == 1)
+    Urc("+CREG: " + std::to_string(stat),
+        registered ? registration_msecs_ : 0);
+}
+
+void ModemEmulator::CmdCfun(const std::string &args)
+{
+  if (args == "?")
+    return Respond({ "+CFUN: " + std::to_string(cfun_) + ",0" });
+
+  cfun_ = arg_int(split_args(args), 0, 1);
+  if (cfun_ == 0)
+    {
+      SetRegistered(false);
+      cgatt_ = false;
+      pdp_active_ = false;
+    }
+
+  Respond({});
+}
+
+void ModemEmulator::CmdCops(const std::string &args)
+{
+  int mode;
+
+  if (args == "?")
+    {
+      if (creg_stat_ == 1)
+        return Respond({ "+COPS: 0,0,\"EMULATOR\",2" });
+      return Respond({ "+COPS: 2" });
+    }
+
+  mode = arg_int(split_args(args), 0, 0);
+  Respond({});
+
+  if (mode == 2)
+    SetRegistered(false);
+  else if (mode == 0 && cfun_ == 1)
+    SetRegistered(true);
+}
+
+void ModemEmulator::CmdCreg(const std::string &args)
+{
+  if (args == "?")
+    {
+      return Respond({ "+CREG: " + std::to_string(creg_urc_) + "," +
+                       std::to_string(creg_stat_) });
+    }
+
+  creg_urc_ = arg_int(split_args(args), 0, 0);
+  Respond({});
+}
+
+void ModemEmulator::CmdCgatt(const std::string &args)
+{
+  if (args == "?")
+    return Respond({ std::string("+CGATT: ") + (cgatt_ ? "1" : "0") });
+
+  if (creg_stat_ != 1)
+    return RespondError(30); /* No network service */
+
+  cgatt_ = arg_int(split_args(args), 0, 0) == 1;
+  if (!cgatt_)
+    pdp_active_ = false;
+
+  Respond({});
+}
+
+void ModemEmulator::CmdUpsda(const std::string &args)
+{
+  std::vector<std::string> a = split_args(args);
+  int action = arg_int(a, 1);
+
+  if (action == 3)
+    {
+      if (!cgatt_)
+        return RespondError(148); /* Unspecified GPRS error */
+      pdp_active_ = true;
+    }
+  else if (action == 4)
+    pdp_active_ = false;
+
+  Respond({});
+}
+
+void ModemEmulator::CmdUpsnd(const std::string &args)
+{
+  std::vector<std::string> a = split_args(args);
+  int param = arg_int(a, 1);
+  std::string prefix = "+UPSND: " + a[0] + "," + std::to_string(param) + ",";
+
+  switch (param)
+    {
+      case 0:
+        return Respond({ prefix + "\"" + (pdp_active_ ? kLocalAddr : "") +
+                         "\"" });
+      case 1:
+        return Respond({ prefix + "\"" + kDns1Addr + "\"" });
+      case 2:
+        return Respond({ prefix + "\"" + kDns2Addr + "\"" });
+      case 8:
+        return Respond({ prefix + (pdp_active_ ? "1" : "0") });
+      default:
+        return RespondError(4);
+    }
+}
+
+ModemEmulator::Socket *ModemEmulator::GetSocket(int sd)
+{
+  if (sd < 0 || sd >= NUM_SOCKETS || !sockets_[sd].used)
+    return NULL;
+  return &sockets_[sd];
+}
+
+void ModemEmulator::CmdUsocr(const std::string &args)
+{
+  int proto = arg_int(split_args(args), 0);
+
+  if (!pdp_active_)
+    return RespondError(4);
+
+  for (int sd = 0; sd < NUM_SOCKETS; sd++)
+    {
+      if (sockets_[sd].used)
+        continue;
+
+      sockets_[sd] = Socket();
+      sockets_[sd].used = true;
+      sockets_[sd].tcp = (proto == 6);
+      return Respond({ "+USOCR: " + std::to_string(sd) });
+    }
+
+  RespondError(4);
+}
+
+void ModemEmulator::CmdUsoco(const std::string &args)
+{
+  std::vector<std::string> a = split_args(args);
+  Socket *sock = GetSocket(arg_int(a, 0));
+
+  if (!sock || a.size() < 3)
+    return RespondError(4);
+
+  sock->connected = true;
+  sock->peer_addr = a[1];
+  sock->peer_port = arg_int(a, 2);
+  Respond({});
+}
+
+void ModemEmulator::CmdUsowr(const std::string &args, bool udp)
+{
+  std::vector<std::string> a = split_args(args);
+  int sd = arg_int(a, 0);
+  Socket *sock = GetSocket(sd);
+  int len = arg_int(a, udp ? 3 : 1);
+
+  if (!sock || len <= 0 || (!udp && !sock->connected))
+    return RespondError(4);
+
+  /* Binary data mode; modem prompts with '@' after which exactly 'len'
+   * bytes are taken as socket data. */
+
+  data_sd_ = sd;
+  data_udp_ = udp;
+  data_len_ = len;
+  data_.clear();
+  in_data_mode_ = true;
+  Emit("@", latency_msecs_);
+}
+
+void ModemEmulator::HandleData()
+{
+  Socket *sock = GetSocket(data_sd_);
+  std::string name = data_udp_ ? "+USOST" : "+USOWR";
+
+  if (!sock)
+    return RespondError(4);
+
+  sock->received += data_;
+  Respond({ name + ": " + std::to_string(data_sd_) + "," +
+            std::to_string(data_.size()) });
+
+  if (echo_server_)
+    DoRemoteSend(data_sd_, data_);
+}
+
+void ModemEmulator::DoRemoteSend(int sd, const std::string &data)
+{
+  Socket *sock = GetSocket(sd);
+
+  if (!sock || (sock->tcp && !sock->connected) || data.empty())
+    return;
+
+  sock->rxbuf += data;
+  Urc(std::string(sock->tcp ? "+UUSORD: " : "+UUSORF: ") +
+      std::to_string(sd) + "," + std::to_string(sock->rxbuf.size()),
+      latency_msecs_);
+}
+
+void ModemEmulator::CmdUsord(const std::string &args, bool udp)
+{
+  std::vector<std::string> a = split_args(args);
+  int sd = arg_int(a, 0);
+  Socket *sock = GetSocket(sd);
+  size_t len = arg_int(a, 1, 0);
+  std::string head;
+  std::string data;
+
+  if (!sock)
+    return RespondError(4);
+
+  head = std::string(udp ? "+USORF: " : "+USORD: ") + std::to_string(sd) +
+         ",";
+
+  if (len == 0)
+    return Respond({ head + std::to_string(sock->rxbuf.size()) });
+
+  len = std::min(std::min(len, kMaxReadLen), sock->rxbuf.size());
+  data = sock->rxbuf.substr(0, len);
+  sock->rxbuf.erase(0, len);
+
+  if (udp)
+    {
+      head += "\"" + (sock->peer_addr.empty() ? std::string(kDns1Addr) :
+                      sock->peer_addr) + "\"," +
+              std::to_string(sock->peer_port) + ",";
+    }
+
+  Respond({ head + std::to_string(len) + ",\"" + data + "\"" });
+}
+
+void ModemEmulator::CmdUsocl(const std::string &args)
+{
+  Socket *sock = GetSocket(arg_int(split_args(args), 0));
+
+  if (!sock)
+    return RespondError(4);
+
+  sock->used = false;
+  sock->connected = false;
+  Respond({});
+}
+
+void ModemEmulator::CmdUsoctl(const std::string &args)
+{
+  std::vector<std::string> a = split_args(args);
+  int sd = arg_int(a, 0);
+  int param = arg_int(a, 1);
+
+  if (!GetSocket(sd))
+    return RespondError(4);
+
+  /* All written data is immediately acknowledged by remote, so
+   * unacknowledged byte count (param 11) is always zero. */
+
+  Respond({ "+USOCTL: " + std::to_string(sd) + "," + std::to_string(param) +
+            ",0" });
+}
+
+void ModemEmulator::CmdUftpc(const std::string &args)
+{
+  std::vector<std::string> a = split_args(args);
+  int op = arg_int(a, 0);
+  unsigned int delay = latency_msecs_ * 2;
+  int result = 1;
+
+  switch (op)
+    {
+      case 0: /* Logout */
+      case 1: /* Login */
+        break;
+
+      case 8: /* Change directory */
+        ftp_dir_ = a.size() > 1 ? strip_slashes(a[1]) : "";
+        break;
+
+      case 4: /* Retrieve file */
+        {
+          std::string src;
+          std::map<std::string, std::string>::iterator it;
+
+          if (a.size() < 3)
+            return RespondError(4);
+
+          src = strip_slashes(a[1]);
+          if (!ftp_dir_.empty())
+            src = ftp_dir_ + "/" + src;
+
+          it = ftp_files_.find(src);
+          if (it == ftp_files_.end())
+            {
+              result = 0;
+              break;
+            }
+
+          modem_files_[a[2]] = it->second;
+          if (ftp_rate_ > 0)
+            delay += (uint64_t)it->second.size() * 1000 / ftp_rate_;
+        }
+        break;
+
+      default:
+        return RespondError(4);
+    }
+
+  Respond({});
+  Urc("+UUFTPCR: " + std::to_string(op) + "," + std::to_string(result),
+      delay);
+}
+
+void ModemEmulator::CmdUdelfile(const std::string &args)
+{
+  std::vector<std::string> a = split_args(args);
+
+  if (a.empty() || modem_files_.erase(a[0]) == 0)
+    return RespondError(1612); /* File not found */
+
+  Respond({});
+}
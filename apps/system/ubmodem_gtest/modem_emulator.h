@@ -0,0 +1,252 @@
+/****************************************************************************
+ * apps/system/ubmodem_gtest/modem_emulator.h
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+#ifndef __APPS_SYSTEM_UBMODEM_GTEST_MODEM_EMULATOR_H
+#define __APPS_SYSTEM_UBMODEM_GTEST_MODEM_EMULATOR_H
+
+#include <stdint.h>
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * u-blox SARA AT command emulator on pseudo-terminal.
+ *
+ * Modem library opens slave side of pty as its serial port, emulator
+ * serves master side from own thread. Two modes of operation:
+ *
+ *  - Model: behavioural model of SARA-U2 for power-on, SIM, network
+ *    registration, GPRS, TCP/UDP sockets and FTP download.
+ *  - Replay: strict replay of recorded trace; commands from modem library
+ *    must match trace byte-by-byte and responses are sent with recorded
+ *    timing.
+ *
+ * Traffic is always recorded in trace format that can be loaded back for
+ * replay:
+ *
+ *   > <msecs> <escaped bytes>     from modem library (DTE) to modem
+ *   < <msecs> <escaped bytes>     from modem to modem library
+ *
+ * where <msecs> is time since previous entry and bytes are C-escaped.
+ * Lines starting with '#' are comments.
+ */
+
+class ModemEmulator
+{
+public:
+  ModemEmulator();
+  ~ModemEmulator();
+
+  /* Create pty and start emulator thread. Returns slave side fd, owned by
+   * caller, or -1 on error. */
+
+  int Start();
+  void Stop();
+
+  /* Power state, controlled through modem library hardware operations.
+   * Powered-off modem ignores input. */
+
+  void SetPower(bool on);
+  bool IsPowered();
+
+  /* Model parameters. */
+
+  void SetBaudrate(unsigned int bps);
+  void SetResponseLatency(unsigned int msecs);
+  void SetRegistrationDelay(unsigned int msecs);
+  void SetFtpRate(unsigned int bytes_per_sec);
+  void SetEchoServer(bool echo);
+
+  /* FTP server and modem filesystem content. */
+
+  void AddFtpFile(const std::string &path, const std::string &content);
+  bool GetModemFile(const std::string &name, std::string *content);
+
+  /* Remote end of modem socket. */
+
+  void RemoteSend(int sd, const std::string &data);
+  void RemoteClose(int sd);
+  std::string RemoteReceived(int sd);
+  size_t RemoteReceivedLen(int sd);
+
+  /* Command log, commands without "AT" prefix. */
+
+  std::vector<std::string> Commands();
+  unsigned int CommandCount(const std::string &name);
+
+  /* Trace recording and replay. */
+
+  std::string Trace();
+  bool SaveTrace(const std::string &path);
+  bool LoadTrace(const std::string &trace);
+  bool LoadTraceFile(const std::string &path);
+  bool ReplayDone();
+  std::vector<std::string> Errors();
+
+  /* Statistics. */
+
+  uint64_t BytesToModem();
+  uint64_t BytesFromModem();
+
+  static std::string Escape(const std::string &data);
+  static bool Unescape(const std::string &text, std::string *data);
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct TraceEntry
+  {
+    bool to_modem;
+    unsigned int msecs;
+    std::string data;
+  };
+
+  struct Output
+  {
+    Clock::time_point due;
+    std::string data;
+  };
+
+  struct Socket
+  {
+    bool used;
+    bool tcp;
+    bool connected;
+    std::string rxbuf;        /* Data from remote, not yet read by DTE */
+    std::string received;     /* Data from DTE to remote */
+    std::string peer_addr;
+    int peer_port;
+  };
+
+  enum { NUM_SOCKETS = 7 };
+
+  void Run();
+  void Wake();
+  int NextTimeout(Clock::time_point now);
+
+  void Record(bool to_modem, const std::string &data);
+
+  void Emit(const std::string &data, unsigned int delay_msecs = 0);
+  void FlushOutput(Clock::time_point now);
+
+  void HandleInput(const char *buf, size_t len);
+  void HandleReplayInput(const char *buf, size_t len);
+  void ReplayOutput(Clock::time_point now);
+  void HandleCommand(const std::string &line);
+  void HandleData();
+
+  void Respond(const std::vector<std::string> &lines);
+  void RespondError(int code);
+  void Urc(const std::string &line, unsigned int delay_msecs = 0);
+
+  void CmdCfun(const std::string &args);
+  void CmdCops(const std::string &args);
+  void CmdCreg(const std::string &args);
+  void CmdCgatt(const std::string &args);
+  void CmdUpsda(const std::string &args);
+  void CmdUpsnd(const std::string &args);
+  void CmdUsocr(const std::string &args);
+  void CmdUsoco(const std::string &args);
+  void CmdUsowr(const std::string &args, bool udp);
+  void CmdUsord(const std::string &args, bool udp);
+  void CmdUsocl(const std::string &args);
+  void CmdUsoctl(const std::string &args);
+  void CmdUftpc(const std::string &args);
+  void CmdUdelfile(const std::string &args);
+
+  Socket *GetSocket(int sd);
+  void DoRemoteSend(int sd, const std::string &data);
+  void SetRegistered(bool registered);
+
+  std::mutex lock_;
+  std::thread thread_;
+  bool running_;
+  int master_fd_;
+  int wake_fd_[2];
+
+  bool powered_;
+  bool powering_off_;
+  bool echo_;
+  int cmee_;
+  int cfun_;
+  int creg_urc_;
+  int creg_stat_;
+  bool cgatt_;
+  bool pdp_active_;
+  bool echo_server_;
+
+  unsigned int baudrate_;
+  unsigned int latency_msecs_;
+  unsigned int registration_msecs_;
+  unsigned int ftp_rate_;
+
+  std::string line_;
+  std::string data_;
+  size_t data_len_;
+  int data_sd_;
+  bool data_udp_;
+  bool in_data_mode_;
+
+  std::vector<Output> output_;   /* Scheduled output, in due order */
+  std::deque<Output> wire_;      /* Output in transmission */
+  std::string pending_write_;
+  Clock::time_point line_free_;
+
+  Socket sockets_[NUM_SOCKETS];
+
+  std::map<std::string, std::string> ftp_files_;
+  std::map<std::string, std::string> modem_files_;
+  std::string ftp_dir_;
+
+  std::vector<std::string> commands_;
+
+  std::string trace_;
+  Clock::time_point trace_prev_;
+
+  bool replay_;
+  std::vector<TraceEntry> replay_entries_;
+  size_t replay_pos_;
+  std::string replay_input_;
+  Clock::time_point replay_prev_;
+  std::vector<std::string> errors_;
+
+  uint64_t bytes_to_modem_;
+  uint64_t bytes_from_modem_;
+};
+
+#endif /* __APPS_SYSTEM_UBMODEM_GTEST_MODEM_EMULATOR_H */
@@ -0,0 +1,865 @@
+/****************************************************************************
+ * apps/system/ubmodem_gtest/ubmodem_emulator_test.cc
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "modem_emulator.h"
+#include "host_glue.h"
+
+extern "C" {
+#include <nuttx/net/usrsock.h>
+#define delete delete_ /* Member name in C header is C++ keyword */
+#include <apps/system/ubmodem.h>
+#undef delete
+
+/* From ubmodem_parser.h, which is not C++ clean. */
+
+int __ubmodem_parser_benchmark(uint64_t *bytes_per_sec);
+}
+
+typedef std::chrono::steady_clock Clock;
+
+static long elapsed_msecs(Clock::time_point start)
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+           Clock::now() - start).count();
+}
+
+/* Message received from modem library on usrsock link. */
+
+struct UsrsockMessage
+{
+  int msgid;
+  int flags;
+  int xid;
+  int result;
+  int usockid;
+  int events;
+  std::string data;
+};
+
+/*
+ * Runs modem library against pty-backed modem emulator. Test acts as
+ * NuttX kernel on usrsock link and drives modem library event loop.
+ *
+ * Environment variables:
+ *   UBMODEM_EMU_VERBOSE    - Enable modem library debug output.
+ *   UBMODEM_EMU_TRACE_DIR  - Save AT traces of each test to directory.
+ */
+
+class ModemEmulatorTest : public testing::Test
+{
+protected:
+  std::unique_ptr<ModemEmulator> emu;
+  struct ubmodem_s *modem;
+  int usrsock_fd;
+  int serial_fd;
+  uint8_t xid;
+
+  enum ubmodem_func_level_e level;
+  bool target_reached;
+  bool level_failed;
+  struct in_addr ipaddr;
+  int ftp_status;
+
+  std::string usrsock_rx;
+  std::deque<UsrsockMessage> usrsock_msgs;
+  std::vector<UsrsockMessage> usrsock_events;
+
+  virtual void SetUp()
+  {
+    int sv[2];
+
+    emu.reset(new ModemEmulator());
+    modem = NULL;
+    serial_fd = -1;
+    xid = 0;
+    level = UBMODEM_LEVEL_POWERED_OFF;
+    target_reached = false;
+    level_failed = false;
+    ipaddr.s_addr = 0;
+    ftp_status = -1;
+
+    ubmodem_host_verbose = getenv("UBMODEM_EMU_VERBOSE") != NULL;
+
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+    usrsock_fd = sv[0];
+    ubmodem_host_usrsock_fd = sv[1];
+    fcntl(usrsock_fd, F_SETFL, fcntl(usrsock_fd, F_GETFL) | O_NONBLOCK);
+  }
+
+  virtual void TearDown()
+  {
+    const char *dir = getenv("UBMODEM_EMU_TRACE_DIR");
+
+    if (modem)
+      {
+        EXPECT_TRUE(StopModem());
+      }
+
+    emu->Stop();
+
+    if (dir)
+      {
+        const testing::TestInfo *info =
+          testing::UnitTest::GetInstance()->current_test_info();
+
+        emu->SaveTrace(std::string(dir) + "/" + info->name() + ".trace");
+      }
+
+    close(usrsock_fd);
+    close(ubmodem_host_usrsock_fd);
+    ubmodem_host_usrsock_fd = -1;
+  }
+
+  /* Modem hardware operations, wired to emulator. */
+
+  static int hw_initialize(void *priv, bool *is_vcc_off)
+  {
+    ModemEmulatorTest *self = (ModemEmulatorTest *)priv;
+
+    /* VCC is on at start-up and modem is running. */
+
+    *is_vcc_off = false;
+    self->emu->SetPower(true);
+    return self->serial_fd;
+  }
+
+  static int hw_deinitialize(void *priv, int serial_fd)
+  {
+    close(serial_fd);
+    return OK;
+  }
+
+  static bool hw_vcc_set(void *priv, bool on)
+  {
+    ModemEmulatorTest *self = (ModemEmulatorTest *)priv;
+
+    if (!on)
+      self->emu->SetPower(false);
+    return on;
+  }
+
+  static uint32_t hw_poweron_pin_set(void *priv, bool set)
+  {
+    ModemEmulatorTest *self = (ModemEmulatorTest *)priv;
+
+    /* Modem powers on at rising edge of POWER_ON pulse. */
+
+    if (set)
+      self->emu->SetPower(true);
+    return 5;
+  }
+
+  static uint32_t hw_reset_pin_set(void *priv, bool set)
+  {
+    ModemEmulatorTest *self = (ModemEmulatorTest *)priv;
+
+    /* Modem reboots at release of RESET_N. */
+
+    if (set)
+      {
+        self->emu->SetPower(false);
+        self->emu->SetPower(true);
+      }
+    return 5;
+  }
+
+  static bool config_cb(struct ubmodem_s *modem, const char *name,
+                        char *buf, size_t buflen, void *priv)
+  {
+    if (strcmp(name, "modem.apn_name") == 0)
+      {
+        snprintf(buf, buflen, "%s", "internet");
+        return true;
+      }
+
+    return false;
+  }
+
+  static void event_cb(struct ubmodem_s *modem,
+                       enum ubmodem_event_flags_e event,
+                       const void *event_data, size_t datalen, void *priv)
+  {
+    ModemEmulatorTest *self = (ModemEmulatorTest *)priv;
+
+    switch (event)
+      {
+        case UBMODEM_EVENT_FLAG_TARGET_LEVEL_REACHED:
+          {
+            const struct ubmodem_event_target_level_reached_s *data =
+              (const struct ubmodem_event_target_level_reached_s *)event_data;
+
+            self->level = data->new_level;
+            self->target_reached = true;
+          }
+          break;
+
+        case UBMODEM_EVENT_FLAG_FAILED_LEVEL_TRANSITION:
+          self->level_failed = true;
+          break;
+
+        case UBMODEM_EVENT_FLAG_IP_ADDRESS:
+          self->ipaddr =
+            ((const struct ubmodem_event_ip_address_s *)event_data)->ipaddr;
+          break;
+
+        case UBMODEM_EVENT_FLAG_FTP_DOWNLOAD_STATUS:
+          self->ftp_status =
+            ((const struct ubmodem_event_ftp_download_status_s *)
+               event_data)->file_downloaded;
+          break;
+
+        default:
+          break;
+      }
+  }
+
+  void StartModem()
+  {
+    static const struct ubmodem_hw_ops_s hw_ops =
+    {
+      .initialize      = hw_initialize,
+      .deinitialize    = hw_deinitialize,
+      .vcc_set         = hw_vcc_set,
+      .poweron_pin_set = hw_poweron_pin_set,
+      .reset_pin_set   = hw_reset_pin_set,
+      .pm_set_activity = NULL,
+    };
+
+    serial_fd = emu->Start();
+    ASSERT_GE(serial_fd, 0);
+
+    modem = ubmodem_initialize(&hw_ops, this);
+    ASSERT_TRUE(modem != NULL);
+
+    ubmodem_set_config_callback(modem, config_cb, this);
+    ubmodem_register_event_listener(modem,
+                                    UBMODEM_EVENT_FLAG_TARGET_LEVEL_REACHED |
+                                    UBMODEM_EVENT_FLAG_FAILED_LEVEL_TRANSITION |
+                                    UBMODEM_EVENT_FLAG_IP_ADDRESS |
+                                    UBMODEM_EVENT_FLAG_FTP_DOWNLOAD_STATUS,
+                                    event_cb, this);
+  }
+
+  /* Power off modem and uninitialize library once its state machine has
+   * become idle, without pending timers. */
+
+  bool StopModem()
+  {
+    bool ok;
+
+    ok = RequestLevel(UBMODEM_LEVEL_POWERED_OFF, 10000) &&
+         RunUntil([&]()
+           {
+             int maxfds = ubmodem_poll_max_fds(modem);
+             struct pollfd pfds[maxfds];
+             int timeout;
+
+             ubmodem_pollfds_setup(modem, pfds, maxfds, &timeout);
+             return ubmodem_is_powered_off(modem) && timeout < 0;
+           }, 1000);
+
+    ubmodem_unregister_event_listener(modem, event_cb);
+    if (ok)
+      ubmodem_uninitialize(modem);
+    modem = NULL;
+    return ok;
+  }
+
+  /* Run modem library event loop until 'done' returns true or timeout. */
+
+  bool RunUntil(const std::function<bool()> &done, int timeout_msecs)
+  {
+    Clock::time_point start = Clock::now();
+    int maxfds = ubmodem_poll_max_fds(modem);
+    struct pollfd pfds[maxfds];
+
+    while (!done())
+      {
+        int timeout;
+        int nfds;
+        int ret;
+
+        if (elapsed_msecs(start) > timeout_msecs)
+          return false;
+
+        nfds = ubmodem_pollfds_setup(modem, pfds, maxfds, &timeout);
+        if (nfds < 0)
+          return false;
+
+        if (timeout < 0 || timeout > 10)
+          timeout = 10;
+
+        ret = poll(pfds, nfds, timeout);
+        if (ret < 0 && errno != EINTR)
+          return false;
+
+        ubmodem_pollfds_event(modem, ret > 0 ? pfds : NULL,
+                              ret > 0 ? nfds : 0);
+
+        PumpUsrsock();
+      }
+
+    return true;
+  }
+
+  bool RequestLevel(enum ubmodem_func_level_e target, int timeout_msecs)
+  {
+    target_reached = false;
+    level_failed = false;
+    ubmodem_request_level(modem, target);
+
+    return RunUntil([&]() { return target_reached || level_failed; },
+                    timeout_msecs) && target_reached && level == target;
+  }
+
+  /* Kernel side of usrsock link. */
+
+  void PumpUsrsock()
+  {
+    char buf[2048];
+    ssize_t len;
+
+    while ((len = read(usrsock_fd, buf, sizeof(buf))) > 0)
+      usrsock_rx.append(buf, len);
+
+    while (ParseUsrsockMessage())
+      ;
+  }
+
+  bool ParseUsrsockMessage()
+  {
+    const struct usrsock_message_common_s *head;
+    UsrsockMessage msg = {};
+    size_t msglen;
+
+    if (usrsock_rx.size() < sizeof(*head))
+      return false;
+
+    head = (const struct usrsock_message_common_s *)usrsock_rx.data();
+    msg.msgid = head->msgid;
+    msg.flags = head->flags;
+
+    if (head->msgid == USRSOCK_MESSAGE_SOCKET_EVENT)
+      {
+        struct usrsock_message_socket_event_s event;
+
+        if (usrsock_rx.size() < sizeof(event))
+          return false;
+
+        memcpy(&event, usrsock_rx.data(), sizeof(event));
+        msg.usockid = event.usockid;
+        msg.events = event.events;
+        msglen = sizeof(event);
+        usrsock_events.push_back(msg);
+      }
+    else if (head->msgid == USRSOCK_MESSAGE_RESPONSE_ACK)
+      {
+        struct usrsock_message_req_ack_s ack;
+
+        if (usrsock_rx.size() < sizeof(ack))
+          return false;
+
+        memcpy(&ack, usrsock_rx.data(), sizeof(ack));
+        msg.xid = ack.xid;
+        msg.result = ack.result;
+        msglen = sizeof(ack);
+        usrsock_msgs.push_back(msg);
+      }
+    else
+      {
+        struct usrsock_message_datareq_ack_s ack;
+
+        EXPECT_EQ(USRSOCK_MESSAGE_RESPONSE_DATA_ACK, head->msgid);
+        if (usrsock_rx.size() < sizeof(ack))
+          return false;
+
+        memcpy(&ack, usrsock_rx.data(), sizeof(ack));
+        msglen = sizeof(ack) + ack.valuelen +
+                 (ack.reqack.result > 0 ? ack.reqack.result : 0);
+        if (usrsock_rx.size() < msglen)
+          return false;
+
+        msg.xid = ack.reqack.xid;
+        msg.result = ack.reqack.result;
+        msg.data = usrsock_rx.substr(sizeof(ack) + ack.valuelen,
+                                     msglen - sizeof(ack) - ack.valuelen);
+        usrsock_msgs.push_back(msg);
+      }
+
+    usrsock_rx.erase(0, msglen);
+    return true;
+  }
+
+  /* Send request and wait for completed response. */
+
+  bool UsrsockRequest(const void *req, size_t reqlen, const void *data,
+                      size_t datalen, UsrsockMessage *resp)
+  {
+    struct usrsock_request_common_s *head =
+      (struct usrsock_request_common_s *)req;
+    std::string buf;
+
+    head->xid = ++xid;
+    buf.append((const char *)req, reqlen);
+    if (datalen > 0)
+      buf.append((const char *)data, datalen);
+
+    if (write(usrsock_fd, buf.data(), buf.size()) != (ssize_t)buf.size())
+      return false;
+
+    return RunUntil([&]()
+      {
+        while (!usrsock_msgs.empty())
+          {
+            UsrsockMessage msg = usrsock_msgs.front();
+
+            usrsock_msgs.pop_front();
+            if (msg.xid != head->xid ||
+                USRSOCK_MESSAGE_REQ_IN_PROGRESS(msg.flags))
+              continue;
+
+            *resp = msg;
+            return true;
+          }
+        return false;
+      }, 10000);
+  }
+
+  bool WaitEvent(int usockid, int events, int timeout_msecs)
+  {
+    return RunUntil([&]()
+      {
+        for (auto it = usrsock_events.begin(); it != usrsock_events.end();
+             ++it)
+          {
+            if (it->usockid == usockid && (it->events & events))
+              {
+                usrsock_events.erase(it);
+                return true;
+              }
+          }
+        return false;
+      }, timeout_msecs);
+  }
+
+  int SocketOpen(int type)
+  {
+    struct usrsock_request_socket_s req = {};
+    UsrsockMessage resp;
+
+    req.head.reqid = USRSOCK_REQUEST_SOCKET;
+    req.domain = AF_INET;
+    req.type = type;
+    req.protocol = 0;
+
+    if (!UsrsockRequest(&req, sizeof(req), NULL, 0, &resp))
+      return -ETIMEDOUT;
+    return resp.result;
+  }
+
+  int SocketConnect(int usockid, const char *ip, int port)
+  {
+    struct usrsock_request_connect_s req = {};
+    struct sockaddr_in addr = {};
+    UsrsockMessage resp;
+
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, ip, &addr.sin_addr);
+
+    req.head.reqid = USRSOCK_REQUEST_CONNECT;
+    req.usockid = usockid;
+    req.addrlen = sizeof(addr);
+
+    if (!UsrsockRequest(&req, sizeof(req), &addr, sizeof(addr), &resp))
+      return -ETIMEDOUT;
+    return resp.result;
+  }
+
+  /* Blocking send as done by kernel: wait for SENDTO_READY on EAGAIN. */
+
+  int SocketSend(int usockid, const std::string &data)
+  {
+    size_t pos = 0;
+
+    while (pos < data.size())
+      {
+        struct usrsock_request_sendto_s req = {};
+        size_t len = std::min(data.size() - pos, (size_t)1024);
+        UsrsockMessage resp;
+
+        req.head.reqid = USRSOCK_REQUEST_SENDTO;
+        req.usockid = usockid;
+        req.addrlen = 0;
+        req.buflen = len;
+
+        if (!UsrsockRequest(&req, sizeof(req), data.data() + pos, len, &resp))
+          return -ETIMEDOUT;
+
+        if (resp.result == -EAGAIN)
+          {
+            if (!WaitEvent(usockid, USRSOCK_EVENT_SENDTO_READY, 10000))
+              return -ETIMEDOUT;
+            continue;
+          }
+
+        if (resp.result < 0)
+          return resp.result;
+
+        pos += resp.result;
+      }
+
+    return pos;
+  }
+
+  /* Blocking receive as done by kernel: wait for RECVFROM_AVAIL on EAGAIN. */
+
+  int SocketRecv(int usockid, size_t maxlen, std::string *data)
+  {
+    for (;;)
+      {
+        struct usrsock_request_recvfrom_s req = {};
+        UsrsockMessage resp;
+
+        req.head.reqid = USRSOCK_REQUEST_RECVFROM;
+        req.usockid = usockid;
+        req.max_buflen = maxlen;
+        req.max_addrlen = 0;
+
+        if (!UsrsockRequest(&req, sizeof(req), NULL, 0, &resp))
+          return -ETIMEDOUT;
+
+        if (resp.result == -EAGAIN)
+          {
+            if (!WaitEvent(usockid, USRSOCK_EVENT_RECVFROM_AVAIL |
+                                    USRSOCK_EVENT_REMOTE_CLOSED, 10000))
+              return -ETIMEDOUT;
+            continue;
+          }
+
+        if (resp.result > 0)
+          data->append(resp.data);
+        return resp.result;
+      }
+  }
+
+  int SocketClose(int usockid)
+  {
+    struct usrsock_request_close_s req = {};
+    UsrsockMessage resp;
+
+    req.head.reqid = USRSOCK_REQUEST_CLOSE;
+    req.usockid = usockid;
+
+    if (!UsrsockRequest(&req, sizeof(req), NULL, 0, &resp))
+      return -ETIMEDOUT;
+    return resp.result;
+  }
+
+  void ReportMetric(const char *name, double value, const char *unit)
+  {
+    printf("[  METRIC  ] %s: %.1f %s\n", name, value, unit);
+    RecordProperty(name, (int)value);
+  }
+};
+
+TEST_F(ModemEmulatorTest, PowerOnToCommandPrompt)
+{
+  Clock::time_point start = Clock::now();
+
+  StartModem();
+  ASSERT_TRUE(RequestLevel(UBMODEM_LEVEL_CMD_PROMPT, 10000));
+  ReportMetric("cmd_prompt_latency_ms", elapsed_msecs(start), "ms");
+
+  ASSERT_TRUE(emu->IsPowered());
+  ASSERT_EQ(1, emu->CommandCount("+INVALIDCOMMANDTEST"));
+  ASSERT_EQ(0, emu->CommandCount("+CPIN"));
+  ASSERT_EQ("E0", emu->Commands().front());
+}
+
+TEST_F(ModemEmulatorTest, NetworkRegistration)
+{
+  Clock::time_point start = Clock::now();
+
+  emu->SetRegistrationDelay(500);
+  StartModem();
+  ASSERT_TRUE(RequestLevel(UBMODEM_LEVEL_NETWORK, 20000));
+  ReportMetric("network_latency_ms", elapsed_msecs(start), "ms");
+
+  ASSERT_EQ(1, emu->CommandCount("+CPIN?"));
+  ASSERT_LE(1, emu->CommandCount("+CREG=1"));
+  ASSERT_LE(1, emu->CommandCount("+COPS=0"));
+}
+
+TEST_F(ModemEmulatorTest, GprsBringUp)
+{
+  Clock::time_point start = Clock::now();
+  char addr[INET_ADDRSTRLEN];
+
+  StartModem();
+  ASSERT_TRUE(RequestLevel(UBMODEM_LEVEL_GPRS, 30000));
+  ReportMetric("gprs_latency_ms", elapsed_msecs(start), "ms");
+
+  inet_ntop(AF_INET, &ipaddr, addr, sizeof(addr));
+  ASSERT_STREQ("10.10.0.2", addr);
+  ASSERT_EQ(1, emu->CommandCount("+UPSDA=0,3"));
+  ASSERT_TRUE(emu->Errors().empty());
+}
+
+TEST_F(ModemEmulatorTest, TcpSocketOpenReadWrite)
+{
+  std::string rx;
+  int usockid;
+
+  StartModem();
+  ASSERT_TRUE(RequestLevel(UBMODEM_LEVEL_GPRS, 30000));
+
+  usockid = SocketOpen(SOCK_STREAM);
+  ASSERT_GE(usockid, 0);
+  ASSERT_EQ(0, SocketConnect(usockid, "192.0.2.1", 7));
+  ASSERT_EQ(1, emu->CommandCount("+USOCO=0,\"192.0.2.1\",7"));
+
+  ASSERT_EQ(5, SocketSend(usockid, "hello"));
+  ASSERT_TRUE(RunUntil([&]() { return emu->RemoteReceivedLen(0) == 5; },
+                       5000));
+  ASSERT_EQ("hello", emu->RemoteReceived(0));
+
+  /* Data with characters significant to AT parser. */
+
+  emu->RemoteSend(0, std::string("a\"b\r\nOK\r\n\0z", 12));
+  while (rx.size() < 12)
+    ASSERT_LT(0, SocketRecv(usockid, 64, &rx));
+  ASSERT_EQ(std::string("a\"b\r\nOK\r\n\0z", 12), rx);
+
+  /* Remote close is reported with event, after which daemon fails
+   * reads. */
+
+  emu->RemoteClose(0);
+  ASSERT_TRUE(WaitEvent(usockid, USRSOCK_EVENT_REMOTE_CLOSED, 5000));
+  ASSERT_EQ(-EPIPE, SocketRecv(usockid, 64, &rx));
+
+  ASSERT_EQ(0, SocketClose(usockid));
+}
+
+TEST_F(ModemEmulatorTest, TcpSocketShortSendCloses)
+{
+  struct usrsock_request_sendto_s req = {};
+  UsrsockMessage resp;
+  int usockid;
+
+  StartModem();
+  ASSERT_TRUE(RequestLevel(UBMODEM_LEVEL_GPRS, 30000));
+
+  usockid = SocketOpen(SOCK_STREAM);
+  ASSERT_GE(usockid, 0);
+  ASSERT_EQ(0, SocketConnect(usockid, "192.0.2.1", 7));
+
+  /* Request data runs out after the data prompt is open; modem has to be
+   * given padding, so socket must not be left usable. */
+
+  fcntl(ubmodem_host_usrsock_fd, F_SETFL,
+        fcntl(ubmodem_host_usrsock_fd, F_GETFL) | O_NONBLOCK);
+
+  req.head.reqid = USRSOCK_REQUEST_SENDTO;
+  req.usockid = usockid;
+  req.addrlen = 0;
+  req.buflen = 8;
+
+  ASSERT_TRUE(UsrsockRequest(&req, sizeof(req), "abc", 3, &resp));
+  ASSERT_EQ(-EPIPE, resp.result);
+  ASSERT_TRUE(WaitEvent(usockid, USRSOCK_EVENT_REMOTE_CLOSED, 5000));
+  ASSERT_EQ(1, emu->CommandCount("+USOCL=0"));
+
+  ASSERT_EQ(0, SocketClose(usockid));
+}
+
+TEST_F(ModemEmulatorTest, TcpSocketThroughput)
+{
+  const size_t total = 32 * 1024;
+  Clock::time_point start;
+  std::string data;
+  std::string rx;
+  long msecs;
+  int usockid;
+
+  emu->SetBaudrate(921600);
+  StartModem();
+  ASSERT_TRUE(RequestLevel(UBMODEM_LEVEL_GPRS, 30000));
+
+  usockid = SocketOpen(SOCK_STREAM);
+  ASSERT_GE(usockid, 0);
+  ASSERT_EQ(0, SocketConnect(usockid, "192.0.2.1", 7));
+
+  for (size_t i = 0; i < total; i++)
+    data += (char)(i * 7 + (i >> 8));
+
+  start = Clock::now();
+  ASSERT_EQ((int)total, SocketSend(usockid, data));
+  ASSERT_TRUE(RunUntil([&]() { return emu->RemoteReceivedLen(0) == total; },
+                       10000));
+  msecs = elapsed_msecs(start);
+  ReportMetric("socket_tx_throughput_Bps", total * 1000.0 / (msecs + 1),
+               "B/s");
+  ASSERT_EQ(data, emu->RemoteReceived(0));
+
+  start = Clock::now();
+  emu->RemoteSend(0, data);
+  while (rx.size() < total)
+    ASSERT_LT(0, SocketRecv(usockid, 1024, &rx));
+  msecs = elapsed_msecs(start);
+  ReportMetric("socket_rx_throughput_Bps", total * 1000.0 / (msecs + 1),
+               "B/s");
+  ASSERT_EQ(data, rx);
+
+  ASSERT_EQ(0, SocketClose(usockid));
+}
+
+TEST_F(ModemEmulatorTest, FtpDownload)
+{
+  struct ubmodem_ftp_download_s ftp = {};
+  Clock::time_point start;
+  std::string content(8192, 'x');
+  std::string file;
+
+  emu->SetFtpRate(64 * 1024);
+  emu->AddFtpFile("/fw/update.bin", content);
+  emu->AddFtpFile("/fw/other.bin", "other");
+
+  StartModem();
+  ASSERT_TRUE(RequestLevel(UBMODEM_LEVEL_GPRS, 30000));
+
+  ftp.hostname = "192.0.2.10";
+  ftp.username = "user";
+  ftp.password = "pass";
+  ftp.filepath_src = "/fw/update.bin";
+  ftp.filepath_dst = "update.bin";
+
+  start = Clock::now();
+  ASSERT_EQ(OK, ubmodem_ftp_download_file(modem, &ftp, NULL));
+  ASSERT_TRUE(RunUntil([&]() { return ftp_status >= 0; }, 30000));
+  ReportMetric("ftp_download_latency_ms", elapsed_msecs(start), "ms");
+
+  ASSERT_EQ(1, ftp_status);
+  ASSERT_TRUE(emu->GetModemFile("update.bin", &file));
+  ASSERT_EQ(content, file);
+  ASSERT_EQ(1, emu->CommandCount("+UFTPC=4,\"update.bin\",\"update.bin\""));
+
+  /* Missing file reports failure. */
+
+  ftp_status = -1;
+  ftp.filepath_src = "/fw/missing.bin";
+  ASSERT_EQ(OK, ubmodem_ftp_download_file(modem, &ftp, NULL));
+  ASSERT_TRUE(RunUntil([&]() { return ftp_status >= 0; }, 30000));
+  ASSERT_EQ(0, ftp_status);
+}
+
+TEST_F(ModemEmulatorTest, ReplayRecordedTrace)
+{
+  std::string trace;
+
+  /* Record bring-up and power-off against behavioural model. */
+
+  StartModem();
+  ASSERT_TRUE(RequestLevel(UBMODEM_LEVEL_GPRS, 30000));
+  ASSERT_TRUE(StopModem());
+  emu->Stop();
+
+  trace = emu->Trace();
+  ASSERT_NE(std::string::npos, trace.find(" ATE0\\r\n"));
+  ASSERT_NE(std::string::npos, trace.find("+CPIN: READY\\r\\n"));
+
+  /* Replay trace with fresh emulator in strict mode; modem library must
+   * issue exactly same command sequence. */
+
+  emu.reset(new ModemEmulator());
+  ASSERT_TRUE(emu->LoadTrace("# recorded bring-up\n" + trace));
+
+  StartModem();
+  ASSERT_TRUE(RequestLevel(UBMODEM_LEVEL_GPRS, 30000));
+  ASSERT_TRUE(StopModem());
+  ASSERT_TRUE(emu->ReplayDone());
+  ASSERT_TRUE(emu->Errors().empty()) << emu->Errors().front();
+}
+
+TEST(ModemParser, Benchmark)
+{
+  uint64_t bytes_per_sec = 0;
+
+  ASSERT_EQ(OK, __ubmodem_parser_benchmark(&bytes_per_sec));
+  ASSERT_LT(0u, bytes_per_sec);
+
+  printf("[  METRIC  ] %s: %.1f %s\n", "parser_throughput_Bps",
+         (double)bytes_per_sec, "B/s");
+  testing::Test::RecordProperty("parser_throughput_Bps", (int)bytes_per_sec);
+}
+
+TEST(ModemEmulatorTrace, EscapeRoundTrip)
+{
+  std::string data("AT+USOWR=0,4\r@\x00\xff\\\n\t", 19);
+  std::string out;
+
+  ASSERT_EQ("AT+USOWR=0,4\\r@\\x00\\xff\\\\\\n\\t",
+            ModemEmulator::Escape(data));
+  ASSERT_TRUE(ModemEmulator::Unescape(ModemEmulator::Escape(data), &out));
+  ASSERT_EQ(data, out);
+  ASSERT_FALSE(ModemEmulator::Unescape("\\x4", &out));
+  ASSERT_FALSE(ModemEmulator::Unescape("\\q", &out));
+}
+
+TEST(ModemEmulatorTrace, RejectsMalformedTrace)
+{
+  ModemEmulator emu;
+
+  ASSERT_TRUE(emu.LoadTrace("# comment\n> 0 AT\\r\n< 5 \\r\\nOK\\r\\n\n"));
+  ASSERT_FALSE(emu.LoadTrace("> x\n"));
+  ASSERT_FALSE(emu.LoadTrace("! 0 AT\n"));
+  ASSERT_FALSE(emu.LoadTrace("> 0 \\z\n"));
+}
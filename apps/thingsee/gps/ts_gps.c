@@ -450,3 +450,21 @@ int ts_gps_set_aiding_params(bool const use_time,
                                  use_loc, latitude, longitude,
                                  altitude, accuracy);
 }
+
+/****************************************************************************
+ * Name: ts_gps_get_aiding_stats
+ *
+ * Description:
+ *   Get GPS time-to-first-fix and on-time statistics
+ *
+ * Input Parameters:
+ *   stats       - Pointer to statistics structure to fill
+ *
+ * Returned Values:
+ *   Status
+ *
+ ****************************************************************************/
+int ts_gps_get_aiding_stats(struct gps_aiding_stats_s * const stats)
+{
+  return ubgps_get_aiding_stats(stats);
+}
@@ -48,6 +48,7 @@
 #include <errno.h>
 #include <poll.h>
 #include <queue.h>
+#include <sched.h>
 #include <debug.h>
 #include <nuttx/clock.h>
 #include <arch/board/board.h>
@@ -64,6 +65,10 @@
 
 //#define TS_CORE_PERF_DEBUG
 
+/* Number of timers in timer selftest benchmark */
+
+#define TS_CORE_SELFTEST_NTIMERS        1024
+
 #ifdef TS_CORE_PERF_DEBUG
 #  define TS_CORE_PERF_FILES_LIMIT      90
 #  define TS_CORE_PERF_TIMERS_LIMIT     90
@@ -98,6 +103,17 @@
 
 #define TS_CORE_MIN_POLL_TIMEOUT_MSEC   100
 
+/* Timer ID is slot index in low 16 bits and slot generation in the upper
+ * 15 bits. Generation changes every time the slot is released, so stale
+ * IDs of expired/stopped timers do not match timers reusing the slot. */
+
+#define TS_CORE_TIMER_SLOT_BITS         16
+#define TS_CORE_TIMER_SLOT_MASK         ((1 << TS_CORE_TIMER_SLOT_BITS) - 1)
+#define TS_CORE_TIMER_GEN_MASK          0x7fff
+#define TS_CORE_TIMER_SLOT_NONE         TS_CORE_TIMER_SLOT_MASK
+#define TS_CORE_TIMER_MAX_SLOTS         TS_CORE_TIMER_SLOT_NONE
+#define TS_CORE_TIMER_MIN_SLOTS         16
+
 #ifndef ARRAY_SIZE
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
 #endif
@@ -123,6 +139,29 @@
 #  define deepsleep_dbg(...) ((void)0)
 #endif
 
+#ifdef CONFIG_THINGSEE_CORE_PROFILER
+#  define TS_CORE_PROF_NENTRIES         CONFIG_THINGSEE_CORE_PROFILER_ENTRIES
+#  define TS_CORE_PROF_BLOCK_MSEC       CONFIG_THINGSEE_CORE_PROFILER_BLOCK_MSEC
+
+/* Histogram buckets: <1 ms, then power-of-two millisecond ranges, last
+ * bucket collects everything from 1024 ms up. */
+
+#  define TS_CORE_PROF_NBUCKETS         12
+
+#  define prof_start(ts_core) \
+          ((ts_core)->prof.enabled ? prof_usec() : -1)
+#  define prof_end(ts_core, start, callback, reg_func_name) \
+          ((start) >= 0 ? \
+           prof_account(ts_core, start, callback, reg_func_name) : (void)0)
+#  define prof_count(ts_core, counter) \
+          ((void)((ts_core)->prof.enabled ? (ts_core)->prof.counter++ : 0))
+#else
+#  define prof_start(ts_core) ((int64_t)-1)
+#  define prof_end(ts_core, start, callback, reg_func_name) \
+          ((void)(start), (void)(callback), (void)(reg_func_name))
+#  define prof_count(ts_core, counter) ((void)0)
+#endif
+
 /****************************************************************************
  * Private Types
  ****************************************************************************/
@@ -149,14 +188,14 @@ struct file_s
 struct timer_flags_s
 {
   enum ts_timer_type_e type:4;    /* Timer type */
-  bool done:1;                    /* Timer done, and in done_timers sq */
+  bool done:1;                    /* Timer done, waiting to be freed */
 };
 
 /* Timer entry */
 
 struct timer_s
 {
-  /* Single linked list entry */
+  /* Single linked list entry (new_timers / done_timers) */
 
   sq_entry_t entry;
 
@@ -164,6 +203,14 @@ struct timer_s
 
   uint32_t id;
 
+  /* Position in active timer heap, -1 when not active */
+
+  int heap_index;
+
+  /* Activation order, for timers expiring at the same time */
+
+  uint32_t seq;
+
   /* Timer flags */
 
   struct timer_flags_s flags;
@@ -197,6 +244,67 @@ struct timer_s
   void * priv;
 };
 
+/* Timer ID slot */
+
+struct timer_slot_s
+{
+  /* Timer using this slot, NULL when slot is free */
+
+  struct timer_s *timer;
+
+  /* Slot generation, part of timer ID */
+
+  uint16_t generation;
+
+  /* Next free slot, when slot is free */
+
+  uint16_t next_free;
+};
+
+#ifdef CONFIG_THINGSEE_CORE_PROFILER
+/* Profiler entry, one per file registrant or timer callback */
+
+struct prof_entry_s
+{
+  /* Callback function */
+
+  const void *callback;
+
+  /* Name of function that registered file, NULL for timers. */
+
+  const char *reg_func_name;
+
+  /* Execution time statistics */
+
+  uint32_t count;
+  uint32_t nblocked;
+  uint32_t max_us;
+  uint64_t total_us;
+  uint32_t hist[TS_CORE_PROF_NBUCKETS];
+};
+
+/* Main loop profiler */
+
+struct prof_s
+{
+  volatile bool enabled;
+
+  /* Main loop iterations and what ended the wait in them */
+
+  uint32_t iterations;
+  uint32_t wake_files;
+  uint32_t wake_timeout;
+  uint32_t wake_deepsleep;
+
+  /* Callbacks not profiled as entry table was full */
+
+  uint32_t dropped;
+
+  unsigned int nentries;
+  struct prof_entry_s entries[TS_CORE_PROF_NENTRIES];
+};
+#endif
+
 /* Deep-sleep hook entry */
 
 struct deepsleep_hook_s
@@ -229,12 +337,23 @@ struct ts_core_s
   struct file_s files[TS_CORE_NFILES];
   struct pollfd pollfds[TS_CORE_NFILES];
 
-  /* Timer queues */
+  /* Active timers, binary min-heap ordered by expiry time. Heap has room
+   * for every timer that has an ID slot. */
+
+  struct timer_s **timers;
+  unsigned int ntimers;
+  uint32_t timer_seq;
+
+  /* Timer ID slots */
+
+  struct timer_slot_s *timer_slots;
+  unsigned int ntimer_slots;
+  uint16_t free_timer_slot;
+
+  /* Timers waiting for activation / to be freed */
 
-  sq_queue_t timers;
   sq_queue_t new_timers;
   sq_queue_t done_timers;
-  size_t heap_size;
 
   /* Deep-sleep hook queue */
 
@@ -259,6 +378,10 @@ struct ts_core_s
     uint32_t total;
   } elapsed;
 #endif /* TS_CORE_PERFORMANCE_DEBUG */
+
+#ifdef CONFIG_THINGSEE_CORE_PROFILER
+  struct prof_s prof;
+#endif
 };
 
 /****************************************************************************
@@ -340,6 +463,238 @@ static int64_t timespec_to_msec(const struct timespec *ts)
   return (int64_t)ts->tv_sec * 1000 + ts->tv_nsec / (1000 * 1000);
 }
 
+#ifdef CONFIG_THINGSEE_CORE_PROFILER
+/****************************************************************************
+ * Name: prof_usec
+ ****************************************************************************/
+static int64_t prof_usec(void)
+{
+  struct timespec ts;
+
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (int64_t)ts.tv_sec * USEC_PER_SEC + ts.tv_nsec / NSEC_PER_USEC;
+}
+
+/****************************************************************************
+ * Name: prof_account
+ *
+ * Description:
+ *   Account execution time of one callback to its profiler entry
+ *
+ ****************************************************************************/
+static void prof_account(struct ts_core_s * const ts_core, int64_t start,
+                         const void *callback, const char *reg_func_name)
+{
+  struct prof_s *prof = &ts_core->prof;
+  struct prof_entry_s *entry = NULL;
+  int64_t elapsed = prof_usec() - start;
+  uint32_t us = (elapsed > UINT32_MAX) ? UINT32_MAX : elapsed;
+  uint32_t ms = us / USEC_PER_MSEC;
+  unsigned int bucket;
+  unsigned int i;
+
+  for (i = 0; i < prof->nentries; i++)
+    {
+      if (prof->entries[i].callback == callback &&
+          prof->entries[i].reg_func_name == reg_func_name)
+        {
+          entry = &prof->entries[i];
+          break;
+        }
+    }
+
+  if (!entry)
+    {
+      if (prof->nentries >= TS_CORE_PROF_NENTRIES)
+        {
+          prof->dropped++;
+          return;
+        }
+
+      entry = &prof->entries[prof->nentries++];
+      memset(entry, 0, sizeof(*entry));
+      entry->callback = callback;
+      entry->reg_func_name = reg_func_name;
+    }
+
+  for (bucket = 0; ms && bucket < TS_CORE_PROF_NBUCKETS - 1; bucket++)
+    ms >>= 1;
+
+  entry->hist[bucket]++;
+  entry->count++;
+  entry->total_us += us;
+  if (us > entry->max_us)
+    entry->max_us = us;
+
+  if (us >= TS_CORE_PROF_BLOCK_MSEC * USEC_PER_MSEC)
+    {
+      entry->nblocked++;
+
+      dbg("%s callback %p blocked main loop for %u ms\n",
+          reg_func_name ? reg_func_name : "timer", callback,
+          us / USEC_PER_MSEC);
+    }
+}
+#endif /* CONFIG_THINGSEE_CORE_PROFILER */
+
+/****************************************************************************
+ * Name: timer_before
+ ****************************************************************************/
+static bool timer_before(const struct timer_s *a, const struct timer_s *b)
+{
+  int cmp = timespec_cmp(&a->date_expires, &b->date_expires);
+
+  if (cmp != 0)
+    return cmp < 0;
+
+  return (int32_t)(a->seq - b->seq) < 0;
+}
+
+/****************************************************************************
+ * Name: timer_heap_set
+ ****************************************************************************/
+static void timer_heap_set(struct ts_core_s * const ts_core, unsigned int pos,
+                           struct timer_s *timer)
+{
+  ts_core->timers[pos] = timer;
+  timer->heap_index = pos;
+}
+
+/****************************************************************************
+ * Name: timer_heap_sift_up
+ ****************************************************************************/
+static void timer_heap_sift_up(struct ts_core_s * const ts_core,
+                               unsigned int pos)
+{
+  struct timer_s *timer = ts_core->timers[pos];
+
+  while (pos > 0)
+    {
+      unsigned int parent = (pos - 1) / 2;
+
+      if (!timer_before(timer, ts_core->timers[parent]))
+        break;
+
+      timer_heap_set(ts_core, pos, ts_core->timers[parent]);
+      pos = parent;
+    }
+
+  timer_heap_set(ts_core, pos, timer);
+}
+
+/****************************************************************************
+ * Name: timer_heap_sift_down
+ ****************************************************************************/
+static void timer_heap_sift_down(struct ts_core_s * const ts_core,
+                                 unsigned int pos)
+{
+  struct timer_s *timer = ts_core->timers[pos];
+
+  while (true)
+    {
+      unsigned int child = pos * 2 + 1;
+
+      if (child >= ts_core->ntimers)
+        break;
+
+      if (child + 1 < ts_core->ntimers &&
+          timer_before(ts_core->timers[child + 1], ts_core->timers[child]))
+        child++;
+
+      if (!timer_before(ts_core->timers[child], timer))
+        break;
+
+      timer_heap_set(ts_core, pos, ts_core->timers[child]);
+      pos = child;
+    }
+
+  timer_heap_set(ts_core, pos, timer);
+}
+
+/****************************************************************************
+ * Name: timer_heap_insert
+ ****************************************************************************/
+static void timer_heap_insert(struct ts_core_s * const ts_core,
+                              struct timer_s *timer)
+{
+  DEBUGASSERT(ts_core->ntimers < ts_core->ntimer_slots);
+
+  timer->seq = ts_core->timer_seq++;
+  timer_heap_set(ts_core, ts_core->ntimers++, timer);
+  timer_heap_sift_up(ts_core, timer->heap_index);
+}
+
+/****************************************************************************
+ * Name: timer_heap_remove
+ ****************************************************************************/
+static void timer_heap_remove(struct ts_core_s * const ts_core,
+                              struct timer_s *timer)
+{
+  unsigned int pos = timer->heap_index;
+  struct timer_s *last;
+
+  DEBUGASSERT(pos < ts_core->ntimers);
+  DEBUGASSERT(ts_core->timers[pos] == timer);
+
+  last = ts_core->timers[--ts_core->ntimers];
+  timer->heap_index = -1;
+
+  if (last == timer)
+    return;
+
+  /* Move last timer to the hole and restore heap order. */
+
+  timer_heap_set(ts_core, pos, last);
+  timer_heap_sift_down(ts_core, pos);
+  if (last->heap_index == pos)
+    timer_heap_sift_up(ts_core, pos);
+}
+
+/****************************************************************************
+ * Name: timer_slot_release
+ ****************************************************************************/
+static void timer_slot_release(struct ts_core_s * const ts_core,
+                               struct timer_s *timer)
+{
+  unsigned int slot = (timer->id - TS_CORE_FIRST_TIMER_ID) &
+                      TS_CORE_TIMER_SLOT_MASK;
+  struct timer_slot_s *s = &ts_core->timer_slots[slot];
+
+  DEBUGASSERT(s->timer == timer);
+
+  s->timer = NULL;
+  s->generation++;
+  s->next_free = ts_core->free_timer_slot;
+  ts_core->free_timer_slot = slot;
+}
+
+/****************************************************************************
+ * Name: timer_lookup
+ ****************************************************************************/
+static struct timer_s *timer_lookup(struct ts_core_s * const ts_core,
+                                    const int timer_id)
+{
+  struct timer_slot_s *s;
+  unsigned int slot;
+  unsigned int generation;
+
+  if (timer_id < TS_CORE_FIRST_TIMER_ID)
+    return NULL;
+
+  slot = (timer_id - TS_CORE_FIRST_TIMER_ID) & TS_CORE_TIMER_SLOT_MASK;
+  generation = (timer_id - TS_CORE_FIRST_TIMER_ID) >> TS_CORE_TIMER_SLOT_BITS;
+
+  if (slot >= ts_core->ntimer_slots)
+    return NULL;
+
+  s = &ts_core->timer_slots[slot];
+  if (!s->timer || (s->generation & TS_CORE_TIMER_GEN_MASK) != generation)
+    return NULL;
+
+  return s->timer;
+}
+
 /****************************************************************************
  * Name: purge_timers
  ****************************************************************************/
@@ -362,20 +717,24 @@ static int execute_timer_callback(struct ts_core_s * const ts_core,
                                   struct timer_s *timer)
 {
   enum ts_timer_type_e type = timer->flags.type;
+  const void *callback = timer->callback;
+  int64_t prof_ts;
   int ret;
 
+  prof_ts = prof_start(ts_core);
+
   ret = (type == TS_TIMER_TYPE_DATE) ?
           timer->date_callback(timer->id, &timer->date_expires, timer->priv) :
           timer->callback(timer->id, timer->priv);
 
+  prof_end(ts_core, prof_ts, callback, NULL);
+
   if (timer->flags.done)
     {
       return ret; /* Timer deleted itself in callback. */
     }
 
-  /* Executed timer is always first of active queue (unless deleted itself). */
-
-  DEBUGASSERT(timer == (struct timer_s *)sq_peek(&ts_core->timers));
+  timer_heap_remove(ts_core, timer);
 
   if (type == TS_TIMER_TYPE_INTERVAL)
     {
@@ -383,19 +742,18 @@ static int execute_timer_callback(struct ts_core_s * const ts_core,
 
       timespec_add_msec(&timer->date_expires, timer->interval_ms);
 
-      /* Move to new queue for reinsertion to active queue. */
+      /* Move to new queue for reinsertion to active heap. */
 
-      sq_remfirst(&ts_core->timers);
       sq_addlast(&timer->entry, &ts_core->new_timers);
     }
   else
     {
       /* Deactivate timer, move to done queue. */
 
-      sq_remfirst(&ts_core->timers);
       sq_addlast(&timer->entry, &ts_core->done_timers);
 
       timer->flags.done = true;
+      timer_slot_release(ts_core, timer);
     }
 
   return ret;
@@ -419,18 +777,56 @@ static int execute_timer_callback(struct ts_core_s * const ts_core,
 static int ts_core_get_timer_id(struct ts_core_s * const ts_core,
                                 struct timer_s * new_timer)
 {
-  /* Convert timer object position in heap to timer_id. */
+  struct timer_slot_s *s;
+  unsigned int slot;
 
-  if (ts_core->heap_size <= 0)
+  if (ts_core->free_timer_slot == TS_CORE_TIMER_SLOT_NONE)
     {
-      struct mallinfo ml = mallinfo();
+      unsigned int nslots = ts_core->ntimer_slots * 2;
+      struct timer_slot_s *slots;
+      struct timer_s **timers;
+
+      if (nslots < TS_CORE_TIMER_MIN_SLOTS)
+        nslots = TS_CORE_TIMER_MIN_SLOTS;
+      if (nslots > TS_CORE_TIMER_MAX_SLOTS)
+        nslots = TS_CORE_TIMER_MAX_SLOTS;
+      if (nslots <= ts_core->ntimer_slots)
+        return ERROR;
 
-      ts_core->heap_size = ml.arena;
-      DEBUGASSERT(ts_core->heap_size > 0);
-      DEBUGASSERT(ts_core->heap_size < INT_MAX);
+      /* Grow active heap together with slots, so that activating timer
+       * never needs to allocate. */
+
+      timers = realloc(ts_core->timers, nslots * sizeof(*timers));
+      if (!timers)
+        return ERROR;
+      ts_core->timers = timers;
+
+      slots = realloc(ts_core->timer_slots, nslots * sizeof(*slots));
+      if (!slots)
+        return ERROR;
+      ts_core->timer_slots = slots;
+
+      /* Chain new slots to free list, lowest first. */
+
+      for (slot = nslots; slot-- > ts_core->ntimer_slots; )
+        {
+          slots[slot].timer = NULL;
+          slots[slot].generation = 0;
+          slots[slot].next_free = ts_core->free_timer_slot;
+          ts_core->free_timer_slot = slot;
+        }
+
+      ts_core->ntimer_slots = nslots;
     }
 
-  return ((uintptr_t)new_timer % (ts_core->heap_size)) + TS_CORE_FIRST_TIMER_ID;
+  slot = ts_core->free_timer_slot;
+  s = &ts_core->timer_slots[slot];
+
+  ts_core->free_timer_slot = s->next_free;
+  s->timer = new_timer;
+
+  return (((s->generation & TS_CORE_TIMER_GEN_MASK) << TS_CORE_TIMER_SLOT_BITS) |
+          slot) + TS_CORE_FIRST_TIMER_ID;
 }
 
 /****************************************************************************
@@ -461,11 +857,38 @@ static void dbg_timers(const char *qname, sq_queue_t *timer_queue)
 #endif
 }
 
+/****************************************************************************
+ * Name: dbg_active_timers
+ ****************************************************************************/
+static void dbg_active_timers(const char *qname,
+                              struct ts_core_s * const ts_core)
+{
+#ifdef TS_CORE_TIMERS_DEBUG
+  struct timespec curr_ts;
+  int64_t curr_msec;
+  unsigned int i;
+
+  clock_gettime(CLOCK_MONOTONIC, &curr_ts);
+  curr_msec = timespec_to_msec(&curr_ts);
+
+  /* Heap order, only first entry is guaranteed to be the next to expire. */
+
+  for (i = 0; i < ts_core->ntimers; i++)
+    {
+      struct timer_s *timer = ts_core->timers[i];
+      int64_t timer_msec = timespec_to_msec(&timer->date_expires);
+
+      dbg("[%s] %d: id=%d: expiry in %lld msec, type %d\n",
+          qname, i, timer->id, (timer_msec - curr_msec), timer->flags.type);
+    }
+#endif
+}
+
 /****************************************************************************
  * Name: ts_core_gc_timers
  *
  * Description:
- *   Garbage collect timer queue
+ *   Activate new timers and free completed timers
  *
  * Input Parameters:
  *   ts_core     - Pointer to Thingsee core library structure
@@ -473,60 +896,25 @@ static void dbg_timers(const char *qname, sq_queue_t *timer_queue)
  ****************************************************************************/
 static void ts_core_gc_timers(struct ts_core_s * const ts_core)
 {
-  struct timer_s *new_timer, *next_new_timer;
+  struct timer_s *new_timer;
 
   DEBUGASSERT(ts_core != NULL);
 
-  /* Insert new timers to active queue. */
+  /* Insert new timers to active heap. */
 
-  new_timer = (struct timer_s *)sq_peek(&ts_core->new_timers);
-  while (new_timer)
+  while ((new_timer = (struct timer_s *)sq_remfirst(&ts_core->new_timers)))
     {
-      struct timer_s *prev, *active;
-
-      next_new_timer = (struct timer_s *)sq_next(&new_timer->entry);
-
-      DEBUGASSERT(new_timer == (struct timer_s *)sq_peek(&ts_core->new_timers));
-      sq_remfirst(&ts_core->new_timers);
-
-      /* Ordered insert to active timer queue. */
-
-      active = (struct timer_s *)sq_peek(&ts_core->timers);
-      if (!active)
-        {
-          sq_addfirst(&new_timer->entry, &ts_core->timers);
-        }
-      else
+      if (new_timer->flags.done)
         {
-          if (timespec_cmp(&new_timer->date_expires,
-                           &active->date_expires) < 0)
-            {
-              sq_addfirst(&new_timer->entry, &ts_core->timers);
-            }
-          else
-            {
-              while (true)
-                {
-                  prev = active;
-                  active = (struct timer_s *)sq_next(&active->entry);
-
-                  if (!active || timespec_cmp(&new_timer->date_expires,
-                                              &active->date_expires) < 0)
-                    {
-                      break;
-                    }
-                }
-
-              sq_addafter(&prev->entry, &new_timer->entry,
-                          &ts_core->timers);
-            }
+          /* Stopped before it got activated. */
+
+          free(new_timer);
+          continue;
         }
 
-      new_timer = next_new_timer;
+      timer_heap_insert(ts_core, new_timer);
     }
 
-  DEBUGASSERT(sq_peek(&ts_core->new_timers) == NULL);
-
   /* Free completed timers. */
 
   dbg_timers("gc done", &ts_core->done_timers);
@@ -535,7 +923,7 @@ static void ts_core_gc_timers(struct ts_core_s * const ts_core)
 
   /* Debug print. */
 
-  dbg_timers("gc active", &ts_core->timers);
+  dbg_active_timers("gc active", ts_core);
 }
 
 /****************************************************************************
@@ -554,16 +942,18 @@ static void ts_core_gc_timers(struct ts_core_s * const ts_core)
  ****************************************************************************/
 static int ts_core_timer_get_timeout(struct ts_core_s * const ts_core)
 {
-  struct timer_s * timer = (struct timer_s *)sq_peek(&ts_core->timers);
+  struct timer_s * timer;
   struct timespec curr_ts;
   int timeout_ms = -1;
   int64_t curr_msec;
   int64_t timer_msec;
   int ret;
 
-  if (!timer)
+  if (!ts_core->ntimers)
     return timeout_ms;
 
+  timer = ts_core->timers[0];
+
   /* Get current time. */
 
   ret = clock_gettime(CLOCK_MONOTONIC, &curr_ts);
@@ -586,7 +976,7 @@ static int ts_core_timer_get_timeout(struct ts_core_s * const ts_core)
     }
   else
     {
-      /* First timer in active timer queue expires first. */
+      /* First timer in active timer heap expires first. */
 
       if (timer_msec - curr_msec <= INT_MAX)
         timeout_ms = timer_msec - curr_msec;
@@ -596,7 +986,7 @@ static int ts_core_timer_get_timeout(struct ts_core_s * const ts_core)
 
   /* Debug print. */
 
-  dbg_timers("timeout active", &ts_core->timers);
+  dbg_active_timers("timeout active", ts_core);
 
   return timeout_ms;
 }
@@ -619,15 +1009,17 @@ static int ts_core_process_timers(struct ts_core_s * const ts_core)
 
   /* Debug print. */
 
-  dbg_timers("pre active ", &ts_core->timers);
+  dbg_active_timers("pre active ", ts_core);
 
-  /* Get next timer from queue, use peek since timers queue might have
-   * been modified (entries removed) in timer callback. */
+  /* Get next timer from heap, re-read top since heap might have been
+   * modified (entries removed) in timer callback. */
 
-  while ((timer = (struct timer_s *)sq_peek(&ts_core->timers)) != NULL)
+  while (ts_core->ntimers > 0)
     {
       int ret;
 
+      timer = ts_core->timers[0];
+
       DEBUGASSERT(timer->flags.type >= 0);
       DEBUGASSERT(timer->flags.type < TS_TIMER_TYPE_MAX);
 
@@ -665,7 +1057,7 @@ static int ts_core_process_timers(struct ts_core_s * const ts_core)
 
   /* Debug print. */
 
-  dbg_timers("post active", &ts_core->timers);
+  dbg_active_timers("post active", ts_core);
   dbg_timers("post new   ", &ts_core->new_timers);
   dbg_timers("post done  ", &ts_core->done_timers);
 
@@ -955,6 +1347,10 @@ static int ts_core_process(struct ts_core_s *const ts_core)
 
   time_deepslept = ts_core_deepsleep(ts_core);
 
+  prof_count(ts_core, iterations);
+  if (time_deepslept > 0)
+    prof_count(ts_core, wake_deepsleep);
+
   /* Get timeout to next timer */
 
   timeout_ms = ts_core_timer_get_timeout(ts_core);
@@ -1006,6 +1402,11 @@ static int ts_core_process(struct ts_core_s *const ts_core)
 
       nrevents = ret;
 
+      if (nrevents > 0)
+        prof_count(ts_core, wake_files);
+      else if (nrevents == 0)
+        prof_count(ts_core, wake_timeout);
+
       for (i = 0; nrevents > 0 && i < ts_core->nfiles; i++)
         {
           file = &ts_core->files[i];
@@ -1016,13 +1417,18 @@ static int ts_core_process(struct ts_core_s *const ts_core)
           if (pfd->revents != 0 && file->callback != NULL && pfd->fd >= 0)
             {
               int fd = pfd->fd;
+              ts_fd_callback_t callback = file->callback;
+              const char *reg_func_name = file->reg_func_name;
+              int64_t prof_ts;
 
               perf_dbg_start_ticks(ts_core);
+              prof_ts = prof_start(ts_core);
 
               /* Execute file descriptor callback */
 
-              ret = file->callback(pfd, file->priv);
+              ret = callback(pfd, file->priv);
 
+              prof_end(ts_core, prof_ts, callback, reg_func_name);
               perf_dbg_add_elapsed_ticks(ts_core, files);
 
               if (ret < 0)
@@ -1053,6 +1459,8 @@ static int ts_core_process(struct ts_core_s *const ts_core)
       /* Sleep given time */
 
       usleep(timeout_ms * USEC_PER_MSEC);
+
+      prof_count(ts_core, wake_timeout);
     }
 
   /* Process timers */
@@ -1091,6 +1499,7 @@ static int __ts_core_timer_setup(const ts_timer_type_t type,
 {
   struct ts_core_s * ts_core = &g_ts_core;
   struct timer_s * timer;
+  int ret;
 
   /* Check input parameters */
 
@@ -1109,7 +1518,17 @@ static int __ts_core_timer_setup(const ts_timer_type_t type,
 
   /* Setup interval timer */
 
-  timer->id = ts_core_get_timer_id(ts_core, timer);
+  ret = ts_core_get_timer_id(ts_core, timer);
+  if (ret < 0)
+    {
+      free(timer);
+      set_errno(ENOMEM);
+
+      return ERROR;
+    }
+
+  timer->id = ret;
+  timer->heap_index = -1;
   timer->flags.type = type;
 
   if (type == TS_TIMER_TYPE_DATE)
@@ -1129,7 +1548,7 @@ static int __ts_core_timer_setup(const ts_timer_type_t type,
     }
   timer->priv = priv;
 
-  /* Add timer to new timers queue */
+  /* Add timer to new timers queue, activated on next garbage collect */
 
   sq_addlast(&timer->entry, &ts_core->new_timers);
 
@@ -1165,7 +1584,11 @@ int ts_core_initialize(void)
 
   /* Initialize timer queues */
 
-  sq_init(&ts_core->timers);
+  ts_core->timers = NULL;
+  ts_core->ntimers = 0;
+  ts_core->timer_slots = NULL;
+  ts_core->ntimer_slots = 0;
+  ts_core->free_timer_slot = TS_CORE_TIMER_SLOT_NONE;
   sq_init(&ts_core->new_timers);
   sq_init(&ts_core->done_timers);
 
@@ -1210,10 +1633,18 @@ int ts_core_deinitialize(void)
 
   /* Free timers */
 
-  purge_timers(&ts_core->timers);
+  while (ts_core->ntimers > 0)
+    free(ts_core->timers[--ts_core->ntimers]);
   purge_timers(&ts_core->new_timers);
   purge_timers(&ts_core->done_timers);
 
+  free(ts_core->timers);
+  ts_core->timers = NULL;
+  free(ts_core->timer_slots);
+  ts_core->timer_slots = NULL;
+  ts_core->ntimer_slots = 0;
+  ts_core->free_timer_slot = TS_CORE_TIMER_SLOT_NONE;
+
   ts_core->deepsleep_watchdog_timer = -1;
 
   return OK;
@@ -1501,13 +1932,6 @@ int __ts_core_timer_stop(const int timer_id)
 {
   struct ts_core_s * ts_core = &g_ts_core;
   struct timer_s * timer;
-  int i;
-  sq_queue_t *timer_queues[] =
-    {
-      &ts_core->timers,
-      &ts_core->new_timers,
-      NULL,
-    };
 
   /* Check input parameters */
 
@@ -1518,40 +1942,29 @@ int __ts_core_timer_stop(const int timer_id)
       return ERROR;
     }
 
-  for (i = 0; timer_queues[i]; i++)
+  timer = timer_lookup(ts_core, timer_id);
+  if (!timer || timer->flags.done)
     {
-      struct timer_s * prev = NULL;
-
-      timer = (struct timer_s *)sq_peek(timer_queues[i]);
-      while (timer)
-        {
-          if (timer->id == timer_id)
-            {
-              /* Remove timer from active/new queue */
-
-              if (prev)
-                sq_remafter(&prev->entry, timer_queues[i]);
-              else
-                sq_remfirst(timer_queues[i]);
-
-              /* Add timer to completed/'to-be-freed' queue */
-
-              sq_addlast(&timer->entry, &ts_core->done_timers);
-              timer->flags.done = true;
+      set_errno(EINVAL);
 
-              return OK;
-            }
+      return ERROR;
+    }
 
-          /* Move to next timer */
+  if (timer->heap_index >= 0)
+    {
+      /* Remove timer from active heap, add to completed/'to-be-freed'
+       * queue. */
 
-          prev = timer;
-          timer = (struct timer_s *)sq_next(&timer->entry);
-        }
+      timer_heap_remove(ts_core, timer);
+      sq_addlast(&timer->entry, &ts_core->done_timers);
     }
 
-  set_errno(EINVAL);
+  /* Timer still in new queue is freed when new queue is processed. */
 
-  return ERROR;
+  timer->flags.done = true;
+  timer_slot_release(ts_core, timer);
+
+  return OK;
 }
 
 /****************************************************************************
@@ -1766,6 +2179,114 @@ bool ts_core_is_date_before_compile_date(time_t ctime)
   return false; /* Current day same as compile day. */
 }
 
+#ifdef CONFIG_THINGSEE_CORE_PROFILER
+/****************************************************************************
+ * Name: ts_core_profiler_enable
+ *
+ * Description:
+ *   Start or stop collecting main loop profiling data. Collected data is
+ *   kept when profiler is stopped.
+ *
+ * Input Parameters:
+ *   enable - true to start, false to stop profiling
+ *
+ ****************************************************************************/
+void ts_core_profiler_enable(bool enable)
+{
+  g_ts_core.prof.enabled = enable;
+}
+
+/****************************************************************************
+ * Name: ts_core_profiler_reset
+ *
+ * Description:
+ *   Clear collected main loop profiling data
+ *
+ ****************************************************************************/
+void ts_core_profiler_reset(void)
+{
+  struct prof_s *prof = &g_ts_core.prof;
+  bool enabled = prof->enabled;
+
+  sched_lock();
+  memset(prof, 0, sizeof(*prof));
+  prof->enabled = enabled;
+  sched_unlock();
+}
+
+/****************************************************************************
+ * Name: ts_core_profiler_dump
+ *
+ * Description:
+ *   Print collected main loop profiling data
+ *
+ * Input Parameters:
+ *   stream - Output stream
+ *
+ * Returned Value:
+ *   0 (OK) means the function was executed successfully
+ *  -1 (ERROR) means the function was executed unsuccessfully. Check value of
+ *  errno for more details.
+ *
+ ****************************************************************************/
+int ts_core_profiler_dump(FILE *stream)
+{
+  struct prof_s *prof;
+  unsigned int i;
+  unsigned int b;
+
+  /* Take snapshot, main loop may be updating profile concurrently. */
+
+  prof = malloc(sizeof(*prof));
+  if (!prof)
+    {
+      set_errno(ENOMEM);
+
+      return ERROR;
+    }
+
+  sched_lock();
+  memcpy(prof, &g_ts_core.prof, sizeof(*prof));
+  sched_unlock();
+
+  fprintf(stream, "ts_core profiler %s: %u iterations\n",
+          prof->enabled ? "running" : "stopped", prof->iterations);
+  fprintf(stream, "wakeups: files %u, timeout %u, deep-sleep %u\n",
+          prof->wake_files, prof->wake_timeout, prof->wake_deepsleep);
+  fprintf(stream, "blocking threshold %d ms, %u calls not profiled\n",
+          TS_CORE_PROF_BLOCK_MSEC, prof->dropped);
+
+  fprintf(stream, "\n%-10s %-32s %7s %8s %8s %5s\n", "callback", "registrant",
+          "count", "avg us", "max us", "block");
+
+  for (i = 0; i < prof->nentries; i++)
+    {
+      struct prof_entry_s *entry = &prof->entries[i];
+
+      fprintf(stream, "%-10p %-32s %7u %8u %8u %5u\n", entry->callback,
+              entry->reg_func_name ? entry->reg_func_name : "timer",
+              entry->count, (unsigned int)(entry->total_us / entry->count),
+              entry->max_us, entry->nblocked);
+
+      /* Histogram, bucket n counts calls taking [2^(n-1), 2^n) ms. */
+
+      fprintf(stream, "  ms:");
+      for (b = 0; b < TS_CORE_PROF_NBUCKETS; b++)
+        {
+          if (b < TS_CORE_PROF_NBUCKETS - 1)
+            fprintf(stream, " <%u:%u", 1 << b, entry->hist[b]);
+          else
+            fprintf(stream, " >=%u:%u", 1 << (b - 1), entry->hist[b]);
+        }
+      fprintf(stream, "\n");
+    }
+
+  free(prof);
+
+  return OK;
+}
+#endif /* CONFIG_THINGSEE_CORE_PROFILER */
+
 /****************************************************************************
  * Name: ts_core_mainloop
  *
@@ -1858,6 +2379,126 @@ static int ts_core_timer_selftest_date_cb(const int timer_id,
   return OK;
 }
 
+/****************************************************************************
+ * Name: ts_core_timer_selftest_check_heap
+ *
+ * Description:
+ *   Check that active timer heap is ordered and timers know their position
+ *
+ ****************************************************************************/
+static void ts_core_timer_selftest_check_heap(struct ts_core_s * const ts_core)
+{
+  unsigned int i;
+
+  for (i = 0; i < ts_core->ntimers; i++)
+    {
+      DEBUGASSERT(ts_core->timers[i]->heap_index == i);
+      DEBUGASSERT(!ts_core->timers[i]->flags.done);
+      DEBUGASSERT(i == 0 ||
+                  !timer_before(ts_core->timers[i],
+                                ts_core->timers[(i - 1) / 2]));
+    }
+}
+
+/****************************************************************************
+ * Name: ts_core_timer_selftest_usec
+ ****************************************************************************/
+static int64_t ts_core_timer_selftest_usec(void)
+{
+  struct timespec ts;
+
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (int64_t)ts.tv_sec * USEC_PER_SEC + ts.tv_nsec / NSEC_PER_USEC;
+}
+
+/****************************************************************************
+ * Name: ts_core_timer_selftest_bench
+ *
+ * Description:
+ *   Setup, activate and stop large number of timers, check heap order on
+ *   the way and report time spent in each phase.
+ *
+ ****************************************************************************/
+static void ts_core_timer_selftest_bench(void)
+{
+  struct ts_core_s * ts_core = &g_ts_core;
+  bool cb_ok = false;
+  uint32_t rand = 1;
+  int64_t t_setup, t_gc, t_stop;
+  int64_t start;
+  int *ids;
+  int ret;
+  int i;
+
+  (void)ret;
+
+  ids = malloc(TS_CORE_SELFTEST_NTIMERS * sizeof(*ids));
+  DEBUGASSERT(ids);
+  if (!ids)
+    return;
+
+  /* Setup timers with pseudo-random timeouts well in the future. */
+
+  start = ts_core_timer_selftest_usec();
+
+  for (i = 0; i < TS_CORE_SELFTEST_NTIMERS; i++)
+    {
+      rand = rand * 1103515245 + 12345;
+
+      ids[i] = ts_core_timer_setup(TS_TIMER_TYPE_TIMEOUT,
+                                   60 * MSEC_PER_SEC + (rand >> 16) % 60000,
+                                   ts_core_timer_selftest_cb, &cb_ok);
+      DEBUGASSERT(ids[i] >= TS_CORE_FIRST_TIMER_ID);
+    }
+
+  t_setup = ts_core_timer_selftest_usec() - start;
+
+  /* Activate. */
+
+  start = ts_core_timer_selftest_usec();
+  ts_core_gc_timers(ts_core);
+  t_gc = ts_core_timer_selftest_usec() - start;
+
+  DEBUGASSERT(ts_core->ntimers == TS_CORE_SELFTEST_NTIMERS);
+  ts_core_timer_selftest_check_heap(ts_core);
+
+  /* Stop every other timer, then the rest. */
+
+  start = ts_core_timer_selftest_usec();
+
+  for (i = 0; i < TS_CORE_SELFTEST_NTIMERS; i += 2)
+    {
+      ret = ts_core_timer_stop(ids[i]);
+      DEBUGASSERT(ret == OK);
+    }
+
+  DEBUGASSERT(ts_core->ntimers == TS_CORE_SELFTEST_NTIMERS / 2);
+  ts_core_timer_selftest_check_heap(ts_core);
+
+  for (i = 1; i < TS_CORE_SELFTEST_NTIMERS; i += 2)
+    {
+      ret = ts_core_timer_stop(ids[i]);
+      DEBUGASSERT(ret == OK);
+    }
+
+  t_stop = ts_core_timer_selftest_usec() - start;
+
+  DEBUGASSERT(ts_core->ntimers == 0);
+  ret = ts_core_timer_stop(ids[0]);
+  DEBUGASSERT(ret == ERROR);
+
+  ts_core_gc_timers(ts_core);
+  DEBUGASSERT(sq_peek(&ts_core->done_timers) == NULL);
+  DEBUGASSERT(cb_ok == false);
+
+  printf("ts_core: %d timers: setup %lld us, activate %lld us, stop %lld us\n",
+         TS_CORE_SELFTEST_NTIMERS, (long long)t_setup, (long long)t_gc,
+         (long long)t_stop);
+
+  free(ids);
+}
+
 /****************************************************************************
  * Name: ts_core_timer_selftest
  *
@@ -1876,10 +2517,14 @@ static void ts_core_timer_selftest(void)
   bool interval_cb_ok = false;
   int date_id;
   bool date_cb_ok = false;
+  int reuse_id;
+  int ret;
+
+  (void)ret;
 
   /* Check that there are no timers registered */
 
-  DEBUGASSERT(sq_peek(&ts_core->timers) == NULL);
+  DEBUGASSERT(ts_core->ntimers == 0);
   DEBUGASSERT(sq_peek(&ts_core->new_timers) == NULL);
 
   /* Setup timeout timer */
@@ -1888,9 +2533,8 @@ static void ts_core_timer_selftest(void)
                                    1 * MSEC_PER_TICK,
                                    ts_core_timer_selftest_cb,
                                    &timeout_cb_ok);
-  DEBUGASSERT(ts_core->heap_size > 0);
   DEBUGASSERT(timeout_id >= TS_CORE_FIRST_TIMER_ID);
-  DEBUGASSERT(timeout_id < TS_CORE_FIRST_TIMER_ID + ts_core->heap_size);
+  DEBUGASSERT(timer_lookup(ts_core, timeout_id) != NULL);
 
   /* Setup interval timer */
 
@@ -1899,7 +2543,6 @@ static void ts_core_timer_selftest(void)
                                     ts_core_timer_selftest_cb,
                                     &interval_cb_ok);
   DEBUGASSERT(interval_id >= TS_CORE_FIRST_TIMER_ID);
-  DEBUGASSERT(interval_id < TS_CORE_FIRST_TIMER_ID + ts_core->heap_size);
   DEBUGASSERT(interval_id != timeout_id);
 
   /* Setup date timer */
@@ -1910,7 +2553,6 @@ static void ts_core_timer_selftest(void)
                                      ts_core_timer_selftest_date_cb,
                                      &date_cb_ok);
   DEBUGASSERT(date_id >= TS_CORE_FIRST_TIMER_ID);
-  DEBUGASSERT(date_id < TS_CORE_FIRST_TIMER_ID + ts_core->heap_size);
   DEBUGASSERT(date_id != timeout_id);
   DEBUGASSERT(date_id != interval_id);
 
@@ -1919,6 +2561,7 @@ static void ts_core_timer_selftest(void)
   timer = (struct timer_s *)sq_peek(&ts_core->new_timers);
   DEBUGASSERT(timer);
   DEBUGASSERT(timer->flags.type == TS_TIMER_TYPE_TIMEOUT);
+  DEBUGASSERT(timer->heap_index == -1);
 
   /* Check interval timer */
 
@@ -1935,33 +2578,21 @@ static void ts_core_timer_selftest(void)
   timer = (struct timer_s *)sq_next(&timer->entry);
   DEBUGASSERT(!timer);
 
-  /* Clear 'is_new' mark. */
+  /* Activate new timers. */
 
   ts_core_gc_timers(ts_core);
 
   timer = (struct timer_s *)sq_peek(&ts_core->new_timers);
   DEBUGASSERT(!timer);
 
-  /* Check timeout timer */
-
-  timer = (struct timer_s *)sq_peek(&ts_core->timers);
-  DEBUGASSERT(timer);
-  DEBUGASSERT(timer->flags.type == TS_TIMER_TYPE_TIMEOUT);
-
-  /* Check interval timer */
-
-  timer = (struct timer_s *)sq_next(&timer->entry);
-  DEBUGASSERT(timer);
-  DEBUGASSERT(timer->flags.type == TS_TIMER_TYPE_INTERVAL);
-
-  /* Check date timer */
-
-  timer = (struct timer_s *)sq_next(&timer->entry);
-  DEBUGASSERT(timer);
-  DEBUGASSERT(timer->flags.type == TS_TIMER_TYPE_DATE);
+  /* Timeout timer expires first, interval and date timer expire at same
+   * time in order of setup. */
 
-  timer = (struct timer_s *)sq_next(&timer->entry);
-  DEBUGASSERT(!timer);
+  DEBUGASSERT(ts_core->ntimers == 3);
+  ts_core_timer_selftest_check_heap(ts_core);
+  DEBUGASSERT(ts_core->timers[0]->flags.type == TS_TIMER_TYPE_TIMEOUT);
+  DEBUGASSERT(timer_before(timer_lookup(ts_core, interval_id),
+                           timer_lookup(ts_core, date_id)));
 
   /* Wait for timers to expire */
 
@@ -2001,8 +2632,7 @@ static void ts_core_timer_selftest(void)
   timer = (struct timer_s *)sq_next(&timer->entry);
   DEBUGASSERT(!timer);
 
-  timer = (struct timer_s *)sq_peek(&ts_core->timers);
-  DEBUGASSERT(!timer);
+  DEBUGASSERT(ts_core->ntimers == 0);
 
   /* Garbage collect non-active timers */
 
@@ -2012,21 +2642,36 @@ static void ts_core_timer_selftest(void)
   DEBUGASSERT(!timer);
   timer = (struct timer_s *)sq_peek(&ts_core->done_timers);
   DEBUGASSERT(!timer);
-  timer = (struct timer_s *)sq_peek(&ts_core->timers);
-  DEBUGASSERT(timer);
-  DEBUGASSERT(timer->flags.type == TS_TIMER_TYPE_INTERVAL);
+  DEBUGASSERT(ts_core->ntimers == 1);
+  DEBUGASSERT(ts_core->timers[0]->flags.type == TS_TIMER_TYPE_INTERVAL);
 
   /* Try to stop timeout timer, which has already been removed */
 
-  DEBUGASSERT(ts_core_timer_stop(timeout_id) == ERROR);
+  ret = ts_core_timer_stop(timeout_id);
+  DEBUGASSERT(ret == ERROR);
 
-  /* Stop interval timer */
+  /* New timer reuses slot of expired timer, but not its ID */
+
+  reuse_id = ts_core_timer_setup(TS_TIMER_TYPE_TIMEOUT, MSEC_PER_SEC,
+                                 ts_core_timer_selftest_cb, &timeout_cb_ok);
+  DEBUGASSERT(reuse_id >= TS_CORE_FIRST_TIMER_ID);
+  DEBUGASSERT(reuse_id != timeout_id);
+  ret = ts_core_timer_stop(timeout_id);
+  DEBUGASSERT(ret == ERROR);
+  ret = ts_core_timer_stop(date_id);
+  DEBUGASSERT(ret == ERROR);
+
+  /* Stop timer before it was activated */
 
-  DEBUGASSERT(ts_core_timer_stop(interval_id) == OK);
+  ret = ts_core_timer_stop(reuse_id);
+  DEBUGASSERT(ret == OK);
+  ret = ts_core_timer_stop(reuse_id);
+  DEBUGASSERT(ret == ERROR);
 
-  /* Try to stop date timer, which has already been removed */
+  /* Stop interval timer */
 
-  DEBUGASSERT(ts_core_timer_stop(date_id) == ERROR);
+  ret = ts_core_timer_stop(interval_id);
+  DEBUGASSERT(ret == OK);
 
   /* Garbage collect non-active timers */
 
@@ -2034,9 +2679,13 @@ static void ts_core_timer_selftest(void)
 
   /* Check that there are no timers registered */
 
-  DEBUGASSERT(sq_peek(&ts_core->timers) == NULL);
+  DEBUGASSERT(ts_core->ntimers == 0);
   DEBUGASSERT(sq_peek(&ts_core->new_timers) == NULL);
   DEBUGASSERT(sq_peek(&ts_core->done_timers) == NULL);
+
+  /* Many timers */
+
+  ts_core_timer_selftest_bench();
 }
 
 /****************************************************************************
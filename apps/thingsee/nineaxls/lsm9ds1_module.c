@@ -720,6 +720,60 @@ int nineax_lsm9ds1_read_all(int16_t data[static 9])
   return OK;
 }
 
+/****************************************************************************
+ * Name: nineax_lsm9ds1_read_fifo
+ *
+ * Description:
+ *  Reads all samples stored in gyro and accelerometer FIFO, with
+ *  magnetometer value read alongside each of them.
+ *
+ * Input Parameters:
+ *  max_samples - capacity of data array
+ *
+ * Output Parameters:
+ *  data - samples in nineax_lsm9ds1_read_all() format
+ *
+ * Returned Values:
+ *   On success returns number of samples read, at least one. On Error
+ *   returns -1
+ *
+ ****************************************************************************/
+
+int nineax_lsm9ds1_read_fifo(int16_t (*data)[9], int max_samples)
+{
+  int ret;
+  int nsamples;
+  lsm9ds1_gyro_status_t int_info;
+
+  ret = ioctl(sensor.fd, LSM9DS1_IOC_READ_STATUS_GYRO, (unsigned int)&int_info);
+  if (ret < 0)
+    {
+      return ERROR;
+    }
+
+  /* FIFO_SRC holds number of unread samples in FSS bits. Read at least one,
+   * as in bypass mode or on empty FIFO output registers hold latest sample.
+   */
+
+  nsamples = int_info.fifo_src_data & NINEAX_LSM9DS1_FIFO_SRC_FSS_MASK;
+  if (nsamples < 1)
+    {
+      nsamples = 1;
+    }
+  else if (nsamples > max_samples)
+    {
+      nsamples = max_samples;
+    }
+
+  ret = read(sensor.fd, (char *)data, nsamples * 9 * sizeof(int16_t));
+  if (ret != nsamples * 9 * sizeof(int16_t))
+    {
+      return ERROR;
+    }
+
+  return nsamples;
+}
+
 /****************************************************************************
  * Name: nineax_lsm9ds1_read_resolutions
  *
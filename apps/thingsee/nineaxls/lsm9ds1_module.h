@@ -39,6 +39,13 @@
 #  define NINEAX_MAG_VALID_ID                   0x3D
 #  define NINEAX_GYRO_ACC_VALID_ID              0x68
 
+/* Gyro and accelerometer FIFO depth, and mask of stored sample count in
+ * FIFO_SRC register.
+ */
+
+#  define NINEAX_LSM9DS1_FIFO_DEPTH             32
+#  define NINEAX_LSM9DS1_FIFO_SRC_FSS_MASK      0x3F
+
 /****************************************************************************
  * Name: nineax_lsm9ds1_who_am_i
  *
@@ -279,6 +286,27 @@ int nineax_lsm9ds1_load_bias_from_eeprom(int16_t bias[static 9]);
 
 int nineax_lsm9ds1_read_all(int16_t data[static 9]);
 
+/****************************************************************************
+ * Name: nineax_lsm9ds1_read_fifo
+ *
+ * Description:
+ *  Reads all samples stored in gyro and accelerometer FIFO, with
+ *  magnetometer value read alongside each of them.
+ *
+ * Input Parameters:
+ *  max_samples - capacity of data array
+ *
+ * Output Parameters:
+ *  data - samples in nineax_lsm9ds1_read_all() format
+ *
+ * Returned Values:
+ *   On success returns number of samples read, at least one. On Error
+ *   returns -1
+ *
+ ****************************************************************************/
+
+int nineax_lsm9ds1_read_fifo(int16_t (*data)[9], int max_samples);
+
 /****************************************************************************
  * Name: nineax_lsm9ds1_read_resolutions
  *
@@ -37,6 +37,8 @@
 #include <stdbool.h>
 #include <sys/types.h>
 #include <math.h>
+#include <string.h>
+#include <assert.h>
 #include <debug.h>
 #include <nuttx/clock.h>
 
@@ -50,6 +52,21 @@
  */
 static float ts_device_declination = +10.28333333f;
 
+#ifdef CONFIG_THINGSEE_NINEAXELS_FUSION_FIXED
+
+/* Longest sample interval accepted for batch update. Longer gaps, like the
+ * one before first batch, would overflow fixed-point gyro step.
+ */
+#define FUSION_BATCH_MAX_DT_MSEC 1000
+
+/* Fixed-point fusion state for batch updates. */
+static struct ts_nineaxls_fusion_q ts_fusion_q =
+{
+  .q = { TS_FUSION_Q_ONE, 0, 0, 0 }
+};
+
+#endif
+
 
 /* Update sensor fusion internal state from sensor raw data and calibration. */
 int ts_nineaxls_fusion_update(float gx, float gy, float gz,
@@ -111,6 +128,82 @@ int ts_nineaxls_fusion_update(float gx, float gy, float gz,
   return ret;
 }
 
+#ifdef CONFIG_THINGSEE_NINEAXELS_FUSION_FIXED
+
+/* Configure batch update with gyro resolution in dps per LSB and raw gyro
+ * and accelerometer biases. Gyro rate in Q43 fits int32_t only for
+ * LSM9DS1_GYRO_SCALE_245DPS, wider scales are not supported.
+ */
+void ts_nineaxls_fusion_config_batch(float gyro_reso, const int16_t bias[6])
+{
+  float rate = gyro_reso * (M_PI / 180.0f) * (float)(1LL << TS_FUSION_GYRO_Q);
+
+  DEBUGASSERT(rate > 0.0f && rate + 0.5f < (float)INT32_MAX);
+
+  ts_fusion_q.gyro_rate = (int32_t)(rate + 0.5f);
+  memcpy(ts_fusion_q.bias, bias, sizeof(ts_fusion_q.bias));
+}
+
+/* Update sensor fusion internal state from a block of raw samples read from
+ * sensor FIFO, each of gyro, accelerometer and magnetometer x, y and z.
+ * Samples are assumed evenly spaced over the time since previous block.
+ */
+int ts_nineaxls_fusion_update_batch(const int16_t (*data)[9], int nsamples)
+{
+  int ret = OK;
+  static systime_t ltick = 0;
+  static bool started = false;
+  systime_t ctick;
+  uint32_t msec;
+
+  if (nsamples <= 0)
+    {
+      return OK;
+    }
+
+  /* For integration in filter algo. First block has no start time and
+   * only gets corrected by reference vectors.
+   */
+
+  ctick = clock_systimer();
+  msec = started ? (ctick - ltick) * MSEC_PER_TICK : 0;
+  ltick = ctick;
+  started = true;
+
+  if (msec > FUSION_BATCH_MAX_DT_MSEC * nsamples)
+    {
+      msec = FUSION_BATCH_MAX_DT_MSEC * nsamples;
+    }
+
+  ts_fusion_q.dt = (int32_t)((((int64_t)msec << TS_FUSION_Q) / 1000) / nsamples);
+
+#if defined(CONFIG_THINGSEE_NINEAXELS_FUSION_MADGWICK)
+  ret = ts_sensor_update_madgwick_q(&ts_fusion_q, data, nsamples);
+#elif defined(CONFIG_THINGSEE_NINEAXELS_FUSION_MAHONY)
+  ret = ts_sensor_update_mahony_q(&ts_fusion_q, data, nsamples);
+#else
+  /* No algorithm! */
+  ret = -1;
+#endif
+
+  if (ret < 0)
+    {
+      dbg("sensor filter is misbehaving!\n");
+      return ret;
+    }
+
+  /* Publish for orientation queries. */
+
+  ts_sensor_q[0] = ts_fusion_q.q[0] * (1.0f / TS_FUSION_Q_ONE);
+  ts_sensor_q[1] = ts_fusion_q.q[1] * (1.0f / TS_FUSION_Q_ONE);
+  ts_sensor_q[2] = ts_fusion_q.q[2] * (1.0f / TS_FUSION_Q_ONE);
+  ts_sensor_q[3] = ts_fusion_q.q[3] * (1.0f / TS_FUSION_Q_ONE);
+
+  return ret;
+}
+
+#endif /* CONFIG_THINGSEE_NINEAXELS_FUSION_FIXED */
+
 /* Get fusioned state as quaternion. */
 int ts_nineaxls_fusion_get_quaternion(float o_q[static 4])
 {
@@ -36,6 +36,52 @@
 #ifndef TS_NINEAXLS_FUSION_H
 #define TS_NINEAXLS_FUSION_H
 
+#include <stdint.h>
+
+/* Someone needs to actually measure these: */
+
+/* Gyroscope measurement error in rads/s (start at 40 deg/s) */
+#define GYRO_MEAS_ERROR (M_PI * (40.0f / 180.0f))
+
+/* Gyroscope measurement drift in rad/s/s (start at 0.0 deg/s/s) */
+#define GYRO_MEAS_DRIFT (M_PI * (0.0f  / 180.0f))
+
+/* Constant sqrt(3.0f/4.0f) */
+#define SQRT_3_DIV_4 0.866025f
+
+/* Madgwick scheme parameters: */
+
+/* Compute beta, 0.041 in the paper [1]. Our value,
+ * 0.6045995 is much larger and thus makes the filter converge
+ * much faster.
+ */
+#define MAD_BETA (SQRT_3_DIV_4 * GYRO_MEAS_ERROR)
+
+/* compute zeta, the other free parameter in the Madgwick scheme usually set to a small or zero value. */
+#define MAD_ZETA (SQRT_3_DIV_4 * GYRO_MEAS_DRIFT)
+
+/* Mahony scheme parameters: */
+
+/* MAH_KP is for proportional feedback, MAH_KI for integral error term. */
+#define MAH_KP (2.0f * 5.0f)
+#define MAH_KI 0.0f
+
+/* Fixed-point fusion works on raw sensor samples, one FIFO block at a time.
+ * Quaternion and time step are in Q28, gyro scale is rad/s per LSB in Q43.
+ * Q43 leaves room for gyro full scale up to 245 dps (~1.15e9 per LSB).
+ */
+#define TS_FUSION_Q         28
+#define TS_FUSION_Q_ONE     (1 << TS_FUSION_Q)
+#define TS_FUSION_GYRO_Q    43
+
+struct ts_nineaxls_fusion_q
+{
+  int32_t q[4];             /* Orientation quaternion, Q28 */
+  int32_t gyro_rate;        /* Gyro rate per LSB in rad/s, Q43 */
+  int32_t dt;               /* Sample interval in seconds, Q28 */
+  int16_t bias[6];          /* Gyro and accelerometer bias in LSB */
+};
+
 extern float ts_sensor_q[4];
 
 int ts_nineaxls_fusion_update(float gx, float gy, float gz,
@@ -56,5 +102,15 @@ int ts_sensor_update_mahony(float gx, float gy, float gz,
                             float mx, float my, float mz,
                             float deltat);
 
+int ts_sensor_update_madgwick_q(struct ts_nineaxls_fusion_q *f,
+                                const int16_t (*data)[9], int nsamples);
+
+int ts_sensor_update_mahony_q(struct ts_nineaxls_fusion_q *f,
+                              const int16_t (*data)[9], int nsamples);
+
+void ts_nineaxls_fusion_config_batch(float gyro_reso, const int16_t bias[6]);
+
+int ts_nineaxls_fusion_update_batch(const int16_t (*data)[9], int nsamples);
+
 #endif
 
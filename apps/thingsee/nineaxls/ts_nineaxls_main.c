@@ -90,9 +90,11 @@ static int lsm9ds1_main(void)
   int ret = OK;
   uint8_t gyro_id = 0;
   uint8_t mag_id = 0;
-  int16_t data[9] = { 0 };
   int16_t bias[9] = { 0 };
+#ifndef CONFIG_THINGSEE_NINEAXELS_FUSION_FIXED
+  int16_t data[9] = { 0 };
   float fbias[6];
+#endif
   float gyro_reso, xl_reso, mag_reso;
 
   nineax_lsm9ds1_start();
@@ -111,6 +113,43 @@ static int lsm9ds1_main(void)
 
   nineax_lsm9ds1_read_resolutions(&gyro_reso, &xl_reso, &mag_reso);
 
+#ifdef CONFIG_THINGSEE_NINEAXELS_FUSION_FIXED
+  /* Fixed-point fusion takes raw samples, only gyro resolution and bias
+   * are needed up front.
+   */
+
+  ts_nineaxls_fusion_config_batch(gyro_reso, bias);
+
+  while (1)
+    {
+      static int16_t fifo[NINEAX_LSM9DS1_FIFO_DEPTH][9];
+      static uint32_t cnt;
+      float yaw, pitch, roll;
+      int nsamples;
+
+      nineax_lsm9ds1_wait_for_sensor();
+      nsamples = nineax_lsm9ds1_read_fifo(fifo, NINEAX_LSM9DS1_FIFO_DEPTH);
+      if (nsamples < 0)
+        {
+          continue;
+        }
+
+      ts_nineaxls_fusion_update_batch((const int16_t (*)[9])fifo, nsamples);
+
+      /* Orientation conversion is CPU-heavy, only do it once in a while. */
+
+      if (cnt / 100 != (cnt + nsamples) / 100)
+        {
+          lldbg("Raw GYRO: %hd, %hd, %hd\n", fifo[0][0], fifo[0][1], fifo[0][2]);
+          lldbg("Raw XL  : %hd, %hd, %hd\n", fifo[0][3], fifo[0][4], fifo[0][5]);
+          lldbg("Raw MAGN: %hd, %hd, %hd\n", fifo[0][6], fifo[0][7], fifo[0][8]);
+          ts_nineaxls_fusion_get_orientation(&yaw, &pitch, &roll);
+          lldbg("Yaw = %.6g, Pitch = %.6g, Roll = %.6g\n", yaw, pitch, roll);
+          lldbg("q = [%.6g %.6g %.6g %.6g]\n", ts_sensor_q[0], ts_sensor_q[1], ts_sensor_q[2], ts_sensor_q[3]);
+        }
+      cnt += nsamples;
+    }
+#else
   /* Convert biases to floating-point here, not during every sensor update. */
   fbias[0] = gyro_reso * bias[0];
   fbias[1] = gyro_reso * bias[1];
@@ -168,6 +207,7 @@ static int lsm9ds1_main(void)
         }
       cnt++;
     }
+#endif
 
   nineax_lsm9ds1_stop();
 
@@ -33,53 +33,26 @@
  *
  ****************************************************************************/
 
+#include <stdint.h>
 #include <math.h>
 #include <float.h>
 #include <errno.h>
 
+#include "ts_nineaxls_fusion.h"
+
 /* Quaternion to hold algorithm output. This is a global variable for speed
  * optimization purposes.
  */
 float ts_sensor_q[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
 
-/* Someone needs to actually measure these: */
-
-/* Gyroscope measurement error in rads/s (start at 40 deg/s) */
-#define GYRO_MEAS_ERROR (M_PI * (40.0f / 180.0f))
-
-/* Gyroscope measurement drift in rad/s/s (start at 0.0 deg/s/s) */
-#define GYRO_MEAS_DRIFT (M_PI * (0.0f  / 180.0f))
-
-/* Constant sqrt(3.0f/4.0f) */
-#define SQRT_3_DIV_4 0.866025f
-
-/* Madgwick scheme parameters: */
-
-/* Compute beta, 0.041 in the paper [1]. Our value,
- * 0.6045995 is much larger and thus makes the filter converge
- * much faster.
- */
-#define MAD_BETA (SQRT_3_DIV_4 * GYRO_MEAS_ERROR)
-
-/* compute zeta, the other free parameter in the Madgwick scheme usually set to a small or zero value. */
-#define MAD_ZETA (SQRT_3_DIV_4 * GYRO_MEAS_DRIFT)
-
-/* Mahony scheme parameters: */
-
-/* MAH_KP is for proportional feedback, MAH_KI for integral error term. */
-#define MAH_KP (2.0f * 5.0f)
-#define MAH_KI 0.0f
-
 /* 1/sqrt(x) using integer arithmetic. */
 float inv_sqrt(float x)
 {
   float halfx = 0.5f * x;
-  float y = x;
-  long i = *(long*)&y;
-  i = 0x5f3759df - (i>>1);
-  y = *(float*)&i;
-  y = y * (1.5f - (halfx * y * y));
-  return y;
+  union { float f; int32_t i; } y = { x };
+  y.i = 0x5f3759df - (y.i>>1);
+  y.f = y.f * (1.5f - (halfx * y.f * y.f));
+  return y.f;
 }
 
 /* Helper macros, normalize 3- and 4-dimensional vectors in-place.  */
@@ -0,0 +1,448 @@
+/****************************************************************************
+ * apps/thingsee/nineaxls/ts_nineaxls_quaternion_q.c
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/* Fixed-point versions of the orientation filters in ts_nineaxls_quaternion.c.
+ *
+ * STM32L1 has no FPU, so every float operation of the reference filters is a
+ * library call. These kernels run a block of raw FIFO samples through the
+ * same equations in Q28, where each product is a single 32x32->64 multiply.
+ * Sums of products are accumulated in 64 bits (Q56) before scaling back, so
+ * intermediate terms may exceed the Q28 range of +-8.
+ *
+ * Gyro samples are scaled straight to half rotation angle over the sample
+ * interval, and accelerometer and magnetometer samples are only normalized,
+ * so no unit conversions remain in the loop.
+ */
+
+#include <nuttx/config.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "ts_nineaxls_fusion.h"
+
+#define FQ                  TS_FUSION_Q
+#define FQ_ONE              TS_FUSION_Q_ONE
+#define FQ_HALF             (FQ_ONE / 2)
+
+/* Float constant to Q28, folded at compile time. */
+#define FQ_CONST(x)         ((int32_t)((x) * FQ_ONE + 0.5f))
+
+/* Q28 product, and Q56 product for accumulating sums. */
+#define fmul(a, b)          ((int32_t)(((int64_t)(a) * (b)) >> FQ))
+#define fmul56(a, b)        ((int64_t)(a) * (b))
+#define fq56(x)             ((int32_t)((x) >> FQ))
+
+/* Initial guesses of 1/sqrt(x) in Q30 for x in [1/4, 1), sixteenths. */
+static const uint32_t g_rsqrt_seed[12] =
+{
+  0x78adf778, 0x6d28a4f0, 0x64695585, 0x5d7a5d1b, 0x57cea99d, 0x530eafa5,
+  0x4f00d944, 0x4b7d8317, 0x48686148, 0x45aca3d5, 0x433a98c6, 0x41062920
+};
+
+/* Reciprocal square root of a sum of squares. Non-zero n2 is scaled by an
+ * even power of two to x in [1/4, 1) Q30, and with returned r in Q30
+ *
+ *   1/sqrt(n2) = r * 2^-(61 + *hshift), and
+ *   sqrt(n2)   = x * r * 2^(*hshift - 29).
+ *
+ * Table seed is within 6%, three Newton steps bring it to Q30 precision.
+ */
+static uint32_t frsqrt(uint64_t n2, uint32_t *x, int *hshift)
+{
+  int shift = 2 - __builtin_clzll(n2);
+  uint32_t y;
+  uint64_t y2;
+  int i;
+
+  if (shift & 1)
+    {
+      shift++;
+    }
+
+  *x = (uint32_t)((shift >= 0 ? n2 >> shift : n2 << -shift) >> 32);
+  *hshift = shift / 2;
+
+  y = g_rsqrt_seed[(*x >> 26) - 4];
+  for (i = 0; i < 3; i++)
+    {
+      y2 = ((uint64_t)y * y) >> 30;
+      y = (uint32_t)(((uint64_t)y * ((3u << 30) - (uint32_t)((*x * y2) >> 30))) >> 31);
+    }
+
+  return y;
+}
+
+/* Scale vector in place to unit length in Q28. Components can be in any
+ * common scale but must be below 2^30 in magnitude. Zero vector is left
+ * as is and false returned.
+ */
+static bool fnormalize(int32_t *v, int n)
+{
+  uint64_t n2 = 0;
+  uint32_t x;
+  uint32_t r;
+  int shift;
+  int i;
+
+  for (i = 0; i < n; i++)
+    {
+      n2 += (uint64_t)fmul56(v[i], v[i]);
+    }
+
+  if (n2 == 0)
+    {
+      return false;
+    }
+
+  r = frsqrt(n2, &x, &shift);
+  shift += 61 - FQ;
+
+  for (i = 0; i < n; i++)
+    {
+      v[i] = (int32_t)((fmul56(v[i], r) + ((int64_t)1 << (shift - 1))) >> shift);
+    }
+
+  return true;
+}
+
+/* sqrt(a^2 + b^2) of Q28 values. */
+static int32_t fhypot(int32_t a, int32_t b)
+{
+  uint64_t n2 = (uint64_t)fmul56(a, a) + (uint64_t)fmul56(b, b);
+  uint32_t x;
+  uint32_t r;
+  int shift;
+
+  if (n2 == 0)
+    {
+      return 0;
+    }
+
+  r = frsqrt(n2, &x, &shift);
+  return (int32_t)(((uint64_t)x * r) >> (29 - shift));
+}
+
+/* Load one raw sample: gyro as half rotation angle in Q28, accelerometer
+ * and magnetometer as unit vectors. Returns false if either reference
+ * vector is zero and correction has to be skipped.
+ */
+static bool fload_sample(const struct ts_nineaxls_fusion_q *f,
+                         const int16_t d[9], int32_t gstep,
+                         int32_t g[3], int32_t a[3], int32_t m[3])
+{
+  bool valid;
+
+  g[0] = (int32_t)(((int64_t)(d[0] - f->bias[0]) * gstep) >> 16);
+  g[1] = (int32_t)(((int64_t)(d[1] - f->bias[1]) * gstep) >> 16);
+  g[2] = (int32_t)(((int64_t)(d[2] - f->bias[2]) * gstep) >> 16);
+
+  a[0] = d[3] - f->bias[3];
+  a[1] = d[4] - f->bias[4];
+  a[2] = d[5] - f->bias[5];
+
+  /* Magnetometer x-axis is opposite to gyro x-axis, see
+   * ts_nineaxls_fusion_update().
+   */
+
+#if defined(CONFIG_LSM9DS1_SENS)
+  m[0] = -d[6];
+#else
+  m[0] = d[6];
+#endif
+  m[1] = d[7];
+  m[2] = d[8];
+
+  valid = fnormalize(a, 3);
+  valid = fnormalize(m, 3) && valid;
+  return valid;
+}
+
+/* Half rotation angle per gyro LSB over one sample interval, Q44. */
+static int32_t fgyro_step(const struct ts_nineaxls_fusion_q *f)
+{
+  return (int32_t)(((int64_t)f->gyro_rate * f->dt) >> FQ);
+}
+
+#ifdef CONFIG_THINGSEE_NINEAXELS_FUSION_MADGWICK
+
+/* Madgwick filter, see ts_sensor_update_madgwick(). */
+
+int ts_sensor_update_madgwick_q(struct ts_nineaxls_fusion_q *f,
+                                const int16_t (*data)[9], int nsamples)
+{
+  int32_t q1 = f->q[0];
+  int32_t q2 = f->q[1];
+  int32_t q3 = f->q[2];
+  int32_t q4 = f->q[3];
+  int32_t gstep = fgyro_step(f);
+  int32_t beta_dt = fmul(FQ_CONST(MAD_BETA), f->dt);
+  int n;
+
+  for (n = 0; n < nsamples; n++)
+    {
+      int32_t g[3], a[3], m[3];
+      int32_t s[4] = { 0, 0, 0, 0 };
+      int32_t q[4];
+
+      if (fload_sample(f, data[n], gstep, g, a, m))
+        {
+          int32_t hx, hy, _2bx, _2bz, _4bx, _4bz;
+          int32_t fg1, fg2, fg3, fb1, fb2, fb3;
+          int32_t _2q1mx = 2 * fmul(q1, m[0]);
+          int32_t _2q1my = 2 * fmul(q1, m[1]);
+          int32_t _2q1mz = 2 * fmul(q1, m[2]);
+          int32_t _2q2mx = 2 * fmul(q2, m[0]);
+          int32_t _2q1 = 2 * q1;
+          int32_t _2q2 = 2 * q2;
+          int32_t _2q3 = 2 * q3;
+          int32_t _2q4 = 2 * q4;
+          int32_t q1q1 = fmul(q1, q1);
+          int32_t q1q2 = fmul(q1, q2);
+          int32_t q1q3 = fmul(q1, q3);
+          int32_t q1q4 = fmul(q1, q4);
+          int32_t q2q2 = fmul(q2, q2);
+          int32_t q2q3 = fmul(q2, q3);
+          int32_t q2q4 = fmul(q2, q4);
+          int32_t q3q3 = fmul(q3, q3);
+          int32_t q3q4 = fmul(q3, q4);
+          int32_t q4q4 = fmul(q4, q4);
+
+          /* Reference direction of Earth's magnetic field */
+
+          hx = fq56(fmul56(m[0], q1q1) - fmul56(_2q1my, q4) +
+                    fmul56(_2q1mz, q3) + fmul56(m[0], q2q2) +
+                    fmul56(fmul(_2q2, m[1]), q3) +
+                    fmul56(fmul(_2q2, m[2]), q4) -
+                    fmul56(m[0], q3q3) - fmul56(m[0], q4q4));
+          hy = fq56(fmul56(_2q1mx, q4) + fmul56(m[1], q1q1) -
+                    fmul56(_2q1mz, q2) + fmul56(_2q2mx, q3) -
+                    fmul56(m[1], q2q2) + fmul56(m[1], q3q3) +
+                    fmul56(fmul(_2q3, m[2]), q4) - fmul56(m[1], q4q4));
+          _2bx = fhypot(hx, hy);
+          _2bz = fq56(-fmul56(_2q1mx, q3) + fmul56(_2q1my, q2) +
+                      fmul56(m[2], q1q1) + fmul56(_2q2mx, q4) -
+                      fmul56(m[2], q2q2) + fmul56(fmul(_2q3, m[1]), q4) -
+                      fmul56(m[2], q3q3) + fmul56(m[2], q4q4));
+          _4bx = 2 * _2bx;
+          _4bz = 2 * _2bz;
+
+          /* Objective function terms shared by all gradient components */
+
+          fg1 = 2 * q2q4 - 2 * q1q3 - a[0];
+          fg2 = 2 * q1q2 + 2 * q3q4 - a[1];
+          fg3 = FQ_ONE - 2 * q2q2 - 2 * q3q3 - a[2];
+          fb1 = fq56(fmul56(_2bx, FQ_HALF - q3q3 - q4q4) +
+                     fmul56(_2bz, q2q4 - q1q3)) - m[0];
+          fb2 = fq56(fmul56(_2bx, q2q3 - q1q4) +
+                     fmul56(_2bz, q1q2 + q3q4)) - m[1];
+          fb3 = fq56(fmul56(_2bx, q1q3 + q2q4) +
+                     fmul56(_2bz, FQ_HALF - q2q2 - q3q3)) - m[2];
+
+          /* Gradient decent algorithm corrective step, Q56 scaled to Q24 */
+
+          s[0] = (int32_t)((-fmul56(_2q3, fg1) + fmul56(_2q2, fg2) -
+                            fmul56(fmul(_2bz, q3), fb1) +
+                            fmul56(fmul(_2bz, q2) - fmul(_2bx, q4), fb2) +
+                            fmul56(fmul(_2bx, q3), fb3)) >> 32);
+          s[1] = (int32_t)((fmul56(_2q4, fg1) + fmul56(_2q1, fg2) -
+                            fmul56(4 * q2, fg3) +
+                            fmul56(fmul(_2bz, q4), fb1) +
+                            fmul56(fmul(_2bx, q3) + fmul(_2bz, q1), fb2) +
+                            fmul56(fmul(_2bx, q4) - fmul(_4bz, q2), fb3)) >> 32);
+          s[2] = (int32_t)((-fmul56(_2q1, fg1) + fmul56(_2q4, fg2) -
+                            fmul56(4 * q3, fg3) +
+                            fmul56(-fmul(_4bx, q3) - fmul(_2bz, q1), fb1) +
+                            fmul56(fmul(_2bx, q2) + fmul(_2bz, q4), fb2) +
+                            fmul56(fmul(_2bx, q1) - fmul(_4bz, q3), fb3)) >> 32);
+          s[3] = (int32_t)((fmul56(_2q2, fg1) + fmul56(_2q3, fg2) +
+                            fmul56(-fmul(_4bx, q4) + fmul(_2bz, q2), fb1) +
+                            fmul56(fmul(_2bz, q3) - fmul(_2bx, q1), fb2) +
+                            fmul56(fmul(_2bx, q2), fb3)) >> 32);
+
+          /* Normalize step magnitude, and scale it for the time step */
+
+          if (fnormalize(s, 4))
+            {
+              s[0] = fmul(beta_dt, s[0]);
+              s[1] = fmul(beta_dt, s[1]);
+              s[2] = fmul(beta_dt, s[2]);
+              s[3] = fmul(beta_dt, s[3]);
+            }
+        }
+
+      /* Integrate rate of change of quaternion */
+
+      q[0] = q1 + fq56(-fmul56(q2, g[0]) - fmul56(q3, g[1]) - fmul56(q4, g[2])) - s[0];
+      q[1] = q2 + fq56(fmul56(q1, g[0]) + fmul56(q3, g[2]) - fmul56(q4, g[1])) - s[1];
+      q[2] = q3 + fq56(fmul56(q1, g[1]) - fmul56(q2, g[2]) + fmul56(q4, g[0])) - s[2];
+      q[3] = q4 + fq56(fmul56(q1, g[2]) + fmul56(q2, g[1]) - fmul56(q3, g[0])) - s[3];
+
+      /* Normalize the output quaternion */
+
+      if (!fnormalize(q, 4))
+        {
+          return -1;
+        }
+
+      q1 = q[0];
+      q2 = q[1];
+      q3 = q[2];
+      q4 = q[3];
+    }
+
+  f->q[0] = q1;
+  f->q[1] = q2;
+  f->q[2] = q3;
+  f->q[3] = q4;
+  return 0;
+}
+
+#endif /* CONFIG_THINGSEE_NINEAXELS_FUSION_MADGWICK */
+
+#ifdef CONFIG_THINGSEE_NINEAXELS_FUSION_MAHONY
+
+/* Mahony filter, see ts_sensor_update_mahony(). Integral feedback is not
+ * implemented, MAH_KI is zero.
+ */
+
+int ts_sensor_update_mahony_q(struct ts_nineaxls_fusion_q *f,
+                              const int16_t (*data)[9], int nsamples)
+{
+  int32_t q1 = f->q[0];
+  int32_t q2 = f->q[1];
+  int32_t q3 = f->q[2];
+  int32_t q4 = f->q[3];
+  int32_t gstep = fgyro_step(f);
+  int32_t kp_hdt = (int32_t)(((int64_t)(int32_t)(MAH_KP * 32768.0f) * f->dt) >> 16);
+  int n;
+
+  for (n = 0; n < nsamples; n++)
+    {
+      int32_t g[3], a[3], m[3];
+      int32_t q[4];
+      int32_t pa, pb, pc;
+
+      if (fload_sample(f, data[n], gstep, g, a, m))
+        {
+          int32_t hx, hy, bx, bz;
+          int32_t vx, vy, vz, wx, wy, wz;
+          int32_t ex, ey, ez;
+          int32_t q1q1 = fmul(q1, q1);
+          int32_t q1q2 = fmul(q1, q2);
+          int32_t q1q3 = fmul(q1, q3);
+          int32_t q1q4 = fmul(q1, q4);
+          int32_t q2q2 = fmul(q2, q2);
+          int32_t q2q3 = fmul(q2, q3);
+          int32_t q2q4 = fmul(q2, q4);
+          int32_t q3q3 = fmul(q3, q3);
+          int32_t q3q4 = fmul(q3, q4);
+          int32_t q4q4 = fmul(q4, q4);
+
+          /* Reference direction of Earth's magnetic field */
+
+          hx = 2 * fq56(fmul56(m[0], FQ_HALF - q3q3 - q4q4) +
+                        fmul56(m[1], q2q3 - q1q4) +
+                        fmul56(m[2], q2q4 + q1q3));
+          hy = 2 * fq56(fmul56(m[0], q2q3 + q1q4) +
+                        fmul56(m[1], FQ_HALF - q2q2 - q4q4) +
+                        fmul56(m[2], q3q4 - q1q2));
+          bx = fhypot(hx, hy);
+          bz = 2 * fq56(fmul56(m[0], q2q4 - q1q3) +
+                        fmul56(m[1], q3q4 + q1q2) +
+                        fmul56(m[2], FQ_HALF - q2q2 - q3q3));
+
+          /* Estimated direction of gravity and magnetic field */
+
+          vx = 2 * (q2q4 - q1q3);
+          vy = 2 * (q1q2 + q3q4);
+          vz = q1q1 - q2q2 - q3q3 + q4q4;
+          wx = 2 * fq56(fmul56(bx, FQ_HALF - q3q3 - q4q4) +
+                        fmul56(bz, q2q4 - q1q3));
+          wy = 2 * fq56(fmul56(bx, q2q3 - q1q4) +
+                        fmul56(bz, q1q2 + q3q4));
+          wz = 2 * fq56(fmul56(bx, q1q3 + q2q4) +
+                        fmul56(bz, FQ_HALF - q2q2 - q3q3));
+
+          /* Error is cross product between estimated direction and
+           * measured direction of gravity
+           */
+
+          ex = fq56(fmul56(a[1], vz) - fmul56(a[2], vy) +
+                    fmul56(m[1], wz) - fmul56(m[2], wy));
+          ey = fq56(fmul56(a[2], vx) - fmul56(a[0], vz) +
+                    fmul56(m[2], wx) - fmul56(m[0], wz));
+          ez = fq56(fmul56(a[0], vy) - fmul56(a[1], vx) +
+                    fmul56(m[0], wy) - fmul56(m[1], wx));
+
+          /* Apply feedback terms */
+
+          g[0] += fmul(kp_hdt, ex);
+          g[1] += fmul(kp_hdt, ey);
+          g[2] += fmul(kp_hdt, ez);
+        }
+
+      /* Integrate rate of change of quaternion. Like the float filter,
+       * later components see the already updated q1.
+       */
+
+      pa = q2;
+      pb = q3;
+      pc = q4;
+      q[0] = q1 + fq56(-fmul56(q2, g[0]) - fmul56(q3, g[1]) - fmul56(q4, g[2]));
+      q[1] = pa + fq56(fmul56(q[0], g[0]) + fmul56(pb, g[2]) - fmul56(pc, g[1]));
+      q[2] = pb + fq56(fmul56(q[0], g[1]) - fmul56(pa, g[2]) + fmul56(pc, g[0]));
+      q[3] = pc + fq56(fmul56(q[0], g[2]) + fmul56(pa, g[1]) - fmul56(pb, g[0]));
+
+      /* Normalize the output quaternion */
+
+      if (!fnormalize(q, 4))
+        {
+          return -1;
+        }
+
+      q1 = q[0];
+      q2 = q[1];
+      q3 = q[2];
+      q4 = q[3];
+    }
+
+  f->q[0] = q1;
+  f->q[1] = q2;
+  f->q[2] = q3;
+  f->q[3] = q4;
+  return 0;
+}
+
+#endif /* CONFIG_THINGSEE_NINEAXELS_FUSION_MAHONY */
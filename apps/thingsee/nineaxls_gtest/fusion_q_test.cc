@@ -0,0 +1,478 @@
+/****************************************************************************
+ * apps/thingsee/nineaxls_gtest/fusion_q_test.cc
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+/* Fixed-point batch fusion against the float filters. Raw LSM9DS1 samples
+ * are generated from a tumbling ground truth orientation, fed to the float
+ * filter one at a time the way ts_nineaxls_main.c does, and to fixed-point
+ * kernel in FIFO sized blocks.
+ *
+ * Float filters normalize with single step inv_sqrt(), and the small length
+ * error left in the normalized gradient biases the estimate by degrees, so
+ * accuracy is compared against ground truth rather than float output.
+ * Host has an FPU, so the throughput ratio understates what is gained on
+ * target.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "gtest/gtest.h"
+extern "C" {
+#include "ts_nineaxls_fusion.h"
+}
+
+namespace {
+
+/* Scales of LSM9DS1 at 245 dps, 2 g as configured by lsm9ds1_module.c */
+
+const float kGyroReso = 0.00875f;   /* dps/LSB */
+const float kXlReso = 0.000061f;    /* g/LSB */
+const float kMagReso = 0.00014f;    /* gauss/LSB */
+const double kRate = 238.0;         /* Hz */
+const int kBlock = 16;
+
+/* Magnetic field in Oulu, gauss, earth frame x north, z up */
+
+const double kFieldNorth = 0.13;
+const double kFieldUp = -0.50;
+
+const int16_t kBias[6] = { 12, -7, 3, 40, -25, 60 };
+
+typedef std::vector<std::vector<int16_t> > Samples;
+
+struct Quat
+{
+  double w, x, y, z;
+};
+
+Quat Mul(const Quat &a, const Quat &b)
+{
+  Quat r = {
+    a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+    a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+    a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+    a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w
+  };
+
+  return r;
+}
+
+/* Earth frame vector to sensor frame, q* v q */
+
+void ToSensor(const Quat &q, const double v[3], double out[3])
+{
+  Quat qc = { q.w, -q.x, -q.y, -q.z };
+  Quat p = { 0, v[0], v[1], v[2] };
+  Quat r = Mul(Mul(qc, p), q);
+
+  out[0] = r.x;
+  out[1] = r.y;
+  out[2] = r.z;
+}
+
+/* Angle between orientations in degrees */
+
+double AngleDeg(const Quat &a, const double b[4])
+{
+  double dot = fabs(a.w * b[0] + a.x * b[1] + a.y * b[2] + a.z * b[3]);
+
+  return 2.0 * acos(dot > 1.0 ? 1.0 : dot) * 180.0 / M_PI;
+}
+
+uint64_t g_seed;
+
+double Gauss(void)
+{
+  double u1, u2;
+
+  g_seed = g_seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  u1 = ((g_seed >> 11) + 1.0) / 9007199254740993.0;
+  g_seed = g_seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  u2 = (g_seed >> 11) / 9007199254740992.0;
+  return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+int16_t Raw(double value, double reso, double noise_lsb, int16_t bias)
+{
+  double lsb = value / reso + noise_lsb * Gauss() + bias;
+
+  return (int16_t)lrint(lsb);
+}
+
+/* Device tumbling at up to about 70 dps around all axes, starting 40
+ * degrees off from identity the filters start at.
+ */
+
+Samples Tumble(double seconds, std::vector<Quat> *truth)
+{
+  Samples samples;
+  Quat q = { cos(M_PI / 9), sin(M_PI / 9) * 0.6, sin(M_PI / 9) * 0.8, 0 };
+  const double g[3] = { 0, 0, 1 };
+  const double field[3] = { kFieldNorth, 0, kFieldUp };
+  int n = (int)(seconds * kRate);
+
+  g_seed = 1;
+  for (int i = 0; i < n; i++)
+    {
+      double t = i / kRate;
+      double w[3] = {
+        1.2 * sin(2 * M_PI * 0.30 * t),
+        0.9 * cos(2 * M_PI * 0.17 * t),
+        0.6 * sin(2 * M_PI * 0.11 * t + 1.0)
+      };
+      double wn = sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+      double half = 0.5 * wn / kRate;
+      double a[3], m[3];
+      std::vector<int16_t> s(9);
+
+      ToSensor(q, g, a);
+      ToSensor(q, field, m);
+
+      for (int k = 0; k < 3; k++)
+        {
+          s[k] = Raw(w[k] * 180.0 / M_PI, kGyroReso, 2.0, kBias[k]);
+          s[3 + k] = Raw(a[k], kXlReso, 4.0, kBias[3 + k]);
+        }
+
+      /* Magnetometer x-axis is reversed on LSM9DS1 */
+
+      s[6] = Raw(-m[0], kMagReso, 5.0, 0);
+      s[7] = Raw(m[1], kMagReso, 5.0, 0);
+      s[8] = Raw(m[2], kMagReso, 5.0, 0);
+
+      samples.push_back(s);
+      truth->push_back(q);
+
+      if (wn > 0)
+        {
+          Quat dq = { cos(half), sin(half) * w[0] / wn,
+                      sin(half) * w[1] / wn, sin(half) * w[2] / wn };
+          q = Mul(q, dq);
+        }
+    }
+
+  return samples;
+}
+
+typedef int (*float_update_t)(float, float, float, float, float, float,
+                              float, float, float, float);
+typedef int (*fixed_update_t)(struct ts_nineaxls_fusion_q *,
+                              const int16_t (*)[9], int);
+
+/* Float path, sample conversion as in ts_nineaxls_main.c and
+ * ts_nineaxls_fusion_update().
+ */
+
+class FloatFusion
+{
+public:
+  explicit FloatFusion(float_update_t update) : update_(update)
+  {
+    ts_sensor_q[0] = 1.0f;
+    ts_sensor_q[1] = 0.0f;
+    ts_sensor_q[2] = 0.0f;
+    ts_sensor_q[3] = 0.0f;
+
+    for (int i = 0; i < 3; i++)
+      {
+        fbias_[i] = kGyroReso * kBias[i];
+        fbias_[3 + i] = kXlReso * kBias[3 + i];
+      }
+  }
+
+  int Update(const int16_t *d)
+  {
+    float gx = d[0] * kGyroReso - fbias_[0];
+    float gy = d[1] * kGyroReso - fbias_[1];
+    float gz = d[2] * kGyroReso - fbias_[2];
+    float ax = d[3] * kXlReso - fbias_[3];
+    float ay = d[4] * kXlReso - fbias_[4];
+    float az = d[5] * kXlReso - fbias_[5];
+    float mx = -(d[6] * kMagReso);
+    float my = d[7] * kMagReso;
+    float mz = d[8] * kMagReso;
+
+    return update_(gx * M_PI / 180.0f, gy * M_PI / 180.0f,
+                   gz * M_PI / 180.0f, ax, ay, az, mx, my, mz,
+                   (float)(1.0 / kRate));
+  }
+
+  void Get(double q[4]) const
+  {
+    for (int i = 0; i < 4; i++)
+      q[i] = ts_sensor_q[i];
+  }
+
+private:
+  float_update_t update_;
+  float fbias_[6];
+};
+
+/* Fixed-point path, set up as in ts_nineaxls_fusion_config_batch() */
+
+class FixedFusion
+{
+public:
+  explicit FixedFusion(fixed_update_t update) : update_(update)
+  {
+    memset(&f_, 0, sizeof(f_));
+    f_.q[0] = TS_FUSION_Q_ONE;
+    f_.gyro_rate = (int32_t)(kGyroReso * (M_PI / 180.0f) *
+                             (float)(1LL << TS_FUSION_GYRO_Q) + 0.5f);
+    f_.dt = (int32_t)(TS_FUSION_Q_ONE / kRate + 0.5);
+    memcpy(f_.bias, kBias, sizeof(f_.bias));
+  }
+
+  int Update(const int16_t (*data)[9], int n)
+  {
+    return update_(&f_, data, n);
+  }
+
+  void Get(double q[4]) const
+  {
+    for (int i = 0; i < 4; i++)
+      q[i] = f_.q[i] / (double)TS_FUSION_Q_ONE;
+  }
+
+private:
+  fixed_update_t update_;
+  struct ts_nineaxls_fusion_q f_;
+};
+
+struct Comparison
+{
+  double max_divergence;    /* Between float and fixed, degrees */
+  double float_error;       /* RMS against truth after settling */
+  double fixed_error;
+  double fixed_final_max;   /* Largest fixed error over last minute */
+};
+
+Comparison Compare(float_update_t float_update, fixed_update_t fixed_update,
+                   double seconds)
+{
+  std::vector<Quat> truth;
+  Samples samples = Tumble(seconds, &truth);
+  FloatFusion ref(float_update);
+  FixedFusion fixed(fixed_update);
+  Comparison c = { 0, 0, 0, 0 };
+  int settle = (int)(10 * kRate);
+  int final = (int)(samples.size() - 60 * kRate);
+  int count = 0;
+
+  for (size_t i = 0; i + kBlock <= samples.size(); i += kBlock)
+    {
+      int16_t block[kBlock][9];
+      double qf[4], qx[4];
+      Quat qfloat;
+      double div;
+
+      for (int k = 0; k < kBlock; k++)
+        {
+          memcpy(block[k], &samples[i + k][0], sizeof(block[k]));
+          EXPECT_EQ(0, ref.Update(block[k]));
+        }
+
+      EXPECT_EQ(0, fixed.Update(block, kBlock));
+
+      ref.Get(qf);
+      fixed.Get(qx);
+
+      qfloat.w = qf[0];
+      qfloat.x = qf[1];
+      qfloat.y = qf[2];
+      qfloat.z = qf[3];
+      div = AngleDeg(qfloat, qx);
+      if (div > c.max_divergence)
+        c.max_divergence = div;
+
+      if ((int)i >= settle)
+        {
+          const Quat &t = truth[i + kBlock - 1];
+
+          double err = AngleDeg(t, qx);
+
+          c.float_error += pow(AngleDeg(t, qf), 2);
+          c.fixed_error += pow(err, 2);
+          count++;
+
+          if ((int)i >= final && err > c.fixed_final_max)
+            c.fixed_final_max = err;
+        }
+    }
+
+  c.float_error = sqrt(c.float_error / count);
+  c.fixed_error = sqrt(c.fixed_error / count);
+  return c;
+}
+
+double NowSec(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void Metric(const char *name, double value, const char *unit)
+{
+  printf("[  METRIC  ] %s: %.3f %s\n", name, value, unit);
+  ::testing::Test::RecordProperty(name, (int)value);
+}
+
+/* Both paths over same samples, samples per second. */
+
+void Benchmark(const char *name, float_update_t float_update,
+               fixed_update_t fixed_update)
+{
+  std::vector<Quat> truth;
+  Samples samples = Tumble(60, &truth);
+  std::vector<int16_t> flat;
+  FloatFusion ref(float_update);
+  FixedFusion fixed(fixed_update);
+  size_t n = samples.size() / kBlock * kBlock;
+  const int rounds = 5;
+  double start, float_time, fixed_time;
+  char metric[64];
+
+  for (size_t i = 0; i < n; i++)
+    flat.insert(flat.end(), samples[i].begin(), samples[i].end());
+
+  start = NowSec();
+  for (int r = 0; r < rounds; r++)
+    {
+      for (size_t i = 0; i < n; i++)
+        ref.Update(&flat[i * 9]);
+    }
+  float_time = NowSec() - start;
+
+  start = NowSec();
+  for (int r = 0; r < rounds; r++)
+    {
+      for (size_t i = 0; i < n; i += kBlock)
+        fixed.Update((const int16_t (*)[9])&flat[i * 9], kBlock);
+    }
+  fixed_time = NowSec() - start;
+
+  snprintf(metric, sizeof(metric), "%s_float_samples_per_sec", name);
+  Metric(metric, rounds * n / float_time, "samples/s");
+  snprintf(metric, sizeof(metric), "%s_fixed_samples_per_sec", name);
+  Metric(metric, rounds * n / fixed_time, "samples/s");
+}
+
+} /* namespace */
+
+TEST(FusionQ, MadgwickAccuracy)
+{
+  Comparison c = Compare(ts_sensor_update_madgwick,
+                         ts_sensor_update_madgwick_q, 600);
+
+  Metric("madgwick_max_divergence", c.max_divergence, "deg");
+  Metric("madgwick_float_rms_error", c.float_error, "deg");
+  Metric("madgwick_fixed_rms_error", c.fixed_error, "deg");
+  Metric("madgwick_fixed_final_max_error", c.fixed_final_max, "deg");
+
+  /* No worse than float, and no drift from accumulated rounding over ten
+   * minutes of tumbling.
+   */
+
+  EXPECT_LT(c.fixed_error, c.float_error + 0.05);
+  EXPECT_LT(c.fixed_error, 0.5);
+  EXPECT_LT(c.fixed_final_max, 1.0);
+}
+
+TEST(FusionQ, MahonyAccuracy)
+{
+  Comparison c = Compare(ts_sensor_update_mahony,
+                         ts_sensor_update_mahony_q, 600);
+
+  Metric("mahony_max_divergence", c.max_divergence, "deg");
+  Metric("mahony_float_rms_error", c.float_error, "deg");
+  Metric("mahony_fixed_rms_error", c.fixed_error, "deg");
+  Metric("mahony_fixed_final_max_error", c.fixed_final_max, "deg");
+
+  /* No worse than float, and no drift from accumulated rounding over ten
+   * minutes of tumbling.
+   */
+
+  EXPECT_LT(c.fixed_error, c.float_error + 0.05);
+  EXPECT_LT(c.fixed_error, 0.5);
+  EXPECT_LT(c.fixed_final_max, 1.0);
+}
+
+TEST(FusionQ, ZeroIntervalKeepsOrientation)
+{
+  FixedFusion fixed(ts_sensor_update_madgwick_q);
+  std::vector<Quat> truth;
+  Samples samples = Tumble(1, &truth);
+  int16_t block[kBlock][9];
+  struct ts_nineaxls_fusion_q f;
+  double q[4];
+
+  memset(&f, 0, sizeof(f));
+  f.q[0] = TS_FUSION_Q_ONE;
+  for (int k = 0; k < kBlock; k++)
+    memcpy(block[k], &samples[k][0], sizeof(block[k]));
+
+  /* First block has no measured interval */
+
+  ASSERT_EQ(0, ts_sensor_update_madgwick_q(&f, block, kBlock));
+  EXPECT_EQ(TS_FUSION_Q_ONE, f.q[0]);
+  EXPECT_EQ(0, f.q[1]);
+  EXPECT_EQ(0, f.q[2]);
+  EXPECT_EQ(0, f.q[3]);
+
+  /* Zero reference vectors skip correction but still integrate gyro */
+
+  memset(block, 0, sizeof(block));
+  for (int k = 0; k < kBlock; k++)
+    {
+      memcpy(block[k], kBias, sizeof(kBias));
+      block[k][2] += 1000;
+    }
+
+  ASSERT_EQ(0, fixed.Update(block, kBlock));
+  fixed.Get(q);
+  EXPECT_NEAR(1000 * kGyroReso * kBlock / kRate,
+              2.0 * atan2(q[3], q[0]) * 180.0 / M_PI, 1e-3);
+}
+
+TEST(FusionQ, Benchmark)
+{
+  Benchmark("madgwick", ts_sensor_update_madgwick,
+            ts_sensor_update_madgwick_q);
+  Benchmark("mahony", ts_sensor_update_mahony,
+            ts_sensor_update_mahony_q);
+}
@@ -54,11 +54,13 @@
 #include <errno.h>
 #include <netinet/in.h>
 #include <math.h>
+#include <time.h>
 
 #include <apps/system/conman.h>
 
 #include "connector.h"
 #include "conn_comm.h"
+#include "conn_comm_dns.h"
 #include "conn_comm_link.h"
 #include "conn_comm_util.h"
 #include "conn_comm_execute_http.h"
@@ -84,10 +86,30 @@
 #define CONNECTION_RETRY_DELAY_SEC    10
 #define CONNECTION_RETRIES            12
 
+#ifdef CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE
+#  ifndef CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE_DEPTH
+#    define CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE_DEPTH 4
+#  endif
+#  if CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE_DEPTH > TASK_MESSAGE_QUEUE_MAX
+#    error "CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE_DEPTH invalid"
+#  endif
+#endif
+
 /****************************************************************************
  * Private Types
  ****************************************************************************/
 
+/* Network request constructed from a task. */
+
+struct conn_request_s
+{
+  struct conn_network_task_s *task;
+  char *hdr;
+  char *data;
+  size_t hdrlen;
+  size_t datalen;
+};
+
 /****************************************************************************
  * Private Function Prototypes
  ****************************************************************************/
@@ -105,6 +127,20 @@ void conn_destroy_task(struct conn_network_task_s *task);
 static con_str_t *con = NULL;
 static conn_protocol_type_t protocol_type;
 
+/* Throughput of the current network session, and of all completed ones. */
+
+static struct conn_network_stats_s session_stats;
+static struct conn_network_stats_s total_stats;
+static struct timespec radio_on_since;
+
+#ifdef CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE
+/* Task taken from the queue while collecting a pipeline, but not part of
+ * it. */
+
+static network_task_s held_task;
+static bool held_task_valid;
+#endif
+
 /****************************************************************************
  * Private Functions
  ****************************************************************************/
@@ -128,13 +164,15 @@ static bool conn_network_is_deepsleep_allowed(void * const priv)
 {
   bool queued;
   bool processing;
+  bool lingering;
 
   pthread_mutex_lock(&con->mutex);
   queued = con->mq_task_count > 0;
   processing = con->processing_task;
+  lingering = con->lingering;
   pthread_mutex_unlock(&con->mutex);
 
-  return !(queued || processing);
+  return !(queued || processing || lingering);
 }
 
 static int request_connection(uint32_t *connid, bool onoff)
@@ -230,84 +268,155 @@ out:
   return ret;
 }
 
-static int execute_task_conn_request(struct conn_network_task_s *task)
+static uint32_t conn_elapsed_msecs(const struct timespec *since)
 {
-  char *hdr = NULL;
-  char *data = NULL;
-  size_t hdrlen = 0;
-  size_t datalen = 0;
-  int ret = ERROR;
-  struct conn_network_task_s *next_task = NULL;
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (now.tv_sec - since->tv_sec) * 1000 +
+         (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+static void conn_stats_report(const char *what,
+                              const struct conn_network_stats_s *stats)
+{
+#ifdef CONFIG_THINGSEE_CONNECTORS_DEBUG
+  uint32_t msecs = stats->radio_on_msecs ? stats->radio_on_msecs : 1;
+  uint32_t bytes = stats->tx_bytes + stats->rx_bytes;
+  unsigned long tasks_rate = (uint64_t)stats->tasks * 100000 / msecs;
+  unsigned long bytes_rate = (uint64_t)bytes * 1000 / msecs;
+  unsigned long msecs_per_kb = bytes ? (uint64_t)msecs * 1024 / bytes : 0;
+
+  con_dbg("%s: %u tasks, %u bytes sent, %u received, radio on %u ms\n",
+          what, stats->tasks, stats->tx_bytes, stats->rx_bytes,
+          stats->radio_on_msecs);
+  con_dbg("%s: %lu.%02lu tasks/s, %lu bytes/s, %lu.%03lu radio-on s/KB\n",
+          what, tasks_rate / 100, tasks_rate % 100, bytes_rate,
+          msecs_per_kb / 1000, msecs_per_kb % 1000);
+#endif
+}
+
+static void conn_stats_session_end(void)
+{
+  session_stats.radio_on_msecs = conn_elapsed_msecs(&radio_on_since);
+
+  pthread_mutex_lock(&con->mutex);
+  total_stats.tasks += session_stats.tasks;
+  total_stats.tx_bytes += session_stats.tx_bytes;
+  total_stats.rx_bytes += session_stats.rx_bytes;
+  total_stats.radio_on_msecs += session_stats.radio_on_msecs;
+  pthread_mutex_unlock(&con->mutex);
+
+  conn_stats_report("Network session", &session_stats);
+  conn_stats_report("Network total", &total_stats);
+
+  memset(&session_stats, 0, sizeof(session_stats));
+}
+
+static void conn_count_putc(char c, void *priv)
+{
+  size_t *count = priv;
+
+  (*count)++;
+}
+
+static int conn_request_construct(struct conn_request_s *req)
+{
+  struct conn_network_task_s *task = req->task;
+  int ret;
 
   DEBUGASSERT(task);
 
+  req->hdr = NULL;
+  req->data = NULL;
+  req->hdrlen = 0;
+  req->datalen = 0;
+
   con_dbg("%s\n", task->title);
 
   con_dbg_save_pos();
 
-  ret = task->construct(task->context, &hdr, &data);
-  if (ret == OK)
+  if (task->body)
     {
-      con_dbg_save_pos();
+      /* Measure streamed body, for 'construct' to put in the header. */
 
-      hdrlen = (hdr != NULL) ? strlen(hdr) : 0;
-      datalen = (data != NULL) ? strlen(data) : 0;
-      if (protocol_type != CON_PROTOCOL_MQTT && hdrlen <= 0)
-        ret = ERROR;
+      if (protocol_type != CON_PROTOCOL_HTTP)
+        {
+          return ERROR;
+        }
+
+      task->context->payload_len = 0;
+      ret = task->body(task->context, conn_count_putc,
+                       &task->context->payload_len);
+      if (ret != OK)
+        {
+          return ret;
+        }
     }
 
+  ret = task->construct(task->context, &req->hdr, &req->data);
   if (ret == OK)
     {
-      int status_code = INT_MIN;
-      struct conn_link_s conn_link;
-      struct conn_content_stream_s content;
+      con_dbg_save_pos();
 
-      con_dbg("Protocol type: %d\n", protocol_type);
+      req->hdrlen = (req->hdr != NULL) ? strlen(req->hdr) : 0;
+      if (req->data != NULL)
+        req->datalen = strlen(req->data);
+      else if (task->body)
+        req->datalen = task->context->payload_len;
+      if (protocol_type != CON_PROTOCOL_MQTT && req->hdrlen <= 0)
+        ret = ERROR;
+    }
 
-      conn_link_init(&conn_link);
-      conn_content_stream_init(&content);
+  return ret;
+}
 
-      con_dbg_save_pos();
+/* Processes the response, queues the workflow's next task or completes the
+ * workflow, and frees the task. 'content' is NULL if the request was never
+ * executed.
+ */
 
-      switch (protocol_type)
-        {
-          case CON_PROTOCOL_HTTP:
-            ret = conn_execute_http_request(con, task, &status_code,
-                                            &conn_link, hdr, hdrlen,
-                                            data, datalen, &content);
-            break;
-          case CON_PROTOCOL_MQTT:
-            ret = conn_execute_mqtt_request(data, datalen, task, &status_code);
-            break;
-          default:
-            /* Do nothing about a wrong protocol type */
-
-            break;
-        }
+static int conn_request_complete(struct conn_request_s *req, int ret,
+                                 int status_code,
+                                 struct conn_content_stream_s *content)
+{
+  struct conn_network_task_s *task = req->task;
+  struct conn_network_task_s *next_task = NULL;
 
+  if (content)
+    {
       if (ret < 0)
         {
           status_code = ret;
         }
 
+      session_stats.tasks++;
+      session_stats.tx_bytes += req->hdrlen + req->datalen;
+
       if (status_code != INT_MIN)
         {
           con_dbg_save_pos();
 
+          if (status_code >= 0)
+            {
+              session_stats.rx_bytes += content->max_content_len;
+            }
+
           if (task->process_stream)
             {
               next_task = task->process_stream(task->context, status_code,
-                                               content.max_content_len,
+                                               content->max_content_len,
                                                conn_content_stream_getc,
-                                               &content);
+                                               content);
             }
           else
             {
               next_task = conn_stream_to_string_and_process(
                                                 task, status_code,
-                                                content.max_content_len,
+                                                content->max_content_len,
                                                 conn_content_stream_getc,
-                                                &content);
+                                                content);
             }
 
           if (next_task != NULL)
@@ -317,8 +426,8 @@ static int execute_task_conn_request(struct conn_network_task_s *task)
             }
         }
 
-      conn_content_stream_close(&content);
-      conn_free_pointer((void**)&hdr);
+      conn_content_stream_close(content);
+      conn_free_pointer((void**)&req->hdr);
     }
 
   if (next_task == NULL) /* We have reached the end of the workflow */
@@ -328,13 +437,13 @@ static int execute_task_conn_request(struct conn_network_task_s *task)
       /* Note, 'data' will be freed in conn_complete_task_workflow() */
 
       conn_complete_task_workflow(task->context, ret);
-      data = NULL;
+      req->data = NULL;
     }
   else if (ret == 0 && !task->context->payload)
     {
       con_dbg_save_pos();
 
-      conn_free_pointer((void**)&data);
+      conn_free_pointer((void**)&req->data);
     }
 
   con_dbg_save_pos();
@@ -344,12 +453,278 @@ static int execute_task_conn_request(struct conn_network_task_s *task)
   return ret;
 }
 
+static int conn_request_execute(struct conn_request_s *req,
+                                struct conn_content_stream_s *content)
+{
+  int status_code = INT_MIN;
+  int ret = ERROR;
+
+  con_dbg("Protocol type: %d\n", protocol_type);
+
+  conn_content_stream_init(content);
+
+  con_dbg_save_pos();
+
+  switch (protocol_type)
+    {
+      case CON_PROTOCOL_HTTP:
+        ret = conn_execute_http_request(con, req->task, &status_code,
+                                        req->hdr, req->hdrlen,
+                                        req->data, req->datalen,
+                                        content);
+        break;
+      case CON_PROTOCOL_MQTT:
+        ret = conn_execute_mqtt_request(req->data, req->datalen, req->task,
+                                        &status_code);
+        break;
+      default:
+        /* Do nothing about a wrong protocol type */
+
+        break;
+    }
+
+  return conn_request_complete(req, ret, status_code, content);
+}
+
+static int execute_task_conn_request(struct conn_network_task_s *task)
+{
+  struct conn_request_s req = { .task = task };
+  struct conn_content_stream_s content;
+  int ret;
+
+  ret = conn_request_construct(&req);
+  if (ret != OK)
+    {
+      return conn_request_complete(&req, ret, INT_MIN, NULL);
+    }
+
+  return conn_request_execute(&req, &content);
+}
+
+#ifdef CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE
+
+/* Executes HTTP tasks going to the same endpoint. The first request is
+ * executed alone, so that it opens the connection and shows whether the
+ * server keeps it. The rest are then written back-to-back on the kept
+ * connection and their responses read in order. Requests left without a
+ * response when the connection closes are sent again one at a time.
+ */
+
+static int execute_task_conn_pipeline(struct conn_network_task_s **tasks,
+                                      int ntasks)
+{
+  struct conn_request_s reqs[CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE_DEPTH];
+  struct conn_content_stream_s content;
+  int result = OK;
+  int nreqs = 0;
+  int nsent;
+  int status_code;
+  int ret;
+  int i;
+
+  DEBUGASSERT(ntasks <= CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE_DEPTH);
+
+  for (i = 0; i < ntasks; i++)
+    {
+      reqs[nreqs].task = tasks[i];
+
+      ret = conn_request_construct(&reqs[nreqs]);
+      if (ret != OK)
+        {
+          result = conn_request_complete(&reqs[nreqs], ret, INT_MIN, NULL);
+          continue;
+        }
+
+      nreqs++;
+    }
+
+  if (nreqs == 0)
+    {
+      return result;
+    }
+
+  ret = conn_request_execute(&reqs[0], &content);
+  if (ret != OK)
+    {
+      result = ret;
+    }
+
+  for (nsent = 1; nsent < nreqs; nsent++)
+    {
+      struct conn_request_s *req = &reqs[nsent];
+
+      ret = conn_http_pipeline_send(con, req->task, req->hdr, req->hdrlen,
+                                    req->data, req->datalen);
+      if (ret != OK)
+        {
+          break;
+        }
+    }
+
+  con_dbg("Pipelined %d of %d requests\n", nsent - 1, nreqs - 1);
+
+  for (i = 1; i < nreqs; i++)
+    {
+      if (i < nsent)
+        {
+          conn_content_stream_init(&content);
+          status_code = INT_MIN;
+
+          ret = conn_http_pipeline_receive(&status_code, &content);
+          if (ret != -ENOTCONN)
+            {
+              ret = conn_request_complete(&reqs[i], ret, status_code,
+                                          &content);
+              if (ret != OK)
+                {
+                  result = ret;
+                }
+              continue;
+            }
+
+          con_dbg("Pipelined connection closed, %d requests unanswered\n",
+                  nsent - i);
+          nsent = i;
+        }
+
+      ret = conn_request_execute(&reqs[i], &content);
+      if (ret != OK)
+        {
+          result = ret;
+        }
+    }
+
+  return result;
+}
+
+/* Takes further queued requests to the same endpoint as 'first' for
+ * pipelining. The first task that does not fit is held back and returned
+ * next by conn_network_receive_task(), so queue order is kept.
+ */
+
+static int conn_network_collect_tasks(struct conn_network_task_s *first,
+                                      struct conn_network_task_s **tasks)
+{
+  FAR const struct timespec ts = { 0, 0 };
+  network_task_s task;
+  int ntasks = 1;
+  bool more;
+
+  tasks[0] = first;
+
+  while (ntasks < CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE_DEPTH)
+    {
+      pthread_mutex_lock(&con->mutex);
+      more = !held_task_valid && con->mq_task_count > 0;
+      pthread_mutex_unlock(&con->mutex);
+
+      if (!more || mq_timedreceive(con->task_mq, (void *)&task,
+                                   sizeof(task), 0, &ts) != sizeof(task))
+        {
+          break;
+        }
+
+      if (task.type != NETWORK_TASK_REQUEST ||
+          !conn_http_same_endpoint(con, first, task.conn))
+        {
+          /* Still counted in 'mq_task_count' until taken. */
+
+          pthread_mutex_lock(&con->mutex);
+          held_task = task;
+          held_task_valid = true;
+          pthread_mutex_unlock(&con->mutex);
+          break;
+        }
+
+      pthread_mutex_lock(&con->mutex);
+      con->mq_task_count = (con->mq_task_count < 2) ? 0 : con->mq_task_count - 1;
+      pthread_mutex_unlock(&con->mutex);
+
+      tasks[ntasks++] = task.conn;
+    }
+
+  return ntasks;
+}
+
+#endif /* CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE */
+
+static int conn_network_receive_task(network_task_s *task, uint32_t connid)
+{
+  struct timespec deadline;
+  ssize_t ret;
+
+#ifdef CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE
+  bool held;
+
+  pthread_mutex_lock(&con->mutex);
+  held = held_task_valid;
+  if (held)
+    {
+      *task = held_task;
+      held_task_valid = false;
+    }
+  pthread_mutex_unlock(&con->mutex);
+
+  if (held)
+    {
+      return OK;
+    }
+#endif
+
+  /* While an idle kept-alive HTTP connection holds the network up, wait
+   * for the next task only until the connection's idle timeout. */
+
+  if (connid != -1 && conn_http_keepalive_deadline(&deadline))
+    {
+      ret = mq_timedreceive(con->task_mq, (void *)task, sizeof(*task), 0,
+                            &deadline);
+      if (ret < 0 && get_errno() == ETIMEDOUT)
+        {
+          return -ETIMEDOUT;
+        }
+    }
+  else
+    {
+      ret = mq_receive(con->task_mq, (void *)task, sizeof(*task), 0);
+    }
+
+  return (ret == sizeof(*task)) ? OK : ERROR;
+}
+
+static void conn_network_release(uint32_t *connid)
+{
+  int ret;
+
+  con_dbg_save_pos();
+
+  conn_http_keepalive_close();
+
+  if (*connid == -1)
+    {
+      return;
+    }
+
+  ret = request_connection(connid, false);
+  if (ret < 0)
+    {
+      con_dbg("request_connection id: %d off failed\n", *connid);
+    }
+  *connid = -1;
+
+  conn_stats_session_end();
+}
+
 static void *conn_network_thread(void *param)
 {
   network_task_s task;
+  struct timespec deadline;
   bool stopped = false;
   bool do_ping;
   uint32_t connid = -1;
+#ifdef CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE
+  struct conn_network_task_s *tasks[CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE_DEPTH];
+  int ntasks;
+#endif
 
   UNUSED(param);
 
@@ -364,9 +739,26 @@ static void *conn_network_thread(void *param)
 
       conn_task_done();
 
-      /* Do we have a new task?. Note, blocks until new task available */
+      /* Do we have a new task?. Note, blocks until new task available or
+       * kept-alive connection times out. */
 
-      if (mq_receive(con->task_mq, (void *)&task, sizeof(task), 0) != sizeof(task))
+      ret = conn_network_receive_task(&task, connid);
+      if (ret == -ETIMEDOUT)
+        {
+          con_dbg("Keep-alive connection idle, releasing network\n");
+
+          conn_network_release(&connid);
+
+          pthread_mutex_lock(&con->mutex);
+          con->lingering = false;
+          pthread_mutex_unlock(&con->mutex);
+
+          /* Ping engine thread, to allow re-evaluation of deep-sleepiness. */
+
+          conn_ping_main_thread();
+          continue;
+        }
+      else if (ret != OK)
         {
           con_dbg("Failed to get task (%d)!!! \n", get_errno());
           continue;
@@ -385,6 +777,7 @@ static void *conn_network_thread(void *param)
       {
       case NETWORK_TASK_STOP:
         con_dbg("Ending network task\n");
+        conn_network_release(&connid);
         stopped = true;
         break;
       case NETWORK_TASK_REQUEST:
@@ -392,6 +785,8 @@ static void *conn_network_thread(void *param)
           {
             con_dbg_save_pos();
 
+            clock_gettime(CLOCK_MONOTONIC, &radio_on_since);
+
             ret = request_connection(&connid, true);
             if (ret < 0)
               {
@@ -402,11 +797,27 @@ static void *conn_network_thread(void *param)
                 conn_destroy_task(task.conn);
                 break;
               }
+
+            /* Refresh expired server addresses in one go. */
+
+            conn_comm_dns_prewarm(con->host);
           }
 
         con_dbg_save_pos();
 
-        ret = execute_task_conn_request(task.conn);
+#ifdef CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE
+        if (protocol_type == CON_PROTOCOL_HTTP)
+          {
+            ntasks = conn_network_collect_tasks(task.conn, tasks);
+            ret = (ntasks > 1) ? execute_task_conn_pipeline(tasks, ntasks) :
+                                 execute_task_conn_request(task.conn);
+          }
+        else
+#endif
+          {
+            ret = execute_task_conn_request(task.conn);
+          }
+
         if (ret != OK)
           {
             con_dbg("Task handling error: %d\n", ret);
@@ -423,16 +834,13 @@ static void *conn_network_thread(void *param)
         con_dbg("Task count: %d\n", task_count);
         pthread_mutex_unlock(&con->mutex);
 
-        if (task_count == 0 && protocol_type == CON_PROTOCOL_HTTP)
-          {
-            con_dbg_save_pos();
+        /* Keep the network up while the server lets us keep the HTTP
+         * connection, so that requests arriving shortly reuse it. */
 
-            ret = request_connection(&connid, false);
-            if (ret < 0)
-              {
-                con_dbg("request_connection id: %d off failed\n", connid);
-              }
-            connid = -1;
+        if (task_count == 0 && protocol_type == CON_PROTOCOL_HTTP &&
+            !conn_http_keepalive_deadline(&deadline))
+          {
+            conn_network_release(&connid);
           }
         break;
       }
@@ -441,6 +849,7 @@ static void *conn_network_thread(void *param)
 
       pthread_mutex_lock(&con->mutex);
       con->processing_task = false;
+      con->lingering = (connid != -1 && conn_http_keepalive_deadline(&deadline));
       do_ping = (task.type == NETWORK_TASK_REQUEST && con->mq_task_count == 0);
       pthread_mutex_unlock(&con->mutex);
       if (do_ping)
@@ -682,6 +1091,7 @@ struct conn_network_task_s* conn_create_network_task(
       task->construct = construct;
       task->process = process;
       task->process_stream = NULL;
+      task->body = NULL;
       task->http.get_conn_params = NULL;
     }
 
@@ -814,6 +1224,24 @@ void conn_empty_message_queue(void)
 
   pthread_mutex_lock(&con->mutex);
 
+#ifdef CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE
+  if (!con->stopping && held_task_valid)
+    {
+      task = held_task;
+      held_task_valid = false;
+
+      con_dbg("Purging held task\n");
+      if (task.type == NETWORK_TASK_REQUEST)
+        {
+          pthread_mutex_unlock(&con->mutex);
+          conn_complete_task_workflow(task.conn->context, ERROR);
+          pthread_mutex_lock(&con->mutex);
+          conn_destroy_task(task.conn);
+        }
+      con->mq_task_count--;
+    }
+#endif
+
   while (!con->stopping && con->mq_task_count > 0 && mq_receive(con->task_mq, (void *)&task, sizeof(task), 0) >= sizeof(task))
     {
       con_dbg("Purging task %d\n", con->mq_task_count);
@@ -833,6 +1261,13 @@ void conn_empty_message_queue(void)
   pthread_mutex_unlock(&con->mutex);
 }
 
+void conn_get_network_stats(struct conn_network_stats_s *stats)
+{
+  pthread_mutex_lock(&con->mutex);
+  *stats = total_stats;
+  pthread_mutex_unlock(&con->mutex);
+}
+
 int conn_uninit(void)
 {
   int ret = OK;
@@ -88,12 +88,25 @@ typedef struct con_str
   bool processing_task:1;
   bool network_ready:1; /* obsolete, write-accessed only */
   bool thread_joining:1;
+  bool lingering:1; /* network kept up for idle HTTP keep-alive connection */
   mqd_t task_mq;
   pthread_mutex_t mutex;
   struct sockaddr_in srv_ip4addr;
   bool stopping;
 } con_str_t;
 
+/* Network throughput counters. Rates are derived against the time the
+ * data connection was held up, which includes connection setup and idle
+ * keep-alive time. */
+
+struct conn_network_stats_s
+{
+  uint32_t tasks;           /* requests executed */
+  uint32_t tx_bytes;        /* request header and content bytes sent */
+  uint32_t rx_bytes;        /* response content bytes received */
+  uint32_t radio_on_msecs;  /* data connection up */
+};
+
 typedef enum
 {
   NETWORK_TASK_STOP,
@@ -103,6 +116,7 @@ typedef enum
 typedef struct
 {
   char *payload;
+  size_t payload_len; /* length of body streamed by task's 'body' callback */
   int process_status;
   struct sockaddr_in srv_ip4addr;
   send_cb_t cb;
@@ -115,9 +129,18 @@ struct conn_http_params_s
   const char *host;
   uint16_t port;
   enum conn_comm_tls_e tls;
-  struct sockaddr_in *ipaddr_cache;
+  struct sockaddr_in *ipaddr_cache; /* receives server address, which is
+                                     * cached by conn_comm_dns */
 };
 
+typedef void (*conn_putc_t)(char c, void *priv);
+
+/* Writes the request body with 'putc_fn'. Called more than once per request
+ * (to measure, then to send), so must write the same body each time. */
+
+typedef int (*conn_request_body_t)
+    (conn_workflow_context_s *context, conn_putc_t putc_fn, void *putc_priv);
+
 typedef int (*conn_request_construct_t)
     (conn_workflow_context_s *context, char **outhdr, char **outdata);
 
@@ -140,6 +163,7 @@ struct conn_network_task_s
   conn_request_construct_t construct; /* Constructs the network request */
   conn_response_process_t process; /* Processes the server response and returns the next task */
   conn_response_process_stream_t process_stream; /* Processes the server response and returns the next task */
+  conn_request_body_t body; /* Streams the request body, when 'construct' gives none (HTTP only) */
   union
   {
     /* Protocol specific helpers. */
@@ -186,6 +210,7 @@ void conn_complete_task_workflow(conn_workflow_context_s *context, int err);
 int conn_init(con_str_t *conn);
 int conn_uninit(void);
 void conn_empty_message_queue(void);
+void conn_get_network_stats(struct conn_network_stats_s *stats);
 #ifdef CONFIG_THINGSEE_ENGINE
 int conn_update_profile(char * const profile);
 #endif
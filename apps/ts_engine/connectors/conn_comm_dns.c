@@ -0,0 +1,376 @@
+/****************************************************************************
+ * apps/ts_engine/connectors/conn_comm_dns.c
+ *
+ * Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <apps/netutils/dnsclient.h>
+
+#include "con_dbg.h"
+#include "conn_comm_dns.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define DNS_CACHE_ENTRIES     CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_ENTRIES
+#define DNS_CACHE_HOST_MAX    64
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* Entry is free when 'host' is empty. Entry with zero 'addr' caches the
+ * name not existing, and one with zero 'expires' has no valid address, but
+ * may still hold the last known one. */
+
+struct conn_dns_entry_s
+{
+  char host[DNS_CACHE_HOST_MAX];
+  in_addr_t addr;
+  time_t expires;               /* CLOCK_MONOTONIC */
+  time_t last_used;             /* CLOCK_MONOTONIC */
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* Kept in RAM, which is retained over deep-sleep (STOP mode). Board code
+ * advances CLOCK_MONOTONIC by the time slept, so expiry times stay valid
+ * across wake-ups. */
+
+static struct {
+  pthread_mutex_t mutex;
+  struct conn_dns_entry_s entries[DNS_CACHE_ENTRIES];
+} g_conn_dns =
+{
+  .mutex = PTHREAD_MUTEX_INITIALIZER
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static time_t dns_cache_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec;
+}
+
+static struct conn_dns_entry_s *dns_cache_find(const char *hostname)
+{
+  int i;
+
+  for (i = 0; i < DNS_CACHE_ENTRIES; i++)
+    {
+      if (g_conn_dns.entries[i].host[0] != '\0' &&
+          !strcmp(g_conn_dns.entries[i].host, hostname))
+        {
+          return &g_conn_dns.entries[i];
+        }
+    }
+
+  return NULL;
+}
+
+/* Returns entry of 'hostname', taking free or least recently used entry
+ * for it if not yet cached. */
+
+static struct conn_dns_entry_s *dns_cache_get(const char *hostname,
+                                              time_t now)
+{
+  struct conn_dns_entry_s *entry;
+  int i;
+
+  if (strlen(hostname) >= DNS_CACHE_HOST_MAX)
+    {
+      return NULL;
+    }
+
+  entry = dns_cache_find(hostname);
+  if (entry)
+    {
+      return entry;
+    }
+
+  entry = &g_conn_dns.entries[0];
+  for (i = 0; i < DNS_CACHE_ENTRIES; i++)
+    {
+      if (g_conn_dns.entries[i].host[0] == '\0')
+        {
+          entry = &g_conn_dns.entries[i];
+          break;
+        }
+
+      if (g_conn_dns.entries[i].last_used < entry->last_used)
+        {
+          entry = &g_conn_dns.entries[i];
+        }
+    }
+
+  if (entry->host[0] != '\0')
+    {
+      con_dbg("DNS cache: dropping '%s' for '%s'\n", entry->host, hostname);
+    }
+
+  memset(entry, 0, sizeof(*entry));
+  strcpy(entry->host, hostname);
+  entry->last_used = now;
+
+  return entry;
+}
+
+/* Stores result of lookup. Failures other than name not existing leave
+ * entry as it was, so that last known address can still be used. */
+
+static void dns_cache_store(const char *hostname, int result,
+                            in_addr_t addr, uint32_t ttl, time_t now)
+{
+  struct conn_dns_entry_s *entry;
+
+  if (result != OK && result != -ENOENT)
+    {
+      return;
+    }
+
+  entry = dns_cache_get(hostname, now);
+  if (!entry)
+    {
+      return;
+    }
+
+  if (result == OK)
+    {
+      if (ttl < CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_MIN_TTL)
+        {
+          ttl = CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_MIN_TTL;
+        }
+      else if (ttl > CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_MAX_TTL)
+        {
+          ttl = CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_MAX_TTL;
+        }
+
+      entry->addr = addr;
+    }
+  else
+    {
+      ttl = CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_NEGATIVE_TTL;
+      entry->addr = 0;
+    }
+
+  entry->expires = now + ttl;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int conn_comm_dns_resolve(const char *hostname, in_addr_t *addr)
+{
+  struct conn_dns_entry_s *entry;
+  in_addr_t resolved = 0;
+  uint32_t ttl = 0;
+  time_t now;
+  int ret;
+  int err;
+
+  pthread_mutex_lock(&g_conn_dns.mutex);
+
+  now = dns_cache_now();
+  entry = dns_cache_find(hostname);
+  if (entry && now < entry->expires)
+    {
+      entry->last_used = now;
+      resolved = entry->addr;
+
+      pthread_mutex_unlock(&g_conn_dns.mutex);
+
+      if (resolved == 0)
+        {
+          con_dbg("DNS cache: '%s' does not exist\n", hostname);
+          errno = ENOENT;
+          return ERROR;
+        }
+
+      *addr = resolved;
+      return OK;
+    }
+
+  pthread_mutex_unlock(&g_conn_dns.mutex);
+
+  /* Not cached or expired, look up without holding the cache. */
+
+  ret = dns_gethostip_multi_ttl(hostname, &resolved, 1, &ttl);
+  err = errno;
+
+  pthread_mutex_lock(&g_conn_dns.mutex);
+
+  now = dns_cache_now();
+  dns_cache_store(hostname, (ret > 0) ? OK : -err, resolved, ttl, now);
+
+  if (ret > 0)
+    {
+      con_dbg("DNS cache: '%s' resolved, ttl %u\n", hostname, ttl);
+
+      *addr = resolved;
+      ret = OK;
+    }
+  else if (err != ENOENT && (entry = dns_cache_find(hostname)) &&
+           entry->addr != 0)
+    {
+      con_dbg("DNS cache: lookup of '%s' failed, using last known address\n",
+              hostname);
+
+      entry->last_used = now;
+      *addr = entry->addr;
+      ret = OK;
+    }
+  else
+    {
+      ret = ERROR;
+    }
+
+  pthread_mutex_unlock(&g_conn_dns.mutex);
+
+  errno = err;
+  return ret;
+}
+
+void conn_comm_dns_invalidate(const char *hostname)
+{
+  struct conn_dns_entry_s *entry;
+
+  pthread_mutex_lock(&g_conn_dns.mutex);
+
+  entry = dns_cache_find(hostname);
+  if (entry)
+    {
+      entry->expires = 0;
+    }
+
+  pthread_mutex_unlock(&g_conn_dns.mutex);
+}
+
+int conn_comm_dns_prewarm(const char *hostname)
+{
+  struct dns_lookup_s lookups[DNS_CACHE_ENTRIES];
+  char (*names)[DNS_CACHE_HOST_MAX];
+  struct conn_dns_entry_s *entry;
+  int nlookups = 0;
+  time_t now;
+  int ret;
+  int i;
+
+  names = malloc(sizeof(*names) * DNS_CACHE_ENTRIES);
+  if (!names)
+    {
+      return ERROR;
+    }
+
+  pthread_mutex_lock(&g_conn_dns.mutex);
+
+  now = dns_cache_now();
+
+  if (hostname && hostname[0] != '\0')
+    {
+      entry = dns_cache_get(hostname, now);
+      if (entry)
+        {
+          entry->last_used = now;
+        }
+    }
+
+  /* Names are copied, as entries may be reused while lookups are done
+   * without holding the cache. */
+
+  for (i = 0; i < DNS_CACHE_ENTRIES; i++)
+    {
+      entry = &g_conn_dns.entries[i];
+      if (entry->host[0] != '\0' && now >= entry->expires)
+        {
+          strcpy(names[nlookups], entry->host);
+          lookups[nlookups].hostname = names[nlookups];
+          nlookups++;
+        }
+    }
+
+  pthread_mutex_unlock(&g_conn_dns.mutex);
+
+  if (nlookups == 0)
+    {
+      free(names);
+      return 0;
+    }
+
+  con_dbg("DNS cache: looking up %d names\n", nlookups);
+
+  ret = dns_gethostip_parallel(lookups, nlookups);
+  if (ret >= 0)
+    {
+      pthread_mutex_lock(&g_conn_dns.mutex);
+
+      now = dns_cache_now();
+      for (i = 0; i < nlookups; i++)
+        {
+          dns_cache_store(lookups[i].hostname, lookups[i].result,
+                          lookups[i].ipaddr, lookups[i].ttl, now);
+        }
+
+      pthread_mutex_unlock(&g_conn_dns.mutex);
+    }
+
+  free(names);
+  return ret;
+}
+
+void conn_comm_dns_flush(void)
+{
+  pthread_mutex_lock(&g_conn_dns.mutex);
+  memset(g_conn_dns.entries, 0, sizeof(g_conn_dns.entries));
+  pthread_mutex_unlock(&g_conn_dns.mutex);
+}
@@ -0,0 +1,126 @@
+/****************************************************************************
+ * apps/ts_engine/connectors/conn_comm_dns.h
+ *
+ * Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#ifndef __APPS_TS_ENGINE_CONNECTORS_CONN_COMM_DNS_H
+#define __APPS_TS_ENGINE_CONNECTORS_CONN_COMM_DNS_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <arpa/inet.h>
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#ifndef CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_ENTRIES
+#  define CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_ENTRIES 4
+#endif
+
+#ifndef CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_MIN_TTL
+#  define CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_MIN_TTL 60
+#endif
+
+#ifndef CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_MAX_TTL
+#  define CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_MAX_TTL 86400
+#endif
+
+#ifndef CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_NEGATIVE_TTL
+#  define CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_NEGATIVE_TTL 60
+#endif
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: conn_comm_dns_resolve
+ *
+ * Description:
+ *   Get IPv4 address of 'hostname' from the resolver cache shared by all
+ *   connectors, or look it up if cached entry has expired. When lookup
+ *   fails for other reason than name not existing, last known address is
+ *   returned even if expired.
+ *
+ * Returned Value:
+ *   OK on success, ERROR otherwise with errno ENOENT if name does not
+ *   exist.
+ *
+ ****************************************************************************/
+
+int conn_comm_dns_resolve(const char *hostname, in_addr_t *addr);
+
+/****************************************************************************
+ * Name: conn_comm_dns_invalidate
+ *
+ * Description:
+ *   Mark cached address of 'hostname' expired, for example after failing
+ *   to connect to it, so that next resolve looks it up again.
+ *
+ ****************************************************************************/
+
+void conn_comm_dns_invalidate(const char *hostname);
+
+/****************************************************************************
+ * Name: conn_comm_dns_prewarm
+ *
+ * Description:
+ *   Add 'hostname' to the cache and look up all cached names that have
+ *   expired, with queries for all of them in flight at the same time.
+ *   Names of earlier requests stay cached, so this also covers other
+ *   servers used by the connector. Called when data connection comes up,
+ *   so that connector requests following it do not each wait for a DNS
+ *   round-trip.
+ *
+ * Returned Value:
+ *   Number of names looked up successfully, or ERROR.
+ *
+ ****************************************************************************/
+
+int conn_comm_dns_prewarm(const char *hostname);
+
+/****************************************************************************
+ * Name: conn_comm_dns_flush
+ *
+ * Description:
+ *   Drop all cached names.
+ *
+ ****************************************************************************/
+
+void conn_comm_dns_flush(void);
+
+#endif /* __APPS_TS_ENGINE_CONNECTORS_CONN_COMM_DNS_H */
@@ -50,6 +50,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <arpa/inet.h>
 #include <pthread.h>
 #include <errno.h>
@@ -59,6 +60,7 @@
 
 #include "connector.h"
 #include "conn_comm.h"
+#include "conn_comm_dns.h"
 #include "conn_comm_link.h"
 #include "conn_comm_util.h"
 #include "conn_comm_execute_http.h"
@@ -74,10 +76,65 @@
 #define CONNECTION_SEND_TIMEOUT       (20 * 1000) /* msecs */
 #define CONNECTION_RECV_TIMEOUT       (30 * 1000) /* msecs */
 
+#define HTTP_LINK_HOST_MAX            64
+
+#ifndef CONFIG_THINGSEE_CONNECTORS_HTTP_BODY_CHUNK
+#  define CONFIG_THINGSEE_CONNECTORS_HTTP_BODY_CHUNK 512
+#endif
+
+#ifdef CONFIG_THINGSEE_CONNECTORS_HTTP_KEEPALIVE
+#  ifndef CONFIG_THINGSEE_CONNECTORS_HTTP_KEEPALIVE_IDLE
+#    define CONFIG_THINGSEE_CONNECTORS_HTTP_KEEPALIVE_IDLE 10
+#  endif
+#endif
+
 /****************************************************************************
  * Private Types
  ****************************************************************************/
 
+/* HTTP connection, kept open between requests to the same host, port and
+ * TLS setting while the server allows it. There is only one: requests are
+ * executed one at a time by the network thread, and the SSL input buffer is
+ * preallocated for a single session.
+ */
+
+struct conn_http_link_s
+{
+  struct conn_link_s link;
+  bool open:1;                  /* 'link' holds a connected socket */
+  bool reusable:1;              /* response framing allows reuse */
+  bool use_ssl:1;
+  uint16_t port;
+  size_t content_left;          /* response content not read from link */
+  struct timespec idle_since;   /* CLOCK_MONOTONIC */
+  char host[HTTP_LINK_HOST_MAX];
+#ifdef CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE
+  size_t pending_len;           /* start of next pipelined response */
+  char pending[CONN_STREAM_BUF_SIZE];
+#endif
+};
+
+/* Where a task's request goes, resolved from its connection parameters. */
+
+struct http_endpoint_s
+{
+  const char *host;
+  uint16_t port;
+  bool use_ssl;
+  struct sockaddr_in *ipaddr;         /* address cache to use */
+  struct sockaddr_in volatile_cache;  /* when task does not provide one */
+};
+
+/* Collects streamed request into link writes of one chunk each. */
+
+struct http_body_sink_s
+{
+  struct conn_http_link_s *http_link;
+  size_t pos;                   /* bytes in 'g_body_chunk' */
+  size_t written;               /* bytes passed to link */
+  int error;
+};
+
 /****************************************************************************
  * Private Function Prototypes
  ****************************************************************************/
@@ -86,30 +143,136 @@
  * Private Data
  ****************************************************************************/
 
+static struct conn_http_link_s g_http_link;
+
+/* Streamed request bodies are written from here, so the whole body never
+ * needs to be in memory. */
+
+static char g_body_chunk[CONFIG_THINGSEE_CONNECTORS_HTTP_BODY_CHUNK];
+
 /****************************************************************************
  * Private Functions
  ****************************************************************************/
 
+static void http_link_close(struct conn_http_link_s *http_link)
+{
+  if (http_link->open)
+    {
+      http_con_dbg("Close connection to %s:%d\n", http_link->host,
+                   http_link->port);
+
+      conn_link_close(&http_link->link);
+      http_link->open = false;
+    }
+
+  http_link->reusable = false;
+#ifdef CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE
+  http_link->pending_len = 0;
+#endif
+}
+
+#ifdef CONFIG_THINGSEE_CONNECTORS_HTTP_KEEPALIVE
+static int http_link_idle_secs(struct conn_http_link_s *http_link)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return now.tv_sec - http_link->idle_since.tv_sec;
+}
+#endif
+
+/* Returns true if the kept-alive connection matches and can be used for
+ * the next request. Any other open connection is closed.
+ */
+
+static bool http_link_reuse(struct conn_http_link_s *http_link,
+                            const char *host, uint16_t port, bool use_ssl)
+{
+#ifdef CONFIG_THINGSEE_CONNECTORS_HTTP_KEEPALIVE
+  if (http_link->open && http_link->reusable &&
+#ifdef CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE
+      http_link->pending_len == 0 &&
+#endif
+      http_link->port == port && http_link->use_ssl == use_ssl &&
+      !strcmp(http_link->host, host) &&
+      http_link_idle_secs(http_link) < CONFIG_THINGSEE_CONNECTORS_HTTP_KEEPALIVE_IDLE)
+    {
+      http_con_dbg("Reuse connection to %s:%d\n", host, port);
+      return true;
+    }
+#endif
+
+  http_link_close(http_link);
+  return false;
+}
+
+static void http_link_opened(struct conn_http_link_s *http_link,
+                             const char *host, uint16_t port, bool use_ssl)
+{
+  size_t hostlen = strlen(host);
+
+  http_link->open = true;
+  http_link->port = port;
+  http_link->use_ssl = use_ssl;
+
+  /* Connection to an overlong host name is not kept. */
+
+  if (hostlen < sizeof(http_link->host))
+    {
+      memcpy(http_link->host, host, hostlen + 1);
+    }
+  else
+    {
+      http_link->host[0] = '\0';
+    }
+}
+
 void execute_http_request_close_link(void *priv)
 {
-  struct conn_link_s *conn_link = priv;
+  struct conn_http_link_s *http_link = priv;
 
-  if (conn_link)
+  if (!http_link || !http_link->open)
     {
-      conn_link_close(conn_link);
+      return;
     }
+
+#ifdef CONFIG_THINGSEE_CONNECTORS_HTTP_KEEPALIVE
+  if (http_link->reusable && http_link->content_left == 0 &&
+      http_link->host[0] != '\0')
+    {
+      /* Response fully read, keep connection for the next request. */
+
+      clock_gettime(CLOCK_MONOTONIC, &http_link->idle_since);
+      return;
+    }
+#endif
+
+  http_link_close(http_link);
 }
 
 ssize_t execute_http_request_read_link(void *priv, void *buf, size_t buflen)
 {
-  struct conn_link_s *conn_link = priv;
+  struct conn_http_link_s *http_link = priv;
+  int ret;
 
-  if (!conn_link)
+  if (!http_link || !http_link->open)
     {
       return -1;
     }
 
-  return conn_link_read(conn_link, (unsigned char *)buf, buflen);
+  ret = conn_link_read(&http_link->link, (unsigned char *)buf, buflen);
+  if (ret <= 0 || ret > http_link->content_left)
+    {
+      http_link->reusable = false;
+      http_link->content_left = 0;
+    }
+  else
+    {
+      http_link->content_left -= ret;
+    }
+
+  return ret;
 }
 
 static bool parse_line_int(const char *line, size_t linelen,
@@ -133,46 +296,37 @@ static bool parse_line_int(const char *line, size_t linelen,
   return false;
 }
 
-/****************************************************************************
- * Public Functions
- ****************************************************************************/
+static bool parse_line_token(const char *line, size_t linelen,
+                             const char *hdr, size_t hdrlen,
+                             const char *token)
+{
+  if (linelen >= hdrlen && !strncasecmp(hdr, line, hdrlen))
+    {
+      line += hdrlen;
 
-int conn_execute_http_request(struct con_str *con,
+      while (*line == ' ' || *line == '\t')
+        line++;
+
+      return !strncasecmp(line, token, strlen(token));
+    }
+
+  return false;
+}
+
+static bool parse_line_present(const char *line, size_t linelen,
+                               const char *hdr, size_t hdrlen)
+{
+  return linelen >= hdrlen && !strncasecmp(hdr, line, hdrlen);
+}
+
+static void http_get_endpoint(struct con_str *con,
                               struct conn_network_task_s *task,
-                              int *pstatus_code,
-                              struct conn_link_s *conn_link,
-                              char *hdr,
-                              size_t hdrlen,
-                              char *pdata,
-                              size_t datalen,
-                              struct conn_content_stream_s *content)
+                              struct http_endpoint_s *ep)
 {
-  const char *bufs[3] = { hdr, pdata, NULL };
-  const size_t lens[3] = { hdrlen, datalen, 0 };
-  const char **pbuf = bufs;
-  const size_t *plen = lens;
-  char linebuf[CONN_STREAM_BUF_SIZE];
-  char *inbuf;
-  size_t sizeof_inbuf;
-  size_t linepos;
-  size_t len;
-  char prev_ch;
-  int linenum;
-  int num;
-  int sock;
-  int ret;
-  int contentlen;
-  size_t pos;
-  const char *host;
-  struct sockaddr_in volatile_cache;
-  struct sockaddr_in *current_srv_ip4addr;
-  bool use_ssl;
-  conn_workflow_context_s *context = task->context;
   struct conn_http_params_s params = {};
-  uint16_t port;
 
   if (!task->http.get_conn_params ||
-      !task->http.get_conn_params(context, &params))
+      !task->http.get_conn_params(task->context, &params))
     {
       params.host = con->host;
       params.port = con->port;
@@ -180,49 +334,52 @@ int conn_execute_http_request(struct con_str *con,
       params.ipaddr_cache = &con->srv_ip4addr;
     }
 
-  port = params.port;
-  host = params.host;
+  ep->host = params.host;
+  ep->port = params.port;
   if (params.ipaddr_cache == NULL)
     {
-      memset(&volatile_cache, 0, sizeof(volatile_cache));
-      params.ipaddr_cache = &volatile_cache;
+      memset(&ep->volatile_cache, 0, sizeof(ep->volatile_cache));
+      params.ipaddr_cache = &ep->volatile_cache;
     }
-  current_srv_ip4addr = params.ipaddr_cache;
+  ep->ipaddr = params.ipaddr_cache;
 
   switch (params.tls)
     {
     case CONN_COMM_TLS_AUTO:
-      use_ssl = (port == 443);
+      ep->use_ssl = (ep->port == 443);
       break;
     case CONN_COMM_TLS_ENABLE:
-      use_ssl = true;
+      ep->use_ssl = true;
       break;
     case CONN_COMM_TLS_DISABLE:
-      use_ssl = false;
+      ep->use_ssl = false;
       break;
     default:
       DEBUGASSERT(false);
+      ep->use_ssl = false;
       break;
     }
+}
 
-  DEBUGASSERT(hdr && pstatus_code && content && conn_link);
-
-  *pstatus_code = ERROR;
+static int http_link_connect(struct con_str *con,
+                             struct conn_http_link_s *http_link,
+                             struct http_endpoint_s *ep)
+{
+  int sock;
+  int ret;
 
-  http_con_dbg("%s:\n%s%s", use_ssl ? "HTTPS" : "HTTP", hdr, pdata);
+  conn_link_init(&http_link->link);
 
-  /* Fetch server IP address. */
+  /* Fetch server IP address. Shared resolver cache keeps it for its
+   * time-to-live, so this does a DNS lookup only when it has expired. */
 
-  if (current_srv_ip4addr->sin_addr.s_addr == 0)
-    {
-      con_dbg_save_pos();
+  con_dbg_save_pos();
 
-      con->network_ready = false;
-      if (conn_comm_get_server_address(current_srv_ip4addr, host) != OK)
-        return NETWORK_ERROR;
+  con->network_ready = false;
+  if (conn_comm_get_server_address(ep->ipaddr, ep->host) != OK)
+    return NETWORK_ERROR;
 
-      con->network_ready = true;
-    }
+  con->network_ready = true;
 
   con_dbg_save_pos();
 
@@ -235,15 +392,15 @@ int conn_execute_http_request(struct con_str *con,
 
   con_dbg_save_pos();
 
-  http_con_dbg("Connect to port %d ...\n", port);
-  current_srv_ip4addr->sin_port = htons(port);
-  ret = connect(sock, (struct sockaddr *)current_srv_ip4addr, sizeof(*current_srv_ip4addr));
+  http_con_dbg("Connect to port %d ...\n", ep->port);
+  ep->ipaddr->sin_port = htons(ep->port);
+  ret = connect(sock, (struct sockaddr *)ep->ipaddr, sizeof(*ep->ipaddr));
   if (ret < 0)
     {
       /* Could not connect to server. Try updating server IP address on
        * next try. */
 
-      memset(current_srv_ip4addr, 0, sizeof(*current_srv_ip4addr));
+      conn_comm_dns_invalidate(ep->host);
       goto err_close;
     }
 
@@ -251,40 +408,169 @@ int conn_execute_http_request(struct con_str *con,
 
   /* Initialize connection (http / https). */
 
-  if (conn_link_open(conn_link, &sock, use_ssl, CONNECTION_RECV_TIMEOUT,
+  if (conn_link_open(&http_link->link, &sock, ep->use_ssl,
+                     CONNECTION_RECV_TIMEOUT,
                      CONNECTION_SEND_TIMEOUT) < 0)
     {
       goto err_close;
     }
 
+  DEBUGASSERT(sock < 0);
+  http_link_opened(http_link, ep->host, ep->port, ep->use_ssl);
+  return OK;
+
+err_close:
+  conn_link_close(&http_link->link);
+  http_link->open = false;
+  http_link->reusable = false;
+  if (sock >= 0)
+    close(sock);
+  http_con_dbg("Socket closed!\n");
+  return NETWORK_ERROR;
+}
+
+static void http_body_flush(struct http_body_sink_s *sink)
+{
+  const char *bufs[2] = { g_body_chunk, NULL };
+  const size_t lens[2] = { sink->pos, 0 };
+
+  if (sink->pos == 0 || sink->error)
+    {
+      return;
+    }
+
+  if (conn_link_write(&sink->http_link->link, bufs, lens) < 0)
+    {
+      sink->error = ERROR;
+    }
+
+  sink->written += sink->pos;
+  sink->pos = 0;
+}
+
+static void http_body_putc(char c, void *priv)
+{
+  struct http_body_sink_s *sink = priv;
+
+  g_body_chunk[sink->pos++] = c;
+  if (sink->pos == sizeof(g_body_chunk))
+    {
+      http_body_flush(sink);
+    }
+}
+
+static int http_link_send(struct conn_http_link_s *http_link,
+                          struct conn_network_task_s *task,
+                          char *hdr, size_t hdrlen,
+                          char *pdata, size_t datalen)
+{
+  const char *bufs[3] = { hdr, pdata, NULL };
+  const size_t lens[3] = { hdrlen, datalen, 0 };
+  struct http_body_sink_s sink = {};
+  size_t pos;
+  int ret;
+
   con_dbg_save_pos();
 
-  /* Send data to the server */
+  if (pdata != NULL || !task->body || datalen == 0)
+    {
+      return conn_link_write(&http_link->link, bufs, lens);
+    }
+
+  /* Stream header and body through the chunk buffer. */
 
-  if (conn_link_write(conn_link, pbuf, plen) < 0)
+  sink.http_link = http_link;
+
+  for (pos = 0; pos < hdrlen; pos++)
     {
-      goto err_close;
+      http_body_putc(hdr[pos], &sink);
+    }
+
+  ret = task->body(task->context, http_body_putc, &sink);
+  http_body_flush(&sink);
+
+  if (sink.error)
+    {
+      return ERROR;
+    }
+
+  if (ret != OK || sink.written != hdrlen + datalen)
+    {
+      /* Body failed, or differs from the one measured for Content-Length.
+       * Server is left waiting for the rest of the request. */
+
+      con_dbg("Streamed body failed, length %d, expected %d\n",
+              (int)(sink.written - hdrlen), (int)datalen);
+      return -EINVAL;
     }
 
+  return sink.written;
+}
+
+/* Reads response status line and headers, and prepares content stream for
+ * the content that follows. Returns -ENOTCONN if the connection was closed
+ * before any of the response was received.
+ */
+
+static int http_read_response(struct conn_http_link_s *http_link,
+                              int *pstatus_code,
+                              struct conn_content_stream_s *content)
+{
+  char linebuf[CONN_STREAM_BUF_SIZE];
+  char *inbuf;
+  size_t sizeof_inbuf;
+  size_t linepos;
+  size_t len;
+  char prev_ch;
+  int linenum;
+  int num;
+  int ret;
+  int contentlen;
+  bool have_contentlen;
+  size_t pos;
+
   http_con_dbg("Wait response...\n");
 
-  /* Read HTTP header. */
+  /* Read HTTP header. The connection stays reusable only if the response
+   * is HTTP/1.1 with its length known up front and the server does not ask
+   * to close. */
 
   linepos = 0;
   prev_ch = 0;
   linenum = 0;
   contentlen = 0;
+  have_contentlen = false;
   len = 0;
   inbuf = content->buf;
   sizeof_inbuf = sizeof(content->buf);
+  http_link->reusable = true;
   do
     {
       con_dbg_save_pos();
 
-      ret = conn_link_read(conn_link, (unsigned char *)inbuf, sizeof_inbuf);
+#ifdef CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE
+      if (http_link->pending_len > 0)
+        {
+          /* Received already with the previous response. */
+
+          ret = http_link->pending_len;
+          memcpy(inbuf, http_link->pending, ret);
+          http_link->pending_len = 0;
+        }
+      else
+#endif
+        {
+          ret = conn_link_read(&http_link->link, (unsigned char *)inbuf,
+                               sizeof_inbuf);
+        }
       http_con_dbg("conn_link_read, ret=%d\n", ret);
       if (ret <= 0)
-        goto invalid_response;
+        {
+          if (linenum == 0 && linepos == 0)
+            return -ENOTCONN;
+
+          goto invalid_response;
+        }
 
       con_dbg_save_pos();
 
@@ -320,6 +606,13 @@ int conn_execute_http_request(struct con_str *con,
 
                       goto invalid_response;
                     }
+
+                  if (*pstatus_code == 204 || *pstatus_code == 304)
+                    {
+                      /* No content, even without Content-Length. */
+
+                      have_contentlen = true;
+                    }
                 }
               else if (linenum > 0)
                 {
@@ -350,6 +643,10 @@ int conn_execute_http_request(struct con_str *con,
 
                   static const char content_len[] = "CONTENT-LENGTH:";
                   const size_t content_len_len = sizeof(content_len) - 1;
+                  static const char connection[] = "CONNECTION:";
+                  const size_t connection_len = sizeof(connection) - 1;
+                  static const char transfer_enc[] = "TRANSFER-ENCODING:";
+                  const size_t transfer_enc_len = sizeof(transfer_enc) - 1;
 
                   if (parse_line_int(linebuf, linepos, content_len,
                                      content_len_len, &contentlen)
@@ -358,6 +655,14 @@ int conn_execute_http_request(struct con_str *con,
                       /* Got content length! */
 
                       http_con_dbg("HTTP Content length = %d!\n", contentlen);
+                      have_contentlen = true;
+                    }
+                  else if (parse_line_token(linebuf, linepos, connection,
+                                            connection_len, "close") ||
+                           parse_line_present(linebuf, linepos, transfer_enc,
+                                              transfer_enc_len))
+                    {
+                      http_link->reusable = false;
                     }
                 }
 
@@ -380,6 +685,26 @@ handle_content:
 
   con_dbg_save_pos();
 
+#ifdef CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE
+  if (have_contentlen && len > (size_t)contentlen)
+    {
+      /* Read past the content into the next pipelined response, keep it
+       * for the next read. */
+
+      http_link->pending_len = len - contentlen;
+      memcpy(http_link->pending, &inbuf[contentlen], http_link->pending_len);
+      len = contentlen;
+    }
+#endif
+
+  if (!have_contentlen || len > (size_t)contentlen)
+    {
+      http_link->reusable = false;
+    }
+
+  http_link->content_left = (len < (size_t)contentlen) ?
+                            (size_t)contentlen - len : 0;
+
   /* Prepare content stream. */
 
   content->buf_pos = 0;
@@ -388,24 +713,201 @@ handle_content:
   content->max_content_len = contentlen;
   content->link_close = execute_http_request_close_link;
   content->link_read = execute_http_request_read_link;
-  content->conn_link = conn_link;
+  content->conn_link = http_link;
 
-  DEBUGASSERT(sock < 0);
   http_con_dbg("Done!\n");
   return OK;
 
 invalid_response:
   http_con_dbg("Invalid HTTP response!\n");
-  conn_link_close(conn_link);
-  if (sock >= 0)
-    close(sock);
+  http_link_close(http_link);
   http_con_dbg("Socket closed!\n");
   return ERROR;
+}
 
-err_close:
-  conn_link_close(conn_link);
-  if (sock >= 0)
-    close(sock);
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int conn_execute_http_request(struct con_str *con,
+                              struct conn_network_task_s *task,
+                              int *pstatus_code,
+                              char *hdr,
+                              size_t hdrlen,
+                              char *pdata,
+                              size_t datalen,
+                              struct conn_content_stream_s *content)
+{
+  struct conn_http_link_s *http_link = &g_http_link;
+  struct http_endpoint_s ep;
+  bool reused;
+  int ret;
+
+  DEBUGASSERT(hdr && pstatus_code && content);
+
+  http_get_endpoint(con, task, &ep);
+
+  *pstatus_code = ERROR;
+
+  http_con_dbg("%s:\n%s%s", ep.use_ssl ? "HTTPS" : "HTTP", hdr,
+               pdata ? pdata : "");
+
+  reused = http_link_reuse(http_link, ep.host, ep.port, ep.use_ssl);
+
+reconnect:
+
+  if (!reused)
+    {
+      ret = http_link_connect(con, http_link, &ep);
+      if (ret < 0)
+        {
+          return ret;
+        }
+    }
+
+  /* Send data to the server */
+
+  ret = http_link_send(http_link, task, hdr, hdrlen, pdata, datalen);
+  if (ret == -EINVAL)
+    {
+      http_link_close(http_link);
+      return ERROR;
+    }
+  else if (ret < 0)
+    {
+      goto err_reconnect;
+    }
+
+  ret = http_read_response(http_link, pstatus_code, content);
+  if (ret == -ENOTCONN)
+    {
+      goto err_reconnect;
+    }
+
+  return ret;
+
+err_reconnect:
+  http_link_close(http_link);
   http_con_dbg("Socket closed!\n");
+
+  if (reused)
+    {
+      /* Server closed the kept-alive connection before seeing the request,
+       * send it again on a fresh one. */
+
+      http_con_dbg("Kept-alive connection lost, reconnecting...\n");
+      reused = false;
+      goto reconnect;
+    }
+
   return NETWORK_ERROR;
 }
+
+#ifdef CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE
+
+bool conn_http_same_endpoint(struct con_str *con,
+                             struct conn_network_task_s *task1,
+                             struct conn_network_task_s *task2)
+{
+  struct http_endpoint_s ep1;
+  struct http_endpoint_s ep2;
+
+  http_get_endpoint(con, task1, &ep1);
+  http_get_endpoint(con, task2, &ep2);
+
+  return ep1.port == ep2.port && ep1.use_ssl == ep2.use_ssl &&
+         ep1.host && ep2.host && !strcmp(ep1.host, ep2.host);
+}
+
+int conn_http_pipeline_send(struct con_str *con,
+                            struct conn_network_task_s *task,
+                            char *hdr,
+                            size_t hdrlen,
+                            char *pdata,
+                            size_t datalen)
+{
+  struct conn_http_link_s *http_link = &g_http_link;
+  struct http_endpoint_s ep;
+
+  DEBUGASSERT(hdr);
+
+  http_get_endpoint(con, task, &ep);
+
+  /* Only pipelined on a connection the server has already agreed to keep
+   * open. */
+
+  if (!http_link_reuse(http_link, ep.host, ep.port, ep.use_ssl))
+    {
+      return ERROR;
+    }
+
+  http_con_dbg("%s (pipelined):\n%s%s", ep.use_ssl ? "HTTPS" : "HTTP", hdr,
+               pdata ? pdata : "");
+
+  if (http_link_send(http_link, task, hdr, hdrlen, pdata, datalen) < 0)
+    {
+      http_link_close(http_link);
+      return NETWORK_ERROR;
+    }
+
+  return OK;
+}
+
+int conn_http_pipeline_receive(int *pstatus_code,
+                               struct conn_content_stream_s *content)
+{
+  struct conn_http_link_s *http_link = &g_http_link;
+  int ret;
+
+  DEBUGASSERT(pstatus_code && content);
+
+  *pstatus_code = ERROR;
+
+  /* Previous response closed the connection, or was not read to the end. */
+
+  if (!http_link->open)
+    {
+      return -ENOTCONN;
+    }
+
+  ret = http_read_response(http_link, pstatus_code, content);
+  if (ret == -ENOTCONN)
+    {
+      http_link_close(http_link);
+    }
+
+  return ret;
+}
+
+#endif /* CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE */
+
+bool conn_http_keepalive_deadline(struct timespec *abstime)
+{
+#ifdef CONFIG_THINGSEE_CONNECTORS_HTTP_KEEPALIVE
+  int left;
+
+  if (!g_http_link.open || !g_http_link.reusable)
+    {
+      return false;
+    }
+
+  left = CONFIG_THINGSEE_CONNECTORS_HTTP_KEEPALIVE_IDLE -
+         http_link_idle_secs(&g_http_link);
+  if (left <= 0)
+    {
+      return false;
+    }
+
+  clock_gettime(CLOCK_REALTIME, abstime);
+  abstime->tv_sec += left;
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+void conn_http_keepalive_close(void)
+{
+  http_link_close(&g_http_link);
+}
@@ -46,6 +46,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <time.h>
 #include <arpa/inet.h>
 
 /****************************************************************************
@@ -55,27 +56,73 @@
 #define HTTP_DEFAULT_USER_AGENT            "tsone/0.3"
 #define HTTP_DEFAULT_PORT                  80
 
+#ifdef CONFIG_THINGSEE_CONNECTORS_HTTP_KEEPALIVE
+#  define HTTP_CONNECTION_HEADER           "Connection: keep-alive\r\n"
+#else
+#  define HTTP_CONNECTION_HEADER           "Connection: close\r\n"
+#endif
+
 /****************************************************************************
  * Public Types
  ****************************************************************************/
 
 struct con_str;
 struct conn_network_task_s;
-struct conn_link_s;
 struct conn_content_stream_s;
 
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
 
+/* Send request and read response header. Without 'pdata', a body of
+ * 'datalen' bytes is streamed from the task's 'body' callback. */
+
 int conn_execute_http_request(struct con_str *con,
                               struct conn_network_task_s *task,
                               int *pstatus_code,
-                              struct conn_link_s *conn_link,
                               char *hdr,
                               size_t hdrlen,
                               char *pdata,
                               size_t datalen,
                               struct conn_content_stream_s *content);
 
+#ifdef CONFIG_THINGSEE_CONNECTORS_HTTP_PIPELINE
+
+/* True if both tasks send their requests to the same host, port and TLS
+ * setting. */
+
+bool conn_http_same_endpoint(struct con_str *con,
+                             struct conn_network_task_s *task1,
+                             struct conn_network_task_s *task2);
+
+/* Write request on the kept-alive connection without waiting for the
+ * response. Returns ERROR, without sending, if there is no open connection
+ * to the task's endpoint. */
+
+int conn_http_pipeline_send(struct con_str *con,
+                            struct conn_network_task_s *task,
+                            char *hdr,
+                            size_t hdrlen,
+                            char *pdata,
+                            size_t datalen);
+
+/* Read response to the oldest pipelined request. Previous response content
+ * must have been closed. Returns -ENOTCONN if the connection was closed
+ * before the response; the request should then be sent again. */
+
+int conn_http_pipeline_receive(int *pstatus_code,
+                               struct conn_content_stream_s *content);
+
+#endif
+
+/* Idle kept-alive connection: returns true and the absolute CLOCK_REALTIME
+ * time at which it should be closed. */
+
+bool conn_http_keepalive_deadline(struct timespec *abstime);
+
+/* Close kept-alive connection, if any. Must be done before the network
+ * connection under it goes down. */
+
+void conn_http_keepalive_close(void);
+
 #endif /* __APPS_TS_ENGINE_CONNECTORS_CONN_COMM_EXECUTE_HTTP_H */
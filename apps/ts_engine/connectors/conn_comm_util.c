@@ -51,9 +51,8 @@
 #include <errno.h>
 #include <pthread.h>
 
-#include <apps/netutils/dnsclient.h>
-
 #include "con_dbg.h"
+#include "conn_comm_dns.h"
 #include "conn_comm_util.h"
 
 /****************************************************************************
@@ -113,7 +112,7 @@ int conn_comm_get_server_address(struct sockaddr_in *addr,
 
   con_dbg("Getting IP address for '%s'\n", hostname);
 
-  ret = dns_gethostip(hostname, &addr->sin_addr.s_addr);
+  ret = conn_comm_dns_resolve(hostname, &addr->sin_addr.s_addr);
   if (ret != OK)
     {
       con_dbg("Failed to get address for '%s'\n", hostname);
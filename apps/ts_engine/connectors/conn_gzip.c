@@ -0,0 +1,341 @@
+/****************************************************************************
+ * apps/ts_engine/connectors/conn_gzip.c
+ *
+ * Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <crc32.h>
+
+#include "conn_gzip.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define GZIP_MIN_MATCH          3
+#define GZIP_MAX_MATCH          130 /* Lookahead kept in the window */
+#define GZIP_MAX_DIST           (CONN_GZIP_WINDOW - GZIP_MAX_MATCH)
+#define GZIP_MAX_CHAIN          16
+#define GZIP_END_OF_BLOCK       256
+
+#if (CONN_GZIP_WINDOW & (CONN_GZIP_WINDOW - 1)) || \
+    CONN_GZIP_WINDOW < 2 * GZIP_MAX_MATCH || CONN_GZIP_WINDOW > 32768
+#  error "CONFIG_THINGSEE_CONNECTORS_GZIP_WINDOW must be power of two, 512..32768"
+#endif
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* Deflate length codes 257..285 and distance codes 0..29 (RFC 1951). */
+
+static const uint16_t g_len_base[29] =
+{
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+  67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t g_len_extra[29] =
+{
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4,
+  5, 5, 5, 5, 0
+};
+
+static const uint16_t g_dist_base[30] =
+{
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513,
+  769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t g_dist_extra[30] =
+{
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10,
+  11, 11, 12, 12, 13, 13
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static void gzip_put_bits(struct conn_gzip_s *gz, uint32_t value, int nbits)
+{
+  gz->bitbuf |= value << gz->bitcount;
+  gz->bitcount += nbits;
+
+  while (gz->bitcount >= 8)
+    {
+      gz->putc_fn(gz->bitbuf & 0xff, gz->putc_priv);
+      gz->bitbuf >>= 8;
+      gz->bitcount -= 8;
+    }
+}
+
+/* Huffman codes are packed starting from the most significant bit. */
+
+static void gzip_put_code(struct conn_gzip_s *gz, uint32_t code, int nbits)
+{
+  uint32_t reversed = 0;
+  int i;
+
+  for (i = 0; i < nbits; i++)
+    {
+      reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+
+  gzip_put_bits(gz, reversed, nbits);
+}
+
+static void gzip_put_symbol(struct conn_gzip_s *gz, int sym)
+{
+  if (sym < 144)
+    {
+      gzip_put_code(gz, 0x30 + sym, 8);
+    }
+  else if (sym < 256)
+    {
+      gzip_put_code(gz, 0x190 + sym - 144, 9);
+    }
+  else if (sym < 280)
+    {
+      gzip_put_code(gz, sym - 256, 7);
+    }
+  else
+    {
+      gzip_put_code(gz, 0xc0 + sym - 280, 8);
+    }
+}
+
+static void gzip_put_match(struct conn_gzip_s *gz, int len, int dist)
+{
+  int code;
+
+  code = 28;
+  while (g_len_base[code] > len)
+    {
+      code--;
+    }
+
+  gzip_put_symbol(gz, 257 + code);
+  gzip_put_bits(gz, len - g_len_base[code], g_len_extra[code]);
+
+  code = 29;
+  while (g_dist_base[code] > dist)
+    {
+      code--;
+    }
+
+  gzip_put_code(gz, code, 5);
+  gzip_put_bits(gz, dist - g_dist_base[code], g_dist_extra[code]);
+}
+
+static void gzip_put_u32(struct conn_gzip_s *gz, uint32_t value)
+{
+  int i;
+
+  for (i = 0; i < 4; i++)
+    {
+      gz->putc_fn((value >> (i * 8)) & 0xff, gz->putc_priv);
+    }
+}
+
+static inline uint8_t gzip_byte(struct conn_gzip_s *gz, uint32_t pos)
+{
+  return gz->window[pos & (CONN_GZIP_WINDOW - 1)];
+}
+
+/* Add string starting at 'pos' to the hash chains. Positions are kept
+ * modulo 2^16, so chains may point to wrong places; matches are verified
+ * against the window.
+ */
+
+static void gzip_insert(struct conn_gzip_s *gz, uint32_t pos)
+{
+  uint32_t h;
+
+  if (pos + GZIP_MIN_MATCH > gz->in_pos)
+    {
+      return;
+    }
+
+  h = (gzip_byte(gz, pos) << 16) | (gzip_byte(gz, pos + 1) << 8) |
+      gzip_byte(gz, pos + 2);
+  h = (h * 0x9e3779b1u) >> (32 - CONN_GZIP_HASH_BITS);
+
+  gz->prev[pos & (CONN_GZIP_WINDOW - 1)] = gz->head[h];
+  gz->head[h] = pos;
+}
+
+static int gzip_longest_match(struct conn_gzip_s *gz, int maxlen, int *dist)
+{
+  uint32_t pos = gz->pos;
+  uint16_t cand;
+  int bestlen = 0;
+  int lastdist = 0;
+  int chain;
+  int d;
+  int len;
+
+  /* Current position was inserted last, so its chain starts from prev. */
+
+  cand = gz->prev[pos & (CONN_GZIP_WINDOW - 1)];
+
+  for (chain = 0; chain < GZIP_MAX_CHAIN; chain++)
+    {
+      d = (uint16_t)(pos - cand);
+      if (d <= lastdist || d > GZIP_MAX_DIST || (uint32_t)d > pos)
+        {
+          break;
+        }
+
+      len = 0;
+      while (len < maxlen &&
+             gzip_byte(gz, pos - d + len) == gzip_byte(gz, pos + len))
+        {
+          len++;
+        }
+
+      if (len > bestlen)
+        {
+          bestlen = len;
+          *dist = d;
+          if (len == maxlen)
+            {
+              break;
+            }
+        }
+
+      lastdist = d;
+      cand = gz->prev[cand & (CONN_GZIP_WINDOW - 1)];
+    }
+
+  return bestlen;
+}
+
+/* Encode literal or match at current position. */
+
+static void gzip_deflate_one(struct conn_gzip_s *gz)
+{
+  int avail = gz->in_pos - gz->pos;
+  int len = 0;
+  int dist = 0;
+
+  gzip_insert(gz, gz->pos);
+
+  if (avail >= GZIP_MIN_MATCH)
+    {
+      len = gzip_longest_match(gz, avail < GZIP_MAX_MATCH ? avail :
+                               GZIP_MAX_MATCH, &dist);
+    }
+
+  if (len < GZIP_MIN_MATCH)
+    {
+      gzip_put_symbol(gz, gzip_byte(gz, gz->pos));
+      gz->pos++;
+      return;
+    }
+
+  gzip_put_match(gz, len, dist);
+
+  while (--len > 0)
+    {
+      gzip_insert(gz, ++gz->pos);
+    }
+
+  gz->pos++;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+void conn_gzip_init(struct conn_gzip_s *gz, conn_putc_t putc_fn,
+                    void *putc_priv)
+{
+  static const uint8_t header[10] =
+  {
+    0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 255 /* deflate, no mtime, unknown OS */
+  };
+  size_t i;
+
+  memset(gz, 0, sizeof(*gz));
+  gz->putc_fn = putc_fn;
+  gz->putc_priv = putc_priv;
+  gz->crc = 0xffffffff;
+
+  for (i = 0; i < sizeof(header); i++)
+    {
+      putc_fn(header[i], putc_priv);
+    }
+
+  /* Final block with fixed Huffman codes. */
+
+  gzip_put_bits(gz, 1, 1);
+  gzip_put_bits(gz, 1, 2);
+}
+
+void conn_gzip_putc(char c, void *priv)
+{
+  struct conn_gzip_s *gz = priv;
+  uint8_t byte = c;
+
+  gz->crc = crc32part(&byte, 1, gz->crc);
+  gz->window[gz->in_pos & (CONN_GZIP_WINDOW - 1)] = byte;
+  gz->in_pos++;
+
+  while (gz->in_pos - gz->pos >= GZIP_MAX_MATCH)
+    {
+      gzip_deflate_one(gz);
+    }
+}
+
+void conn_gzip_finish(struct conn_gzip_s *gz)
+{
+  while (gz->pos < gz->in_pos)
+    {
+      gzip_deflate_one(gz);
+    }
+
+  gzip_put_symbol(gz, GZIP_END_OF_BLOCK);
+  gzip_put_bits(gz, 0, 7); /* Flush to byte boundary */
+  gz->bitbuf = 0;
+  gz->bitcount = 0;
+
+  gzip_put_u32(gz, gz->crc ^ 0xffffffff);
+  gzip_put_u32(gz, gz->in_pos);
+}
@@ -0,0 +1,103 @@
+/****************************************************************************
+ * apps/ts_engine/connectors/conn_gzip.h
+ *
+ * Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#ifndef __APPS_TS_ENGINE_CONNECTORS_CONN_GZIP_H
+#define __APPS_TS_ENGINE_CONNECTORS_CONN_GZIP_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+
+#include "conn_comm.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+/* History searched for repeated strings, power of two. */
+
+#ifndef CONFIG_THINGSEE_CONNECTORS_GZIP_WINDOW
+#  define CONFIG_THINGSEE_CONNECTORS_GZIP_WINDOW 2048
+#endif
+
+#define CONN_GZIP_WINDOW                   CONFIG_THINGSEE_CONNECTORS_GZIP_WINDOW
+#define CONN_GZIP_HASH_BITS                10
+#define CONN_GZIP_CONTENT_ENCODING         "gzip"
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+/* Streaming gzip (RFC 1952) compressor: one deflate block with the fixed
+ * Huffman codes. Output is written to 'putc_fn' as input is given.
+ */
+
+struct conn_gzip_s
+{
+  conn_putc_t putc_fn;
+  void *putc_priv;
+  uint32_t crc;
+  uint32_t in_pos;      /* Input bytes given */
+  uint32_t pos;         /* Input bytes compressed */
+  uint32_t bitbuf;
+  int bitcount;
+  uint8_t window[CONN_GZIP_WINDOW];
+  uint16_t prev[CONN_GZIP_WINDOW];
+  uint16_t head[1 << CONN_GZIP_HASH_BITS];
+};
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/* Start compressed stream to 'putc_fn'. */
+
+void conn_gzip_init(struct conn_gzip_s *gz, conn_putc_t putc_fn,
+                    void *putc_priv);
+
+/* Compress one byte; 'priv' is the struct conn_gzip_s, so that this can be
+ * given as putc callback to body producers.
+ */
+
+void conn_gzip_putc(char c, void *priv);
+
+/* Compress rest of the input and end the stream. */
+
+void conn_gzip_finish(struct conn_gzip_s *gz);
+
+#endif /* __APPS_TS_ENGINE_CONNECTORS_CONN_GZIP_H */
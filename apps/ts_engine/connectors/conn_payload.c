@@ -0,0 +1,454 @@
+/****************************************************************************
+ * apps/ts_engine/connectors/conn_payload.c
+ *
+ * Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <debug.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <apps/netutils/cJSON.h>
+#ifdef CONFIG_THINGSEE_CONNECTORS_CBOR
+#  include <apps/netutils/cbor.h>
+#endif
+
+#include "connector.h"
+#include "con_dbg.h"
+#include "conn_payload.h"
+#include "engine/log_record.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#ifdef CONFIG_THINGSEE_CONNECTORS_CBOR
+
+/* Payloads are encoded one at a time to this buffer; larger ones to a
+ * temporary allocation. */
+
+#define CONN_CBOR_BUF_SIZE                 256
+
+/* Doubles with integral value below this are exact as int64_t. */
+
+#define CONN_CBOR_MAX_EXACT_INT            9007199254740992.0
+
+#endif
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+#ifdef CONFIG_THINGSEE_CONNECTORS_CBOR
+static uint8_t g_cbor_buf[CONN_CBOR_BUF_SIZE];
+#endif
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+#ifdef CONFIG_THINGSEE_CONNECTORS_CBOR
+static CborError conn_payload_cbor_double(CborEncoder *encoder, double d)
+{
+  float f = (float)d;
+
+  if (d > -CONN_CBOR_MAX_EXACT_INT && d < CONN_CBOR_MAX_EXACT_INT &&
+      d == (double)(int64_t)d)
+    {
+      return cbor_encode_int(encoder, (int64_t)d);
+    }
+
+  if ((double)f == d)
+    {
+      return cbor_encode_float(encoder, f);
+    }
+
+  return cbor_encode_double(encoder, d);
+}
+
+/* Errors are or'ed together: encoding continues after running out of
+ * buffer to find out the length needed. Returns CborErrorUnknownType for
+ * value types that cannot be encoded.
+ */
+
+static CborError conn_payload_cbor_value(CborEncoder *encoder,
+                                       const char *label,
+                                       const struct ts_value *value)
+{
+  CborEncoder array, entry;
+  CborError err = CborNoError;
+  int i;
+
+  switch (value->valuetype)
+    {
+    case VALUEDOUBLE:
+      return conn_payload_cbor_double(encoder, value->valuedouble);
+
+    case VALUEUINT16:
+      return cbor_encode_uint(encoder, value->valueuint16);
+
+    case VALUEUINT32:
+    case VALUEHEXSTRING:
+      return cbor_encode_uint(encoder, value->valueuint32);
+
+    case VALUEINT16:
+      return cbor_encode_int(encoder, value->valueint16);
+
+    case VALUEINT32:
+      return cbor_encode_int(encoder, value->valueint32);
+
+    case VALUEBOOL:
+      /* Number, as in JSON. */
+
+      return cbor_encode_uint(encoder, value->valuebool);
+
+    case VALUESTRING:
+      return cbor_encode_text_stringz(encoder, value->valuestring ?
+                                      value->valuestring : "");
+
+    case VALUEARRAY:
+    case VALUEARRAY_FIRSTSTRING:
+      /* Items are single-member maps, as in JSON. */
+
+      err |= cbor_encoder_create_array(encoder, &array,
+                                       value->valuearray.number_of_items);
+      for (i = 0; i < value->valuearray.number_of_items; i++)
+        {
+          err |= cbor_encoder_create_map(&array, &entry, 1);
+          err |= cbor_encode_text_stringz(&entry, label);
+          err |= conn_payload_cbor_value(&entry, label,
+                                         &value->valuearray.items[i]);
+          err |= cbor_encoder_close_container(&array, &entry);
+        }
+      err |= cbor_encoder_close_container(encoder, &array);
+      return err;
+
+    default:
+      con_dbg("Unhandled value type: %d\n", value->valuetype);
+      return CborErrorUnknownType;
+    }
+}
+#endif /* CONFIG_THINGSEE_CONNECTORS_CBOR */
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/* Request bodies are generated twice from the same payloads, so a payload
+ * is either rendered fully or not at all. Items are completed before they
+ * are added to their parent, as adding may move them.
+ */
+
+cJSON *conn_payload_to_json(const struct ts_payload *payload)
+{
+  cJSON *pload, *engine, *senses;
+  const char * TS =   "ts";
+  uint64_t timestamp_msecs;
+  int i;
+
+  timestamp_msecs = (uint64_t)payload->state.ts.tv_sec * 1000;
+  timestamp_msecs += payload->state.ts.tv_nsec / (1000 * 1000);
+
+  pload = cJSON_CreateObject();
+  if (!pload)
+    {
+      return NULL;
+    }
+
+  engine = cJSON_CreateObject();
+  if (!engine)
+    {
+      goto errout;
+    }
+
+  cJSON_AddStringToObject(engine, "pId", payload->state.pId ? payload->state.pId : "(null)");
+  cJSON_AddNumberToObject(engine, "puId", payload->state.puId);
+  cJSON_AddNumberToObject(engine, "stId", payload->state.stId);
+  cJSON_AddNumberToObject(engine, "evId", payload->state.evId);
+  cJSON_AddNumberToObject(engine, TS, timestamp_msecs);
+
+  if (cJSON_GetArraySize(engine) != 5 ||
+      !cJSON_AddItemToObject(pload, "engine", engine))
+    {
+      cJSON_Delete(engine);
+      goto errout;
+    }
+
+  if (payload->number_of_senses > 0)
+    {
+      senses = cJSON_CreateArray();
+      if (!senses)
+        {
+          goto errout;
+        }
+
+      for (i = 0; i < payload->number_of_senses; i++)
+        {
+          char sId[11]; /* SenseID format is 0xAABBCCDD -> 10 chars */
+          const char * VAL = "val";
+
+          cJSON *sense = cJSON_CreateObject();
+          if (!sense)
+            break;
+
+          sprintf(sId, "0x%08x", payload->senses[i].sId);
+          cJSON_AddStringToObject(sense, "sId", sId);
+
+          __value_to_json(sense, VAL, &payload->senses[i].value);
+
+          cJSON_AddNumberToObject(sense, TS, timestamp_msecs);
+
+          if (cJSON_GetArraySize(sense) != 3 ||
+              !cJSON_AddItemToArray(senses, sense))
+            {
+              cJSON_Delete(sense);
+              break;
+            }
+        }
+
+      if (i < payload->number_of_senses ||
+          !cJSON_AddItemToObject(pload, "senses", senses))
+        {
+          cJSON_Delete(senses);
+          goto errout;
+        }
+    }
+
+  return pload;
+
+errout:
+  cJSON_Delete(pload);
+  return NULL;
+}
+
+int conn_payload_put_json(const uint8_t *records, size_t records_len,
+                          conn_putc_t putc_fn, void *putc_priv)
+{
+  struct ts_payload *payload;
+  cJSON *pload;
+  bool first = true;
+  int ret;
+
+  putc_fn('[', putc_priv);
+
+  while (records_len > 0)
+    {
+      ret = __ts_engine_log_record_decode(records, records_len, &payload);
+      if (ret <= 0)
+        {
+          con_dbg("record decode failed: %d\n", ret);
+          return ERROR;
+        }
+
+      records += ret;
+      records_len -= ret;
+
+      pload = conn_payload_to_json(payload);
+      free(payload);
+      if (!pload)
+        {
+          con_dbg("conn_payload_to_json failed\n");
+          return ERROR;
+        }
+
+      if (!first)
+        {
+          putc_fn(',', putc_priv);
+        }
+
+      cJSON_Print_Stream(pload, false, putc_fn, putc_priv);
+      cJSON_Delete(pload);
+      first = false;
+    }
+
+  putc_fn(']', putc_priv);
+
+  return OK;
+}
+
+#ifdef CONFIG_THINGSEE_CONNECTORS_CBOR
+int conn_payload_to_cbor(const struct ts_payload *payload,
+                             uint8_t *buf, size_t buflen)
+{
+  CborEncoder encoder, pload, engine, senses, sense;
+  CborError err = CborNoError;
+  uint64_t timestamp_msecs;
+  int i;
+
+  timestamp_msecs = (uint64_t)payload->state.ts.tv_sec * 1000;
+  timestamp_msecs += payload->state.ts.tv_nsec / (1000 * 1000);
+
+  cbor_encoder_init(&encoder, buf, buflen, 0);
+
+  err |= cbor_encoder_create_map(&encoder, &pload,
+                                 payload->number_of_senses > 0 ? 2 : 1);
+
+  err |= cbor_encode_text_stringz(&pload, "engine");
+  err |= cbor_encoder_create_map(&pload, &engine, 5);
+  err |= cbor_encode_text_stringz(&engine, "pId");
+  err |= cbor_encode_text_stringz(&engine, payload->state.pId ?
+                                  payload->state.pId : "(null)");
+  err |= cbor_encode_text_stringz(&engine, "puId");
+  err |= cbor_encode_int(&engine, payload->state.puId);
+  err |= cbor_encode_text_stringz(&engine, "stId");
+  err |= cbor_encode_int(&engine, payload->state.stId);
+  err |= cbor_encode_text_stringz(&engine, "evId");
+  err |= cbor_encode_int(&engine, payload->state.evId);
+  err |= cbor_encode_text_stringz(&engine, "ts");
+  err |= cbor_encode_uint(&engine, timestamp_msecs);
+  err |= cbor_encoder_close_container(&pload, &engine);
+
+  if (payload->number_of_senses > 0)
+    {
+      err |= cbor_encode_text_stringz(&pload, "senses");
+      err |= cbor_encoder_create_array(&pload, &senses,
+                                       payload->number_of_senses);
+
+      for (i = 0; i < payload->number_of_senses; i++)
+        {
+          err |= cbor_encoder_create_map(&senses, &sense, 3);
+          err |= cbor_encode_text_stringz(&sense, "sId");
+          err |= cbor_encode_uint(&sense, payload->senses[i].sId);
+          err |= cbor_encode_text_stringz(&sense, "val");
+          err |= conn_payload_cbor_value(&sense, "val",
+                                         &payload->senses[i].value);
+          err |= cbor_encode_text_stringz(&sense, "ts");
+          err |= cbor_encode_uint(&sense, timestamp_msecs);
+          err |= cbor_encoder_close_container(&senses, &sense);
+        }
+
+      err |= cbor_encoder_close_container(&pload, &senses);
+    }
+
+  err |= cbor_encoder_close_container(&encoder, &pload);
+
+  if (err & ~CborErrorOutOfMemory)
+    {
+      con_dbg("CBOR encoding failed: %d\n", err);
+      return ERROR;
+    }
+
+  if (!encoder.end)
+    {
+      return buflen + encoder.bytes_needed;
+    }
+
+  return encoder.ptr - buf;
+}
+
+int conn_payload_put_cbor(const uint8_t *records, size_t records_len,
+                          int count, conn_putc_t putc_fn, void *putc_priv)
+{
+  CborEncoder encoder, array;
+  struct ts_payload *payload;
+  uint8_t *buf;
+  int len;
+  int ret;
+  int i;
+
+  /* Array header only; the payloads are encoded separately. */
+
+  cbor_encoder_init(&encoder, g_cbor_buf, sizeof(g_cbor_buf), 0);
+  cbor_encoder_create_array(&encoder, &array, count);
+  cbor_encoder_close_container(&encoder, &array);
+
+  len = encoder.ptr - g_cbor_buf;
+  for (i = 0; i < len; i++)
+    {
+      putc_fn(g_cbor_buf[i], putc_priv);
+    }
+
+  while (records_len > 0)
+    {
+      ret = __ts_engine_log_record_decode(records, records_len, &payload);
+      if (ret <= 0)
+        {
+          con_dbg("record decode failed: %d\n", ret);
+          return ERROR;
+        }
+
+      records += ret;
+      records_len -= ret;
+
+      buf = g_cbor_buf;
+      len = conn_payload_to_cbor(payload, buf, sizeof(g_cbor_buf));
+      if (len > (int)sizeof(g_cbor_buf))
+        {
+          buf = malloc(len);
+          if (buf)
+            {
+              len = conn_payload_to_cbor(payload, buf, len);
+            }
+        }
+
+      free(payload);
+
+      if (!buf || len < 0)
+        {
+          if (buf != g_cbor_buf)
+            {
+              free(buf);
+            }
+
+          return ERROR;
+        }
+
+      for (i = 0; i < len; i++)
+        {
+          putc_fn(buf[i], putc_priv);
+        }
+
+      if (buf != g_cbor_buf)
+        {
+          free(buf);
+        }
+
+      count--;
+    }
+
+  if (count != 0)
+    {
+      con_dbg("record count mismatch: %d\n", count);
+      return ERROR;
+    }
+
+  return OK;
+}
+#endif /* CONFIG_THINGSEE_CONNECTORS_CBOR */
@@ -0,0 +1,103 @@
+/****************************************************************************
+ * apps/ts_engine/connectors/conn_payload.h
+ *
+ * Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#ifndef __APPS_TS_ENGINE_CONNECTORS_CONN_PAYLOAD_H
+#define __APPS_TS_ENGINE_CONNECTORS_CONN_PAYLOAD_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "conn_comm.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define CONN_PAYLOAD_JSON_CONTENT_TYPE     "application/json"
+#define CONN_PAYLOAD_CBOR_CONTENT_TYPE     "application/cbor"
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/* Returns the JSON object for one payload, or NULL if out of memory:
+ *
+ *   { "engine": { "pId": text, "puId": int, "stId": int, "evId": int,
+ *                 "ts": msecs },
+ *     "senses": [ { "sId": "0x%08x", "val": value, "ts": msecs }, ... ] }
+ *
+ * "senses" is left out when there are none.
+ */
+
+cJSON *conn_payload_to_json(const struct ts_payload *payload);
+
+/* Write JSON array of the payloads in 'records_len' bytes of binary log
+ * records to 'putc_fn'. Returns OK or ERROR.
+ */
+
+int conn_payload_put_json(const uint8_t *records, size_t records_len,
+                          conn_putc_t putc_fn, void *putc_priv);
+
+#ifdef CONFIG_THINGSEE_CONNECTORS_CBOR
+
+/* CBOR (RFC 7049) encoding of a payload has the same items as the JSON, so
+ * that backend can convert it to JSON as is. Only "sId" differs: it is an
+ * integer instead of text. Doubles are sent as integers or single precision
+ * floats when that is exact.
+ */
+
+/* Encode 'payload' to 'buf'. Returns length of the encoding, which did not
+ * fit in 'buf' if larger than 'buflen'; retry with a large enough buffer.
+ * Returns ERROR if the payload has values that cannot be encoded.
+ */
+
+int conn_payload_to_cbor(const struct ts_payload *payload,
+                         uint8_t *buf, size_t buflen);
+
+/* Write CBOR array of the 'count' payloads in 'records_len' bytes of binary
+ * log records to 'putc_fn'. Returns OK or ERROR.
+ */
+
+int conn_payload_put_cbor(const uint8_t *records, size_t records_len,
+                          int count, conn_putc_t putc_fn, void *putc_priv);
+
+#endif /* CONFIG_THINGSEE_CONNECTORS_CBOR */
+
+#endif /* __APPS_TS_ENGINE_CONNECTORS_CONN_PAYLOAD_H */
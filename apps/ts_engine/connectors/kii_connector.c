@@ -52,6 +52,7 @@
 #include "connector_ids.h"
 #include "con_dbg.h"
 #include "conn_comm.h"
+#include "conn_comm_execute_http.h"
 #include "kii_connext.h"
 #include "kii_construct_connext.h"
 
@@ -302,7 +303,7 @@ static int kii_get_access_token_construct(conn_workflow_context_s *context,
           "Accept: */*\r\n"
           "x-kii-appid: %s\r\n"
           "x-kii-appkey: %s\r\n"
-          "Connection: close\r\n"
+          HTTP_CONNECTION_HEADER
           "Content-Length: %d\r\n"
           "Content-Type: application/vnd.kii.OauthTokenRequest+json\r\n"
           "\r\n",
@@ -56,6 +56,7 @@
 #include "connector_ids.h"
 #include "con_dbg.h"
 #include "conn_comm.h"
+#include "conn_comm_execute_http.h"
 
 /****************************************************************************
  * Pre-processor Definitions
@@ -142,7 +143,7 @@ static int meshblu_post_message_construct(conn_workflow_context_s *context,
           "User-Agent: %s\r\n"
           "Host: %s\r\n"
           "Accept: */*\r\n"
-          "Connection: close\r\n"
+          HTTP_CONNECTION_HEADER
           "Content-Length: %d\r\n"
           "Content-Type: application/x-www-form-urlencoded\r\n"
           "\r\n",
@@ -185,7 +186,7 @@ static int meshblu_post_data_construct(conn_workflow_context_s *context,
           "User-Agent: %s\r\n"
           "Host: %s\r\n"
           "Accept: */*\r\n"
-          "Connection: close\r\n"
+          HTTP_CONNECTION_HEADER
           "Content-Length: %d\r\n"
           "Content-Type: application/x-www-form-urlencoded\r\n"
           "\r\n",
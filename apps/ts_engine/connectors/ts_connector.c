@@ -53,6 +53,11 @@
 #include "con_dbg.h"
 #include "conn_comm.h"
 #include "conn_comm_execute_http.h"
+#include "conn_payload.h"
+#ifdef CONFIG_THINGSEE_CONNECTORS_GZIP
+#  include "conn_gzip.h"
+#endif
+#include "engine/log_record.h"
 
 /****************************************************************************
  * Pre-processor Definitions
@@ -72,6 +77,8 @@ typedef struct
   char *device_auth_uuid;
   char *device_auth_token;
   char *api;
+  bool cbor; /* "encoding": "cbor" */
+  bool gzip; /* "contentEncoding": "gzip" */
 }tsc_cloud_params_s;
 
 /****************************************************************************
@@ -89,6 +96,8 @@ static int tsc_multisend_url(struct ts_payload **payload, int number_of_payloads
 static int tsc_send_url(struct ts_payload *payload, send_cb_t cb,
                         struct url * const url,
                         const void *priv);
+static int tsc_post_data_body(conn_workflow_context_s *context,
+                              conn_putc_t putc_fn, void *putc_priv);
 
 /****************************************************************************
  * Private Data
@@ -102,6 +111,9 @@ static struct {
 struct tsc_context_priv_s
 {
   struct url *url;
+  int count;
+  size_t records_len;
+  uint8_t records[]; /* payloads to send, as binary log records */
 };
 
 /****************************************************************************
@@ -143,6 +155,33 @@ static bool tsc_get_http_params(conn_workflow_context_s *context,
   return true;
 }
 
+#ifdef CONFIG_THINGSEE_CONNECTORS_CBOR
+/* Payloads to the Thingsee backend are sent as CBOR if so configured in
+ * cloud params. Custom URLs always get JSON.
+ */
+
+static bool tsc_use_cbor(conn_workflow_context_s *context)
+{
+  struct tsc_context_priv_s *context_priv = context->context_priv;
+
+  return ts_context.cloud_params.cbor && !context_priv->url;
+}
+#endif
+
+#ifdef CONFIG_THINGSEE_CONNECTORS_GZIP
+/* Batches of payloads to the Thingsee backend are compressed if so
+ * configured in cloud params.
+ */
+
+static bool tsc_use_gzip(conn_workflow_context_s *context)
+{
+  struct tsc_context_priv_s *context_priv = context->context_priv;
+
+  return ts_context.cloud_params.gzip && !context_priv->url &&
+         context_priv->count > 1;
+}
+#endif
+
 static int tsc_post_data_construct(conn_workflow_context_s *context,
                                    char **outhdr, char **outdata)
 {
@@ -152,9 +191,9 @@ static int tsc_post_data_construct(conn_workflow_context_s *context,
   int i;
   int ret;
 
-  /* Construct HTTP data */
-  *outdata = context->payload;
-  datalen = (*outdata != NULL) ? strlen(*outdata) : 0;
+  /* HTTP data is streamed by tsc_post_data_body(). */
+  *outdata = NULL;
+  datalen = context->payload_len;
 
   if (datalen > 0)
     {
@@ -214,9 +253,10 @@ static int tsc_post_data_construct(conn_workflow_context_s *context,
           "Host: %s\r\n"
           "Accept: */*\r\n"
           "%s" /* auth */
-          "Connection: close\r\n"
+          HTTP_CONNECTION_HEADER
           "Content-Length: %d\r\n"
-          "Content-Type: application/json\r\n"
+          "Content-Type: %s\r\n"
+          "%s" /* Content-Encoding */
           "\r\n",
           (context_url ? (context_url->api ? context_url->api : "") : ts_context.cloud_params.api),
           (context_url ? "" : "/events"),
@@ -226,7 +266,16 @@ static int tsc_post_data_construct(conn_workflow_context_s *context,
           HTTP_DEFAULT_USER_AGENT,
           (context_url ? context_url->host : ts_context.con.host),
           header,
-          strlen(*outdata)
+          datalen,
+#ifdef CONFIG_THINGSEE_CONNECTORS_CBOR
+          tsc_use_cbor(context) ? CONN_PAYLOAD_CBOR_CONTENT_TYPE :
+#endif
+          CONN_PAYLOAD_JSON_CONTENT_TYPE,
+#ifdef CONFIG_THINGSEE_CONNECTORS_GZIP
+          tsc_use_gzip(context) ?
+            "Content-Encoding: " CONN_GZIP_CONTENT_ENCODING "\r\n" :
+#endif
+          ""
       );
 
       free(header);
@@ -234,7 +283,7 @@ static int tsc_post_data_construct(conn_workflow_context_s *context,
 
   if (datalen >= 0 && hdrlen >= 0)
     {
-      con_dbg("SENDINGDATA:\n%s%s\n", *outhdr, *outdata);
+      con_dbg("SENDINGDATA:\n%s(%d bytes)\n", *outhdr, datalen);
     }
 
   return (datalen >= 0 && hdrlen >= 0) ? OK : ERROR;
@@ -319,6 +368,7 @@ static struct conn_network_task_s *tsc_post_data_create(conn_workflow_context_s
 
   if (task)
     {
+      task->body = tsc_post_data_body;
       task->http.get_conn_params = tsc_get_http_params;
     }
 
@@ -335,6 +385,10 @@ static int tsc_parse_cloud_params(const char * const connectors)
 {
   cJSON *root, *arrayitem;
   cJSON *port;
+#if defined(CONFIG_THINGSEE_CONNECTORS_CBOR) || \
+    defined(CONFIG_THINGSEE_CONNECTORS_GZIP)
+  cJSON *encoding;
+#endif
   int ret = ERROR;
   uint32_t connid = 1;
 
@@ -369,6 +423,40 @@ static int tsc_parse_cloud_params(const char * const connectors)
       con_dbg("Mandatory item missing in cloud params!\n");
       goto out;
     }
+
+#ifdef CONFIG_THINGSEE_CONNECTORS_CBOR
+  encoding = cJSON_GetObjectItem(arrayitem, "encoding");
+  if (encoding)
+    {
+      if (cJSON_type(encoding) == cJSON_String &&
+          !strcmp(cJSON_string(encoding), "cbor"))
+        {
+          ts_context.cloud_params.cbor = true;
+        }
+      else if (cJSON_type(encoding) != cJSON_String ||
+               strcmp(cJSON_string(encoding), "json"))
+        {
+          con_dbg("Unsupported encoding - using JSON!\n");
+        }
+    }
+#endif
+
+#ifdef CONFIG_THINGSEE_CONNECTORS_GZIP
+  encoding = cJSON_GetObjectItem(arrayitem, "contentEncoding");
+  if (encoding)
+    {
+      if (cJSON_type(encoding) == cJSON_String &&
+          !strcmp(cJSON_string(encoding), CONN_GZIP_CONTENT_ENCODING))
+        {
+          ts_context.cloud_params.gzip = true;
+        }
+      else
+        {
+          con_dbg("Unsupported content encoding - not compressing!\n");
+        }
+    }
+#endif
+
   ts_context.con.port = HTTP_DEFAULT_PORT;
   port = cJSON_GetObjectItem(arrayitem, "port");
   if (port)
@@ -424,94 +512,106 @@ static int tsc_uninit(void)
   return OK;
 }
 
-static conn_workflow_context_s *tsc_create_workflow_context(struct ts_payload **payload, int number_of_payloads,
-                                                            send_cb_t cb, struct url * const url, const void *priv)
+/* JSON or CBOR array of the payloads, generated from the binary records
+ * one payload at a time. */
+
+static int tsc_post_data_encode(conn_workflow_context_s *context,
+                                conn_putc_t putc_fn, void *putc_priv)
 {
-  cJSON *root, *pload, *engine, *senses;
-  conn_workflow_context_s *context = NULL;
-  const char * TS =   "ts";
-  uint64_t timestamp_msecs;
+  struct tsc_context_priv_s *context_priv = context->context_priv;
 
-  root = cJSON_CreateArray();
-  if (root)
+#ifdef CONFIG_THINGSEE_CONNECTORS_CBOR
+  if (tsc_use_cbor(context))
     {
-      while (number_of_payloads--)
-        {
-          pload = cJSON_CreateObject();
-          if (pload)
-            {
-              engine = cJSON_CreateObject();
-              if (engine)
-                {
-                  const char * PID =  "pId";
-                  const char * PUID = "puId";
-                  const char * STID = "stId";
-                  const char * EVID = "evId";
-
-                  cJSON_AddStringToObject(engine, PID, (*payload)->state.pId ? (*payload)->state.pId : "(null)");
+      return conn_payload_put_cbor(context_priv->records,
+                                   context_priv->records_len,
+                                   context_priv->count, putc_fn, putc_priv);
+    }
+#endif
 
-                  cJSON_AddNumberToObject(engine, PUID, (*payload)->state.puId);
+  return conn_payload_put_json(context_priv->records,
+                               context_priv->records_len,
+                               putc_fn, putc_priv);
+}
 
-                  cJSON_AddNumberToObject(engine, STID, (*payload)->state.stId);
+static int tsc_post_data_body(conn_workflow_context_s *context,
+                              conn_putc_t putc_fn, void *putc_priv)
+{
+#ifdef CONFIG_THINGSEE_CONNECTORS_GZIP
+  struct conn_gzip_s *gz;
+  int ret;
 
-                  cJSON_AddNumberToObject(engine, EVID, (*payload)->state.evId);
+  if (tsc_use_gzip(context))
+    {
+      gz = malloc(sizeof(*gz));
+      if (!gz)
+        {
+          con_dbg("malloc failed\n");
+          return ERROR;
+        }
 
-                  timestamp_msecs = (uint64_t)(*payload)->state.ts.tv_sec * 1000;
-                  timestamp_msecs += (*payload)->state.ts.tv_nsec / (1000 * 1000);
-                  cJSON_AddNumberToObject(engine, TS, timestamp_msecs);
+      conn_gzip_init(gz, putc_fn, putc_priv);
+      ret = tsc_post_data_encode(context, conn_gzip_putc, gz);
+      conn_gzip_finish(gz);
+      free(gz);
 
-                  cJSON_AddItemToObject(pload, "engine", engine);
-                } /* Engine */
+      return ret;
+    }
+#endif
 
-              if ((*payload)->number_of_senses > 0)
-                {
-                  senses = cJSON_CreateArray();
-                  if (senses)
-                    {
-                      int i;
-                      for (i = 0; i < (*payload)->number_of_senses; i++)
-                        {
-                          char sId[11]; /* SenseID format is 0xAABBCCDD -> 10 chars */
-                          const char * VAL = "val";
+  return tsc_post_data_encode(context, putc_fn, putc_priv);
+}
 
-                          cJSON *sense = cJSON_CreateObject();
-                          if (!sense)
-                            break;
+/* Payloads are released by the caller once sent, so keep them as compact
+ * binary records in the workflow context. The JSON body is generated from
+ * these while sending.
+ */
 
-                          sprintf(sId, "0x%08x", (*payload)->senses[i].sId);
-                          cJSON_AddStringToObject(sense, "sId", sId);
+static conn_workflow_context_s *tsc_create_workflow_context(struct ts_payload **payload, int number_of_payloads,
+                                                            send_cb_t cb, struct url * const url, const void *priv)
+{
+  conn_workflow_context_s *context;
+  struct tsc_context_priv_s *context_priv;
+  size_t records_len = 0;
+  size_t pos = 0;
+  int ret;
+  int i;
 
-                          __value_to_json(sense, VAL, &(*payload)->senses[i].value);
+  for (i = 0; i < number_of_payloads; i++)
+    {
+      records_len += __ts_engine_log_record_size(payload[i]);
+    }
 
-                          timestamp_msecs = (uint64_t)(*payload)->state.ts.tv_sec * 1000;
-                          timestamp_msecs += (*payload)->state.ts.tv_nsec / (1000 * 1000);
-                          cJSON_AddNumberToObject(sense, TS, timestamp_msecs);
-                          cJSON_AddItemToArray(senses, sense);
-                        }
+  context = (conn_workflow_context_s*)calloc(1, sizeof(conn_workflow_context_s) + sizeof(struct tsc_context_priv_s) + records_len);
+  if (!context)
+    {
+      return NULL;
+    }
 
-                      cJSON_AddItemToObject(pload, "senses", senses);
-                    }
-                }
-              cJSON_AddItemToArray(root, pload);
-            }
-          payload++;
-        }
-      context = (conn_workflow_context_s*)calloc(1, sizeof(conn_workflow_context_s) + sizeof(struct tsc_context_priv_s));
-      if (context)
-        {
-          struct tsc_context_priv_s *context_priv;
+  context->payload = NULL;
+  context->cb = cb;
+  context->priv = priv;
 
-          context->payload = cJSON_PrintUnformatted(root);
-          context->cb = cb;
-          context->priv = priv;
+  context->context_priv = (void *)((uint8_t*)context + sizeof(*context));
+  context_priv = context->context_priv;
+  context_priv->url = url;
+  context_priv->count = number_of_payloads;
+  context_priv->records_len = records_len;
 
-          context->context_priv = (void *)((uint8_t*)context + sizeof(*context));
-          context_priv = context->context_priv;
-          context_priv->url = url;
+  for (i = 0; i < number_of_payloads; i++)
+    {
+      ret = __ts_engine_log_record_encode(payload[i],
+                                          &context_priv->records[pos],
+                                          records_len - pos);
+      if (ret < 0)
+        {
+          con_dbg("__ts_engine_log_record_encode failed\n");
+          free(context);
+          return NULL;
         }
-    }
 
-  cJSON_Delete(root);
+      pos += ret;
+    }
 
   return context;
 }
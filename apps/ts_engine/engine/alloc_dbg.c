@@ -67,6 +67,12 @@ struct alloc
 {
   sq_queue_t allocs;
   bool on;
+
+  /* Metrics since alloc_dbg_start() */
+
+  unsigned int count;   /* Number of allocations */
+  size_t current;       /* Bytes currently allocated */
+  size_t peak;          /* Highest value of 'current' */
 };
 
 static struct alloc g_alloc =
@@ -77,9 +83,25 @@ static struct alloc g_alloc =
 void alloc_dbg_start(void)
 {
   sq_init(&g_alloc.allocs);
+  g_alloc.count = 0;
+  g_alloc.current = 0;
+  g_alloc.peak = 0;
   g_alloc.on = true;
 }
 
+void alloc_dbg_report(void)
+{
+  eng_dbg("allocs: %u, current: %u bytes, peak: %u bytes\n",
+          g_alloc.count, g_alloc.current, g_alloc.peak);
+}
+
+static void del_entry(struct alloc_entry *entry)
+{
+  sq_rem(&entry->entry, &g_alloc.allocs);
+  g_alloc.current -= entry->len;
+  free(entry);
+}
+
 static void add_entry(void * const addr, size_t len, char *file, int line)
 {
   struct alloc_entry *entry;
@@ -97,6 +119,13 @@ static void add_entry(void * const addr, size_t len, char *file, int line)
   entry->line = line;
 
   sq_addlast(&entry->entry, &g_alloc.allocs);
+
+  g_alloc.count++;
+  g_alloc.current += len;
+  if (g_alloc.current > g_alloc.peak)
+    {
+      g_alloc.peak = g_alloc.current;
+    }
 }
 
 void *alloc_dbg_alloc(size_t size, char *file, int line, bool zero)
@@ -169,8 +198,7 @@ void *alloc_dbg_realloc(void *p, size_t newsize, char *file, int line)
 
       if (old)
         {
-          sq_rem(&old->entry, &g_alloc.allocs);
-          free(old);
+          del_entry(old);
         }
     }
   if (addr)
@@ -248,8 +276,7 @@ void alloc_dbg_free(void *addr, char *file, int line)
     {
       if (entry->addr == addr)
         {
-          sq_rem(&entry->entry, &g_alloc.allocs);
-          free(entry);
+          del_entry(entry);
           free(addr);
           return;
         }
@@ -272,6 +299,8 @@ void alloc_dbg_stop(void)
 
   g_alloc.on = false;
 
+  alloc_dbg_report();
+
   entry = (struct alloc_entry *) sq_peek(&g_alloc.allocs);
 
   while (entry)
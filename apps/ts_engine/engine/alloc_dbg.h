@@ -49,6 +49,7 @@
 #define free(x) alloc_dbg_free((x), __FILE__, __LINE__)
 
 void alloc_dbg_start(void);
+void alloc_dbg_report(void);
 void *alloc_dbg_alloc(size_t size, char *file, int line, bool zero);
 void *alloc_dbg_realloc(void *p, size_t newsize, char *file, int line);
 char *alloc_dbg_strdup(char *str, char *file, int line);
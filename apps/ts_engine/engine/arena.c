@@ -0,0 +1,105 @@
+/****************************************************************************
+ * apps/ts_engine/engine/arena.c
+ *
+ * Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "eng_dbg.h"
+#include "eng_error.h"
+#include "arena.h"
+
+int __ts_engine_arena_init(struct ts_arena *arena, size_t size)
+{
+  arena->used = 0;
+  arena->size = ARENA_SIZE(size);
+  arena->base = calloc(1, arena->size);
+  if (!arena->base)
+    {
+      eng_dbg("calloc %u failed\n", arena->size);
+      arena->size = 0;
+      return -TS_ENGINE_ERROR_OOM;
+    }
+
+  return OK;
+}
+
+void __ts_engine_arena_release(struct ts_arena *arena)
+{
+  free(arena->base);
+  arena->base = NULL;
+  arena->size = 0;
+  arena->used = 0;
+}
+
+void *__ts_engine_arena_alloc(struct ts_arena *arena, size_t size)
+{
+  void *p;
+
+  size = ARENA_SIZE(size);
+
+  if (size > arena->size - arena->used)
+    {
+      eng_dbg("arena exhausted: %u + %u > %u\n", arena->used, size,
+              arena->size);
+      return NULL;
+    }
+
+  p = arena->base + arena->used;
+  arena->used += size;
+
+  return p;
+}
+
+char *__ts_engine_arena_strdup(struct ts_arena *arena, const char *str)
+{
+  size_t len;
+  char *p;
+
+  if (!str)
+    {
+      return NULL;
+    }
+
+  len = strlen(str) + 1;
+
+  p = __ts_engine_arena_alloc(arena, len);
+  if (p)
+    {
+      memcpy(p, str, len);
+    }
+
+  return p;
+}
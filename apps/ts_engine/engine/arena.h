@@ -0,0 +1,78 @@
+/****************************************************************************
+ * apps/ts_engine/engine/arena.h
+ *
+ * Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#ifndef __APPS_TS_ENGINE_ENGINE_ARENA_H__
+#define __APPS_TS_ENGINE_ENGINE_ARENA_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Bump allocator for data that lives and dies together, such as a parsed
+ * profile. The whole arena is one heap block that is sized up front and
+ * released with a single free; there is no per-object free.
+ */
+
+#define ARENA_ALIGN             sizeof(double)
+#define ARENA_SIZE(size)        (((size) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+struct ts_arena
+{
+  uint8_t *base;
+  size_t size;
+  size_t used;
+};
+
+/* Allocate a zeroed arena of 'size' bytes. Returns OK, or
+ * -TS_ENGINE_ERROR_OOM.
+ */
+
+int __ts_engine_arena_init(struct ts_arena *arena, size_t size);
+
+/* Release all memory of 'arena'. */
+
+void __ts_engine_arena_release(struct ts_arena *arena);
+
+/* Allocate 'size' zeroed bytes from 'arena'. Returns NULL if the arena is
+ * exhausted.
+ */
+
+void *__ts_engine_arena_alloc(struct ts_arena *arena, size_t size);
+
+/* Copy string 'str' to 'arena'. Returns NULL if 'str' is NULL or the arena
+ * is exhausted.
+ */
+
+char *__ts_engine_arena_strdup(struct ts_arena *arena, const char *str);
+
+#endif
@@ -67,6 +67,8 @@
 #include "client.h"
 #include "geofence.h"
 #include "cloud_property.h"
+#include "threshold.h"
+#include "payload.h"
 
 #ifdef CONFIG_ARCH_SIM
 #include "sense_sim.h"
@@ -256,11 +258,12 @@ generate_payload (const void *any, bool eventpayload)
   purpose = state->parent;
   profile = purpose->parent;
 
-  payload = malloc (number_of_causes * sizeof(struct ts_sense_value)
-                    + sizeof(*payload) + extralen);
+  payload = __ts_engine_payload_alloc (number_of_causes *
+                                       sizeof(struct ts_sense_value) +
+                                       sizeof(*payload) + extralen);
   if (!payload)
     {
-      eng_dbg ("malloc for payload failed\n");
+      eng_dbg ("alloc for payload failed\n");
       return NULL;
     }
 
@@ -318,6 +321,22 @@ generate_cause_payload (struct ts_cause *cause)
   return generate_payload(cause, false);
 }
 
+/* Cause payload is generated once per handled cause and shared between
+ * sending and logging. Released by handle_cause_event(), which also drops
+ * it if a threshold check rewrites the sense value.
+ */
+
+static struct ts_payload *
+get_cause_payload (struct ts_cause *cause, struct ts_payload **payload)
+{
+  if (!*payload)
+    {
+      *payload = generate_cause_payload(cause);
+    }
+
+  return *payload;
+}
+
 static void
 log_event (struct ts_event *event)
 {
@@ -333,7 +352,7 @@ log_event (struct ts_event *event)
     }
 
   __ts_engine_log_payload (payload, LOG_EVENTS);
-  free (payload);
+  __ts_engine_payload_free (payload);
 
   mem_dbg();
   vbat_dbg();
@@ -342,21 +361,17 @@ log_event (struct ts_event *event)
 }
 
 static void
-log_cause (struct ts_cause *cause)
+log_cause (struct ts_cause *cause, struct ts_payload **payload)
 {
 #ifndef CONFIG_ARCH_SIM
 
-  struct ts_payload *payload;
-
-  payload = generate_cause_payload(cause);
-  if (!payload)
+  if (!get_cause_payload(cause, payload))
     {
       eng_dbg("generate_cause_payload failed\n");
       return;
     }
 
-  __ts_engine_log_payload (payload, LOG_CAUSES);
-  free (payload);
+  __ts_engine_log_payload (*payload, LOG_CAUSES);
 
   mem_dbg();
   vbat_dbg();
@@ -433,52 +448,35 @@ is_active_relative_cause (struct ts_cause *cause)
 
 bool __ts_engine_check_geofence(struct ts_threshold *thr, struct ts_value *value)
 {
+  struct ts_profile *profile = thr->parent->parent->parent->parent->parent;
   struct point test;
-  struct poly *poly;
-  int i;
-  int points;
   int ret;
 
-  DEBUGASSERT(thr->conf.value.valuetype == VALUEARRAY &&
-              !(thr->conf.value.valuearray.number_of_items & 0x1));
-
   DEBUGASSERT(value->valuetype == VALUEARRAY &&
               value->valuearray.number_of_items == 7);
 
-  points = thr->conf.value.valuearray.number_of_items / 2;
+  /* Polygon and its index are prepared when the profile is parsed. */
 
-  if (points < 3)
+  if (!thr->conf.poly)
     {
       eng_dbg("Not enough points in polygon\n");
       return false;
     }
 
-  poly = malloc(sizeof(*poly) + points * (sizeof(poly->points[0])));
-  if (!poly)
-    {
-      eng_dbg("malloc %d failed\n", sizeof(*poly) +
-              points * (sizeof(poly->points[0])));
-      return false;
-    }
-
-  for (i = 0; i < points; i++)
-    {
-      poly->points[i].x = thr->conf.value.valuearray.items[2 * i].valuedouble;
-      poly->points[i].y = thr->conf.value.valuearray.items[2 * i + 1].valuedouble;
-    }
-
-  poly->number_of_points = points;
-
   test.x = value->valuearray.items[0].valuedouble;
   test.y = value->valuearray.items[1].valuedouble;
 
-  ret = point_in_polygon(&test, poly);
+  /* Every fence of the profile is checked against the same location, so
+   * all fences are queried at once and the result is shared. */
+
+  ret = geofence_set_contains(profile->conf.geofences, &test,
+                              thr->conf.poly);
 
-  free(poly);
   free_valuearray(value);
 
   value->valuetype = VALUEBOOL;
   value->valuebool = ret;
+  thr->parent->dyn.value_rewritten = true;
 
   return ret;
 }
@@ -904,13 +902,24 @@ check_thresholds (struct ts_cause *cause)
       return 0;
     }
 
-  ret = 1;
+  ret = ERROR;
+
+  if (cause->conf.compiled)
+    {
+      ret = __ts_engine_threshold_eval (cause->conf.compiled, value,
+                                        &cause->dyn.sense_bias.value);
+    }
 
-  while (threshold)
+  if (ret == ERROR)
     {
-      ret = check_threshold (threshold, value) && ret;
+      ret = 1;
+
+      while (threshold)
+        {
+          ret = check_threshold (threshold, value) && ret;
 
-      threshold = (struct ts_threshold *) sq_next(&threshold->entry);
+          threshold = (struct ts_threshold *) sq_next(&threshold->entry);
+        }
     }
 
   if (cause->conf.threshold.negate)
@@ -1141,7 +1150,7 @@ send_event (struct ts_event *event)
       ret = ERROR;
     }
 
-  free(payload);
+  __ts_engine_payload_free(payload);
 
   mem_dbg();
   vbat_dbg();
@@ -1190,10 +1199,9 @@ void __ts_engine_ping_result(struct ts_engine_app *app, const void *priv, int re
 }
 
 static int
-send_cause (struct ts_cause *cause)
+send_cause (struct ts_cause *cause, struct ts_payload **payload)
 {
-  struct ts_payload *payload = NULL;
-  int ret;
+  int ret = OK;
 
 #ifdef CONFIG_THINGSEE_CONNECTORS
   const struct ts_connector *con;
@@ -1201,8 +1209,7 @@ send_cause (struct ts_cause *cause)
   ret = ts_engine_select_connector(0, &con);
   if (ret == OK && con->send)
     {
-      payload = generate_cause_payload (cause);
-      if (!payload)
+      if (!get_cause_payload (cause, payload))
         {
           eng_dbg ("generate_cause_payload failed\n");
           return ERROR;
@@ -1211,23 +1218,22 @@ send_cause (struct ts_cause *cause)
      if (cause->parent->conf.actions.cloud.url.host &&
          con->send_url)
         {
-          ret = con->send_url (payload, send_cb, &cause->parent->conf.actions.cloud.url, cause);
+          ret = con->send_url (*payload, send_cb, &cause->parent->conf.actions.cloud.url, cause);
         }
       else
         {
-          ret = con->send (payload, send_cb, cause);
+          ret = con->send (*payload, send_cb, cause);
         }
 
       if (ret != OK)
         {
           eng_dbg ("send failed, logging payload\n");
-          __ts_engine_log_payload (payload, LOG_CAUSES);
+          __ts_engine_log_payload (*payload, LOG_CAUSES);
           ret = ERROR;
         }
     }
 #endif
 
-  free (payload);
   return ret;
 }
 
@@ -1473,6 +1479,7 @@ handle_cause_event (struct ts_cause *cause, struct timespec *timestamp)
   struct ts_purpose *purpose = state->parent;
   struct ts_profile *profile = purpose->parent;
   struct ts_engine *engine = profile->parent;
+  struct ts_payload *payload = NULL;
   char valuestr[VALUE_STR_MAX_LEN];
   bool purpose_changing;
   bool state_changing = false;
@@ -1493,13 +1500,25 @@ handle_cause_event (struct ts_cause *cause, struct timespec *timestamp)
 
   if (cause->conf.measurement.send)
     {
-      send_cause (cause);
+      send_cause (cause, &payload);
     }
 
   /* Check thresholds */
 
+  cause->dyn.value_rewritten = false;
+
   ret = check_thresholds (cause);
 
+  if (cause->dyn.value_rewritten)
+    {
+      /* Geofence check turned the location into a boolean, payload that
+       * was sent no longer matches the value to be logged.
+       */
+
+      __ts_engine_payload_free (payload);
+      payload = NULL;
+    }
+
   /* Did we trigger */
 
   if (ret)
@@ -1510,7 +1529,7 @@ handle_cause_event (struct ts_cause *cause, struct timespec *timestamp)
 
       if (cause->conf.senseLog || cause->conf.measurement.log)
         {
-          log_cause (cause);
+          log_cause (cause, &payload);
         }
     }
   else
@@ -1519,7 +1538,7 @@ handle_cause_event (struct ts_cause *cause, struct timespec *timestamp)
 
       if (cause->conf.measurement.log)
         {
-          log_cause (cause);
+          log_cause (cause, &payload);
         }
 
       goto out;
@@ -1566,6 +1585,7 @@ handle_cause_event (struct ts_cause *cause, struct timespec *timestamp)
 
 out:
 
+  __ts_engine_payload_free (payload);
   free_valuearray(&cause->dyn.sense_value.value);
 
   return state_changing;
@@ -1726,6 +1746,7 @@ mem_dbg (void)
 {
 #ifdef CONFIG_THINGSEE_ENGINE_DBG
   struct mallinfo mem;
+  struct ts_payload_stats payloads;
 
   mem = mallinfo ();
 
@@ -1733,6 +1754,11 @@ mem_dbg (void)
   eng_dbg ("Mem:   %11d%11d%11d%11d\n", mem.arena, mem.uordblks, mem.fordblks,
        mem.mxordblk);
 
+  __ts_engine_payload_stats (&payloads);
+
+  eng_dbg ("Payloads: %u pooled, %u heap, %u in use\n", payloads.pooled,
+           payloads.heap, payloads.in_use);
+
 #endif
 }
 
@@ -38,23 +38,174 @@
 #include <nuttx/config.h>
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "geofence.h"
 
-bool point_in_polygon(struct point *test, struct poly *poly)
+static inline bool edge_crosses(const struct point *test,
+                                const struct poly *poly, int i)
 {
+  int j = i ? i - 1 : poly->number_of_points - 1;
+  const struct point *a = &poly->points[i];
+  const struct point *b = &poly->points[j];
+
+  return ((a->y > test->y) != (b->y > test->y))
+      && (test->x < (b->x - a->x) * (test->y - a->y) / (b->y - a->y) + a->x);
+}
+
+static int slab_of(const struct poly *poly, double y)
+{
+  double s = (y - poly->bbox.min_y) * poly->slab_scale;
+
+  if (!(s > 0.0))
+    {
+      return 0;
+    }
+
+  if (s >= poly->number_of_slabs)
+    {
+      return poly->number_of_slabs - 1;
+    }
+
+  return (int)s;
+}
+
+static void edge_slabs(const struct poly *poly, int i, int *lo, int *hi)
+{
+  double ya = poly->points[i].y;
+  double yb = poly->points[i ? i - 1 : poly->number_of_points - 1].y;
+
+  *lo = slab_of(poly, ya < yb ? ya : yb);
+  *hi = slab_of(poly, ya < yb ? yb : ya);
+}
+
+void geofence_init_poly(struct poly *poly, int number_of_points)
+{
+  struct geofence_bbox *bbox = &poly->bbox;
+  uint16_t *cursor;
+  int slabs;
+  int lo;
+  int hi;
   int i;
-  int j;
+  int k;
+
+  poly->number_of_points = number_of_points;
+
+  bbox->min_x = bbox->max_x = poly->points[0].x;
+  bbox->min_y = bbox->max_y = poly->points[0].y;
+
+  for (i = 1; i < number_of_points; i++)
+    {
+      if (poly->points[i].x < bbox->min_x)
+        bbox->min_x = poly->points[i].x;
+      if (poly->points[i].x > bbox->max_x)
+        bbox->max_x = poly->points[i].x;
+      if (poly->points[i].y < bbox->min_y)
+        bbox->min_y = poly->points[i].y;
+      if (poly->points[i].y > bbox->max_y)
+        bbox->max_y = poly->points[i].y;
+    }
+
+  slabs = GEOFENCE_SLABS(number_of_points);
+
+  poly->edges = (uint16_t *)&poly->points[number_of_points];
+  poly->slab_start = poly->edges + number_of_points;
+  poly->slab_first = poly->slab_start + slabs + 1;
+
+  if (!(bbox->max_y > bbox->min_y))
+    {
+      slabs = 0;
+    }
+
+  poly->number_of_slabs = slabs;
+  if (slabs == 0)
+    {
+      return;
+    }
+
+  poly->slab_scale = slabs / (bbox->max_y - bbox->min_y);
+
+  /* Group edges by slab of their lower end (counting sort) */
+
+  memset(poly->slab_start, 0, (slabs + 1) * sizeof(uint16_t));
+
+  for (i = 0; i < number_of_points; i++)
+    {
+      edge_slabs(poly, i, &lo, &hi);
+      poly->slab_start[lo + 1]++;
+    }
+
+  for (k = 1; k <= slabs; k++)
+    {
+      poly->slab_start[k] += poly->slab_start[k - 1];
+    }
+
+  cursor = poly->slab_first;
+  memcpy(cursor, poly->slab_start, slabs * sizeof(uint16_t));
+
+  for (i = 0; i < number_of_points; i++)
+    {
+      edge_slabs(poly, i, &lo, &hi);
+      poly->edges[cursor[lo]++] = i;
+    }
+
+  /* Edges spanning several slabs are found from slab of their lower end */
+
+  for (k = 0; k < slabs; k++)
+    {
+      poly->slab_first[k] = k;
+    }
+
+  for (i = 0; i < number_of_points; i++)
+    {
+      edge_slabs(poly, i, &lo, &hi);
+
+      for (k = lo + 1; k <= hi; k++)
+        {
+          if (poly->slab_first[k] > lo)
+            {
+              poly->slab_first[k] = lo;
+            }
+        }
+    }
+}
+
+bool point_in_polygon(const struct point *test, const struct poly *poly)
+{
+  const struct geofence_bbox *bbox = &poly->bbox;
   bool in = false;
+  int end;
+  int i;
+  int k;
 
-  for (i = 0, j = poly->number_of_points - 1; i < poly->number_of_points; j =
-      i++)
+  if (test->x < bbox->min_x || test->x > bbox->max_x ||
+      test->y < bbox->min_y || test->y >= bbox->max_y)
     {
-      if (((poly->points[i].y > test->y) != (poly->points[j].y > test->y))
-          && (test->x
-              < (poly->points[j].x - poly->points[i].x)
-                  * (test->y - poly->points[i].y)
-                  / (poly->points[j].y - poly->points[i].y) + poly->points[i].x))
+      return false;
+    }
+
+  if (poly->number_of_slabs == 0)
+    {
+      for (i = 0; i < poly->number_of_points; i++)
+        {
+          if (edge_crosses(test, poly, i))
+            {
+              in = !in;
+            }
+        }
+
+      return in;
+    }
+
+  /* Only edges of slabs that reach test point can cross the ray */
+
+  k = slab_of(poly, test->y);
+  end = poly->slab_start[k + 1];
+
+  for (i = poly->slab_start[poly->slab_first[k]]; i < end; i++)
+    {
+      if (edge_crosses(test, poly, poly->edges[i]))
         {
           in = !in;
         }
@@ -62,3 +213,50 @@ bool point_in_polygon(struct point *test, struct poly *poly)
 
   return in;
 }
+
+int geofence_set_query(const struct geofence_set *set,
+                       const struct point *test, uint16_t *hits,
+                       int max_hits)
+{
+  int count = 0;
+  int i;
+
+  for (i = 0; i < set->number_of_fences; i++)
+    {
+      if (point_in_polygon(test, set->fences[i]))
+        {
+          if (count < max_hits)
+            {
+              hits[count] = i;
+            }
+
+          count++;
+        }
+    }
+
+  return count;
+}
+
+bool geofence_set_contains(struct geofence_set *set, const struct point *test,
+                           const struct poly *poly)
+{
+  int i;
+
+  if (!set->valid || test->x != set->last.x || test->y != set->last.y)
+    {
+      set->number_of_hits = geofence_set_query(set, test, set->hits,
+                                               set->number_of_fences);
+      set->last = *test;
+      set->valid = true;
+    }
+
+  for (i = 0; i < set->number_of_hits; i++)
+    {
+      if (set->hits[i] == poly->fence_id)
+        {
+          return true;
+        }
+    }
+
+  return false;
+}
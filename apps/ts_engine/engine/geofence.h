@@ -38,18 +38,100 @@
 #ifndef __APPS_TS_ENGINE_ENGINE_RAYTRACE_H__
 #define __APPS_TS_ENGINE_ENGINE_RAYTRACE_H__
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Polygons are indexed when the profile is loaded: a bounding box rejects
+ * far away points, and a slab index over y limits ray casting to edges
+ * near the test point. Edges are grouped by the slab of their lower end,
+ * and each slab records the first group that can still reach it, so the
+ * index takes a fixed amount of memory per point.
+ */
+
+#define GEOFENCE_MAX_POINTS             UINT16_MAX
+
+/* Smaller polygons are cast against all edges */
+
+#define GEOFENCE_MIN_INDEXED_POINTS     16
+
+#define GEOFENCE_EDGES_PER_SLAB         4
+
+#define GEOFENCE_SLABS(points) \
+  ((points) >= GEOFENCE_MIN_INDEXED_POINTS ? \
+   (points) / GEOFENCE_EDGES_PER_SLAB : 0)
+
+/* Size of polygon with its index */
+
+#define GEOFENCE_POLY_SIZE(points) \
+  (sizeof(struct poly) + (points) * sizeof(struct point) + \
+   ((points) + 2 * GEOFENCE_SLABS(points) + 1) * sizeof(uint16_t))
+
 struct point
 {
   double x;
   double y;
 };
 
+struct geofence_bbox
+{
+  double min_x;
+  double min_y;
+  double max_x;
+  double max_y;
+};
+
 struct poly
 {
+  struct geofence_bbox bbox;
+  double slab_scale;            /* Slabs per unit of y */
+  uint16_t number_of_slabs;     /* 0: no index */
+  uint16_t fence_id;            /* Index in geofence set */
+  uint16_t *slab_start;         /* Edges with lower end in slab */
+  uint16_t *slab_first;         /* First slab with edges reaching slab */
+  uint16_t *edges;              /* Edge i joins points i - 1 and i */
   int number_of_points;
   struct point points[];
 };
 
-bool point_in_polygon(struct point *test, struct poly *poly);
+/* All polygons of a profile, for querying a location against every fence
+ * at once. Result of last query is kept, as every fence is checked against
+ * the same location.
+ */
+
+struct geofence_set
+{
+  int number_of_fences;
+  struct poly **fences;
+
+  bool valid;                   /* 'hits' are for 'last' */
+  struct point last;
+  int number_of_hits;
+  uint16_t *hits;               /* number_of_fences entries */
+};
+
+/* Build bounding box and slab index of 'poly', which is allocated with
+ * GEOFENCE_POLY_SIZE() and has 'number_of_points' points filled in.
+ */
+
+void geofence_init_poly(struct poly *poly, int number_of_points);
+
+bool point_in_polygon(const struct point *test, const struct poly *poly);
+
+/* Find all fences of 'set' containing 'test'. Indices of containing fences
+ * are stored to 'hits', up to 'max_hits'. Returns number of containing
+ * fences.
+ */
+
+int geofence_set_query(const struct geofence_set *set,
+                       const struct point *test, uint16_t *hits,
+                       int max_hits);
+
+/* Check whether 'poly' of 'set' contains 'test'. All fences are queried
+ * once per location.
+ */
+
+bool geofence_set_contains(struct geofence_set *set, const struct point *test,
+                           const struct poly *poly);
 
 #endif
@@ -92,6 +92,8 @@ STR_LABEL(gps_accuracy);
 STR_LABEL(gps_is_inside_geofence);
 STR_LABEL(gps_timestamp);
 STR_LABEL(gps_latlon);
+STR_LABEL(gps_ttff);
+STR_LABEL(gps_on_time);
 STR_LABEL(ground_speed);
 STR_LABEL(air_speed);
 STR_LABEL(battery_full_capacity);
@@ -55,15 +55,23 @@
 #include "execute.h"
 #include "util.h"
 #include "sense.h"
+#include "log_record.h"
+#include "log_segment.h"
 
 #ifndef ARRAY_SIZE
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
 #endif
 
-#define SENSE_NAME_MAX_LEN      32
+#ifndef CONFIG_THINGSEE_ENGINE_LOG_ENTRIES_PER_REQUEST
+#  define CONFIG_THINGSEE_ENGINE_LOG_ENTRIES_PER_REQUEST 20
+#endif
+
+#ifndef CONFIG_THINGSEE_ENGINE_LOG_BYTES_PER_REQUEST
+#  define CONFIG_THINGSEE_ENGINE_LOG_BYTES_PER_REQUEST 2048
+#endif
 
-#define ENTRIES_PER_REQUEST     20
-#define CHARS_IN_ONE_SEND       2048
+#define ENTRIES_PER_REQUEST     CONFIG_THINGSEE_ENGINE_LOG_ENTRIES_PER_REQUEST
+#define CHARS_IN_ONE_SEND       CONFIG_THINGSEE_ENGINE_LOG_BYTES_PER_REQUEST
 #define RETRY_DELAY             30
 #define BAILOUT_ERROUR_COUNT    10
 
@@ -75,6 +83,8 @@ struct send_log
   struct send_log **handle;
   struct url *url;
   int entries_per_request;
+  const char *segment;
+  int segment_index;
   off_t offset;
   int errcount;
 };
@@ -90,279 +100,85 @@ static const char *g_filenames_str[NUMBER_OF_LOGS] = {
     [LOG_SENDS]  = SEND_LOG_ABS_FILENAME
 };
 
-static void free_payload(struct ts_payload *payload)
+static void finish(struct send_log *send_log)
 {
-  int i;
-
-  if (payload->state.pId)
+  if (send_log->fds[LOG_SENDS] >= 0)
     {
-      free((void *) payload->state.pId);
+      close(send_log->fds[LOG_SENDS]);
+      send_log->fds[LOG_SENDS] = -1;
     }
 
-  for (i = 0; i < payload->number_of_senses; i++)
-    {
-      free((void *) payload->senses[i].name);
-      if (payload->senses[i].value.valuetype == VALUEARRAY)
-        {
-          free(payload->senses[i].value.valuearray.items);
-        }
-    }
-
-  free(payload);
-}
+  free((void *)send_log->segment);
+  send_log->segment = NULL;
 
-static char *serialize_payload(struct ts_payload *payload)
-{
-  char valuebuf[VALUE_STR_MAX_LEN];
-  char *entry;
-  int i;
-  size_t buflen = 512;
-  int n = 0;
-  int saved;
-  void *realloc_tmp;
-
-  entry = malloc(buflen);
-  if (!entry)
+  if (send_log->handle)
     {
-      eng_dbg("malloc %d failed\n", buflen);
-      return NULL;
+      *(send_log->handle) = NULL;
     }
-
-  n += snprintf(&entry[n], buflen - n, "%s,%d,%d,%d,%d,%d", payload->state.pId,
-                payload->state.puId, payload->state.stId, payload->state.evId,
-                payload->state.ts.tv_sec, payload->state.ts.tv_nsec);
-
-  for (i = 0; i < payload->number_of_senses; i++)
-    {
-      __value_serialize(valuebuf, VALUE_STR_MAX_LEN, &payload->senses[i].value);
-
-      saved = n;
-
-      retry:
-
-      n += snprintf(&entry[n], buflen - n, ";%s,0x%08x,%s,%d,%d",
-                    payload->senses[i].name, payload->senses[i].sId,
-                    valuebuf,
-                    payload->senses[i].ts.tv_sec,
-                    payload->senses[i].ts.tv_nsec);
-
-      if (n == (buflen - 1))
-        {
-          buflen += 64;
-
-          realloc_tmp = realloc(entry, buflen);
-          if (!realloc_tmp)
-            {
-              eng_dbg("realloc %d failed\n", buflen);
-              free(entry);
-              return NULL;
-            }
-          entry = realloc_tmp;
-
-          n = saved;
-          goto retry;
-        }
-    }
-
-  if (n + 2 >= buflen)
-    {
-      realloc_tmp = realloc(entry, buflen);
-      if (!realloc_tmp)
-        {
-          eng_dbg("realloc %d failed\n", buflen);
-          free(entry);
-          return NULL;
-        }
-      entry = realloc_tmp;
-    }
-
-  entry[n++] = '\n';
-  entry[n++] = '\0';
-
-  return entry;
 }
 
-static struct ts_payload *deserialize_payload(struct send_log *send_log,
-                                              char *str)
+static int open_segment(struct send_log *send_log)
 {
+  struct log_cursor cursor;
   int ret;
-  char *state_info;
-  char *cause;
-  static char id_buf[32];
-  static char value_buf[32];
-  struct ts_payload *payload;
-  int causes = 0;
-  void *realloc_tmp;
-  char *saveptr;
-
-  state_info = strtok_r(str, ";", &saveptr);
-  if (!state_info)
-    {
-      state_info = str;
-    }
-
-  payload = malloc(sizeof(*payload));
-  if (!payload)
-    {
-      eng_dbg("malloc failed\n");
-      return NULL;
-    }
-
-  memset(payload, 0, sizeof(*payload));
-
-  ret = sscanf(state_info, "%s,%d,%d,%d,%d,%d", id_buf, &payload->state.puId,
-               &payload->state.stId, &payload->state.evId,
-               &payload->state.ts.tv_sec, &payload->state.ts.tv_nsec);
-  if (ret != 6)
-    {
-      eng_dbg("state parse failed: %d\n", ret);
-      goto errout;
-    }
-
-  payload->state.pId = strdup(id_buf);
-  if (!payload->state.pId)
-    {
-      eng_dbg("strdup failed\n");
-      goto errout;
-    }
-
-  cause = strtok_r(NULL, ";", &saveptr);
 
-  while (cause)
+  send_log->segment = __ts_engine_util_find_log(LOG_DIRECTORY,
+                                                LOG_SEGMENT_BASENAME);
+  if (!send_log->segment)
     {
-      realloc_tmp = realloc(
-          payload,
-          sizeof(*payload) + (causes + 1) * sizeof(struct ts_sense_value));
-      if (!realloc_tmp)
-        {
-          eng_dbg("realloc failed\n");
-          goto errout;
-        }
-      payload = realloc_tmp;
-
-      payload->senses[causes].name = malloc(SENSE_NAME_MAX_LEN);
-      if (!payload->senses[causes].name)
-        {
-          eng_dbg("malloc for name failed\n");
-          goto errout;
-        }
-
-      payload->number_of_senses++;
-
-      ret = sscanf(cause, "%s,%s,%s,%d,%d", payload->senses[causes].name,
-                   id_buf, value_buf,
-                   &payload->senses[causes].ts.tv_sec,
-                   &payload->senses[causes].ts.tv_nsec);
-      if (ret != 5)
-        {
-          eng_dbg("cause %d parse failed\n", causes);eng_dbg("bad cause was: %s\n", cause);
-          goto errout;
-        }
-
-      payload->senses[causes].sId = strtol(id_buf, NULL, 16);
-
-      ret = __value_deserialize(value_buf, &payload->senses[causes].value);
-      if (ret < 0)
-        {
-          eng_dbg("__value_deserialize failed\n");
-          goto errout;
-        }
-
-      cause = strtok_r(NULL, ";", &saveptr);
-      causes++;
+      return ERROR;
     }
 
-  return payload;
+  send_log->segment_index = __ts_engine_log_segment_index(send_log->segment);
 
-  errout:
-
-  free_payload(payload);
-
-  return NULL;
-}
-
-static int readline(int fd, char **buf)
-{
-  int n = 0;
-  int len = 64;
-  char *ptr;
-  int ret;
-  void *realloc_tmp;
-
-  *buf = malloc(len);
-  if (!*buf)
+  send_log->fds[LOG_SENDS] = open(send_log->segment, O_RDONLY);
+  if (send_log->fds[LOG_SENDS] < 0)
     {
-      eng_dbg("malloc failed\n");
+      eng_dbg("open %s failed\n", send_log->segment);
+      free((void *)send_log->segment);
+      send_log->segment = NULL;
       return ERROR;
     }
 
-  ptr = *buf;
-
-  do
+  ret = __ts_engine_log_cursor_load(CURSOR_ABS_FILENAME, &cursor);
+  if (ret == OK && cursor.segment == send_log->segment_index)
     {
-      ret = read(fd, &ptr[n], 1);
-      if (ret < 0)
-        {
-          eng_dbg("read failed\n");
-          free(*buf);
-          return ERROR;
-        }
-
-      n += ret;
-
-      if (ret == 0 || ptr[n - 1] == '\n')
-        {
-          break;
-        }
+      /* Resume after the last delivered record. */
 
-      if (n + 2 > len)
-        {
-          len += 64;
-          realloc_tmp = realloc(*buf, len);
-          if (!realloc_tmp)
-            {
-              eng_dbg("realloc %d failed\n", len);
-              free(*buf);
-              return ERROR;
-            }
-          *buf = realloc_tmp;
-
-          ptr = *buf;
-        }
-    } while (true);
-
-  if (n == 0)
-    {
-      free(*buf);
-    }
-  else
-    {
-      ptr[n] = '\0';
+      lseek(send_log->fds[LOG_SENDS], cursor.offset, SEEK_SET);
     }
 
-  return n;
+  eng_dbg("sending %s from offset %d\n", send_log->segment,
+          (int)lseek(send_log->fds[LOG_SENDS], 0, SEEK_CUR));
+
+  return OK;
 }
 
-static void finish(struct send_log *send_log, bool remove_send_file)
+static int next_segment(struct send_log *send_log)
 {
   int ret;
 
   close(send_log->fds[LOG_SENDS]);
   send_log->fds[LOG_SENDS] = -1;
-  *(send_log->handle) = NULL;
 
-  if (!remove_send_file)
-    {
-      return;
-    }
+  /* Cursor goes first: a reset in between re-sends the segment rather than
+   * skipping records of a later segment that reuses the same number.
+   */
+
+  (void)unlink(CURSOR_ABS_FILENAME);
 
-  eng_dbg("Done with sending: removing %s\n", g_filenames_str[LOG_SENDS]);
+  eng_dbg("Done with %s: removing\n", send_log->segment);
 
-  ret = unlink(g_filenames_str[LOG_SENDS]);
+  ret = unlink(send_log->segment);
   if (ret < 0)
     {
-      eng_dbg("unlink %s failed\n", g_filenames_str[LOG_SENDS]);
+      eng_dbg("unlink %s failed\n", send_log->segment);
     }
+
+  free((void *)send_log->segment);
+  send_log->segment = NULL;
+
+  return open_segment(send_log);
 }
 
 static int retry_timer_cb(const int timer_id, void * const priv)
@@ -379,18 +195,16 @@ static void retry_with_delay(struct send_log *send_log, int delay)
   if (id < 0)
     {
       eng_dbg("ts_core_timer_setup failed\n");
-      finish(send_log, false);
+      finish(send_log);
     }
 }
 
 int __ts_engine_log_process(void * const priv, bool retry)
 {
   struct send_log *send_log = priv;
-  char *line;
   int ret;
   int i, j;
   struct ts_payload *payloads[ENTRIES_PER_REQUEST];
-  int len = 0;
 
   if (send_log->fds[LOG_SENDS] == -1)
     {
@@ -406,7 +220,7 @@ int __ts_engine_log_process(void * const priv, bool retry)
       if (send_log->errcount >= BAILOUT_ERROUR_COUNT)
         {
           eng_dbg("Too many fails, ending send...\n");
-          finish(send_log, false);
+          finish(send_log);
           return ERROR;
         }
     }
@@ -414,53 +228,43 @@ int __ts_engine_log_process(void * const priv, bool retry)
     {
       send_log->offset = lseek(send_log->fds[LOG_SENDS], 0, SEEK_CUR);
       send_log->errcount = 0;
-    }
 
-  eng_dbg("file: %s offset: %d\n", g_filenames_str[LOG_SENDS], send_log->offset);
-
-  for (i = 0; i < send_log->entries_per_request; i++)
-    {
-      ret = readline(send_log->fds[LOG_SENDS], &line);
-      if (ret < 0)
+      if (send_log->offset > 0)
         {
-          eng_dbg("readline failed\n");
-          finish(send_log, false);
-          return ERROR;
-        }
+          struct log_cursor cursor;
 
-      if (ret == 0)
-        {
-          if (i == 0)
-            {
-              finish(send_log, true);
-              return OK;
-            }
-          break; /* send the last items */
-        }
+          /* Everything before offset has been delivered. */
 
-      len += ret;
-      if (len > CHARS_IN_ONE_SEND)
-        {
-          free(line);
-
-          if (i == 0)
-            {
-              eng_dbg("too long line, skipping\n");
-              i--;
-              continue;
-            }
-          break;
+          cursor.segment = send_log->segment_index;
+          cursor.offset = send_log->offset;
+
+          (void)__ts_engine_log_cursor_save(CURSOR_ABS_FILENAME, &cursor);
         }
+    }
 
-      payloads[i] = deserialize_payload(send_log, line);
+  eng_dbg("file: %s offset: %d\n", send_log->segment, send_log->offset);
 
-      free(line);
+  i = __ts_engine_log_record_read_batch(send_log->fds[LOG_SENDS], payloads,
+                                        send_log->entries_per_request,
+                                        CHARS_IN_ONE_SEND);
+  if (i < 0)
+    {
+      eng_dbg("__ts_engine_log_record_read_batch failed\n");
+      finish(send_log);
+      return ERROR;
+    }
 
-      if (!payloads[i])
+  if (i == 0)
+    {
+      ret = next_segment(send_log);
+      if (ret < 0)
         {
-          eng_dbg("deserialize_payload failed\n");
-          i--;
+          eng_dbg("Done with sending\n");
+          finish(send_log);
+          return OK;
         }
+
+      return __ts_engine_log_process(send_log, false);
     }
 
   if (i > 1)
@@ -480,14 +284,15 @@ int __ts_engine_log_process(void * const priv, bool retry)
 
   for (j = 0; j < i; j++)
     {
-      free_payload(payloads[j]);
+      free(payloads[j]);
     }
 
   return OK;
 }
 
-static void append_log(struct send_log *send_log, enum logtypes type)
+static void seal_log(struct send_log *send_log, enum logtypes type)
 {
+  const char *segment;
   struct stat stats;
   int ret;
 
@@ -503,33 +308,41 @@ static void append_log(struct send_log *send_log, enum logtypes type)
       return;
     }
 
-  ret = __ts_engine_util_cp(g_filenames_str[type], g_filenames_str[LOG_SENDS]);
-  if (ret < 0)
+  if (stats.st_size == 0)
     {
-      eng_dbg("__ts_engine_util_cp %s to %s failed\n", g_filenames_str[type], g_filenames_str[LOG_SENDS]);
+      (void)unlink(g_filenames_str[type]);
+      return;
     }
-  else
-    {
-      eng_dbg("copied %s to %s\n", g_filenames_str[type], g_filenames_str[LOG_SENDS]);
 
-      ret = unlink(g_filenames_str[type]);
-      if (ret < 0)
-        {
-          eng_dbg("unlink %s failed\n", g_filenames_str[type]);
-        }
-      else
-        {
-          eng_dbg("removed %s\n", g_filenames_str[type]);
-        }
+  segment = __ts_engine_util_gen_next_log(LOG_DIRECTORY, LOG_SEGMENT_BASENAME);
+  if (!segment)
+    {
+      eng_dbg("__ts_engine_util_gen_next_log failed\n");
+      return;
     }
+
+  (void)__ts_engine_log_segment_seal(g_filenames_str[type], segment);
+
+  free((void *)segment);
 }
 
 bool __ts_engine_log_have_logs(void)
 {
   struct stat stats;
   int ret;
+
+  const char *segment;
   int i;
 
+  segment = __ts_engine_util_find_log(LOG_DIRECTORY, LOG_SEGMENT_BASENAME);
+  if (segment)
+    {
+      eng_dbg("log segment: %s\n", segment);
+
+      free((void *)segment);
+      return true;
+    }
+
   for (i = 0; i < NUMBER_OF_LOGS; i++)
     {
       if (g_send_log.fds[i] >= 0)
@@ -558,11 +371,17 @@ int __ts_engine_log_start(struct send_log **handle, bool multisend,
                           struct url * const url)
 {
   struct send_log *send_log = &g_send_log;
-  struct stat stats;
   int ret;
 
-  append_log(send_log, LOG_EVENTS);
-  append_log(send_log, LOG_CAUSES);
+  if (send_log->fds[LOG_SENDS] == -1)
+    {
+      /* Send log left behind by older firmware is shipped first. */
+
+      seal_log(send_log, LOG_SENDS);
+    }
+
+  seal_log(send_log, LOG_EVENTS);
+  seal_log(send_log, LOG_CAUSES);
 
   if (send_log->fds[LOG_SENDS] != -1)
     {
@@ -570,20 +389,13 @@ int __ts_engine_log_start(struct send_log **handle, bool multisend,
       return OK;
     }
 
-  ret = stat(g_filenames_str[LOG_SENDS], &stats);
+  ret = open_segment(send_log);
   if (ret < 0)
     {
       eng_dbg("no logs to send\n");
       return OK;
     }
 
-  send_log->fds[LOG_SENDS] = open(g_filenames_str[LOG_SENDS], O_RDONLY);
-  if (send_log->fds[LOG_SENDS] < 0)
-    {
-      eng_dbg("open %s failed\n", g_filenames_str[LOG_SENDS]);
-      return ERROR;
-    }
-
   send_log->url = url;
   send_log->handle = handle;
   *handle = send_log;
@@ -597,7 +409,7 @@ int __ts_engine_log_start(struct send_log **handle, bool multisend,
       send_log->entries_per_request = 1;
     }
 
-  eng_dbg("start sending %s\n", g_filenames_str[LOG_SENDS]);
+  eng_dbg("start sending %s\n", send_log->segment);
 
   return __ts_engine_log_process(send_log, false);
 }
@@ -612,7 +424,7 @@ int __ts_engine_log_stop(struct send_log *handle)
       return ERROR;
     }
 
-  finish(send_log, false);
+  finish(send_log);
 
   return OK;
 }
@@ -620,17 +432,27 @@ int __ts_engine_log_stop(struct send_log *handle)
 void __ts_engine_log_payload(struct ts_payload *payload,
                              enum logtypes type)
 {
-  char *entry;
+  uint8_t *entry;
+  size_t len;
   int ret;
 
-  entry = serialize_payload(payload);
+  len = __ts_engine_log_record_size(payload);
+
+  entry = malloc(len);
   if (!entry)
     {
-      eng_dbg("serialize_payload failed\n");
+      eng_dbg("malloc %d failed\n", len);
       return;
     }
 
-  eng_dbg("%s", entry);
+  ret = __ts_engine_log_record_encode(payload, entry, len);
+  if (ret < 0)
+    {
+      eng_dbg("__ts_engine_log_record_encode failed\n");
+      goto out;
+    }
+
+  eng_dbg("%s: %d bytes\n", g_filenames_str[type], ret);
 
   if (g_send_log.fds[type] == -1)
     {
@@ -642,13 +464,20 @@ void __ts_engine_log_payload(struct ts_payload *payload,
         }
     }
 
-  ret = __ts_engine_full_write(g_send_log.fds[type], entry, strlen(entry));
+  ret = __ts_engine_full_write(g_send_log.fds[type], entry, ret);
   if (ret < 0)
     {
       eng_dbg ("__ts_engine_full_write failed\n");
       goto out;
     }
 
+  if (lseek(g_send_log.fds[type], 0, SEEK_CUR) >= LOG_SEGMENT_MAX_SIZE)
+    {
+      /* Full: hand it over to the sender as it is. */
+
+      seal_log(&g_send_log, type);
+    }
+
 out:
 
   free(entry);
@@ -668,14 +497,35 @@ void __ts_engine_log_close_all(void)
           g_send_log.fds[i] = -1;
         }
     }
+
+  free((void *)g_send_log.segment);
+  g_send_log.segment = NULL;
 }
 
 void __ts_engine_log_remove(void)
 {
+  const char *segment;
   struct stat stats;
   int i;
   int ret;
 
+  while ((segment = __ts_engine_util_find_log(LOG_DIRECTORY,
+                                              LOG_SEGMENT_BASENAME)))
+    {
+      ret = unlink(segment);
+      if (ret < 0)
+        {
+          eng_dbg("unlink %s failed\n", segment);
+          free((void *)segment);
+          break;
+        }
+
+      eng_dbg("removed %s\n", segment);
+      free((void *)segment);
+    }
+
+  (void)unlink(CURSOR_ABS_FILENAME);
+
   for (i = 0; i < ARRAY_SIZE(g_filenames_str); i++)
     {
       ret = stat(g_filenames_str[i], &stats);
@@ -43,12 +43,14 @@
 #define EVENT_LOG_FILENAME      "EVENTS.LOG"
 #define CAUSE_LOG_FILENAME      "CAUSES.LOG"
 #define SEND_LOG_FILENAME       "SEND.LOG"
+#define CURSOR_FILENAME         "SEND.CUR"
 
 #define LOG_DIRECTORY           TS_EMMC_MOUNT_PATH
 
 #define EVENT_LOG_ABS_FILENAME  LOG_DIRECTORY "/" EVENT_LOG_FILENAME
 #define CAUSE_LOG_ABS_FILENAME  LOG_DIRECTORY "/" CAUSE_LOG_FILENAME
 #define SEND_LOG_ABS_FILENAME   LOG_DIRECTORY "/" SEND_LOG_FILENAME
+#define CURSOR_ABS_FILENAME     LOG_DIRECTORY "/" CURSOR_FILENAME
 
 enum logtypes
 {
@@ -0,0 +1,857 @@
+/****************************************************************************
+ * apps/ts_engine/engine/log_record.c
+ *
+ * Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <crc32.h>
+
+#include "eng_dbg.h"
+#include "log_record.h"
+#include "value.h"
+
+#define STR_NULL_LEN            0xFFFF
+
+struct rec_writer
+{
+  uint8_t *buf;
+  size_t len;
+  size_t pos;
+};
+
+struct rec_reader
+{
+  const uint8_t *p;
+  const uint8_t *end;
+  bool error;
+};
+
+/* Decoding is done in two passes over the same record. The first pass only
+ * counts what is needed, the second one fills a single allocation.
+ */
+
+struct rec_space
+{
+  struct ts_value *items;
+  char *strs;
+  size_t nitems;
+  size_t strbytes;
+  bool fill;
+};
+
+static void put_bytes(struct rec_writer *w, const void *data, size_t len)
+{
+  if (w->buf && w->pos + len <= w->len)
+    {
+      memcpy(&w->buf[w->pos], data, len);
+    }
+
+  w->pos += len;
+}
+
+static void put_u8(struct rec_writer *w, uint8_t val)
+{
+  put_bytes(w, &val, 1);
+}
+
+static void put_u16(struct rec_writer *w, uint16_t val)
+{
+  uint8_t b[2];
+
+  b[0] = val & 0xff;
+  b[1] = val >> 8;
+
+  put_bytes(w, b, sizeof(b));
+}
+
+static void put_u32(struct rec_writer *w, uint32_t val)
+{
+  uint8_t b[4];
+
+  b[0] = val & 0xff;
+  b[1] = (val >> 8) & 0xff;
+  b[2] = (val >> 16) & 0xff;
+  b[3] = val >> 24;
+
+  put_bytes(w, b, sizeof(b));
+}
+
+static void put_str(struct rec_writer *w, const char *str)
+{
+  size_t len;
+
+  if (!str)
+    {
+      put_u16(w, STR_NULL_LEN);
+      return;
+    }
+
+  len = strlen(str);
+  if (len >= STR_NULL_LEN)
+    {
+      len = STR_NULL_LEN - 1;
+    }
+
+  put_u16(w, len);
+  put_bytes(w, str, len);
+}
+
+static void put_value(struct rec_writer *w, const struct ts_value *value)
+{
+  uint64_t bits;
+  int i;
+
+  put_u8(w, value->valuetype);
+
+  switch (value->valuetype)
+    {
+    case VALUEDOUBLE:
+      memcpy(&bits, &value->valuedouble, sizeof(bits));
+      put_u32(w, bits & 0xffffffff);
+      put_u32(w, bits >> 32);
+      break;
+
+    case VALUEUINT16:
+    case VALUEINT16:
+      put_u16(w, value->valueuint16);
+      break;
+
+    case VALUEUINT32:
+    case VALUEINT32:
+    case VALUEHEXSTRING:
+      put_u32(w, value->valueuint32);
+      break;
+
+    case VALUEBOOL:
+      put_u8(w, value->valuebool);
+      break;
+
+    case VALUESTRING:
+      put_str(w, value->valuestring);
+      break;
+
+    case VALUEARRAY:
+    case VALUEARRAY_FIRSTSTRING:
+      put_u16(w, value->valuearray.number_of_items);
+      for (i = 0; i < value->valuearray.number_of_items; i++)
+        {
+          put_value(w, &value->valuearray.items[i]);
+        }
+      break;
+    }
+}
+
+static void put_body(struct rec_writer *w, const struct ts_payload *payload)
+{
+  const struct ts_sense_value *sense;
+  int i;
+
+  put_u32(w, payload->state.puId);
+  put_u32(w, payload->state.stId);
+  put_u32(w, payload->state.evId);
+  put_u32(w, payload->state.ts.tv_sec);
+  put_u32(w, payload->state.ts.tv_nsec);
+  put_str(w, payload->state.pId);
+  put_u8(w, payload->number_of_senses);
+
+  for (i = 0; i < payload->number_of_senses; i++)
+    {
+      sense = &payload->senses[i];
+
+      put_u32(w, sense->sId);
+      put_u32(w, sense->ts.tv_sec);
+      put_u32(w, sense->ts.tv_nsec);
+      put_str(w, sense->name);
+      put_value(w, &sense->value);
+    }
+}
+
+static const uint8_t *get_bytes(struct rec_reader *r, size_t len)
+{
+  const uint8_t *p = r->p;
+
+  if (r->error || (size_t)(r->end - r->p) < len)
+    {
+      r->error = true;
+      return NULL;
+    }
+
+  r->p += len;
+
+  return p;
+}
+
+static uint8_t get_u8(struct rec_reader *r)
+{
+  const uint8_t *p = get_bytes(r, 1);
+
+  return p ? p[0] : 0;
+}
+
+static uint16_t get_u16(struct rec_reader *r)
+{
+  const uint8_t *p = get_bytes(r, 2);
+
+  return p ? (p[0] | (p[1] << 8)) : 0;
+}
+
+static uint32_t get_u32(struct rec_reader *r)
+{
+  const uint8_t *p = get_bytes(r, 4);
+
+  return p ? (p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24)) : 0;
+}
+
+static const char *get_str(struct rec_reader *r, struct rec_space *space)
+{
+  const uint8_t *p;
+  uint16_t len;
+  char *str;
+
+  len = get_u16(r);
+  if (len == STR_NULL_LEN)
+    {
+      return NULL;
+    }
+
+  p = get_bytes(r, len);
+  if (!p)
+    {
+      return NULL;
+    }
+
+  if (!space->fill)
+    {
+      space->strbytes += len + 1;
+      return NULL;
+    }
+
+  str = &space->strs[space->strbytes];
+  space->strbytes += len + 1;
+
+  memcpy(str, p, len);
+  str[len] = '\0';
+
+  return str;
+}
+
+static void get_value(struct rec_reader *r, struct rec_space *space,
+                      struct ts_value *value)
+{
+  struct ts_value *items;
+  struct ts_value scratch;
+  uint64_t bits;
+  int count;
+  int i;
+
+  value->valuetype = get_u8(r);
+
+  switch (value->valuetype)
+    {
+    case VALUEDOUBLE:
+      bits = get_u32(r);
+      bits |= (uint64_t)get_u32(r) << 32;
+      memcpy(&value->valuedouble, &bits, sizeof(bits));
+      break;
+
+    case VALUEUINT16:
+    case VALUEINT16:
+      value->valueuint16 = get_u16(r);
+      break;
+
+    case VALUEUINT32:
+    case VALUEINT32:
+    case VALUEHEXSTRING:
+      value->valueuint32 = get_u32(r);
+      break;
+
+    case VALUEBOOL:
+      value->valuebool = get_u8(r);
+      break;
+
+    case VALUESTRING:
+      value->valuestring = (char *)get_str(r, space);
+      break;
+
+    case VALUEARRAY:
+    case VALUEARRAY_FIRSTSTRING:
+      count = get_u16(r);
+
+      /* Reserve all items of this array before recursing, nested arrays
+       * take the following slots.
+       */
+
+      items = space->fill ? &space->items[space->nitems] : NULL;
+      space->nitems += count;
+
+      value->valuearray.number_of_items = count;
+      value->valuearray.items = count ? items : NULL;
+
+      for (i = 0; i < count && !r->error; i++)
+        {
+          get_value(r, space, items ? &items[i] : &scratch);
+        }
+      break;
+
+    default:
+      eng_dbg("unknown valuetype: %d\n", value->valuetype);
+      r->error = true;
+      break;
+    }
+}
+
+static int get_body(struct rec_reader *r, struct rec_space *space,
+                    struct ts_payload *payload)
+{
+  struct ts_ids ids;
+  struct ts_sense_value sense;
+  const char *pId;
+  int senses;
+  int i;
+
+  ids.puId = get_u32(r);
+  ids.stId = get_u32(r);
+  ids.evId = get_u32(r);
+  ids.ts.tv_sec = get_u32(r);
+  ids.ts.tv_nsec = get_u32(r);
+  pId = get_str(r, space);
+  senses = get_u8(r);
+
+  if (space->fill)
+    {
+      payload->state = ids;
+      payload->state.pId = pId;
+      payload->number_of_senses = senses;
+    }
+
+  for (i = 0; i < senses && !r->error; i++)
+    {
+      sense.sId = get_u32(r);
+      sense.ts.tv_sec = get_u32(r);
+      sense.ts.tv_nsec = get_u32(r);
+      sense.name = get_str(r, space);
+
+      get_value(r, space, &sense.value);
+
+      if (space->fill)
+        {
+          payload->senses[i] = sense;
+        }
+    }
+
+  if (r->error)
+    {
+      return ERROR;
+    }
+
+  return senses;
+}
+
+static uint32_t record_crc(const uint8_t *rec, size_t bodylen)
+{
+  return crc32part(&rec[LOG_RECORD_HDR_LEN], bodylen, crc32(&rec[1], 3));
+}
+
+size_t __ts_engine_log_record_size(const struct ts_payload *payload)
+{
+  struct rec_writer w = { NULL, 0, 0 };
+
+  put_body(&w, payload);
+
+  return LOG_RECORD_HDR_LEN + w.pos;
+}
+
+int __ts_engine_log_record_encode(const struct ts_payload *payload,
+                                  uint8_t *buf, size_t buflen)
+{
+  struct rec_writer w;
+  size_t bodylen;
+  uint32_t crc;
+
+  if (buflen < LOG_RECORD_HDR_LEN)
+    {
+      return ERROR;
+    }
+
+  w.buf = &buf[LOG_RECORD_HDR_LEN];
+  w.len = buflen - LOG_RECORD_HDR_LEN;
+  w.pos = 0;
+
+  put_body(&w, payload);
+
+  bodylen = w.pos;
+  if (bodylen > w.len || bodylen > LOG_RECORD_MAX_BODY)
+    {
+      eng_dbg("record too long: %d\n", bodylen);
+      return ERROR;
+    }
+
+  buf[0] = LOG_RECORD_SYNC;
+  buf[1] = LOG_RECORD_VERSION;
+  buf[2] = bodylen & 0xff;
+  buf[3] = bodylen >> 8;
+
+  crc = record_crc(buf, bodylen);
+
+  buf[4] = crc & 0xff;
+  buf[5] = (crc >> 8) & 0xff;
+  buf[6] = (crc >> 16) & 0xff;
+  buf[7] = crc >> 24;
+
+  return LOG_RECORD_HDR_LEN + bodylen;
+}
+
+int __ts_engine_log_record_decode(const uint8_t *buf, size_t buflen,
+                                  struct ts_payload **payload)
+{
+  struct rec_reader r;
+  struct rec_space space;
+  struct ts_payload *out;
+  size_t bodylen;
+  uint32_t crc;
+  size_t offset;
+  int senses;
+
+  *payload = NULL;
+
+  if (buflen < LOG_RECORD_HDR_LEN)
+    {
+      return 0;
+    }
+
+  if (buf[0] != LOG_RECORD_SYNC || buf[1] != LOG_RECORD_VERSION)
+    {
+      return ERROR;
+    }
+
+  bodylen = buf[2] | (buf[3] << 8);
+  if (bodylen > LOG_RECORD_MAX_BODY)
+    {
+      return ERROR;
+    }
+
+  if (buflen < LOG_RECORD_HDR_LEN + bodylen)
+    {
+      return 0;
+    }
+
+  crc = buf[4] | (buf[5] << 8) | (buf[6] << 16) | ((uint32_t)buf[7] << 24);
+  if (crc != record_crc(buf, bodylen))
+    {
+      eng_dbg("crc mismatch\n");
+      return ERROR;
+    }
+
+  /* Pass 1: count senses, array items and string bytes. */
+
+  memset(&space, 0, sizeof(space));
+
+  r.p = &buf[LOG_RECORD_HDR_LEN];
+  r.end = r.p + bodylen;
+  r.error = false;
+
+  senses = get_body(&r, &space, NULL);
+  if (senses < 0)
+    {
+      eng_dbg("corrupt record\n");
+      return ERROR;
+    }
+
+  /* Pass 2: fill one allocation laid out as payload, senses, array items
+   * and strings.
+   */
+
+  offset = sizeof(*out) + senses * sizeof(struct ts_sense_value);
+
+  out = malloc(offset + space.nitems * sizeof(struct ts_value) +
+               space.strbytes);
+  if (!out)
+    {
+      eng_dbg("malloc failed\n");
+      return ERROR;
+    }
+
+  space.items = (struct ts_value *)((uint8_t *)out + offset);
+  space.strs = (char *)&space.items[space.nitems];
+  space.nitems = 0;
+  space.strbytes = 0;
+  space.fill = true;
+
+  r.p = &buf[LOG_RECORD_HDR_LEN];
+  r.error = false;
+
+  get_body(&r, &space, out);
+
+  *payload = out;
+
+  return LOG_RECORD_HDR_LEN + bodylen;
+}
+
+static void free_value(struct ts_value *value)
+{
+  int i;
+
+  switch (value->valuetype)
+    {
+    case VALUESTRING:
+      free(value->valuestring);
+      break;
+
+    case VALUEARRAY:
+    case VALUEARRAY_FIRSTSTRING:
+      for (i = 0; i < value->valuearray.number_of_items; i++)
+        {
+          free_value(&value->valuearray.items[i]);
+        }
+      free(value->valuearray.items);
+      break;
+
+    default:
+      break;
+    }
+}
+
+struct ts_payload *__ts_engine_log_record_from_text(char *line)
+{
+  struct ts_payload *tmp;
+  struct ts_payload *payload = NULL;
+  struct ts_sense_value *sense;
+  char *fields[6];
+  char *saveptr;
+  char *fsaveptr;
+  char *cause;
+  uint8_t *buf;
+  size_t len;
+  int senses = 0;
+  int nfields;
+  int ret;
+  int i;
+
+  for (i = 0; line[i] != '\0'; i++)
+    {
+      if (line[i] == ';')
+        {
+          senses++;
+        }
+    }
+
+  tmp = calloc(1, sizeof(*tmp) + senses * sizeof(struct ts_sense_value));
+  if (!tmp)
+    {
+      eng_dbg("calloc failed\n");
+      return NULL;
+    }
+
+  /* State: pId,puId,stId,evId,sec,nsec */
+
+  cause = strtok_r(line, ";", &saveptr);
+  if (!cause)
+    {
+      goto out;
+    }
+
+  for (nfields = 0; nfields < 6; nfields++)
+    {
+      fields[nfields] = strtok_r(nfields ? NULL : cause, ",", &fsaveptr);
+      if (!fields[nfields])
+        {
+          break;
+        }
+    }
+
+  if (nfields != 6)
+    {
+      eng_dbg("state parse failed: %d\n", nfields);
+      goto out;
+    }
+
+  tmp->state.pId = fields[0];
+  tmp->state.puId = strtol(fields[1], NULL, 10);
+  tmp->state.stId = strtol(fields[2], NULL, 10);
+  tmp->state.evId = strtol(fields[3], NULL, 10);
+  tmp->state.ts.tv_sec = strtol(fields[4], NULL, 10);
+  tmp->state.ts.tv_nsec = strtol(fields[5], NULL, 10);
+
+  /* Senses: name,0xsId,type:value,sec,nsec */
+
+  while ((cause = strtok_r(NULL, ";", &saveptr)) != NULL)
+    {
+      for (nfields = 0; nfields < 5; nfields++)
+        {
+          fields[nfields] = strtok_r(nfields ? NULL : cause, ",", &fsaveptr);
+          if (!fields[nfields])
+            {
+              break;
+            }
+        }
+
+      if (nfields != 5)
+        {
+          eng_dbg("cause %d parse failed: %s\n", tmp->number_of_senses, cause);
+          goto out;
+        }
+
+      sense = &tmp->senses[tmp->number_of_senses];
+
+      sense->name = fields[0];
+      sense->sId = strtoul(fields[1], NULL, 16);
+      sense->ts.tv_sec = strtol(fields[3], NULL, 10);
+      sense->ts.tv_nsec = strtol(fields[4], NULL, 10);
+
+      ret = __value_deserialize(fields[2], &sense->value);
+      if (ret <= 0)
+        {
+          eng_dbg("__value_deserialize failed\n");
+          goto out;
+        }
+
+      tmp->number_of_senses++;
+    }
+
+  /* Re-encode to the binary format so that legacy entries end up in the
+   * same single allocation layout as binary ones.
+   */
+
+  len = __ts_engine_log_record_size(tmp);
+
+  buf = malloc(len);
+  if (!buf)
+    {
+      eng_dbg("malloc %d failed\n", len);
+      goto out;
+    }
+
+  ret = __ts_engine_log_record_encode(tmp, buf, len);
+  if (ret > 0)
+    {
+      ret = __ts_engine_log_record_decode(buf, ret, &payload);
+    }
+
+  free(buf);
+
+out:
+
+  for (i = 0; i < tmp->number_of_senses; i++)
+    {
+      free_value(&tmp->senses[i].value);
+    }
+
+  free(tmp);
+
+  return payload;
+}
+
+int __ts_engine_log_record_read_batch(int fd, struct ts_payload **payloads,
+                                      int max, size_t max_bytes)
+{
+  struct ts_payload *payload;
+  uint8_t *block;
+  uint8_t *rec;
+  uint8_t *nl;
+  void *realloc_tmp;
+  size_t blocklen = LOG_RECORD_BLOCK_SIZE;
+  size_t fill = 0;
+  size_t pos = 0;
+  size_t used = 0;
+  size_t avail;
+  size_t reclen;
+  off_t start;
+  off_t base = 0;
+  bool eof = false;
+  int count = 0;
+  int ret;
+
+  start = lseek(fd, 0, SEEK_CUR);
+  if (start < 0)
+    {
+      eng_dbg("lseek failed\n");
+      return ERROR;
+    }
+
+  /* One extra byte for terminating a legacy line at end of file. */
+
+  block = malloc(blocklen + 1);
+  if (!block)
+    {
+      eng_dbg("malloc %d failed\n", blocklen + 1);
+      return ERROR;
+    }
+
+  while (count < max)
+    {
+      avail = fill - pos;
+      rec = &block[pos];
+
+      if (avail == 0)
+        {
+          if (eof)
+            {
+              break;
+            }
+
+          goto refill;
+        }
+
+      if (rec[0] == LOG_RECORD_SYNC)
+        {
+          ret = __ts_engine_log_record_decode(rec, avail, &payload);
+          if (ret == 0)
+            {
+              if (!eof)
+                {
+                  goto refill;
+                }
+
+              eng_dbg("truncated record at end of log\n");
+              pos = fill;
+              continue;
+            }
+
+          if (ret < 0)
+            {
+              /* Corrupt: resync on the next sync byte. */
+
+              nl = memchr(&rec[1], LOG_RECORD_SYNC, avail - 1);
+              pos = nl ? (size_t)(nl - block) : fill;
+              continue;
+            }
+
+          reclen = ret;
+        }
+      else
+        {
+          /* Legacy text line. */
+
+          nl = memchr(rec, '\n', avail);
+          if (!nl && !eof)
+            {
+              goto refill;
+            }
+
+          reclen = nl ? (size_t)(nl - rec) + 1 : avail;
+          rec[nl ? reclen - 1 : reclen] = '\0';
+
+          payload = (rec[0] != '\0') ?
+              __ts_engine_log_record_from_text((char *)rec) : NULL;
+        }
+
+      if (count > 0 && used + reclen > max_bytes)
+        {
+          /* Leave it for the next batch. */
+
+          free(payload);
+          break;
+        }
+
+      pos += reclen;
+      used += reclen;
+
+      if (payload)
+        {
+          payloads[count++] = payload;
+        }
+      else
+        {
+          eng_dbg("skipping bad entry\n");
+        }
+
+      continue;
+
+    refill:
+
+      if (pos > 0)
+        {
+          memmove(block, &block[pos], fill - pos);
+          fill -= pos;
+          base += pos;
+          pos = 0;
+        }
+
+      if (fill == blocklen)
+        {
+          if (blocklen >= LOG_RECORD_HDR_LEN + LOG_RECORD_MAX_BODY)
+            {
+              eng_dbg("too long entry, skipping\n");
+              pos = (block[0] == LOG_RECORD_SYNC) ? 1 : fill;
+              continue;
+            }
+
+          realloc_tmp = realloc(block, blocklen * 2 + 1);
+          if (!realloc_tmp)
+            {
+              eng_dbg("realloc %d failed\n", blocklen * 2 + 1);
+              goto errout;
+            }
+
+          block = realloc_tmp;
+          blocklen *= 2;
+        }
+
+      ret = read(fd, &block[fill], blocklen - fill);
+      if (ret < 0)
+        {
+          eng_dbg("read failed\n");
+          goto errout;
+        }
+
+      if (ret == 0)
+        {
+          eof = true;
+        }
+
+      fill += ret;
+    }
+
+  free(block);
+
+  lseek(fd, start + base + pos, SEEK_SET);
+
+  return count;
+
+errout:
+
+  free(block);
+
+  while (count > 0)
+    {
+      free(payloads[--count]);
+    }
+
+  lseek(fd, start, SEEK_SET);
+
+  return ERROR;
+}
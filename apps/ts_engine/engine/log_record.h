@@ -0,0 +1,94 @@
+/****************************************************************************
+ * apps/ts_engine/engine/log_record.h
+ *
+ * Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#ifndef __APPS_TS_ENGINE_ENGINE_LOG_RECORD_H__
+#define __APPS_TS_ENGINE_ENGINE_LOG_RECORD_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "connectors/connector.h"
+
+/* Binary log record layout (all fields little-endian):
+ *
+ *   u8  sync        LOG_RECORD_SYNC
+ *   u8  version     LOG_RECORD_VERSION
+ *   u16 length      length of body
+ *   u32 crc         crc32 over version, length and body
+ *   ... body        state ids, timestamp, pId and the senses
+ *
+ * Legacy text lines never start with LOG_RECORD_SYNC, so old text logs and
+ * binary records can be mixed in one file and read with the same reader.
+ */
+
+#define LOG_RECORD_SYNC         0xA5
+#define LOG_RECORD_VERSION      1
+#define LOG_RECORD_HDR_LEN      8
+#define LOG_RECORD_MAX_BODY     4096
+
+#define LOG_RECORD_BLOCK_SIZE   1024
+
+/* Number of bytes needed to encode 'payload', header included. */
+
+size_t __ts_engine_log_record_size(const struct ts_payload *payload);
+
+/* Encode 'payload' to 'buf'. Returns number of bytes written or ERROR. */
+
+int __ts_engine_log_record_encode(const struct ts_payload *payload,
+                                  uint8_t *buf, size_t buflen);
+
+/* Decode one record from 'buf'. Returns number of bytes consumed, 0 if 'buf'
+ * does not hold a complete record yet, or ERROR if the record is corrupt.
+ * '*payload' is a single allocation, release it with free().
+ */
+
+int __ts_engine_log_record_decode(const uint8_t *buf, size_t buflen,
+                                  struct ts_payload **payload);
+
+/* Decode one legacy text log line (without the trailing newline). The
+ * returned payload is a single allocation, release it with free().
+ */
+
+struct ts_payload *__ts_engine_log_record_from_text(char *line);
+
+/* Read up to 'max' records (at most 'max_bytes' bytes of records) from 'fd'
+ * with block reads. The file position is left right after the last consumed
+ * record. Returns number of payloads decoded, 0 at end of file or ERROR.
+ */
+
+int __ts_engine_log_record_read_batch(int fd, struct ts_payload **payloads,
+                                      int max, size_t max_bytes);
+
+#endif
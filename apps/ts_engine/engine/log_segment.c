@@ -0,0 +1,173 @@
+/****************************************************************************
+ * apps/ts_engine/engine/log_segment.c
+ *
+ * Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+#include <nuttx/config.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <crc32.h>
+
+#include "eng_dbg.h"
+#include "log_segment.h"
+
+static void put_u32(uint8_t *b, uint32_t val)
+{
+  b[0] = val & 0xff;
+  b[1] = (val >> 8) & 0xff;
+  b[2] = (val >> 16) & 0xff;
+  b[3] = val >> 24;
+}
+
+static uint32_t get_u32(const uint8_t *b)
+{
+  return b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+int __ts_engine_log_segment_index(const char * const filename)
+{
+  const char *name;
+  const char *p;
+  size_t len = strlen(LOG_SEGMENT_BASENAME);
+
+  name = strrchr(filename, '/');
+  name = name ? name + 1 : filename;
+
+  if (strncmp(name, LOG_SEGMENT_BASENAME, len) || name[len] != '.')
+    {
+      return ERROR;
+    }
+
+  p = &name[len + 1];
+  if (*p == '\0')
+    {
+      return ERROR;
+    }
+
+  for (; *p; p++)
+    {
+      if (*p < '0' || *p > '9')
+        {
+          return ERROR;
+        }
+    }
+
+  return atoi(&name[len + 1]);
+}
+
+int __ts_engine_log_segment_seal(const char * const src,
+                                 const char * const segment)
+{
+  int ret;
+
+  ret = rename(src, segment);
+  if (ret < 0)
+    {
+      eng_dbg("rename %s to %s failed\n", src, segment);
+      return ERROR;
+    }
+
+  eng_dbg("sealed %s as %s\n", src, segment);
+
+  return OK;
+}
+
+int __ts_engine_log_cursor_load(const char * const filename,
+                                struct log_cursor *cursor)
+{
+  uint8_t buf[LOG_CURSOR_LEN];
+  int fd;
+  int ret;
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    {
+      return ERROR;
+    }
+
+  ret = read(fd, buf, sizeof(buf));
+  close(fd);
+
+  if (ret != sizeof(buf))
+    {
+      eng_dbg("short cursor %s\n", filename);
+      return ERROR;
+    }
+
+  if (get_u32(&buf[0]) != LOG_CURSOR_MAGIC ||
+      get_u32(&buf[12]) != crc32(buf, 12))
+    {
+      eng_dbg("bad cursor %s\n", filename);
+      return ERROR;
+    }
+
+  cursor->segment = (int32_t)get_u32(&buf[4]);
+  cursor->offset = get_u32(&buf[8]);
+
+  return OK;
+}
+
+int __ts_engine_log_cursor_save(const char * const filename,
+                                const struct log_cursor *cursor)
+{
+  uint8_t buf[LOG_CURSOR_LEN];
+  int fd;
+  int ret;
+
+  put_u32(&buf[0], LOG_CURSOR_MAGIC);
+  put_u32(&buf[4], cursor->segment);
+  put_u32(&buf[8], cursor->offset);
+  put_u32(&buf[12], crc32(buf, 12));
+
+  fd = open(filename, O_WRONLY | O_CREAT, 0666);
+  if (fd < 0)
+    {
+      eng_dbg("open %s failed\n", filename);
+      return ERROR;
+    }
+
+  ret = write(fd, buf, sizeof(buf));
+  close(fd);
+
+  if (ret != sizeof(buf))
+    {
+      eng_dbg("write %s failed\n", filename);
+      return ERROR;
+    }
+
+  return OK;
+}
@@ -0,0 +1,91 @@
+/****************************************************************************
+ * apps/ts_engine/engine/log_segment.h
+ *
+ * Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#ifndef __APPS_TS_ENGINE_ENGINE_LOG_SEGMENT_H__
+#define __APPS_TS_ENGINE_ENGINE_LOG_SEGMENT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* Logs are shipped in numbered segments ("LOGSEG.<n>"). The events and
+ * causes logs are written as usual and, once big enough or when sending is
+ * started, sealed by renaming them to the next free segment name. The
+ * sender only ever reads sealed segments, oldest first, and removes a
+ * segment once all of its records have been delivered.
+ *
+ * Progress within the oldest segment is kept in a small cursor file so that
+ * sending resumes from the first undelivered record after a reset.
+ */
+
+#define LOG_SEGMENT_BASENAME    "LOGSEG"
+#define LOG_SEGMENT_MAX_SIZE    (32 * 1024)
+
+#define LOG_CURSOR_MAGIC        0x52554353 /* "SCUR" */
+#define LOG_CURSOR_LEN          16
+
+struct log_cursor
+{
+  int segment;
+  off_t offset;
+};
+
+/* Segment number of segment file 'filename', or ERROR if 'filename' is not
+ * a segment name.
+ */
+
+int __ts_engine_log_segment_index(const char * const filename);
+
+/* Seal log 'src' as segment 'segment'. Returns OK, or ERROR if 'src' could
+ * not be renamed.
+ */
+
+int __ts_engine_log_segment_seal(const char * const src,
+                                 const char * const segment);
+
+/* Read cursor from 'filename'. A missing or damaged cursor is reported as
+ * ERROR, in which case sending starts from the beginning of the segment.
+ */
+
+int __ts_engine_log_cursor_load(const char * const filename,
+                                struct log_cursor *cursor);
+
+/* Store 'cursor' to 'filename'. The cursor is rewritten in place with a
+ * single write, a torn write is caught by the crc on load.
+ */
+
+int __ts_engine_log_cursor_save(const char * const filename,
+                                const struct log_cursor *cursor);
+
+#endif
@@ -240,24 +240,12 @@ profile_write(char * const profile_json, size_t len)
 #endif
 }
 
+#ifndef CONFIG_ARCH_SIM
 static const char *
-profile_read(bool *ref)
+profile_read_fallback(bool *ref)
 {
-#ifdef CONFIG_ARCH_SIM
-  size_t len;
-
-  *ref = true;
-  return engine_sense_sim_get_profile(&len);
-#else
   const char *profile;
 
-  profile = __ts_engine_sdcard_read(SDCARD_PROFILE_FILENAME);
-  if (profile)
-    {
-      *ref = false;
-      return profile;
-    }
-
 #ifndef CONFIG_THINGSEE_ENGINE_EEPROM
   profile = NULL;
 #else
@@ -274,24 +262,82 @@ profile_read(bool *ref)
     }
 
   return profile;
+}
+#endif
+
+static const char *
+profile_read(bool *ref)
+{
+#ifdef CONFIG_ARCH_SIM
+  size_t len;
+
+  *ref = true;
+  return engine_sense_sim_get_profile(&len);
+#else
+  const char *profile;
+
+  profile = __ts_engine_sdcard_read(SDCARD_PROFILE_FILENAME);
+  if (profile)
+    {
+      *ref = false;
+      return profile;
+    }
+
+  return profile_read_fallback(ref);
 #endif
 }
 
-static int
-engine_exec_profile(struct ts_engine_app * const app, const char *profile_json)
+static struct ts_profile *
+profile_load(int *errcode)
 {
   struct ts_profile *profile;
-  int errcode;
+  const char *profile_json;
+  bool ref;
+#ifndef CONFIG_ARCH_SIM
+  int fd;
+#endif
 
   eng_dbg("Parsing profile\n");
 
-  profile = profile_parse(profile_json, &errcode);
-  if (!profile)
+#ifdef CONFIG_ARCH_SIM
+  profile_json = profile_read(&ref);
+#else
+  /* Profile on SD card is parsed straight from the file, without loading
+   * the whole JSON text to memory first.
+   */
+
+  fd = open(SDCARD_PROFILE_FILENAME, O_RDONLY);
+  if (fd >= 0)
     {
-      eng_dbg("profile_parse failed: %d\n", errcode);
-      return errcode;
+      profile = profile_parse_fd(fd, errcode);
+      close(fd);
+      return profile;
+    }
+
+  profile_json = profile_read_fallback(&ref);
+#endif
+
+  if (!profile_json)
+    {
+      eng_dbg("profile_read failed\n");
+      *errcode = -TS_ENGINE_ERROR_NO_PROFILE;
+      return NULL;
+    }
+
+  profile = profile_parse(profile_json, errcode);
+
+  if (!ref)
+    {
+      free((void *) profile_json);
     }
 
+  return profile;
+}
+
+static int
+engine_exec_profile(struct ts_engine_app * const app,
+                    struct ts_profile *profile)
+{
   eng_dbg("Starting profile\n");
 
   app->engine = profile_main(app, profile);
@@ -307,28 +353,23 @@ engine_exec_profile(struct ts_engine_app * const app, const char *profile_json)
 
 static int ts_engine_start(struct ts_engine_app * const app)
 {
-  const char * profile_json;
-  bool ref;
+  struct ts_profile *profile;
+  int errcode;
   int ret;
 
-  profile_json = profile_read(&ref);
-  if (!profile_json)
+  profile = profile_load(&errcode);
+  if (!profile)
     {
-      eng_dbg("profile_read failed\n");
-      return -TS_ENGINE_ERROR_NO_PROFILE;
+      eng_dbg("profile_parse failed: %d\n", errcode);
+      return errcode;
     }
 
-  ret = engine_exec_profile(app, profile_json);
+  ret = engine_exec_profile(app, profile);
   if (ret < 0)
     {
       eng_dbg("engine_exec_profile failed\n");
     }
 
-  if (!ref)
-    {
-      free((void *) profile_json);
-    }
-
   eng_dbg("engine started\n");
 
   return ret;
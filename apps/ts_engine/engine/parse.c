@@ -41,6 +41,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
 
 #include <queue.h>
 #include <debug.h>
@@ -52,6 +54,9 @@
 #include "sense.h"
 #include "eng_error.h"
 #include "execute.h"
+#include "threshold.h"
+#include "geofence.h"
+#include "arena.h"
 
 #ifndef offsetof
 #define offsetof(type, member)   ( (size_t) &( ( (type *) 0)->member))
@@ -61,6 +66,9 @@
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
 #endif
 
+#define PROFILE_NAME_MAX        32
+#define PROFILE_READ_BUFSIZE    64
+
 const char *threshold_types[] =
   {
       [isOneOf] = g_isOneOf_str,
@@ -85,9 +93,28 @@ struct ts_parse
   };
 };
 
+struct profile_reader
+{
+  const char *str;              /* String source, NULL when reading fd */
+  int fd;
+  off_t start;
+  ssize_t len;
+  size_t pos;
+  char buf[PROFILE_READ_BUFSIZE];
+};
+
+struct profile_stream
+{
+  cJSON_stream json;
+  struct ts_arena *arena;       /* NULL during sizing pass */
+  size_t size;
+};
+
+typedef int (*stream_member_t)(struct profile_stream *ps, void *parent);
+
 static int
 get_json_valuestring (cJSON * parent, const char * const label,
-		      char ** const value)
+		      const char ** const value)
 {
   cJSON *object;
 
@@ -104,7 +131,7 @@ get_json_valuestring (cJSON * parent, const char * const label,
       return ERROR;
     }
 
-  *value = strdup (cJSON_string(object));
+  *value = cJSON_string(object);
 
   return OK;
 }
@@ -242,7 +269,8 @@ get_json_valuebool (cJSON * parent, const char * const label,
 }
 
 static int
-parse_json_object (cJSON *object, void *data, const struct ts_parse *parse, int items)
+parse_json_object (cJSON *object, void *data, const struct ts_parse *parse,
+                   int items, struct ts_arena *arena)
 {
   int i;
   int j;
@@ -358,9 +386,14 @@ parse_json_object (cJSON *object, void *data, const struct ts_parse *parse, int
         case VALUESTRING:
           {
             char **value = (char **) field;
+            const char *str;
 
-            ret = get_json_valuestring (object, parse[i].label, value);
-            if (ret != OK)
+            ret = get_json_valuestring (object, parse[i].label, &str);
+            if (ret == OK)
+              {
+                *value = __ts_engine_arena_strdup (arena, str);
+              }
+            else
               {
                 if (parse[i].required)
                   {
@@ -369,7 +402,8 @@ parse_json_object (cJSON *object, void *data, const struct ts_parse *parse, int
                   }
                 else
                   {
-                    *value = strdup (parse[i].value.valuestring);
+                    *value = __ts_engine_arena_strdup (arena,
+                                                       parse[i].value.valuestring);
                   }
               }
           }
@@ -409,8 +443,13 @@ parse_json_object (cJSON *object, void *data, const struct ts_parse *parse, int
               {
                 value->valuetype = VALUEARRAY;
                 value->valuearray.number_of_items = cJSON_GetArraySize(array);
-                value->valuearray.items = calloc (1, value->valuearray.number_of_items * sizeof(*value->valuearray.items));
-                ret = OK;
+                value->valuearray.items = __ts_engine_arena_alloc (arena,
+                    value->valuearray.number_of_items * sizeof(*value->valuearray.items));
+                ret = value->valuearray.items ? OK : ERROR;
+                if (ret != OK)
+                  {
+                    value->valuearray.number_of_items = 0;
+                  }
 
                 for (j = 0; j < value->valuearray.number_of_items; j++)
                   {
@@ -431,7 +470,8 @@ parse_json_object (cJSON *object, void *data, const struct ts_parse *parse, int
                         else if (type == cJSON_String)
                           {
                             value->valuearray.items[j].valuetype = VALUESTRING;
-                            value->valuearray.items[j].valuestring = strdup(cJSON_string(obj));
+                            value->valuearray.items[j].valuestring =
+                                __ts_engine_arena_strdup (arena, cJSON_string(obj));
                             if (!value->valuearray.items[j].valuestring)
                               {
                                 eng_dbg("stdup failed\n");
@@ -451,14 +491,9 @@ parse_json_object (cJSON *object, void *data, const struct ts_parse *parse, int
 
             if (ret != OK)
               {
-                for (j = 0; j < value->valuearray.number_of_items; j++)
-                  {
-                    if (value->valuearray.items[j].valuetype == VALUESTRING)
-                      {
-                        free (value->valuearray.items[j].valuestring);
-                      }
-                  }
-                free (value->valuearray.items);
+                /* Partial items stay in the arena until the profile is
+                 * freed.
+                 */
 
                 if (parse[i].required)
                   {
@@ -488,7 +523,7 @@ parse_json_object (cJSON *object, void *data, const struct ts_parse *parse, int
                 obj = cJSON_GetArrayItem(array, 0);
                 if (obj && cJSON_type(obj) == cJSON_String)
                   {
-                    *value = strdup(cJSON_string(obj));
+                    *value = __ts_engine_arena_strdup (arena, cJSON_string(obj));
                     ret = OK;
                   }
               }
@@ -502,7 +537,8 @@ parse_json_object (cJSON *object, void *data, const struct ts_parse *parse, int
                   }
                 else
                   {
-                    *value = strdup (parse[i].value.valuestring);
+                    *value = __ts_engine_arena_strdup (arena,
+                                                       parse[i].value.valuestring);
                   }
               }
           }
@@ -511,7 +547,7 @@ parse_json_object (cJSON *object, void *data, const struct ts_parse *parse, int
         case VALUEHEXSTRING:
           {
             uint32_t *value = (uint32_t *)field;
-            char *hexstring;
+            const char *hexstring;
 
             ret = get_json_valuestring (object, parse[i].label, &hexstring);
             if (ret != OK)
@@ -529,7 +565,6 @@ parse_json_object (cJSON *object, void *data, const struct ts_parse *parse, int
             else if (hexstring != NULL)
               {
                 sscanf(hexstring, "0x%x", value);
-                free (hexstring);
               }
             else
               {
@@ -547,13 +582,14 @@ parse_json_object (cJSON *object, void *data, const struct ts_parse *parse, int
 }
 
 static void
-set_threshold_value (cJSON *thr, struct ts_value *value)
+set_threshold_value (cJSON *thr, struct ts_value *value,
+                     struct ts_arena *arena)
 {
   switch (cJSON_type(thr))
   {
     case cJSON_String:
       value->valuetype = VALUESTRING;
-      value->valuestring = strdup(cJSON_string(thr));
+      value->valuestring = __ts_engine_arena_strdup (arena, cJSON_string(thr));
       break;
 
     case cJSON_Number:
@@ -575,11 +611,57 @@ set_threshold_value (cJSON *thr, struct ts_value *value)
 }
 
 static int
-add_threshold (cJSON *json_threshold, struct ts_cause *cause, int type)
+init_geofence (struct ts_threshold *threshold, struct ts_arena *arena)
+{
+  struct ts_value_array *coords = &threshold->conf.value.valuearray;
+  struct poly *poly;
+  int points;
+  int i;
+
+  /* Polygon and its index are built once here instead of on every
+   * location sample. Invalid polygons are left NULL and never match.
+   */
+
+  points = coords->number_of_items / 2;
+
+  if ((coords->number_of_items & 0x1) || points < 3)
+    {
+      eng_dispdbg ("Not enough points in polygon");
+      return OK;
+    }
+
+  if (points > GEOFENCE_MAX_POINTS)
+    {
+      eng_dispdbg ("Too many points in polygon");
+      return OK;
+    }
+
+  poly = __ts_engine_arena_alloc (arena, GEOFENCE_POLY_SIZE(points));
+  if (!poly)
+    {
+      return -PROFILE_ERROR_OUT_OF_MEMORY;
+    }
+
+  for (i = 0; i < points; i++)
+    {
+      poly->points[i].x = coords->items[2 * i].valuedouble;
+      poly->points[i].y = coords->items[2 * i + 1].valuedouble;
+    }
+
+  geofence_init_poly (poly, points);
+  threshold->conf.poly = poly;
+
+  return OK;
+}
+
+static int
+add_threshold (cJSON *json_threshold, struct ts_cause *cause, int type,
+               struct ts_arena *arena)
 {
   struct ts_threshold *threshold;
+  int ret;
 
-  threshold = malloc (sizeof(struct ts_threshold));
+  threshold = __ts_engine_arena_alloc (arena, sizeof(struct ts_threshold));
   if (!threshold)
     {
       eng_dispdbg ("malloc for ts_threshold failed");
@@ -587,6 +669,7 @@ add_threshold (cJSON *json_threshold, struct ts_cause *cause, int type)
     }
 
   threshold->conf.check_threshold = NULL;
+  threshold->conf.poly = NULL;
 
   switch (cJSON_type(json_threshold))
     {
@@ -600,7 +683,6 @@ add_threshold (cJSON *json_threshold, struct ts_cause *cause, int type)
         if (type != isOneOf && type != isNotIn && type != isInsideGeo)
           {
             eng_dispdbg ("invalid threshold");
-            free(threshold);
             return -PROFILE_ERROR_INVALID_THRESHOLD;
           }
 
@@ -608,15 +690,12 @@ add_threshold (cJSON *json_threshold, struct ts_cause *cause, int type)
         if (n == 0)
           {
             eng_dispdbg ("invalid threshold");
-            free(threshold);
             return -PROFILE_ERROR_INVALID_THRESHOLD;
           }
 
-        items = malloc (n * sizeof(*items));
+        items = __ts_engine_arena_alloc (arena, n * sizeof(*items));
         if (!items)
           {
-            eng_dbg("malloc %d failed\n", n * sizeof(*items));
-            free(threshold);
             return -TS_ENGINE_ERROR_OOM;
           }
 
@@ -624,21 +703,27 @@ add_threshold (cJSON *json_threshold, struct ts_cause *cause, int type)
         threshold->conf.value.valuearray.items = items;
         threshold->conf.value.valuearray.number_of_items = n;
 
-        if (type == isInsideGeo)
+        for (i = 0; i < n; i++)
           {
-            threshold->conf.check_threshold = __ts_engine_check_geofence;
+            item = cJSON_GetArrayItem (json_threshold, i);
+            set_threshold_value (item, &items[i], arena);
           }
 
-        for (i = 0; i < n; i++)
+        if (type == isInsideGeo)
           {
-            item = cJSON_GetArrayItem (json_threshold, i);
-            set_threshold_value (item, &items[i]);
+            threshold->conf.check_threshold = __ts_engine_check_geofence;
+
+            ret = init_geofence (threshold, arena);
+            if (ret != OK)
+              {
+                return ret;
+              }
           }
       }
       break;
 
     default:
-      set_threshold_value (json_threshold, &threshold->conf.value);
+      set_threshold_value (json_threshold, &threshold->conf.value, arena);
     }
 
   threshold->conf.type = type;
@@ -649,7 +734,8 @@ add_threshold (cJSON *json_threshold, struct ts_cause *cause, int type)
 }
 
 static int
-init_threshold (cJSON *json_thresholds, struct ts_cause *cause, int type)
+init_threshold (cJSON *json_thresholds, struct ts_cause *cause, int type,
+                struct ts_arena *arena)
 {
   cJSON *json_threshold;
 
@@ -659,11 +745,12 @@ init_threshold (cJSON *json_thresholds, struct ts_cause *cause, int type)
       return OK;
     }
 
-  return add_threshold (json_threshold, cause, type);
+  return add_threshold (json_threshold, cause, type, arena);
 }
 
 static int
-init_thresholds (cJSON *json_thresholds, struct ts_cause *cause)
+init_thresholds (cJSON *json_thresholds, struct ts_cause *cause,
+                 struct ts_arena *arena)
 {
   int n = 0;
   int ret;
@@ -678,7 +765,7 @@ init_thresholds (cJSON *json_thresholds, struct ts_cause *cause)
 
   while (threshold_types[n])
     {
-      ret = init_threshold (json_thresholds, cause, n);
+      ret = init_threshold (json_thresholds, cause, n, arena);
       if (ret < 0)
 	{
 	  return ret;
@@ -691,7 +778,7 @@ init_thresholds (cJSON *json_thresholds, struct ts_cause *cause)
 }
 
 static int
-init_causes (cJSON *causes, struct ts_event *event)
+init_causes (cJSON *causes, struct ts_event *event, struct ts_arena *arena)
 {
   int i;
   int ret;
@@ -711,7 +798,8 @@ init_causes (cJSON *causes, struct ts_event *event)
   for (i = 0; i < event->conf.number_of_causes; i++)
     {
       cJSON *json_cause = cJSON_GetArrayItem (causes, i);
-      struct ts_cause *cause = calloc (1, sizeof(struct ts_cause));
+      struct ts_cause *cause = __ts_engine_arena_alloc (arena,
+                                                        sizeof(struct ts_cause));
       if (!cause)
 	{
 	  eng_dispdbg ("malloc for struct ts_cause failed");
@@ -734,7 +822,7 @@ init_causes (cJSON *causes, struct ts_event *event)
 	};
 
       ret = parse_json_object (json_cause, cause, parse_cause,
-			       ARRAY_SIZE(parse_cause));
+			       ARRAY_SIZE(parse_cause), arena);
       if (ret != OK)
 	{
 	  eng_dispdbg ("cause parse failed");
@@ -756,7 +844,7 @@ init_causes (cJSON *causes, struct ts_event *event)
 	  };
 
       ret = parse_json_object (json_measurement, cause, parse_measurement,
-			       ARRAY_SIZE(parse_measurement));
+			       ARRAY_SIZE(parse_measurement), arena);
       if (ret != OK)
 	{
 	  eng_dispdbg ("measurement parse failed");
@@ -776,7 +864,7 @@ init_causes (cJSON *causes, struct ts_event *event)
 	  };
 
       ret = parse_json_object (json_threshold, cause, parse_threshold,
-			       ARRAY_SIZE(parse_threshold));
+			       ARRAY_SIZE(parse_threshold), arena);
       if (ret != OK)
 	{
 	  eng_dispdbg ("threshold parse failed");
@@ -784,7 +872,7 @@ init_causes (cJSON *causes, struct ts_event *event)
 	}
 
       ret = init_thresholds (
-	  cJSON_GetObjectItem (json_cause, g_thresholds_str), cause);
+	  cJSON_GetObjectItem (json_cause, g_thresholds_str), cause, arena);
       if (ret != OK)
 	{
 	  eng_dispdbg ("init_thresholds failed");
@@ -798,6 +886,15 @@ init_causes (cJSON *causes, struct ts_event *event)
 	  return -PROFILE_ERROR_INVALID_SENSE_ID;
 	}
 
+      ret = __ts_engine_threshold_compile (cause,
+                                           cause->dyn.sense_info->min.valuetype,
+                                           arena);
+      if (ret != OK)
+	{
+	  eng_dispdbg ("threshold compile failed");
+	  return ret;
+	}
+
       /* Set the name pointer here for easy payload generation */
 
       cause->dyn.sense_value.name = cause->dyn.sense_info->name;
@@ -815,10 +912,9 @@ init_causes (cJSON *causes, struct ts_event *event)
 }
 
 static int
-init_events (cJSON *events, struct ts_state *state)
+init_event (cJSON *json_event, struct ts_event *event,
+            struct ts_arena *arena)
 {
-  int number_of_events;
-  int i;
   int ret;
   cJSON *json_actions;
   cJSON *json_sms;
@@ -826,321 +922,642 @@ init_events (cJSON *events, struct ts_state *state)
   cJSON *json_engine;
   cJSON *json_display;
 
-  sq_init(&state->conf.events);
-
-  if (!events)
+  static const struct ts_parse parse_event[] =
     {
-      eng_dispdbg ("no events");
-      return -PROFILE_ERROR_NO_EVENTS;
+      { g_evId_str, offsetof(struct ts_event, conf.evId), VALUEINT32,
+          true, .error = -PROFILE_ERROR_EVENT_ID_NOT_SET },
+      { g_name_str, offsetof(struct ts_event, conf.name), VALUESTRING,
+          false, .value = { VALUESTRING, .valuestring = NULL }, },
+      { g_eventLog_str, offsetof(struct ts_event, conf.eventLog), VALUEINT32,
+          false, .value = { VALUEINT32, .valueint32 = false }, },
+    };
+
+  ret = parse_json_object (json_event, event, parse_event,
+                           ARRAY_SIZE(parse_event), arena);
+  if (ret != OK)
+    {
+      eng_dispdbg ("event parse failed");
+      return ret;
     }
 
-  number_of_events = cJSON_GetArraySize (events);
-
-  for (i = 0; i < number_of_events; i++)
+  json_actions = cJSON_GetObjectItem (json_event, g_actions_str);
+  if (!json_actions)
     {
-      cJSON *json_event = cJSON_GetArrayItem (events, i);
-      struct ts_event *event = calloc (1, sizeof(struct ts_event));
-      if (!event)
-	{
-	  eng_dispdbg ("malloc for struct ts_event failed");
-	  return -PROFILE_ERROR_OUT_OF_MEMORY;
-	}
+      eng_dispdbg ("%s not set", g_actions_str);
+      return -PROFILE_ERROR_ACTIONS_NOT_SET;
+    }
 
-      event->parent = state;
-      sq_addlast (&event->entry, &state->conf.events);
+  json_sms = cJSON_GetObjectItem (json_actions, g_sms_str);
+  if (json_sms)
+    {
+      static const struct ts_parse parse_sms[] =
+          {
+              { g_text_str, offsetof(struct ts_event, conf.actions.sms.text),
+                VALUESTRING, true, .error = -PROFILE_ERROR_SMS_TEXT_NOT_SET },
+              { g_phoneNumber_str, offsetof(struct ts_event, conf.actions.sms.phoneNumber),
+                VALUEARRAY_FIRSTSTRING, true, .error = -PROFILE_ERROR_SMS_PHONE_NUMBER_NOT_SET },
+          };
+
+      ret = parse_json_object (json_sms, event, parse_sms,
+                               ARRAY_SIZE(parse_sms), arena);
+      if (ret != OK)
+        {
+          eng_dispdbg ("sms parse failed");
+          return ret;
+        }
+    }
+  else
+    {
+      /* "sms" not mandatory. */
 
-      static const struct ts_parse parse_event[] =
-	{
-	  { g_evId_str, offsetof(struct ts_event, conf.evId), VALUEINT32,
-	      true, .error = -PROFILE_ERROR_EVENT_ID_NOT_SET },
-	  { g_name_str, offsetof(struct ts_event, conf.name), VALUESTRING,
-	      false, .value = { VALUESTRING, .valuestring = NULL }, },
-	  { g_eventLog_str, offsetof(struct ts_event, conf.eventLog), VALUEINT32,
-	      false, .value = { VALUEINT32, .valueint32 = false }, },
-	};
+      event->conf.actions.sms.text = NULL;
+      event->conf.actions.sms.phoneNumber = NULL;
+    }
 
-      ret = parse_json_object (json_event, event, parse_event,
-			       ARRAY_SIZE(parse_event));
+  json_cloud = cJSON_GetObjectItem (json_actions, g_cloud_str);
+  if (json_cloud)
+    {
+      static const struct ts_parse parse_cloud[] =
+          {
+              { g_sendEvent_str, offsetof(struct ts_event, conf.actions.cloud.sendEvent),
+                  VALUEBOOL, false, .value = { VALUEBOOL, .valuebool = false }, },
+              { g_sendLog_str, offsetof(struct ts_event, conf.actions.cloud.sendLog),
+                  VALUEBOOL, false, .value = { VALUEBOOL, .valuebool = false }, },
+              { g_sendPush_str, offsetof(struct ts_event, conf.actions.cloud.sendPush),
+                  VALUEBOOL, false, .value = { VALUEBOOL, .valuebool = false }, },
+              { g_host_str, offsetof(struct ts_event, conf.actions.cloud.url.host),
+                  VALUESTRING, false, .value = { VALUESTRING, .valuestring = NULL }, },
+              { g_port_str, offsetof(struct ts_event, conf.actions.cloud.url.port),
+                  VALUEUINT16, false, .value = { VALUEUINT16, .valueuint16 = 80 }, },
+              { g_api_str, offsetof(struct ts_event, conf.actions.cloud.url.api),
+                  VALUESTRING, false, .value = { VALUESTRING, .valuestring = NULL }, },
+              { g_httpHeader_str, offsetof(struct ts_event, conf.actions.cloud.url.http_header),
+                  VALUEARRAY, false, .value = { VALUEARRAY, .valuearray = { 0, NULL }, }, },
+          };
+
+      ret = parse_json_object (json_cloud, event, parse_cloud,
+                               ARRAY_SIZE(parse_cloud), arena);
       if (ret != OK)
-	{
-	  eng_dispdbg ("event parse failed");
-	  return ret;
-	}
+        {
+          eng_dispdbg ("cloud parse failed");
+          return ret;
+        }
 
-      json_actions = cJSON_GetObjectItem (json_event, g_actions_str);
-      if (!json_actions)
-	{
-	  eng_dispdbg ("%s not set", g_actions_str);
-	  return -PROFILE_ERROR_ACTIONS_NOT_SET;
-	}
+      if (event->conf.actions.cloud.url.host)
+        {
+          event->conf.actions.cloud.url.srv_ip4addr.sin_addr.s_addr = 0;
+        }
+    }
+  else
+    {
+      /* "cloud" not mandatory. */
+
+      event->conf.actions.cloud.sendEvent = false;
+      event->conf.actions.cloud.sendLog = false;
+      event->conf.actions.cloud.sendPush = false;
+      event->conf.actions.cloud.url.host = NULL;
+      event->conf.actions.cloud.url.port = -1;
+      event->conf.actions.cloud.url.api = NULL;
+      event->conf.actions.cloud.url.http_header.valuearray.items = NULL;
+      event->conf.actions.cloud.url.http_header.valuearray.number_of_items = 0;
+    }
 
-      json_sms = cJSON_GetObjectItem (json_actions, g_sms_str);
-      if (json_sms)
+  json_engine = cJSON_GetObjectItem (json_actions, g_engine_str);
+  if (json_engine)
+    {
+      static const struct ts_parse parse_engine[] =
+          {
+              { g_gotoStId_str, offsetof(struct ts_event, conf.actions.engine.gotoStId),
+                  VALUEUINT32, false, .value = { VALUEINT32, .valueint32 = -1 }, },
+              { g_gotoPuId_str, offsetof(struct ts_event, conf.actions.engine.gotoPuId),
+                  VALUEUINT32, false, .value = { VALUEINT32, .valueint32 = -1 }, },
+          };
+
+      ret = parse_json_object (json_engine, event, parse_engine,
+                               ARRAY_SIZE(parse_engine), arena);
+      if (ret != OK)
         {
-          static const struct ts_parse parse_sms[] =
-              {
-                  { g_text_str, offsetof(struct ts_event, conf.actions.sms.text),
-                    VALUESTRING, true, .error = -PROFILE_ERROR_SMS_TEXT_NOT_SET },
-                  { g_phoneNumber_str, offsetof(struct ts_event, conf.actions.sms.phoneNumber),
-                    VALUEARRAY_FIRSTSTRING, true, .error = -PROFILE_ERROR_SMS_PHONE_NUMBER_NOT_SET },
-              };
-
-          ret = parse_json_object (json_sms, event, parse_sms,
-                                   ARRAY_SIZE(parse_sms));
-          if (ret != OK)
-            {
-              eng_dispdbg ("sms parse failed");
-              return ret;
-            }
+          eng_dispdbg ("engine parse failed");
+          return ret;
         }
-      else
+    }
+  else
+    {
+      /* "engine" not mandatory. */
+
+      event->conf.actions.engine.gotoPuId = -1;
+      event->conf.actions.engine.gotoStId = -1;
+    }
+
+  json_display = cJSON_GetObjectItem (json_actions, g_display_str);
+  if (json_display)
+    {
+      static const struct ts_parse parse_display[] =
+          {
+              { g_text_str, offsetof(struct ts_event, conf.actions.display.showText),
+                VALUESTRING, true, .error = -PROFILE_ERROR_SHOW_TEXT_NOT_SET },
+          };
+
+      ret = parse_json_object (json_display, event, parse_display,
+                               ARRAY_SIZE(parse_display), arena);
+      if (ret != OK)
         {
-          /* "sms" not mandatory. */
+          eng_dispdbg ("display parse failed");
+          return ret;
+        }
+    }
+  else
+    {
+      /* "display" not mandatory. */
+
+      event->conf.actions.display.showText = NULL;
+    }
 
-          event->conf.actions.sms.text = NULL;
-          event->conf.actions.sms.phoneNumber = NULL;
+  ret = init_causes (cJSON_GetObjectItem (json_event, g_causes_str),
+                     event, arena);
+  if (ret != OK)
+    {
+      eng_dispdbg ("init_causes failed");
+      return ret;
+    }
+
+  return OK;
+}
+
+/* Sizing pass: upper bound of the arena needed for the profile, mirroring
+ * the allocations done by the build pass. Every string value is counted,
+ * whether it is copied or not.
+ */
+
+static size_t
+json_strings_size (cJSON *item)
+{
+  size_t size = 0;
+
+  for (; item; item = cJSON_next (item))
+    {
+      if (cJSON_type (item) == cJSON_String)
+        {
+          size += ARENA_SIZE(strlen (cJSON_string (item)) + 1);
         }
 
-      json_cloud = cJSON_GetObjectItem (json_actions, g_cloud_str);
-      if (json_cloud)
+      size += json_strings_size (cJSON_child (item));
+    }
+
+  return size;
+}
+
+static int
+json_array_size (cJSON *array)
+{
+  return (array && cJSON_type (array) == cJSON_Array) ?
+      cJSON_GetArraySize (array) : 0;
+}
+
+static size_t
+causes_size (cJSON *causes)
+{
+  cJSON *json_cause;
+  cJSON *thr;
+  size_t size = 0;
+  int n_causes;
+  int nitems;
+  int n;
+  int i;
+
+  n_causes = json_array_size (causes);
+
+  for (i = 0; i < n_causes; i++)
+    {
+      json_cause = cJSON_GetArrayItem (causes, i);
+      thr = cJSON_GetObjectItem (json_cause, g_thresholds_str);
+      thr = thr ? cJSON_child (thr) : NULL;
+      nitems = 0;
+
+      for (; thr; thr = cJSON_next (thr))
         {
-          static const struct ts_parse parse_cloud[] =
-              {
-                  { g_sendEvent_str, offsetof(struct ts_event, conf.actions.cloud.sendEvent),
-                      VALUEBOOL, false, .value = { VALUEBOOL, .valuebool = false }, },
-                  { g_sendLog_str, offsetof(struct ts_event, conf.actions.cloud.sendLog),
-                      VALUEBOOL, false, .value = { VALUEBOOL, .valuebool = false }, },
-                  { g_sendPush_str, offsetof(struct ts_event, conf.actions.cloud.sendPush),
-                      VALUEBOOL, false, .value = { VALUEBOOL, .valuebool = false }, },
-                  { g_host_str, offsetof(struct ts_event, conf.actions.cloud.url.host),
-                      VALUESTRING, false, .value = { VALUESTRING, .valuestring = NULL }, },
-                  { g_port_str, offsetof(struct ts_event, conf.actions.cloud.url.port),
-                      VALUEUINT16, false, .value = { VALUEUINT16, .valueuint16 = 80 }, },
-                  { g_api_str, offsetof(struct ts_event, conf.actions.cloud.url.api),
-                      VALUESTRING, false, .value = { VALUESTRING, .valuestring = NULL }, },
-                  { g_httpHeader_str, offsetof(struct ts_event, conf.actions.cloud.url.http_header),
-                      VALUEARRAY, false, .value = { VALUEARRAY, .valuearray = { 0, NULL }, }, },
-              };
-
-          ret = parse_json_object (json_cloud, event, parse_cloud,
-                                   ARRAY_SIZE(parse_cloud));
-          if (ret != OK)
-            {
-              eng_dispdbg ("cloud parse failed");
-              return ret;
-            }
+          size += ARENA_SIZE(sizeof(struct ts_threshold));
 
-          if (event->conf.actions.cloud.url.host)
+          n = json_array_size (thr);
+          if (n)
             {
-              event->conf.actions.cloud.url.srv_ip4addr.sin_addr.s_addr = 0;
+              size += ARENA_SIZE(n * sizeof(struct ts_value));
+
+              if (!strcasecmp (cJSON_name (thr), g_isInsideGeo_str))
+                {
+                  size += ARENA_SIZE(GEOFENCE_POLY_SIZE(n / 2));
+
+                  /* Entries in profile geofence set */
+
+                  size += ARENA_SIZE(sizeof(struct poly *));
+                  size += ARENA_SIZE(sizeof(uint16_t));
+                }
             }
+
+          nitems += n ? n : 1;
         }
-      else
+
+      size += ARENA_SIZE(sizeof(struct ts_cause));
+      size += ARENA_SIZE(THRESHOLD_PROG_SIZE(nitems));
+    }
+
+  return size;
+}
+
+static size_t
+event_size (cJSON *json_event)
+{
+  cJSON *json_cloud;
+  size_t size;
+
+  json_cloud = cJSON_GetObjectItem (
+      cJSON_GetObjectItem (json_event, g_actions_str), g_cloud_str);
+
+  size = ARENA_SIZE(sizeof(struct ts_event));
+  size += json_strings_size (json_event);
+  size += ARENA_SIZE(json_array_size (
+      cJSON_GetObjectItem (json_cloud, g_httpHeader_str)) *
+      sizeof(struct ts_value));
+  size += causes_size (cJSON_GetObjectItem (json_event, g_causes_str));
+
+  return size;
+}
+
+/* Profile is read straight from its source, string or file, with the cJSON
+ * pull parser. Only one event at a time is materialized as a cJSON tree;
+ * profile, purposes and states are streamed and just their scalar members
+ * are collected to a small "shell" object. The source is read twice: first
+ * to size the arena, then to fill it.
+ */
+
+static char
+profile_getc (void *priv)
+{
+  struct profile_reader *reader = priv;
+  char c;
+
+  if (reader->str)
+    {
+      c = reader->str[reader->pos];
+      if (c)
         {
-          /* "cloud" not mandatory. */
-
-          event->conf.actions.cloud.sendEvent = false;
-          event->conf.actions.cloud.sendLog = false;
-          event->conf.actions.cloud.sendPush = false;
-          event->conf.actions.cloud.url.host = NULL;
-          event->conf.actions.cloud.url.port = -1;
-          event->conf.actions.cloud.url.api = NULL;
-          event->conf.actions.cloud.url.http_header.valuearray.items = NULL;
-          event->conf.actions.cloud.url.http_header.valuearray.number_of_items = 0;
+          reader->pos++;
         }
 
-      json_engine = cJSON_GetObjectItem (json_actions, g_engine_str);
-      if (json_engine)
+      return c;
+    }
+
+  if (reader->len <= 0 || reader->pos >= (size_t)reader->len)
+    {
+      do
         {
-          static const struct ts_parse parse_engine[] =
-              {
-                  { g_gotoStId_str, offsetof(struct ts_event, conf.actions.engine.gotoStId),
-                      VALUEUINT32, false, .value = { VALUEINT32, .valueint32 = -1 }, },
-                  { g_gotoPuId_str, offsetof(struct ts_event, conf.actions.engine.gotoPuId),
-                      VALUEUINT32, false, .value = { VALUEINT32, .valueint32 = -1 }, },
-              };
-
-          ret = parse_json_object (json_engine, event, parse_engine,
-                                   ARRAY_SIZE(parse_engine));
-          if (ret != OK)
-            {
-              eng_dispdbg ("engine parse failed");
-              return ret;
-            }
+          reader->len = read (reader->fd, reader->buf, sizeof(reader->buf));
         }
-      else
-        {
-          /* "engine" not mandatory. */
+      while (reader->len < 0 && errno == EINTR);
+
+      reader->pos = 0;
 
-          event->conf.actions.engine.gotoPuId = -1;
-          event->conf.actions.engine.gotoStId = -1;
+      if (reader->len <= 0)
+        {
+          reader->len = 0;
+          return '\0';
         }
+    }
+
+  return reader->buf[reader->pos++];
+}
+
+static int
+profile_rewind (struct profile_reader *reader)
+{
+  reader->pos = 0;
+  reader->len = 0;
+
+  if (!reader->str && lseek (reader->fd, reader->start, SEEK_SET) < 0)
+    {
+      return ERROR;
+    }
+
+  return OK;
+}
+
+static int
+stream_shell (struct profile_stream *ps, cJSON *shell, void *data,
+              const struct ts_parse *parse, int items)
+{
+  if (!ps->arena)
+    {
+      ps->size += json_strings_size (shell);
+      return OK;
+    }
+
+  return parse_json_object (shell, data, parse, items, ps->arena);
+}
+
+/* Stream a JSON object: members of array 'label' are passed one by one to
+ * 'member', everything else ends up in 'shell'.
+ */
+
+static int
+stream_object (struct profile_stream *ps, const char *label,
+               stream_member_t member, void *parent, cJSON **shell,
+               bool *found)
+{
+  char name[PROFILE_NAME_MAX];
+  cJSON *item;
+  int ret;
+
+  *found = false;
+
+  *shell = cJSON_CreateObject ();
+  if (!*shell)
+    {
+      return -PROFILE_ERROR_OUT_OF_MEMORY;
+    }
 
-      json_display = cJSON_GetObjectItem (json_actions, g_display_str);
-      if (json_display)
+  if (cJSON_Stream_Enter (&ps->json) != cJSON_Object)
+    {
+      eng_dispdbg ("object expected");
+      return -PROFILE_ERROR_INVALID_JSON;
+    }
+
+  while ((ret = cJSON_Stream_Next (&ps->json, name, sizeof(name))) > 0)
+    {
+      if (!*found && !strcasecmp (name, label) &&
+          cJSON_Stream_Type (&ps->json) == cJSON_Array)
         {
-          static const struct ts_parse parse_display[] =
-              {
-                  { g_text_str, offsetof(struct ts_event, conf.actions.display.showText),
-                    VALUESTRING, true, .error = -PROFILE_ERROR_SHOW_TEXT_NOT_SET },
-              };
+          *found = true;
+
+          (void)cJSON_Stream_Enter (&ps->json);
 
-          ret = parse_json_object (json_display, event, parse_display,
-                                   ARRAY_SIZE(parse_display));
-          if (ret != OK)
+          while ((ret = cJSON_Stream_Next (&ps->json, NULL, 0)) > 0)
             {
-              eng_dispdbg ("display parse failed");
-              return ret;
+              ret = member (ps, parent);
+              if (ret != OK)
+                {
+                  return ret;
+                }
+            }
+
+          if (ret < 0)
+            {
+              break;
             }
+
+          continue;
         }
-      else
+
+      item = cJSON_Stream_Value (&ps->json);
+      if (!item)
         {
-          /* "display" not mandatory. */
+          ret = ERROR;
+          break;
+        }
 
-          event->conf.actions.display.showText = NULL;
+      if (!cJSON_AddItemToObject (*shell, name, item))
+        {
+          return -PROFILE_ERROR_OUT_OF_MEMORY;
         }
+    }
 
-      ret = init_causes (cJSON_GetObjectItem (json_event, g_causes_str),
-			 event);
-      if (ret != OK)
-	{
-	  eng_dispdbg ("init_causes failed");
-	  return ret;
-	}
+  if (ret < 0)
+    {
+      eng_dispdbg ("malformed JSON");
+      return -PROFILE_ERROR_INVALID_JSON;
     }
 
   return OK;
 }
 
 static int
-init_states (cJSON *states, struct ts_purpose *purpose)
+stream_event (struct profile_stream *ps, void *parent)
 {
-  int number_of_states;
-  int i;
+  struct ts_state *state = parent;
+  struct ts_event *event;
+  cJSON *json_event;
   int ret;
 
-  sq_init(&purpose->conf.states);
+  json_event = cJSON_Stream_Value (&ps->json);
+  if (!json_event)
+    {
+      eng_dispdbg ("malformed event");
+      return -PROFILE_ERROR_INVALID_JSON;
+    }
 
-  if (!states)
+  if (!ps->arena)
     {
-      eng_dispdbg ("no states");
-      return -PROFILE_ERROR_NO_STATES;
+      ps->size += event_size (json_event);
+      cJSON_Delete (json_event);
+      return OK;
     }
 
-  number_of_states = cJSON_GetArraySize (states);
+  event = __ts_engine_arena_alloc (ps->arena, sizeof(struct ts_event));
+  if (!event)
+    {
+      eng_dispdbg ("malloc for struct ts_event failed");
+      cJSON_Delete (json_event);
+      return -PROFILE_ERROR_OUT_OF_MEMORY;
+    }
+
+  event->parent = state;
+  sq_addlast (&event->entry, &state->conf.events);
+
+  ret = init_event (json_event, event, ps->arena);
+
+  cJSON_Delete (json_event);
+
+  return ret;
+}
+
+static int
+stream_state (struct profile_stream *ps, void *parent)
+{
+  struct ts_purpose *purpose = parent;
+  struct ts_state *state = NULL;
+  cJSON *shell;
+  bool found;
+  int ret;
 
-  for (i = 0; i < number_of_states; i++)
+  static const struct ts_parse parse_state[] =
     {
-      cJSON *json_state = cJSON_GetArrayItem (states, i);
-      struct ts_state *state = calloc (1, sizeof(struct ts_state));
+      { g_stId_str, offsetof(struct ts_state, conf.stId), VALUEINT32,
+          true, .error = -PROFILE_ERROR_STATE_ID_NOT_SET },
+      { g_name_str, offsetof(struct ts_state, conf.name), VALUESTRING,
+          false, .value = { VALUESTRING, .valuestring = NULL }, },
+      { g_isGlobal_str, offsetof(struct ts_state, conf.isGlobal), VALUEINT32,
+          false, .value = { VALUEINT32, .valueint32 = false }, },
+    };
+
+  if (ps->arena)
+    {
+      state = __ts_engine_arena_alloc (ps->arena, sizeof(struct ts_state));
       if (!state)
-	{
-	  eng_dispdbg ("malloc for struct ts_state failed");
-	  return -PROFILE_ERROR_OUT_OF_MEMORY;
-	}
+        {
+          eng_dispdbg ("malloc for struct ts_state failed");
+          return -PROFILE_ERROR_OUT_OF_MEMORY;
+        }
 
       state->parent = purpose;
+      sq_init(&state->conf.events);
       sq_addlast (&state->entry, &purpose->conf.states);
+    }
+  else
+    {
+      ps->size += ARENA_SIZE(sizeof(struct ts_state));
+    }
 
-      static const struct ts_parse parse_state[] =
-	{
-	  { g_stId_str, offsetof(struct ts_state, conf.stId), VALUEINT32,
-	      true, .error = -PROFILE_ERROR_STATE_ID_NOT_SET },
-	  { g_name_str, offsetof(struct ts_state, conf.name), VALUESTRING,
-	      false, .value = { VALUESTRING, .valuestring = NULL }, },
-	  { g_isGlobal_str, offsetof(struct ts_state, conf.isGlobal), VALUEINT32,
-	      false, .value = { VALUEINT32, .valueint32 = false }, },
-	};
-
-      ret = parse_json_object (json_state, state, parse_state,
-			       ARRAY_SIZE(parse_state));
-      if (ret != OK)
-	{
-	  eng_dispdbg ("state parse failed");
-	  return ret;
-	}
+  ret = stream_object (ps, g_events_str, stream_event, state, &shell, &found);
+  if (ret == OK && !found)
+    {
+      eng_dispdbg ("no events");
+      ret = -PROFILE_ERROR_NO_EVENTS;
+    }
 
-      ret = init_events (cJSON_GetObjectItem (json_state, g_events_str),
-			 state);
+  if (ret == OK)
+    {
+      ret = stream_shell (ps, shell, state, parse_state,
+                          ARRAY_SIZE(parse_state));
       if (ret != OK)
-	{
-	  eng_dbg ("init_events failed\n");
-	  return ret;
-	}
+        {
+          eng_dispdbg ("state parse failed");
+        }
     }
 
-  return OK;
+  cJSON_Delete (shell);
+
+  return ret;
 }
 
 static int
-init_purposes (cJSON *purposes, struct ts_profile *profile)
+stream_purpose (struct profile_stream *ps, void *parent)
 {
-  int number_of_purposes;
-  int i;
+  struct ts_profile *profile = parent;
+  struct ts_purpose *purpose = NULL;
+  cJSON *shell;
+  bool found;
   int ret;
 
-  sq_init(&profile->conf.purposes);
+  static const struct ts_parse parse_purpose[] =
+    {
+      { g_puId_str, offsetof(struct ts_purpose, conf.puId),
+          VALUEINT32, true, .error = -PROFILE_ERROR_PURPOSE_ID_NOT_SET },
+      { g_name_str, offsetof(struct ts_purpose, conf.name),
+          VALUESTRING, false, .value = { VALUESTRING, .valuestring = NULL }, },
+      { g_initStId_str, offsetof(struct ts_purpose, conf.initStId),
+          VALUEINT32, true, .error = -PROFILE_ERROR_INIT_STATE_ID_NOT_SET },
+    };
+
+  if (ps->arena)
+    {
+      purpose = __ts_engine_arena_alloc (ps->arena,
+                                         sizeof(struct ts_purpose));
+      if (!purpose)
+        {
+          eng_dispdbg ("malloc for struct ts_purpose failed");
+          return -PROFILE_ERROR_OUT_OF_MEMORY;
+        }
+
+      purpose->parent = profile;
+      sq_init(&purpose->conf.states);
+      sq_addlast (&purpose->entry, &profile->conf.purposes);
+    }
+  else
+    {
+      ps->size += ARENA_SIZE(sizeof(struct ts_purpose));
+    }
 
-  if (!purposes)
+  ret = stream_object (ps, g_states_str, stream_state, purpose, &shell,
+                       &found);
+  if (ret == OK && !found)
     {
       eng_dispdbg ("no states");
-      return -PROFILE_ERROR_NO_STATES;
+      ret = -PROFILE_ERROR_NO_STATES;
     }
 
-  number_of_purposes = cJSON_GetArraySize (purposes);
+  if (ret == OK)
+    {
+      ret = stream_shell (ps, shell, purpose, parse_purpose,
+                          ARRAY_SIZE(parse_purpose));
+      if (ret != OK)
+        {
+          eng_dispdbg ("purpose parse failed");
+        }
+    }
+
+  cJSON_Delete (shell);
+
+  return ret;
+}
+
+static int
+stream_profile (struct profile_stream *ps, struct ts_profile *profile)
+{
+  cJSON *shell;
+  bool found;
+  int ret;
 
-  for (i = 0; i < number_of_purposes; i++)
+  static const struct ts_parse parse_profile[] =
     {
-      cJSON *json_purpose = cJSON_GetArrayItem (purposes, i);
-      struct ts_purpose *purpose = calloc (1, sizeof(struct ts_purpose));
-      if (!purpose)
-	{
-	  eng_dispdbg ("malloc for struct ts_purpose failed");
-	  return -PROFILE_ERROR_OUT_OF_MEMORY;
-	}
+      { g_apiVersion_str, offsetof(struct ts_profile, conf.apiVersion),
+          VALUESTRING, true, .error = -PROFILE_ERROR_API_VERSION_NOT_SET },
+      { g_pId_str, offsetof(struct ts_profile, conf.pId),
+          VALUESTRING, false, .value = { VALUESTRING, .valuestring = NULL }, },
+      { g_name_str, offsetof(struct ts_profile, conf.name),
+          VALUESTRING, false, .value = { VALUESTRING, .valuestring = NULL }, },
+      { g_initPuId_str, offsetof(struct ts_profile, conf.initPuId),
+          VALUEUINT32, true, .error = -PROFILE_ERROR_INIT_PURPOSE_ID_NOT_SET },
+    };
+
+  if (!ps->arena)
+    {
+      ps->size += ARENA_SIZE(sizeof(struct ts_profile));
+      ps->size += ARENA_SIZE(sizeof(struct geofence_set));
+    }
 
-      purpose->parent = profile;
-      sq_addlast (&purpose->entry, &profile->conf.purposes);
+  ret = stream_object (ps, g_purposes_str, stream_purpose, profile, &shell,
+                       &found);
+  if (ret == OK && !found)
+    {
+      eng_dispdbg ("purposes not set");
+      ret = -PROFILE_ERROR_PURPOSES_NOT_SET;
+    }
 
-      static const struct ts_parse parse_purpose[] =
-	    {
-	      { g_puId_str, offsetof(struct ts_purpose, conf.puId),
-		  VALUEINT32, true, .error = -PROFILE_ERROR_PURPOSE_ID_NOT_SET },
-	      { g_name_str, offsetof(struct ts_purpose, conf.name),
-		  VALUESTRING, false, .value = { VALUESTRING, .valuestring = NULL }, },
-	      { g_initStId_str, offsetof(struct ts_purpose, conf.initStId),
-		  VALUEINT32, true, .error = -PROFILE_ERROR_INIT_STATE_ID_NOT_SET },
-	    };
-
-      ret = parse_json_object (json_purpose, purpose, parse_purpose,
-			       ARRAY_SIZE(parse_purpose));
-      if (ret != OK)
-	{
-	  eng_dispdbg ("purpose parse failed");
-	  return ret;
-	}
+  if (ret == OK && !cJSON_Stream_End (&ps->json))
+    {
+      eng_dispdbg ("garbage after profile");
+      ret = -PROFILE_ERROR_INVALID_JSON;
+    }
 
-      ret = init_states (cJSON_GetObjectItem (json_purpose, g_states_str),
-			 purpose);
+  if (ret == OK)
+    {
+      ret = stream_shell (ps, shell, profile, parse_profile,
+                          ARRAY_SIZE(parse_profile));
       if (ret != OK)
-	{
-	  eng_dispdbg ("init_states failed");
-	  return ret;
-	}
+        {
+          eng_dispdbg ("profile parse failed");
+        }
     }
 
-  return OK;
+  cJSON_Delete (shell);
+
+  return ret;
 }
 
-void
-profile_free (struct ts_profile *profile)
+/* Collect polygons of all isInsideGeo thresholds to one set, so that a
+ * location is checked against every fence of the profile in one pass.
+ * Without 'set->fences' the fences are only counted.
+ */
+
+static void
+collect_geofences (struct ts_profile *profile, struct geofence_set *set)
 {
-  struct ts_purpose *purpose, *next_purpose;
-  struct ts_state *state, *next_state;
-  struct ts_event *event, *next_event;
-  struct ts_cause *cause, *next_cause;
-  struct ts_threshold *threshold, *next_threshold;
-  int i;
+  struct ts_purpose *purpose;
+  struct ts_state *state;
+  struct ts_event *event;
+  struct ts_cause *cause;
+  struct ts_threshold *threshold;
+
+  set->number_of_fences = 0;
 
   purpose = (struct ts_purpose *) sq_peek(&profile->conf.purposes);
   while (purpose)
@@ -1154,140 +1571,189 @@ profile_free (struct ts_profile *profile)
               cause = (struct ts_cause *) sq_peek(&event->conf.causes);
               while (cause)
                 {
-                  threshold = (struct ts_threshold *) sq_peek(
-                      &cause->conf.thresholds);
+                  threshold = (struct ts_threshold *)
+                      sq_peek(&cause->conf.thresholds);
                   while (threshold)
                     {
-                      next_threshold = (struct ts_threshold *) sq_next(
-                          &threshold->entry);
-                      if (threshold->conf.value.valuetype == VALUESTRING)
-                        {
-                          free (threshold->conf.value.valuestring);
-                        }
-                      else if (threshold->conf.value.valuetype == VALUEARRAY)
+                      if (threshold->conf.poly && set->fences)
                         {
-                          free (threshold->conf.value.valuearray.items);
+                          threshold->conf.poly->fence_id =
+                              set->number_of_fences;
+                          set->fences[set->number_of_fences] =
+                              threshold->conf.poly;
                         }
-                      free (threshold);
-                      threshold = next_threshold;
-                    }
-                  next_cause = (struct ts_cause *) sq_next(&cause->entry);
-                  DEBUGASSERT(cause->dyn.fd < 0);       /* leak! */
-                  DEBUGASSERT(cause->dyn.timer_id < 0); /* leak! */
-                  free (cause);
-                  cause = next_cause;
-                }
-              next_event = (struct ts_event *) sq_next(&event->entry);
-              free (event->conf.actions.cloud.url.host);
-              free (event->conf.actions.cloud.url.api);
-              for (i = 0; i < event->conf.actions.cloud.url.http_header.valuearray.number_of_items; i++)
-                {
-                  if (event->conf.actions.cloud.url.http_header.valuearray.items[i].valuetype == VALUESTRING)
-                    {
-                      free (event->conf.actions.cloud.url.http_header.valuearray.items[i].valuestring);
+
+                      set->number_of_fences += !!threshold->conf.poly;
+                      threshold = (struct ts_threshold *)
+                          sq_next(&threshold->entry);
                     }
+                  cause = (struct ts_cause *) sq_next(&cause->entry);
                 }
-              free (event->conf.actions.cloud.url.http_header.valuearray.items);
-
-              free (event->conf.actions.display.showText);
-              free (event->conf.actions.sms.phoneNumber);
-              free (event->conf.actions.sms.text);
-              free (event->conf.name);
-              free (event);
-              event = next_event;
+              event = (struct ts_event *) sq_next(&event->entry);
             }
-          next_state = (struct ts_state *) sq_next(&state->entry);
-          free (state->conf.name);
-          free (state);
-          state = next_state;
+          state = (struct ts_state *) sq_next(&state->entry);
         }
-      next_purpose = (struct ts_purpose *) sq_next(&purpose->entry);
-      free (purpose->conf.name);
-      free (purpose);
-      purpose = next_purpose;
+      purpose = (struct ts_purpose *) sq_next(&purpose->entry);
+    }
+}
+
+static int
+init_geofences (struct ts_profile *profile)
+{
+  struct geofence_set *set;
+
+  set = __ts_engine_arena_alloc (&profile->arena, sizeof(*set));
+  if (!set)
+    {
+      return -PROFILE_ERROR_OUT_OF_MEMORY;
+    }
+
+  collect_geofences (profile, set);
+  if (set->number_of_fences == 0)
+    {
+      return OK;
+    }
+
+  set->fences = __ts_engine_arena_alloc (&profile->arena,
+      set->number_of_fences * sizeof(struct poly *));
+  set->hits = __ts_engine_arena_alloc (&profile->arena,
+      set->number_of_fences * sizeof(uint16_t));
+  if (!set->fences || !set->hits)
+    {
+      return -PROFILE_ERROR_OUT_OF_MEMORY;
     }
 
-  free (profile->conf.apiVersion);
-  free (profile->conf.pId);
-  free (profile->conf.name);
-  free (profile);
+  collect_geofences (profile, set);
+  profile->conf.geofences = set;
+
+  return OK;
 }
 
-struct ts_profile *
-profile_parse (const char *profile_str, int *errcode)
+static struct ts_profile *
+profile_read_stream (struct profile_reader *reader, int *errcode)
 {
+  struct profile_stream ps = {};
   struct ts_profile *profile;
-  cJSON *json_profile;
-  cJSON *json_purposes;
+  struct ts_arena tmp;
   int ret;
 
-  profile = malloc (sizeof(struct ts_profile));
-  if (!profile)
+  cJSON_Stream_Init (&ps.json, profile_getc, reader);
+
+  ret = stream_profile (&ps, NULL);
+  if (ret != OK)
     {
-      eng_dbg ("malloc for struct ts_profile failed\n");
+      *errcode = ret;
       return NULL;
     }
 
-  json_profile = cJSON_Parse (profile_str);
-  if (!json_profile)
+  if (profile_rewind (reader) != OK)
     {
-      eng_dispdbg ("cJSON_Parse failed");
-      *errcode = -PROFILE_ERROR_INVALID_JSON;
-      goto fail_with_profile;
+      eng_dbg ("rewinding profile failed\n");
+      *errcode = -TS_ENGINE_ERROR_SYSTEM;
+      return NULL;
     }
 
-  static const struct ts_parse parse_profile[] =
-        {
-          { g_apiVersion_str, offsetof(struct ts_profile, conf.apiVersion),
-              VALUESTRING, true, .error = -PROFILE_ERROR_API_VERSION_NOT_SET },
-          { g_pId_str, offsetof(struct ts_profile, conf.pId),
-              VALUESTRING, false, .value = { VALUESTRING, .valuestring = NULL }, },
-          { g_name_str, offsetof(struct ts_profile, conf.name),
-              VALUESTRING, false, .value = { VALUESTRING, .valuestring = NULL }, },
-          { g_initPuId_str, offsetof(struct ts_profile, conf.initPuId),
-              VALUEUINT32, true, .error = -PROFILE_ERROR_INIT_PURPOSE_ID_NOT_SET },
-        };
-
-  ret = parse_json_object (json_profile, profile, parse_profile,
-                           ARRAY_SIZE(parse_profile));
+  /* Whole profile is allocated from one block sized by the first pass, so
+   * reloading a profile does not fragment the heap.
+   */
+
+  ret = __ts_engine_arena_init (&tmp, ps.size);
   if (ret != OK)
     {
-      eng_dispdbg ("profile parse failed");
-      *errcode = ret;
-      goto fail_with_json;
+      eng_dbg ("arena for profile failed\n");
+      *errcode = -PROFILE_ERROR_OUT_OF_MEMORY;
+      return NULL;
     }
 
-  json_purposes = cJSON_GetObjectItem (json_profile, g_purposes_str);
-  if (!json_purposes)
+  profile = __ts_engine_arena_alloc (&tmp, sizeof(struct ts_profile));
+  DEBUGASSERT(profile);
+
+  profile->arena = tmp;
+  sq_init(&profile->conf.purposes);
+
+  ps.arena = &profile->arena;
+  cJSON_Stream_Init (&ps.json, profile_getc, reader);
+
+  ret = stream_profile (&ps, profile);
+  if (ret == OK)
     {
-      eng_dispdbg ("purposes not set");
-      *errcode = -PROFILE_ERROR_PURPOSES_NOT_SET;
-      goto fail_with_json;
+      ret = init_geofences (profile);
     }
 
-  ret = init_purposes (json_purposes, profile);
   if (ret != OK)
     {
-      eng_dispdbg ("init_purposes failed");
       *errcode = ret;
-      goto fail_with_initialized_profile;
+      profile_free (profile);
+      return NULL;
     }
 
   /* TODO: check next_state_id's, must point to existing state */
 
-  cJSON_Delete (json_profile);
+  eng_dbg ("profile uses %u of %u bytes\n", ps.arena->used, ps.arena->size);
 
   *errcode = OK;
 
   return profile;
+}
+
+void
+profile_free (struct ts_profile *profile)
+{
+  struct ts_purpose *purpose;
+  struct ts_state *state;
+  struct ts_event *event;
+  struct ts_cause *cause;
+  struct ts_arena arena;
+
+  purpose = (struct ts_purpose *) sq_peek(&profile->conf.purposes);
+  while (purpose)
+    {
+      state = (struct ts_state *) sq_peek(&purpose->conf.states);
+      while (state)
+        {
+          event = (struct ts_event *) sq_peek(&state->conf.events);
+          while (event)
+            {
+              cause = (struct ts_cause *) sq_peek(&event->conf.causes);
+              while (cause)
+                {
+                  DEBUGASSERT(cause->dyn.fd < 0);       /* leak! */
+                  DEBUGASSERT(cause->dyn.timer_id < 0); /* leak! */
+                  cause = (struct ts_cause *) sq_next(&cause->entry);
+                }
+              event = (struct ts_event *) sq_next(&event->entry);
+            }
+          state = (struct ts_state *) sq_next(&state->entry);
+        }
+      purpose = (struct ts_purpose *) sq_next(&purpose->entry);
+    }
+
+  /* Everything, the profile itself included, lives in the arena. */
+
+  arena = profile->arena;
+  __ts_engine_arena_release (&arena);
+}
+
+struct ts_profile *
+profile_parse (const char *profile_str, int *errcode)
+{
+  struct profile_reader reader = { .str = profile_str };
+
+  return profile_read_stream (&reader, errcode);
+}
 
-fail_with_initialized_profile:
-  profile_free (profile);
-  profile = NULL;
-fail_with_json:
-  cJSON_Delete (json_profile);
-fail_with_profile:
-  if (profile) free (profile);
+struct ts_profile *
+profile_parse_fd (int fd, int *errcode)
+{
+  struct profile_reader reader = { .fd = fd };
+
+  reader.start = lseek (fd, 0, SEEK_CUR);
+  if (reader.start < 0)
+    {
+      eng_dbg ("profile file not seekable\n");
+      *errcode = -TS_ENGINE_ERROR_SYSTEM;
+      return NULL;
+    }
 
-  return NULL;
+  return profile_read_stream (&reader, errcode);
 }
@@ -44,6 +44,7 @@
 
 #include "connectors/connector.h"
 #include "parse_labels.h"
+#include "arena.h"
 
 #include <apps/ts_engine/ts_engine.h>
 
@@ -61,6 +62,9 @@ typedef int bool_t;
 typedef uint64_t timestamp_t;
 
 struct ts_threshold;
+struct ts_threshold_prog;
+struct poly;
+struct geofence_set;
 struct ts_value;
 
 typedef bool (*check_threshold_t)(struct ts_threshold *threshold, struct ts_value *value);
@@ -119,6 +123,7 @@ struct ts_engine
 struct ts_profile
 {
   struct ts_engine *parent;
+  struct ts_arena arena; /* Holds the profile and everything it refers to */
 
   struct
   {
@@ -127,6 +132,7 @@ struct ts_profile
     char * const name;
     purpose_id_t initPuId;
     sq_queue_t purposes;
+    struct geofence_set *geofences; /* NULL: no isInsideGeo thresholds */
   } conf;
 };
 
@@ -278,6 +284,7 @@ struct ts_cause
     struct ts_measurement measurement;
     struct ts_threshold_params threshold;
     sq_queue_t thresholds;
+    struct ts_threshold_prog *compiled; /* NULL: evaluate 'thresholds' */
   } conf;
 
   struct
@@ -287,6 +294,7 @@ struct ts_cause
     int fd;
     bool_t triggered;
     bool measure_bias:1;
+    bool value_rewritten:1; /* sense_value changed by threshold check */
     count_t measurement_counter;
     count_t threshold_counter;
 
@@ -315,6 +323,7 @@ struct ts_threshold
     struct ts_value value;
     enum ts_threshold_t type;
     check_threshold_t check_threshold;
+    struct poly *poly; /* isInsideGeo */
   } conf;
 };
 
@@ -324,4 +333,7 @@ profile_free (struct ts_profile *profile);
 struct ts_profile *
 profile_parse (const char *profile_str, int *errcode);
 
+struct ts_profile *
+profile_parse_fd (int fd, int *errcode);
+
 #endif
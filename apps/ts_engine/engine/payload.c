@@ -0,0 +1,147 @@
+/****************************************************************************
+ * apps/ts_engine/engine/payload.c
+ *
+ * Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "eng_dbg.h"
+#include "payload.h"
+
+#define PAYLOAD_SLOTS           CONFIG_THINGSEE_ENGINE_PAYLOAD_SLOTS
+
+#if PAYLOAD_SLOTS < 1 || PAYLOAD_SLOTS > 255
+#  error "CONFIG_THINGSEE_ENGINE_PAYLOAD_SLOTS must be 1..255"
+#endif
+#define PAYLOAD_SLOT_WORDS      \
+  ((CONFIG_THINGSEE_ENGINE_PAYLOAD_SLOT_SIZE + sizeof(uint64_t) - 1) / \
+   sizeof(uint64_t))
+
+/* Slots are uint64_t arrays to keep payloads aligned for their timespecs
+ * and doubles.
+ */
+
+static uint64_t g_payload_slot[PAYLOAD_SLOTS][PAYLOAD_SLOT_WORDS];
+
+/* Stack of free slot indexes, g_payload_free[0 .. g_payload_nfree - 1]. */
+
+static uint8_t g_payload_free[PAYLOAD_SLOTS];
+static uint8_t g_payload_nfree;
+static bool g_payload_initialized;
+
+static struct ts_payload_stats g_payload_stats;
+
+static void payload_pool_init(void)
+{
+  int i;
+
+  for (i = 0; i < PAYLOAD_SLOTS; i++)
+    {
+      g_payload_free[i] = PAYLOAD_SLOTS - 1 - i;
+    }
+
+  g_payload_nfree = PAYLOAD_SLOTS;
+  g_payload_initialized = true;
+}
+
+static int payload_slot(const struct ts_payload *payload)
+{
+  uintptr_t p = (uintptr_t)payload;
+  uintptr_t base = (uintptr_t)g_payload_slot;
+
+  if (p < base || p >= base + sizeof(g_payload_slot))
+    {
+      return ERROR;
+    }
+
+  return (p - base) / sizeof(g_payload_slot[0]);
+}
+
+struct ts_payload *__ts_engine_payload_alloc(size_t size)
+{
+  struct ts_payload *payload;
+
+  if (!g_payload_initialized)
+    {
+      payload_pool_init();
+    }
+
+  if (size <= sizeof(g_payload_slot[0]) && g_payload_nfree > 0)
+    {
+      g_payload_stats.pooled++;
+      g_payload_stats.in_use++;
+
+      return (void *)g_payload_slot[g_payload_free[--g_payload_nfree]];
+    }
+
+  payload = malloc(size);
+  if (!payload)
+    {
+      eng_dbg("malloc %u failed\n", size);
+      return NULL;
+    }
+
+  g_payload_stats.heap++;
+
+  return payload;
+}
+
+void __ts_engine_payload_free(struct ts_payload *payload)
+{
+  int slot;
+
+  if (!payload)
+    {
+      return;
+    }
+
+  slot = payload_slot(payload);
+  if (slot < 0)
+    {
+      free(payload);
+      return;
+    }
+
+  DEBUGASSERT(g_payload_nfree < PAYLOAD_SLOTS);
+
+  g_payload_free[g_payload_nfree++] = slot;
+  g_payload_stats.in_use--;
+}
+
+void __ts_engine_payload_stats(struct ts_payload_stats *stats)
+{
+  *stats = g_payload_stats;
+}
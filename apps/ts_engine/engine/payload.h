@@ -0,0 +1,82 @@
+/****************************************************************************
+ * apps/ts_engine/engine/payload.h
+ *
+ * Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#ifndef __APPS_TS_ENGINE_ENGINE_PAYLOAD_H__
+#define __APPS_TS_ENGINE_ENGINE_PAYLOAD_H__
+
+#include <stddef.h>
+
+#include "connectors/connector.h"
+
+/* Payloads generated on the sampling path are short lived: they are
+ * serialized by the log or a connector and released right away. They are
+ * taken from a small static pool of equally sized slots, so generating one
+ * does not touch the heap. Payloads larger than a slot, or generated while
+ * all slots are in use, fall back to malloc.
+ *
+ * Engine main loop only, the pool is not locked.
+ */
+
+#ifndef CONFIG_THINGSEE_ENGINE_PAYLOAD_SLOTS
+#  define CONFIG_THINGSEE_ENGINE_PAYLOAD_SLOTS      4
+#endif
+
+#ifndef CONFIG_THINGSEE_ENGINE_PAYLOAD_SLOT_SIZE
+#  define CONFIG_THINGSEE_ENGINE_PAYLOAD_SLOT_SIZE  256
+#endif
+
+struct ts_payload_stats
+{
+  unsigned int pooled;          /* Allocations served from the pool */
+  unsigned int heap;            /* Allocations that fell back to heap */
+  unsigned int in_use;          /* Pool slots currently in use */
+};
+
+/* Allocate uninitialized payload of 'size' bytes, senses and extra memory
+ * included. Returns NULL if out of memory.
+ */
+
+struct ts_payload *__ts_engine_payload_alloc(size_t size);
+
+/* Release payload allocated with __ts_engine_payload_alloc(). NULL is
+ * ignored.
+ */
+
+void __ts_engine_payload_free(struct ts_payload *payload);
+
+/* Get pool usage counters. */
+
+void __ts_engine_payload_stats(struct ts_payload_stats *stats);
+
+#endif
@@ -42,6 +42,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "eng_dbg.h"
 #include "value.h"
@@ -67,17 +68,29 @@
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
 #endif
 
-#define MAX_SENSES_PER_SENSOR 64
+#define MAX_SENSES 64
 #define DEEP_SLEEP_RATE_LIMIT 1000
 
+/* Every (group, property) pair has a slot in the lookup table. Slots of a
+ * group are consecutive, starting from the group's first slot.
+ */
+
+#define SLOTS_LOCATION 0
+#define SLOTS_SPEED (SLOTS_LOCATION + PROPERTY_ID_LOCATION_LAST)
+#define SLOTS_ENERGY (SLOTS_SPEED + PROPERTY_ID_SPEED_LAST)
+#define SLOTS_ORIENTATION (SLOTS_ENERGY + PROPERTY_ID_ENERGY_LAST)
+#define SLOTS_ACCELERATION (SLOTS_ORIENTATION + PROPERTY_ID_ORIENTATION_LAST)
+#define SLOTS_ENVIRONMENT (SLOTS_ACCELERATION + PROPERTY_ID_ACCELERATION_LAST)
+#define SLOTS_HW_KEYS (SLOTS_ENVIRONMENT + PROPERTY_ID_ENVIRONMENT_LAST)
+#define SLOTS_TIME (SLOTS_HW_KEYS + PROPERTY_ID_HW_KEYS_LAST)
+#define SENSE_SLOTS (SLOTS_TIME + PROPERTY_ID_TIME_LAST)
+
 typedef int (*sense_read_t)(struct ts_cause *cause);
 
-struct ts_sense_lookup
+struct ts_sense_slot
 {
-  dq_entry_t entry;
-
-  const struct ts_sense_info *sense_info;
-  uint8_t index;
+  uint8_t first;  /* First entry in g_senses */
+  uint8_t count;  /* Senses of this property, sId index is 0..count-1 */
 };
 
 struct ts_module
@@ -524,6 +537,30 @@ static const struct ts_sense_info sense_info_ublox_gps[] =
 	    .ops.active.uninit = NULL,
 	    .ops.active.read = NULL,
 	},
+	{
+	    .sId = SENSE_ID_GPS_TTFF,
+	    .name = g_gps_ttff_str,
+	    .min = { .valuetype = VALUEUINT32, .valueuint32 = 0 },
+	    .max = { .valuetype = VALUEUINT32, .valueuint32 = UINT32_MAX },
+	    .min_interval = 100,
+	    .ops.irq.init = sense_location_init,
+	    .ops.irq.uninit = sense_location_uninit,
+	    .ops.active.init = NULL,
+	    .ops.active.uninit = NULL,
+	    .ops.active.read = NULL,
+	},
+	{
+	    .sId = SENSE_ID_GPS_ON_TIME,
+	    .name = g_gps_on_time_str,
+	    .min = { .valuetype = VALUEUINT32, .valueuint32 = 0 },
+	    .max = { .valuetype = VALUEUINT32, .valueuint32 = UINT32_MAX },
+	    .min_interval = 100,
+	    .ops.irq.init = sense_location_init,
+	    .ops.irq.uninit = sense_location_uninit,
+	    .ops.active.init = NULL,
+	    .ops.active.uninit = NULL,
+	    .ops.active.read = NULL,
+	},
 #endif
 #ifdef CONFIG_THINGSEE_ENGINE_SENSE_SPEED
 	{
@@ -741,29 +778,26 @@ static const struct ts_module g_modules[] =
     };
 #endif /* !CONFIG_ARCH_SIM */
 
-static dq_queue_t g_group_id_location[PROPERTY_ID_LOCATION_LAST + 1];
-static dq_queue_t g_group_id_speed[PROPERTY_ID_SPEED_LAST + 1];
-static dq_queue_t g_group_id_energy[PROPERTY_ID_ENERGY_LAST + 1];
-static dq_queue_t g_group_id_orientation[PROPERTY_ID_ORIENTATION_LAST + 1];
-static dq_queue_t g_group_id_acceleration[PROPERTY_ID_ACCELERATION_LAST + 1];
-static dq_queue_t g_group_id_environment[PROPERTY_ID_ENVIRONMENT_LAST + 1];
-static dq_queue_t g_group_id_hw_keys[PROPERTY_ID_HW_KEYS_LAST + 1];
-static dq_queue_t g_group_id_time[PROPERTY_ID_TIME_LAST + 1];
-
-static struct group {
-  dq_queue_t *list;
-  int last_property_id;
+static const struct group {
+  uint8_t first_slot;
+  uint8_t last_property_id;
 } g_lookup_tbl[] = {
-    [GROUP_ID_LOCATION] = { g_group_id_location,  PROPERTY_ID_LOCATION_LAST, },
-    [GROUP_ID_SPEED] = { g_group_id_speed,  PROPERTY_ID_SPEED_LAST, },
-    [GROUP_ID_ENERGY] = { g_group_id_energy,  PROPERTY_ID_ENERGY_LAST, },
-    [GROUP_ID_ORIENTATION] = { g_group_id_orientation,  PROPERTY_ID_ORIENTATION_LAST, },
-    [GROUP_ID_ACCELERATION] = { g_group_id_acceleration,  PROPERTY_ID_ACCELERATION_LAST, },
-    [GROUP_ID_ENVIRONMENT] = { g_group_id_environment,  PROPERTY_ID_ENVIRONMENT_LAST, },
-    [GROUP_ID_HW_KEYS] = { g_group_id_hw_keys,  PROPERTY_ID_HW_KEYS_LAST, },
-    [GROUP_ID_TIME] = { g_group_id_time,  PROPERTY_ID_TIME_LAST, },
+    [GROUP_ID_LOCATION] = { SLOTS_LOCATION,  PROPERTY_ID_LOCATION_LAST, },
+    [GROUP_ID_SPEED] = { SLOTS_SPEED,  PROPERTY_ID_SPEED_LAST, },
+    [GROUP_ID_ENERGY] = { SLOTS_ENERGY,  PROPERTY_ID_ENERGY_LAST, },
+    [GROUP_ID_ORIENTATION] = { SLOTS_ORIENTATION,  PROPERTY_ID_ORIENTATION_LAST, },
+    [GROUP_ID_ACCELERATION] = { SLOTS_ACCELERATION,  PROPERTY_ID_ACCELERATION_LAST, },
+    [GROUP_ID_ENVIRONMENT] = { SLOTS_ENVIRONMENT,  PROPERTY_ID_ENVIRONMENT_LAST, },
+    [GROUP_ID_HW_KEYS] = { SLOTS_HW_KEYS,  PROPERTY_ID_HW_KEYS_LAST, },
+    [GROUP_ID_TIME] = { SLOTS_TIME,  PROPERTY_ID_TIME_LAST, },
 };
 
+/* Registered senses ordered by slot and, within a slot, by sId index. */
+
+static const struct ts_sense_info *g_senses[MAX_SENSES];
+static struct ts_sense_slot g_sense_slots[SENSE_SLOTS];
+static int g_number_of_senses;
+
 static int
 start_cause_timer (struct ts_cause *cause);
 
@@ -887,74 +921,81 @@ engine_cause_request_value (struct ts_cause *cause)
     }
 }
 
-const struct ts_sense_info *
-get_sense_info (sense_id_t sId)
+static int
+sense_slot (sense_id_t sId)
 {
   uint8_t group_id;
   uint8_t property_id;
-  uint8_t index;
-  struct ts_sense_lookup *sense_lookup;
 
   group_id = (sId >> 16) & 0xff;
   property_id = (sId >> 8) & 0xff;
-  index = sId & 0xff;
 
   if (group_id < 1 || group_id > GROUP_ID_LAST ||
-      property_id < 1 || property_id > g_lookup_tbl[group_id].last_property_id ||
-      dq_empty(&g_lookup_tbl[group_id].list[property_id]))
+      property_id < 1 || property_id > g_lookup_tbl[group_id].last_property_id)
     {
-      goto fail_out;
+      return ERROR;
     }
 
-  sense_lookup = (struct ts_sense_lookup *)sq_peek (&g_lookup_tbl[group_id].list[property_id]);
+  return g_lookup_tbl[group_id].first_slot + property_id - 1;
+}
 
-  while (sense_lookup)
-    {
-      if (sense_lookup->index == index)
-	{
-	  return sense_lookup->sense_info;
-	}
+const struct ts_sense_info *
+get_sense_info (sense_id_t sId)
+{
+  const struct ts_sense_slot *slot;
+  uint8_t index;
+  int n;
 
-      sense_lookup = (struct ts_sense_lookup *)dq_next (&sense_lookup->entry);
-    }
+  n = sense_slot (sId);
+  index = sId & 0xff;
 
-fail_out:
+  if (n < 0 || index >= g_sense_slots[n].count)
+    {
+      eng_dbg ("sId 0x%08x does not exist\n", sId);
+      return NULL;
+    }
 
-  eng_dbg ("sId 0x%08x does not exist\n", sId);
+  slot = &g_sense_slots[n];
 
-  return NULL;
+  return g_senses[slot->first + index];
 }
 
 static int
 add_sense (const struct ts_sense_info *sense_info)
 {
-  struct ts_sense_lookup *lookup, *prev;
-  uint8_t group_id;
-  uint8_t property_id;
+  int pos;
+  int n;
+  int i;
+
+  n = sense_slot (sense_info->sId);
+  if (n < 0)
+    {
+      eng_dbg ("invalid sId 0x%08x\n", sense_info->sId);
+      return ERROR;
+    }
 
-  lookup = malloc (sizeof(*lookup));
-  if (!lookup)
+  if (g_number_of_senses >= MAX_SENSES || g_sense_slots[n].count == 0xff)
     {
-      eng_dbg ("malloc for ts_sense_lookup failed\n");
+      eng_dbg ("sense table full\n");
       return -TS_ENGINE_ERROR_OOM;
     }
 
-  group_id = (sense_info->sId >> 16) & 0xff;
-  property_id = (sense_info->sId >> 8) & 0xff;
+  /* Append to the slot, making room by shifting the senses of the
+   * following slots up by one.
+   */
 
-  lookup->sense_info = sense_info;
+  pos = g_sense_slots[n].first + g_sense_slots[n].count;
 
-  dq_addlast (&lookup->entry, &g_lookup_tbl[group_id].list[property_id]);
+  memmove (&g_senses[pos + 1], &g_senses[pos],
+           (g_number_of_senses - pos) * sizeof(g_senses[0]));
 
-  prev = (struct ts_sense_lookup *)lookup->entry.blink;
+  g_senses[pos] = sense_info;
+  g_sense_slots[n].count++;
+  g_number_of_senses++;
 
-  if (prev)
+  for (i = n + 1; i < SENSE_SLOTS; i++)
     {
-      lookup->index = prev->index + 1;
-    }
-  else
-    {
-      lookup->index = 0;
+      g_sense_slots[i].first++;
     }
 
   return OK;
@@ -986,28 +1027,30 @@ generate_sense_info_sim (int g, int p)
 int
 initialize_sense_lookup (void)
 {
+#ifdef CONFIG_ARCH_SIM
   int g, p;
-#ifndef CONFIG_ARCH_SIM
+#else
   int i, j;
 #endif
   int ret;
 
+  memset (g_sense_slots, 0, sizeof(g_sense_slots));
+  g_number_of_senses = 0;
+
+#ifdef CONFIG_ARCH_SIM
   for (g = GROUP_ID_LOCATION; g <= GROUP_ID_LAST; g++)
     {
       for (p = 1; p <= g_lookup_tbl[g].last_property_id; p++)
 	{
-	  dq_init (&g_lookup_tbl[g].list[p]);
-
-#ifdef CONFIG_ARCH_SIM
 	  ret = generate_sense_info_sim (g, p);
 	  if (ret != OK)
 	    {
 	      eng_dbg ("generate_sense_info_sim failed\n");
 	      return ERROR;
 	    }
-#endif
 	}
     }
+#endif
 
 #ifndef CONFIG_ARCH_SIM
   for (i = 0; i < ARRAY_SIZE(g_modules); i++)
@@ -1035,33 +1078,6 @@ initialize_sense_lookup (void)
   return OK;
 }
 
-static uint8_t
-find_index (const struct ts_sense_info * const sense_info)
-{
-  struct ts_sense_lookup *lookup;
-  uint8_t group_id;
-  uint8_t property_id;
-
-  group_id = (sense_info->sId >> 16) & 0xff;
-  property_id = (sense_info->sId >> 8) & 0xff;
-
-  lookup = (struct ts_sense_lookup *)sq_peek (&g_lookup_tbl[group_id].list[property_id]);
-
-  while (lookup)
-    {
-      if (lookup->sense_info == sense_info)
-	{
-	  return lookup->index;
-	}
-
-      lookup = (struct ts_sense_lookup *) dq_next(&lookup->entry);
-    }
-
-  DEBUGASSERT(false);
-
-  return 0;
-}
-
 static int
 ts_value_to_double (const struct ts_value * const value, double *outval)
 {
@@ -1102,32 +1118,13 @@ generate_module_json (void)
   return NULL;
 #else
   cJSON *module, *modules, *sense, *senses;
-  int i, j;
-  int sIds[MAX_SENSES_PER_SENSOR];
-  int number_of_senses = 0;
-  uint8_t index;
+  int i, index;
   const struct ts_sense_info *sense_info;
   double val;
   int ret;
   char buf[16];
 
-  for (i = 0; i < ARRAY_SIZE(g_modules); i++)
-    {
-      for (j = 0;
-	  j < g_modules[i].number_of_senses && j < MAX_SENSES_PER_SENSOR; j++)
-	{
-	  if (g_modules[i].sense_info[j].ops.irq.init
-	      || g_modules[i].sense_info[j].ops.active.read)
-	    {
-	      index = find_index (&g_modules[i].sense_info[j]);
-
-	      sIds[number_of_senses++] = g_modules[i].sense_info[j].sId
-		  | index;
-	    }
-	}
-    }
-
-  if (!number_of_senses)
+  if (!g_number_of_senses)
     {
       return NULL;
     }
@@ -1140,7 +1137,7 @@ generate_module_json (void)
 
   senses = cJSON_CreateArray ();
 
-  for (i = 0; i < number_of_senses; i++)
+  for (i = 0; i < g_number_of_senses; i++)
     {
       sense = cJSON_CreateObject ();
       if (!sense)
@@ -1149,14 +1146,10 @@ generate_module_json (void)
 	  return NULL;
 	}
 
-      sense_info = get_sense_info (sIds[i]);
-      if (!sense_info)
-	{
-	  eng_dbg("get_sense_info failed\n");
-	  return NULL;
-	}
+      sense_info = g_senses[i];
+      index = i - g_sense_slots[sense_slot (sense_info->sId)].first;
 
-      snprintf (buf, 16, "0x%08x", sIds[i]);
+      snprintf (buf, 16, "0x%08x", sense_info->sId | index);
       cJSON_AddStringToObject(sense, "sId", buf);
 
       if (sense_info->min.valuetype != VALUESTRING)
@@ -90,7 +90,9 @@ struct ts_sense_info
 #define PROPERTY_ID_IS_INSIDE_GEOFENCE          0x05
 #define PROPERTY_ID_GPS_TIMESTAMP		0x06
 #define PROPERTY_ID_LATLON			0x07
-#define PROPERTY_ID_LOCATION_LAST		PROPERTY_ID_LATLON
+#define PROPERTY_ID_GPS_TTFF			0x08
+#define PROPERTY_ID_GPS_ON_TIME			0x09
+#define PROPERTY_ID_LOCATION_LAST		PROPERTY_ID_GPS_ON_TIME
 
 #define PROPERTY_ID_GROUND_SPEED		0x01
 #define PROPERTY_ID_AIR_SPEED			0x02
@@ -157,6 +159,8 @@ struct ts_sense_info
 #define SENSE_ID_IS_INSIDE_GEOFENCE		((RESERVED << 24) | (GROUP_ID_LOCATION << 16) | (PROPERTY_ID_IS_INSIDE_GEOFENCE << 8) | INDEX)
 #define SENSE_ID_GPS_TIMESTAMP			((RESERVED << 24) | (GROUP_ID_LOCATION << 16) | (PROPERTY_ID_GPS_TIMESTAMP << 8) | INDEX)
 #define SENSE_ID_LATLON				((RESERVED << 24) | (GROUP_ID_LOCATION << 16) | (PROPERTY_ID_LATLON << 8) | INDEX)
+#define SENSE_ID_GPS_TTFF			((RESERVED << 24) | (GROUP_ID_LOCATION << 16) | (PROPERTY_ID_GPS_TTFF << 8) | INDEX)
+#define SENSE_ID_GPS_ON_TIME			((RESERVED << 24) | (GROUP_ID_LOCATION << 16) | (PROPERTY_ID_GPS_ON_TIME << 8) | INDEX)
 
 #define SENSE_ID_GROUND_SPEED			((RESERVED << 24) | (GROUP_ID_SPEED << 16) | (PROPERTY_ID_GROUND_SPEED << 8) | INDEX)
 #define SENSE_ID_AIR_SPEED			((RESERVED << 24) | (GROUP_ID_SPEED << 16) | (PROPERTY_ID_AIR_SPEED << 8) | INDEX)
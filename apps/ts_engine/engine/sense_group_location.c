@@ -410,6 +410,7 @@ gps_cb (void const * const e, void * const priv)
   struct gps_event_s const * const event = e;
   struct client_s *client;
   char latlon_str[32];
+  struct gps_aiding_stats_s aiding_stats;
   int32_t next_secs;
 
   DEBUGASSERT(event);
@@ -502,6 +503,11 @@ gps_cb (void const * const e, void * const priv)
         g_gps.location.current.heading = gps->location->heading / 10000.0;
         g_gps.location.current.accuracy = gps->location->horizontal_accuracy / 1000;
 
+        /* Time-to-first-fix and GPS on-time statistics */
+
+        if (ts_gps_get_aiding_stats(&aiding_stats) != OK)
+          memset(&aiding_stats, 0, sizeof(aiding_stats));
+
         for (client = (struct client_s *) sq_peek(&g_gps.clients);
              client;
              client = (struct client_s *) sq_next(&client->entry))
@@ -610,6 +616,14 @@ gps_cb (void const * const e, void * const priv)
                           g_gps.location.current.longitude);
                   cause->dyn.sense_value.value.valuestring = latlon_str;
                   break;
+                case SENSE_ID_GPS_TTFF:
+                  cause->dyn.sense_value.value.valueuint32 =
+                      aiding_stats.last_ttff;
+                  break;
+                case SENSE_ID_GPS_ON_TIME:
+                  cause->dyn.sense_value.value.valueuint32 =
+                      aiding_stats.total_on_time;
+                  break;
                 default:
                   continue;
               }
@@ -0,0 +1,407 @@
+/****************************************************************************
+ * apps/ts_engine/engine/threshold.c
+ *
+ * Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <queue.h>
+
+#include "eng_dbg.h"
+#include "eng_error.h"
+#include "parse.h"
+#include "threshold.h"
+
+static int compare_int(const void *a, const void *b)
+{
+  const union ts_threshold_key *ka = a;
+  const union ts_threshold_key *kb = b;
+
+  return (ka->i > kb->i) - (ka->i < kb->i);
+}
+
+static int compare_double(const void *a, const void *b)
+{
+  const union ts_threshold_key *ka = a;
+  const union ts_threshold_key *kb = b;
+
+  return (ka->d > kb->d) - (ka->d < kb->d);
+}
+
+/* Cast limit 'limit' the same way the generic evaluation does for a sample
+ * of type 'valuetype'.
+ */
+
+static union ts_threshold_key to_key(enum ts_valuetype_t valuetype,
+                                     double limit)
+{
+  union ts_threshold_key key;
+
+  switch (valuetype)
+    {
+    case VALUEDOUBLE:
+      key.d = limit;
+      break;
+    case VALUEUINT16:
+      key.i = (uint16_t)limit;
+      break;
+    case VALUEUINT32:
+      key.i = (uint32_t)limit;
+      break;
+    case VALUEINT16:
+      key.i = (int16_t)limit;
+      break;
+    case VALUEINT32:
+      key.i = (int32_t)limit;
+      break;
+    case VALUEBOOL:
+    default:
+      key.i = (bool)limit;
+      break;
+    }
+
+  return key;
+}
+
+/* Number of numeric items in isOneOf/isNotIn threshold value 'value', or
+ * ERROR if it holds something else.
+ */
+
+static int set_size(const struct ts_value *value)
+{
+  int i;
+
+  if (value->valuetype == VALUEDOUBLE)
+    {
+      return 1;
+    }
+
+  if (value->valuetype != VALUEARRAY)
+    {
+      return ERROR;
+    }
+
+  for (i = 0; i < value->valuearray.number_of_items; i++)
+    {
+      if (value->valuearray.items[i].valuetype != VALUEDOUBLE)
+        {
+          return ERROR;
+        }
+    }
+
+  return value->valuearray.number_of_items;
+}
+
+static int fill_set(union ts_threshold_key *items,
+                    enum ts_valuetype_t valuetype,
+                    const struct ts_value *value)
+{
+  const struct ts_value *src;
+  int count;
+  int n = 0;
+  int i;
+
+  if (value->valuetype == VALUEARRAY)
+    {
+      src = value->valuearray.items;
+      count = value->valuearray.number_of_items;
+    }
+  else
+    {
+      src = value;
+      count = 1;
+    }
+
+  for (i = 0; i < count; i++)
+    {
+      /* NaN never compares equal, so it can not match and would only
+       * break the ordering.
+       */
+
+      if (valuetype == VALUEDOUBLE && src[i].valuedouble != src[i].valuedouble)
+        {
+          continue;
+        }
+
+      items[n++] = to_key(valuetype, src[i].valuedouble);
+    }
+
+  qsort(items, n, sizeof(*items),
+        valuetype == VALUEDOUBLE ? compare_double : compare_int);
+
+  return n;
+}
+
+static bool find_int(const union ts_threshold_key *items, int n, int64_t key)
+{
+  int lo = 0;
+  int hi = n;
+  int mid;
+
+  while (lo < hi)
+    {
+      mid = (lo + hi) / 2;
+
+      if (key < items[mid].i)
+        {
+          hi = mid;
+        }
+      else if (key > items[mid].i)
+        {
+          lo = mid + 1;
+        }
+      else
+        {
+          return true;
+        }
+    }
+
+  return false;
+}
+
+static bool find_double(const union ts_threshold_key *items, int n, double key)
+{
+  int lo = 0;
+  int hi = n;
+  int mid;
+
+  while (lo < hi)
+    {
+      mid = (lo + hi) / 2;
+
+      if (key < items[mid].d)
+        {
+          hi = mid;
+        }
+      else if (key > items[mid].d)
+        {
+          lo = mid + 1;
+        }
+      else
+        {
+          /* Equal, or 'key' is NaN. */
+
+          return key == items[mid].d;
+        }
+    }
+
+  return false;
+}
+
+int __ts_engine_threshold_compile(struct ts_cause *cause,
+                                  enum ts_valuetype_t valuetype,
+                                  struct ts_arena *arena)
+{
+  struct ts_threshold *threshold;
+  struct ts_threshold_prog *prog;
+  const struct ts_value *oneof = NULL;
+  const struct ts_value *notin = NULL;
+  double gt = 0;
+  double lt = 0;
+  uint8_t flags = 0;
+  int n_oneof = 0;
+  int n_notin = 0;
+
+  cause->conf.compiled = NULL;
+
+  switch (valuetype)
+    {
+    case VALUEDOUBLE:
+    case VALUEUINT16:
+    case VALUEUINT32:
+    case VALUEINT16:
+    case VALUEINT32:
+    case VALUEBOOL:
+      break;
+    default:
+      return OK;
+    }
+
+  threshold = (struct ts_threshold *) sq_peek(&cause->conf.thresholds);
+
+  while (threshold)
+    {
+      if (threshold->conf.check_threshold)
+        {
+          return OK;
+        }
+
+      switch (threshold->conf.type)
+        {
+        case isAny:
+          break;
+        case isGt:
+        case isLt:
+          if (threshold->conf.value.valuetype != VALUEDOUBLE)
+            {
+              return OK;
+            }
+
+          if (threshold->conf.type == isGt)
+            {
+              gt = threshold->conf.value.valuedouble;
+              flags |= THRESHOLD_HAS_GT;
+            }
+          else
+            {
+              lt = threshold->conf.value.valuedouble;
+              flags |= THRESHOLD_HAS_LT;
+            }
+          break;
+        case isOneOf:
+          n_oneof = set_size(&threshold->conf.value);
+          if (n_oneof < 0)
+            {
+              return OK;
+            }
+          oneof = &threshold->conf.value;
+          break;
+        case isNotIn:
+          n_notin = set_size(&threshold->conf.value);
+          if (n_notin < 0)
+            {
+              return OK;
+            }
+          notin = &threshold->conf.value;
+          break;
+        default:
+          return OK;
+        }
+
+      threshold = (struct ts_threshold *) sq_next(&threshold->entry);
+    }
+
+  prog = __ts_engine_arena_alloc(arena, THRESHOLD_PROG_SIZE(n_oneof + n_notin));
+  if (!prog)
+    {
+      return -TS_ENGINE_ERROR_OOM;
+    }
+
+  /* Boolean senses are never compared relative to the bias. */
+
+  if (valuetype != VALUEBOOL && cause->conf.threshold.relative &&
+      cause->conf.measurement.interval != -1)
+    {
+      flags |= THRESHOLD_RELATIVE;
+    }
+
+  prog->valuetype = valuetype;
+  prog->flags = flags;
+  prog->gt = to_key(valuetype, gt);
+  prog->lt = to_key(valuetype, lt);
+  prog->n_oneof = oneof ? fill_set(prog->items, valuetype, oneof) : 0;
+  prog->n_notin = notin ?
+      fill_set(&prog->items[prog->n_oneof], valuetype, notin) : 0;
+
+  cause->conf.compiled = prog;
+
+  return OK;
+}
+
+int __ts_engine_threshold_eval(const struct ts_threshold_prog *prog,
+                               const struct ts_value *value,
+                               const struct ts_value *bias)
+{
+  const union ts_threshold_key *notin = &prog->items[prog->n_oneof];
+  bool relative = prog->flags & THRESHOLD_RELATIVE;
+  double d;
+  int64_t i;
+
+  if (value->valuetype != prog->valuetype)
+    {
+      return ERROR;
+    }
+
+  /* Bias is subtracted in the sample type, wrapping like the generic
+   * evaluation does.
+   */
+
+  switch (prog->valuetype)
+    {
+    case VALUEDOUBLE:
+      d = value->valuedouble - (relative ? bias->valuedouble : 0.0);
+
+      if ((prog->flags & THRESHOLD_HAS_GT) && !(d > prog->gt.d))
+        {
+          return false;
+        }
+
+      if ((prog->flags & THRESHOLD_HAS_LT) && !(d < prog->lt.d))
+        {
+          return false;
+        }
+
+      if (prog->n_oneof && !find_double(prog->items, prog->n_oneof, d))
+        {
+          return false;
+        }
+
+      return !(prog->n_notin && find_double(notin, prog->n_notin, d));
+
+    case VALUEUINT16:
+      i = (uint16_t)(value->valueuint16 - (relative ? bias->valueuint16 : 0));
+      break;
+    case VALUEUINT32:
+      i = (uint32_t)(value->valueuint32 - (relative ? bias->valueuint32 : 0));
+      break;
+    case VALUEINT16:
+      i = (int16_t)(value->valueint16 - (relative ? bias->valueint16 : 0));
+      break;
+    case VALUEINT32:
+      i = (int32_t)((uint32_t)value->valueint32 -
+                    (uint32_t)(relative ? bias->valueint32 : 0));
+      break;
+    case VALUEBOOL:
+    default:
+      i = value->valuebool;
+      break;
+    }
+
+  if ((prog->flags & THRESHOLD_HAS_GT) && !(i > prog->gt.i))
+    {
+      return false;
+    }
+
+  if ((prog->flags & THRESHOLD_HAS_LT) && !(i < prog->lt.i))
+    {
+      return false;
+    }
+
+  if (prog->n_oneof && !find_int(prog->items, prog->n_oneof, i))
+    {
+      return false;
+    }
+
+  return !(prog->n_notin && find_int(notin, prog->n_notin, i));
+}
@@ -0,0 +1,100 @@
+/****************************************************************************
+ * apps/ts_engine/engine/threshold.h
+ *
+ * Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ ****************************************************************************/
+
+#ifndef __APPS_TS_ENGINE_ENGINE_THRESHOLD_H__
+#define __APPS_TS_ENGINE_ENGINE_THRESHOLD_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "value.h"
+#include "arena.h"
+
+struct ts_cause;
+
+/* Thresholds of a cause compiled for the value type its sense produces.
+ *
+ * A cause has at most one threshold of each kind, so the compiled form is
+ * flat: optional open range bounds (isGt/isLt) and two sorted sets
+ * (isOneOf/isNotIn) that are binary searched. Limits and set items are cast
+ * to the sense value type once at compile time and widened to a common
+ * key, so the per sample work is one key conversion and a few compares.
+ * isAny always matches and is dropped.
+ */
+
+#define THRESHOLD_HAS_GT        (1 << 0)
+#define THRESHOLD_HAS_LT        (1 << 1)
+#define THRESHOLD_RELATIVE      (1 << 2)
+
+union ts_threshold_key
+{
+  int64_t i;  /* integer and boolean senses */
+  double d;   /* VALUEDOUBLE senses */
+};
+
+struct ts_threshold_prog
+{
+  enum ts_valuetype_t valuetype;
+  uint8_t flags;
+  uint16_t n_oneof;
+  uint16_t n_notin;
+  union ts_threshold_key gt;
+  union ts_threshold_key lt;
+  union ts_threshold_key items[]; /* n_oneof + n_notin, each set sorted */
+};
+
+#define THRESHOLD_PROG_SIZE(nitems) \
+  (sizeof(struct ts_threshold_prog) + (nitems) * sizeof(union ts_threshold_key))
+
+/* Compile the thresholds of 'cause' for samples of type 'valuetype' into
+ * 'arena'. Causes that need the generic evaluation (string values,
+ * geofences, non-numeric limits) are left without a program. Returns OK,
+ * or -TS_ENGINE_ERROR_OOM.
+ */
+
+int __ts_engine_threshold_compile(struct ts_cause *cause,
+                                  enum ts_valuetype_t valuetype,
+                                  struct ts_arena *arena);
+
+/* Evaluate compiled thresholds against sample 'value'. 'bias' is
+ * subtracted first for relative causes. Returns true/false, or ERROR if
+ * 'value' is not of the compiled type and the caller must fall back to
+ * the generic evaluation.
+ */
+
+int __ts_engine_threshold_eval(const struct ts_threshold_prog *prog,
+                               const struct ts_value *value,
+                               const struct ts_value *bias);
+
+#endif
@@ -386,6 +386,7 @@ static const char * const __ts_engine_util_get_filename(
   size_t basename_len = strlen(basename);
   int index;
   int index_max = 0;
+  int index_min = INT_MAX;
   char *filename;
   int ret;
   bool found = false;
@@ -404,7 +405,8 @@ static const char * const __ts_engine_util_get_filename(
           continue;
         }
 
-      if (dirent->d_name[basename_len] != '.')
+      if (strncmp(dirent->d_name, basename, basename_len) ||
+          dirent->d_name[basename_len] != '.')
         {
           continue;
         }
@@ -413,10 +415,11 @@ static const char * const __ts_engine_util_get_filename(
 
       index = atoi(&dirent->d_name[basename_len + 1]);
 
-      if (first)
+      /* Oldest log has the lowest index. */
+
+      if (index < index_min)
         {
-          index_max = index;
-          break;
+          index_min = index;
         }
 
       index++;
@@ -427,20 +430,21 @@ static const char * const __ts_engine_util_get_filename(
         }
     }
 
+  closedir(dir);
+
   if (!found && first)
     {
       return NULL;
     }
 
-  ret = asprintf(&filename, "%s/%s.%d", dirname, basename, index_max);
+  ret = asprintf(&filename, "%s/%s.%d", dirname, basename,
+                 first ? index_min : index_max);
   if (ret < 0)
     {
       eng_dbg("asprintf failed\n");
       return NULL;
     }
 
-  closedir(dir);
-
   return filename;
 }
 
@@ -295,7 +295,6 @@ int __value_to_json(cJSON *obj, const char * const label,
               {
                 eng_dbg("cJSON_CreateObject failed\n");
                 cJSON_Delete(array_json);
-                cJSON_Delete(obj);
                 return ERROR;
               }
             __value_to_json(array_json_entry, label, &array_value_entry[i]);
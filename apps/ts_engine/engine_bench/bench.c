@@ -0,0 +1,493 @@
+/****************************************************************************
+ * apps/ts_engine/engine_bench/bench.c
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+/* Deterministic replay benchmark for the rule engine.
+ *
+ * Every argument is a simtest scenario directory holding profile.json and
+ * values.json. The profile is parsed and started as on the device, then the
+ * recorded sense traces are replayed round-robin, one sample per sense at a
+ * time, straight into handle_cause_event() of every active cause waiting
+ * for that sense. No timers are involved, so the engine sees the same
+ * sequence on every run and the loop goes as fast as the engine does. The
+ * profile is restarted after each pass over the traces.
+ *
+ * Reported per scenario:
+ *  - events/s:     handle_cause_event() calls per second of engine time
+ *  - allocs/event: malloc/calloc/realloc calls made by the engine per call
+ *  - p50/p99:      latency from handing the value to the engine to the
+ *                  first event action (logged event payload) or to the
+ *                  return of a call that changed state
+ */
+
+#include <nuttx/config.h>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include <apps/netutils/cJSON.h>
+
+#include "bench.h"
+#include "../engine/parse.h"
+#include "../engine/execute.h"
+#include "../engine/main.h"
+
+#define PROFILE_JSON_FILENAME   "profile.json"
+#define VALUES_JSON_FILENAME    "values.json"
+
+#define BENCH_DEFAULT_ROUNDS    10000
+#define BENCH_TRACES_MAX        8
+#define BENCH_CAUSES_MAX        16
+
+#ifndef offset_of
+#define offset_of(type, member) ((intptr_t)(&(((type *)0)->member)))
+#endif
+
+#ifndef container_of
+#define container_of(ptr, type, member) \
+        ((type *)((intptr_t)(ptr) - offset_of(type, member)))
+#endif
+
+struct bench_trace
+{
+  sense_id_t sId;
+  int count;
+  double *values;
+};
+
+struct bench_scenario
+{
+  const char *dir;
+  struct ts_profile *profile;
+  int length;                   /* longest trace */
+  int ntraces;
+  struct bench_trace traces[BENCH_TRACES_MAX];
+};
+
+struct bench_result
+{
+  unsigned long events;
+  unsigned long allocs;
+  uint64_t elapsed_ns;
+  unsigned long nlatency;
+  unsigned long maxlatency;
+  uint32_t *latency;            /* ns, one per action */
+};
+
+static struct ts_engine_app g_app;
+
+static uint64_t
+timespec_diff_ns (const struct timespec *start, const struct timespec *end)
+{
+  return (uint64_t)(end->tv_sec - start->tv_sec) * 1000000000ULL +
+         end->tv_nsec - start->tv_nsec;
+}
+
+static char *
+read_file (const char *dir, const char *name)
+{
+  char path[PATH_MAX];
+  char *buf;
+  FILE *fp;
+  long len;
+
+  snprintf (path, sizeof(path), "%s/%s", dir, name);
+
+  fp = fopen (path, "rb");
+  if (!fp)
+    {
+      fprintf (stderr, "%s: cannot open\n", path);
+      return NULL;
+    }
+
+  fseek (fp, 0, SEEK_END);
+  len = ftell (fp);
+  fseek (fp, 0, SEEK_SET);
+
+  buf = malloc (len + 1);
+  if (buf && fread (buf, 1, len, fp) != len)
+    {
+      free (buf);
+      buf = NULL;
+    }
+
+  fclose (fp);
+
+  if (buf)
+    {
+      buf[len] = '\0';
+    }
+
+  return buf;
+}
+
+static int
+load_profile (struct bench_scenario *sc)
+{
+  char path[PATH_MAX];
+  int errcode = 0;
+  int fd;
+
+  snprintf (path, sizeof(path), "%s/%s", sc->dir, PROFILE_JSON_FILENAME);
+
+  fd = open (path, O_RDONLY);
+  if (fd < 0)
+    {
+      fprintf (stderr, "%s: cannot open\n", path);
+      return ERROR;
+    }
+
+  sc->profile = profile_parse_fd (fd, &errcode);
+  close (fd);
+
+  if (!sc->profile)
+    {
+      fprintf (stderr, "%s: parse failed: %d\n", path, errcode);
+      return ERROR;
+    }
+
+  return OK;
+}
+
+static int
+load_traces (struct bench_scenario *sc)
+{
+  struct bench_trace *trace;
+  cJSON *json;
+  cJSON *item;
+  char *str;
+  int i;
+
+  str = read_file (sc->dir, VALUES_JSON_FILENAME);
+  if (!str)
+    {
+      return ERROR;
+    }
+
+  json = cJSON_Parse (str);
+  free (str);
+  if (!json)
+    {
+      fprintf (stderr, "%s/%s: parse failed\n", sc->dir, VALUES_JSON_FILENAME);
+      return ERROR;
+    }
+
+  sc->ntraces = 0;
+  sc->length = 0;
+
+  for (item = cJSON_child (json); item; item = cJSON_next (item))
+    {
+      if (sc->ntraces == BENCH_TRACES_MAX)
+        {
+          fprintf (stderr, "%s: too many traces\n", sc->dir);
+          break;
+        }
+
+      trace = &sc->traces[sc->ntraces++];
+      trace->sId = strtoul (cJSON_name (item), NULL, 16);
+      trace->count = cJSON_GetArraySize (item);
+      trace->values = malloc (trace->count * sizeof(double));
+      if (!trace->values)
+        {
+          cJSON_Delete (json);
+          return ERROR;
+        }
+
+      for (i = 0; i < trace->count; i++)
+        {
+          trace->values[i] = cJSON_double (cJSON_GetArrayItem (item, i));
+        }
+
+      if (trace->count > sc->length)
+        {
+          sc->length = trace->count;
+        }
+    }
+
+  cJSON_Delete (json);
+  return OK;
+}
+
+static void
+free_scenario (struct bench_scenario *sc)
+{
+  int i;
+
+  for (i = 0; i < sc->ntraces; i++)
+    {
+      free (sc->traces[i].values);
+    }
+
+  if (sc->profile)
+    {
+      profile_free (sc->profile);
+    }
+}
+
+static int
+collect_state_causes (struct ts_state *state, sense_id_t sId,
+                      struct ts_cause **causes, int n)
+{
+  sq_entry_t *entry;
+  struct ts_cause *cause;
+
+  for (entry = sq_peek (&state->dyn.active_causes);
+       entry && n < BENCH_CAUSES_MAX; entry = sq_next (entry))
+    {
+      cause = container_of(entry, struct ts_cause, active_entry);
+      if (cause->dyn.sense_value.sId == sId)
+        {
+          causes[n++] = cause;
+        }
+    }
+
+  return n;
+}
+
+/* Causes are collected up front: handling one may re-add causes to the
+ * active list, or replace it altogether on state change.
+ */
+
+static int
+collect_causes (struct ts_engine *engine, sense_id_t sId,
+                struct ts_cause **causes)
+{
+  struct ts_global_state *global_state;
+  int n;
+
+  n = collect_state_causes (engine->current_state, sId, causes, 0);
+
+  global_state = (struct ts_global_state *) sq_peek(&engine->global_states);
+
+  while (global_state)
+    {
+      n = collect_state_causes (global_state->state, sId, causes, n);
+      global_state = (struct ts_global_state *) sq_next(&global_state->entry);
+    }
+
+  return n;
+}
+
+static void
+replay_sample (struct ts_engine *engine, sense_id_t sId, double value,
+               struct bench_result *res)
+{
+  struct ts_cause *causes[BENCH_CAUSES_MAX];
+  struct timespec start;
+  struct timespec end;
+  unsigned long allocs;
+  unsigned long actions;
+  bool state_changed;
+  int ncauses;
+  int i;
+
+  ncauses = collect_causes (engine, sId, causes);
+
+  for (i = 0; i < ncauses; i++)
+    {
+      causes[i]->dyn.sense_value.value.valuetype = VALUEDOUBLE;
+      causes[i]->dyn.sense_value.value.valuedouble = value;
+
+      g_bench.action_seen = false;
+      allocs = g_bench.allocs;
+      actions = g_bench.actions;
+
+      clock_gettime (CLOCK_MONOTONIC, &start);
+      state_changed = handle_cause_event (causes[i], NULL);
+      clock_gettime (CLOCK_MONOTONIC, &end);
+
+      res->events++;
+      res->allocs += g_bench.allocs - allocs;
+      res->elapsed_ns += timespec_diff_ns (&start, &end);
+
+      if ((g_bench.actions != actions || state_changed) &&
+          res->nlatency < res->maxlatency)
+        {
+          res->latency[res->nlatency++] = timespec_diff_ns (&start,
+              g_bench.action_seen ? &g_bench.action_ts : &end);
+        }
+
+      if (state_changed)
+        {
+          return;
+        }
+    }
+}
+
+static int
+replay_scenario (struct bench_scenario *sc, int rounds,
+                 struct bench_result *res)
+{
+  struct ts_engine *engine;
+  struct bench_trace *trace;
+  int round;
+  int i;
+  int t;
+
+  /* Each sample may at most fire once per active cause. */
+
+  res->maxlatency = (unsigned long)rounds * sc->length * sc->ntraces;
+  res->latency = malloc (res->maxlatency * sizeof(uint32_t) + 1);
+  if (!res->latency)
+    {
+      return ERROR;
+    }
+
+  for (round = 0; round < rounds; round++)
+    {
+      engine = profile_main (&g_app, sc->profile);
+      if (!engine)
+        {
+          fprintf (stderr, "%s: profile_main failed\n", sc->dir);
+          return ERROR;
+        }
+
+      for (i = 0; i < sc->length; i++)
+        {
+          for (t = 0; t < sc->ntraces; t++)
+            {
+              trace = &sc->traces[t];
+              if (i < trace->count)
+                {
+                  replay_sample (engine, trace->sId, trace->values[i], res);
+                }
+            }
+        }
+
+      (void)profile_stop (engine, true, false);
+    }
+
+  return OK;
+}
+
+static int
+compare_u32 (const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+static uint32_t
+percentile (const struct bench_result *res, int pct)
+{
+  if (!res->nlatency)
+    {
+      return 0;
+    }
+
+  return res->latency[(res->nlatency - 1) * pct / 100];
+}
+
+static void
+report (const char *name, struct bench_result *res)
+{
+  double secs = res->elapsed_ns / 1e9;
+
+  qsort (res->latency, res->nlatency, sizeof(uint32_t), compare_u32);
+
+  printf ("%-24s %10lu %12.0f %8.2f %8lu %8u %8u\n", name, res->events,
+          secs > 0 ? res->events / secs : 0.0,
+          res->events ? (double)res->allocs / res->events : 0.0,
+          res->nlatency, percentile (res, 50), percentile (res, 99));
+}
+
+static void
+usage (const char *progname)
+{
+  fprintf (stderr, "usage: %s [-n rounds] <scenario dir>...\n", progname);
+}
+
+int
+main (int argc, char **argv)
+{
+  struct bench_scenario sc;
+  struct bench_result res;
+  const char *name;
+  int rounds = BENCH_DEFAULT_ROUNDS;
+  int status = EXIT_SUCCESS;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "n:")) != -1)
+    {
+      switch (opt)
+        {
+          case 'n':
+            rounds = atoi (optarg);
+            break;
+          default:
+            usage (argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+  if (optind >= argc || rounds <= 0)
+    {
+      usage (argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  printf ("%-24s %10s %12s %8s %8s %8s %8s\n", "scenario", "events",
+          "events/s", "allocs", "actions", "p50 ns", "p99 ns");
+
+  for (; optind < argc; optind++)
+    {
+      memset (&sc, 0, sizeof(sc));
+      memset (&res, 0, sizeof(res));
+      sc.dir = argv[optind];
+
+      name = strrchr (sc.dir, '/');
+      name = (name && name[1]) ? name + 1 : sc.dir;
+
+      if (load_profile (&sc) != OK || load_traces (&sc) != OK ||
+          replay_scenario (&sc, rounds, &res) != OK)
+        {
+          status = EXIT_FAILURE;
+        }
+      else
+        {
+          report (name, &res);
+        }
+
+      free (res.latency);
+      free_scenario (&sc);
+    }
+
+  return status;
+}
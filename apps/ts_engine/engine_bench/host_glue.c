@@ -0,0 +1,196 @@
+/****************************************************************************
+ * apps/ts_engine/engine_bench/host_glue.c
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+/* Platform services the engine expects from the rest of the firmware.
+ * Sensor drivers, timers and connectors are out of the picture: the replay
+ * loop delivers values straight to handle_cause_event(). Log payloads are
+ * encoded to memory so their cost stays in the measurement and counted as
+ * actions.
+ */
+
+#include <nuttx/config.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <apps/thingsee/ts_core.h>
+#include <arch/board/board.h>
+
+#include "bench.h"
+#include "../engine/parse.h"
+#include "../engine/sense.h"
+#include "../engine/log.h"
+#include "../engine/log_record.h"
+#include "../engine/connector.h"
+#include "../engine/cloud_property.h"
+
+struct bench_counters g_bench;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+  g_bench.allocs++;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+  g_bench.allocs++;
+  return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+  g_bench.allocs++;
+  return __real_realloc(ptr, size);
+}
+
+/* Senses the simtest traces use. Like in the simulator they all report
+ * doubles and have no driver behind them.
+ */
+
+static const struct ts_sense_info g_sense_info[] =
+{
+  { .sId = SENSE_ID_LATITUDE, .name = "latitude",
+    .min = { .valuetype = VALUEDOUBLE }, .max = { .valuetype = VALUEDOUBLE } },
+  { .sId = SENSE_ID_LONGITUDE, .name = "longitude",
+    .min = { .valuetype = VALUEDOUBLE }, .max = { .valuetype = VALUEDOUBLE } },
+  { .sId = SENSE_ID_TEMPERATURE, .name = "temperature",
+    .min = { .valuetype = VALUEDOUBLE }, .max = { .valuetype = VALUEDOUBLE } },
+  { .sId = SENSE_ID_HUMIDITY, .name = "humidity",
+    .min = { .valuetype = VALUEDOUBLE }, .max = { .valuetype = VALUEDOUBLE } },
+  { .sId = SENSE_ID_AMBIENT_LIGHT, .name = "ambient_light",
+    .min = { .valuetype = VALUEDOUBLE }, .max = { .valuetype = VALUEDOUBLE } },
+  { .sId = SENSE_ID_PRESSURE, .name = "pressure",
+    .min = { .valuetype = VALUEDOUBLE }, .max = { .valuetype = VALUEDOUBLE } },
+};
+
+const struct ts_sense_info *get_sense_info(sense_id_t sense_id)
+{
+  int i;
+
+  for (i = 0; i < sizeof(g_sense_info) / sizeof(g_sense_info[0]); i++)
+    {
+      if (g_sense_info[i].sId == sense_id)
+        {
+          return &g_sense_info[i];
+        }
+    }
+
+  return NULL;
+}
+
+int engine_cause_request_value(struct ts_cause *cause)
+{
+  cause->dyn.sense_value.value.valuetype = VALUEDOUBLE;
+  return OK;
+}
+
+void __ts_engine_log_payload(struct ts_payload *payload, enum logtypes type)
+{
+  static uint8_t buf[512];
+
+  if (type == LOG_EVENTS)
+    {
+      if (!g_bench.action_seen)
+        {
+          clock_gettime(CLOCK_MONOTONIC, &g_bench.action_ts);
+          g_bench.action_seen = true;
+        }
+
+      g_bench.actions++;
+    }
+
+  (void)__ts_engine_log_record_encode(payload, buf, sizeof(buf));
+}
+
+bool __ts_engine_log_have_logs(void)
+{
+  return false;
+}
+
+int __ts_engine_log_start(struct send_log **handle, bool multisend,
+                          struct url * const url)
+{
+  return ERROR;
+}
+
+int ts_engine_select_connector(const uint32_t connector_idx,
+                               const struct ts_connector **con)
+{
+  return ERROR;
+}
+
+int __ts_engine_cancel_connection(void)
+{
+  return OK;
+}
+
+int __ts_core_timer_stop(const int timer_id)
+{
+  return OK;
+}
+
+int ts_core_fd_unregister(const int fd)
+{
+  return OK;
+}
+
+uint32_t cloud_property_sms(const char *key, uint32_t default_val)
+{
+  return default_val;
+}
+
+void board_rtc_save_value(uint32_t value, uint32_t index)
+{
+}
+
+uint32_t board_rtc_read_value(uint32_t index)
+{
+  return 0;
+}
+
+int *get_errno_ptr(void)
+{
+  return &errno;
+}
+
+void up_assert(const uint8_t *filename, int lineno)
+{
+  fprintf(stderr, "up_assert at %s:%d\n", filename, lineno);
+  abort();
+}
@@ -0,0 +1,98 @@
+/****************************************************************************
+ * apps/ts_engine/engine_gtest/arena_test.cc
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+
+#include <string.h>
+#include "gtest/gtest.h"
+
+extern "C" {
+#include <nuttx/config.h>
+#include "arena.h"
+}
+
+TEST(Arena, AlignedZeroedAllocations)
+{
+  struct ts_arena arena;
+  uint8_t *a;
+  uint8_t *b;
+  int i;
+
+  ASSERT_EQ(OK, __ts_engine_arena_init(&arena, 64));
+
+  a = (uint8_t *)__ts_engine_arena_alloc(&arena, 3);
+  b = (uint8_t *)__ts_engine_arena_alloc(&arena, 16);
+  ASSERT_TRUE(a != NULL);
+  ASSERT_TRUE(b != NULL);
+
+  EXPECT_EQ(0u, (uintptr_t)b % ARENA_ALIGN);
+  EXPECT_EQ(ARENA_SIZE(3) + ARENA_SIZE(16), arena.used);
+
+  for (i = 0; i < 16; i++)
+    {
+      EXPECT_EQ(0, b[i]);
+    }
+
+  __ts_engine_arena_release(&arena);
+  EXPECT_TRUE(arena.base == NULL);
+}
+
+TEST(Arena, Exhausted)
+{
+  struct ts_arena arena;
+
+  ASSERT_EQ(OK, __ts_engine_arena_init(&arena, 32));
+
+  EXPECT_TRUE(__ts_engine_arena_alloc(&arena, 24) != NULL);
+  EXPECT_TRUE(__ts_engine_arena_alloc(&arena, 16) == NULL);
+  EXPECT_TRUE(__ts_engine_arena_alloc(&arena, 8) != NULL);
+  EXPECT_TRUE(__ts_engine_arena_alloc(&arena, 1) == NULL);
+
+  __ts_engine_arena_release(&arena);
+}
+
+TEST(Arena, Strdup)
+{
+  struct ts_arena arena;
+  char *str;
+
+  ASSERT_EQ(OK, __ts_engine_arena_init(&arena, 32));
+
+  str = __ts_engine_arena_strdup(&arena, "profile");
+  ASSERT_TRUE(str != NULL);
+  EXPECT_STREQ("profile", str);
+  EXPECT_TRUE(__ts_engine_arena_strdup(&arena, NULL) == NULL);
+  EXPECT_TRUE(__ts_engine_arena_strdup(&arena,
+      "longer than what is left in the arena") == NULL);
+
+  __ts_engine_arena_release(&arena);
+}
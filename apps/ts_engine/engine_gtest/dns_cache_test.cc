@@ -0,0 +1,286 @@
+/****************************************************************************
+ * apps/ts_engine/engine_gtest/dns_cache_test.cc
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <map>
+#include <string>
+#include "gtest/gtest.h"
+
+extern "C" {
+#include <nuttx/config.h>
+#include <apps/netutils/dnsclient.h>
+#include "connectors/conn_comm_dns.h"
+}
+
+/* Fake resolver: names map to address and TTL, names not in map do not
+ * exist, and 'g_dns_down' makes lookups time out. CLOCK_MONOTONIC is
+ * advanced by 'g_clock_offset' to step over TTLs and deep-sleeps. */
+
+struct fake_name
+{
+  in_addr_t addr;
+  uint32_t ttl;
+};
+
+static std::map<std::string, fake_name> g_names;
+static bool g_dns_down;
+static int g_lookups;
+static int g_parallel_calls;
+static time_t g_clock_offset;
+
+extern "C" int __real_clock_gettime(clockid_t clk, struct timespec *ts);
+
+extern "C" int __wrap_clock_gettime(clockid_t clk, struct timespec *ts)
+{
+  int ret = __real_clock_gettime(clk, ts);
+
+  if (clk == CLOCK_MONOTONIC)
+    {
+      ts->tv_sec += g_clock_offset;
+    }
+
+  return ret;
+}
+
+static int fake_lookup(const char *hostname, in_addr_t *addr, uint32_t *ttl)
+{
+  g_lookups++;
+
+  if (g_dns_down)
+    {
+      return -ETIMEDOUT;
+    }
+
+  auto it = g_names.find(hostname);
+  if (it == g_names.end())
+    {
+      return -ENOENT;
+    }
+
+  *addr = it->second.addr;
+  *ttl = it->second.ttl;
+  return OK;
+}
+
+extern "C" int dns_gethostip_multi_ttl(const char *hostname, in_addr_t *ipaddr,
+                                       size_t nipaddr, uint32_t *ttl)
+{
+  int ret = fake_lookup(hostname, ipaddr, ttl);
+
+  if (ret < 0)
+    {
+      errno = -ret;
+      return ERROR;
+    }
+
+  return 1;
+}
+
+extern "C" int dns_gethostip_parallel(struct dns_lookup_s *lookups,
+                                      size_t nlookups)
+{
+  int nresolved = 0;
+  size_t i;
+
+  g_parallel_calls++;
+
+  for (i = 0; i < nlookups; i++)
+    {
+      lookups[i].result = fake_lookup(lookups[i].hostname, &lookups[i].ipaddr,
+                                      &lookups[i].ttl);
+      if (lookups[i].result == OK)
+        {
+          nresolved++;
+        }
+    }
+
+  return nresolved;
+}
+
+class DnsCache : public ::testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    conn_comm_dns_flush();
+    g_names.clear();
+    g_names["a.example"] = { 0x0100000a, 300 };
+    g_names["b.example"] = { 0x0200000a, 5 };
+    g_dns_down = false;
+    g_lookups = 0;
+    g_parallel_calls = 0;
+    g_clock_offset = 0;
+  }
+
+  in_addr_t Resolve(const char *hostname)
+  {
+    in_addr_t addr = 0;
+
+    if (conn_comm_dns_resolve(hostname, &addr) != OK)
+      {
+        return 0;
+      }
+
+    return addr;
+  }
+};
+
+TEST_F(DnsCache, HonoursTtl)
+{
+  EXPECT_EQ(0x0100000au, Resolve("a.example"));
+  EXPECT_EQ(0x0100000au, Resolve("a.example"));
+  EXPECT_EQ(1, g_lookups);
+
+  /* Long sleep over the TTL. */
+
+  g_clock_offset += 301;
+  g_names["a.example"].addr = 0x0300000a;
+  EXPECT_EQ(0x0300000au, Resolve("a.example"));
+  EXPECT_EQ(2, g_lookups);
+}
+
+TEST_F(DnsCache, ClampsShortTtl)
+{
+  EXPECT_EQ(0x0200000au, Resolve("b.example"));
+
+  g_clock_offset += CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_MIN_TTL - 1;
+  EXPECT_EQ(0x0200000au, Resolve("b.example"));
+  EXPECT_EQ(1, g_lookups);
+
+  g_clock_offset += 1;
+  EXPECT_EQ(0x0200000au, Resolve("b.example"));
+  EXPECT_EQ(2, g_lookups);
+}
+
+TEST_F(DnsCache, CachesNonExistentName)
+{
+  in_addr_t addr;
+
+  EXPECT_EQ(ERROR, conn_comm_dns_resolve("nx.example", &addr));
+  EXPECT_EQ(ENOENT, errno);
+  EXPECT_EQ(ERROR, conn_comm_dns_resolve("nx.example", &addr));
+  EXPECT_EQ(ENOENT, errno);
+  EXPECT_EQ(1, g_lookups);
+
+  g_clock_offset += CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_NEGATIVE_TTL;
+  g_names["nx.example"] = { 0x0400000a, 300 };
+  EXPECT_EQ(0x0400000au, Resolve("nx.example"));
+  EXPECT_EQ(2, g_lookups);
+}
+
+TEST_F(DnsCache, DoesNotCacheTimeout)
+{
+  g_dns_down = true;
+  EXPECT_EQ(0u, Resolve("a.example"));
+  EXPECT_EQ(0u, Resolve("a.example"));
+  EXPECT_EQ(2, g_lookups);
+
+  g_dns_down = false;
+  EXPECT_EQ(0x0100000au, Resolve("a.example"));
+}
+
+TEST_F(DnsCache, UsesLastKnownAddressWhenLookupFails)
+{
+  EXPECT_EQ(0x0100000au, Resolve("a.example"));
+
+  g_clock_offset += 301;
+  g_dns_down = true;
+  EXPECT_EQ(0x0100000au, Resolve("a.example"));
+  EXPECT_EQ(2, g_lookups);
+}
+
+TEST_F(DnsCache, InvalidateForcesLookup)
+{
+  EXPECT_EQ(0x0100000au, Resolve("a.example"));
+
+  g_names["a.example"].addr = 0x0500000a;
+  conn_comm_dns_invalidate("a.example");
+  EXPECT_EQ(0x0500000au, Resolve("a.example"));
+  EXPECT_EQ(2, g_lookups);
+}
+
+TEST_F(DnsCache, PrewarmLooksUpExpiredNamesTogether)
+{
+  in_addr_t addr;
+
+  EXPECT_EQ(1, conn_comm_dns_prewarm("a.example"));
+  EXPECT_EQ(1, g_parallel_calls);
+  EXPECT_EQ(1, g_lookups);
+
+  /* Names used by other requests end up in cache as well. */
+
+  EXPECT_EQ(0x0200000au, Resolve("b.example"));
+  EXPECT_EQ(ERROR, conn_comm_dns_resolve("nx.example", &addr));
+  EXPECT_EQ(3, g_lookups);
+
+  /* Everything is cached, including non-existent name. */
+
+  EXPECT_EQ(0, conn_comm_dns_prewarm("a.example"));
+  EXPECT_EQ(0x0100000au, Resolve("a.example"));
+  EXPECT_EQ(3, g_lookups);
+
+  /* After wake-up, expired ones are looked up in one go. */
+
+  g_clock_offset += CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_NEGATIVE_TTL +
+                    CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_MIN_TTL;
+  EXPECT_EQ(1, conn_comm_dns_prewarm("a.example"));
+  EXPECT_EQ(2, g_parallel_calls);
+  EXPECT_EQ(5, g_lookups);
+}
+
+TEST_F(DnsCache, EvictsLeastRecentlyUsed)
+{
+  char name[16];
+  int i;
+
+  for (i = 0; i < CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_ENTRIES; i++)
+    {
+      snprintf(name, sizeof(name), "h%d.example", i);
+      g_names[name] = { (in_addr_t)(i + 1), 300 };
+      EXPECT_EQ((in_addr_t)(i + 1), Resolve(name));
+      g_clock_offset++;
+    }
+
+  /* Use first one, so that second is the least recently used. */
+
+  EXPECT_EQ(1u, Resolve("h0.example"));
+  EXPECT_EQ(0x0100000au, Resolve("a.example"));
+  EXPECT_EQ(CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_ENTRIES + 1, g_lookups);
+
+  EXPECT_EQ(1u, Resolve("h0.example"));
+  EXPECT_EQ(CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_ENTRIES + 1, g_lookups);
+  EXPECT_EQ(2u, Resolve("h1.example"));
+  EXPECT_EQ(CONFIG_THINGSEE_CONNECTORS_DNS_CACHE_ENTRIES + 2, g_lookups);
+}
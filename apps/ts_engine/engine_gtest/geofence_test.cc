@@ -0,0 +1,340 @@
+/****************************************************************************
+ * apps/ts_engine/engine_gtest/geofence_test.cc
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+#include "gtest/gtest.h"
+
+extern "C" {
+#include <nuttx/config.h>
+#include "geofence.h"
+}
+
+static double now_sec(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Plain ray cast over every edge, as before indexing */
+
+static bool ray_cast(const struct point *test, const struct poly *poly)
+{
+  int i;
+  int j;
+  bool in = false;
+
+  for (i = 0, j = poly->number_of_points - 1; i < poly->number_of_points;
+       j = i++)
+    {
+      if (((poly->points[i].y > test->y) != (poly->points[j].y > test->y))
+          && (test->x
+              < (poly->points[j].x - poly->points[i].x)
+                  * (test->y - poly->points[i].y)
+                  / (poly->points[j].y - poly->points[i].y) + poly->points[i].x))
+        {
+          in = !in;
+        }
+    }
+
+  return in;
+}
+
+class Geofence : public testing::Test
+{
+protected:
+  virtual void TearDown()
+  {
+    for (size_t i = 0; i < polys.size(); i++)
+      {
+        free(polys[i]);
+      }
+  }
+
+  struct poly *MakePoly(const std::vector<struct point> &points)
+  {
+    struct poly *poly;
+
+    poly = (struct poly *)calloc(1, GEOFENCE_POLY_SIZE(points.size()));
+    for (size_t i = 0; i < points.size(); i++)
+      {
+        poly->points[i] = points[i];
+      }
+
+    geofence_init_poly(poly, points.size());
+    polys.push_back(poly);
+    return poly;
+  }
+
+  /* Jagged star-shaped polygon around (cx, cy), like a traced boundary */
+
+  struct poly *MakeStar(double cx, double cy, double radius, int n)
+  {
+    std::vector<struct point> points(n);
+
+    for (int i = 0; i < n; i++)
+      {
+        double a = 2 * M_PI * i / n;
+        double r = radius * (0.5 + 0.5 * (double)rand() / RAND_MAX);
+
+        points[i].x = cx + r * cos(a);
+        points[i].y = cy + r * sin(a);
+      }
+
+    return MakePoly(points);
+  }
+
+  struct point RandomPoint(double x0, double y0, double x1, double y1)
+  {
+    struct point p;
+
+    p.x = x0 + (x1 - x0) * rand() / RAND_MAX;
+    p.y = y0 + (y1 - y0) * rand() / RAND_MAX;
+    return p;
+  }
+
+  std::vector<struct poly *> polys;
+};
+
+TEST_F(Geofence, SmallPolygon)
+{
+  std::vector<struct point> square = { {0, 0}, {10, 0}, {10, 10}, {0, 10} };
+  struct poly *poly = MakePoly(square);
+  struct point in = { 5, 5 };
+  struct point out = { 15, 5 };
+
+  EXPECT_EQ(0, poly->number_of_slabs);
+  EXPECT_EQ(0, poly->bbox.min_x);
+  EXPECT_EQ(10, poly->bbox.max_y);
+  EXPECT_TRUE(point_in_polygon(&in, poly));
+  EXPECT_FALSE(point_in_polygon(&out, poly));
+}
+
+TEST_F(Geofence, FlatPolygonNeverMatches)
+{
+  std::vector<struct point> line;
+  struct point test = { 5, 1 };
+
+  for (int i = 0; i < 32; i++)
+    {
+      line.push_back({ (double)i, 1 });
+    }
+
+  EXPECT_FALSE(point_in_polygon(&test, MakePoly(line)));
+}
+
+TEST_F(Geofence, IndexMatchesRayCast)
+{
+  srand(1);
+
+  for (int n = 3; n <= 1024; n *= 2)
+    {
+      struct poly *poly = MakeStar(60.17, 24.94, 0.05, n);
+
+      if (n >= GEOFENCE_MIN_INDEXED_POINTS)
+        {
+          EXPECT_EQ(n / GEOFENCE_EDGES_PER_SLAB, poly->number_of_slabs);
+        }
+
+      for (int i = 0; i < 2000; i++)
+        {
+          struct point p = RandomPoint(60.1, 24.87, 60.24, 25.01);
+
+          ASSERT_EQ(ray_cast(&p, poly), point_in_polygon(&p, poly))
+              << n << " points, " << p.x << "," << p.y;
+        }
+
+      /* Vertices, where edges of neighbouring slabs meet */
+
+      for (int i = 0; i < n; i++)
+        {
+          ASSERT_EQ(ray_cast(&poly->points[i], poly),
+                    point_in_polygon(&poly->points[i], poly));
+        }
+    }
+}
+
+TEST_F(Geofence, LongEdgesAcrossSlabs)
+{
+  std::vector<struct point> comb;
+
+  /* Teeth pointing up from a long base: the two edges of the base span
+   * the whole polygon height */
+
+  comb.push_back({ 0, 0 });
+  for (int i = 0; i < 40; i++)
+    {
+      comb.push_back({ 1 + i * 1.0, 100 });
+      comb.push_back({ 1.5 + i * 1.0, 1 });
+    }
+  comb.push_back({ 41, 0 });
+
+  struct poly *poly = MakePoly(comb);
+
+  srand(2);
+  for (int i = 0; i < 5000; i++)
+    {
+      struct point p = RandomPoint(-1, -1, 42, 101);
+
+      ASSERT_EQ(ray_cast(&p, poly), point_in_polygon(&p, poly));
+    }
+}
+
+TEST_F(Geofence, SetQueryFindsAllContaining)
+{
+  struct poly *fences[4];
+  struct geofence_set set = {};
+  uint16_t hits[4];
+  uint16_t one;
+  struct point center = { 0, 0 };
+  struct point edge = { 0, 7 };
+  struct point far = { 100, 100 };
+
+  srand(3);
+  fences[0] = MakeStar(0, 0, 4, 64);    /* Radius 2..4 */
+  fences[1] = MakeStar(0, 0, 20, 200);  /* Radius 10..20 */
+  fences[2] = MakeStar(50, 50, 5, 8);
+  fences[3] = MakeStar(0, 0, 16, 500);  /* Radius 8..16 */
+
+  set.number_of_fences = 4;
+  set.fences = fences;
+
+  ASSERT_EQ(3, geofence_set_query(&set, &center, hits, 4));
+  EXPECT_EQ(0, hits[0]);
+  EXPECT_EQ(1, hits[1]);
+  EXPECT_EQ(3, hits[2]);
+
+  ASSERT_EQ(2, geofence_set_query(&set, &edge, hits, 4));
+  EXPECT_EQ(1, hits[0]);
+  EXPECT_EQ(3, hits[1]);
+
+  /* Count is returned even if not all hits fit */
+
+  EXPECT_EQ(3, geofence_set_query(&set, &center, &one, 1));
+  EXPECT_EQ(0, one);
+
+  EXPECT_EQ(0, geofence_set_query(&set, &far, hits, 4));
+}
+
+TEST_F(Geofence, SetContainsSharesQuery)
+{
+  struct poly *fences[2];
+  struct geofence_set set = {};
+  uint16_t hits[2];
+  struct point in_both = { 0, 0 };
+  struct point in_outer = { 0, 15 };
+
+  srand(4);
+  fences[0] = MakeStar(0, 0, 4, 64);
+  fences[1] = MakeStar(0, 0, 40, 64);
+  fences[0]->fence_id = 0;
+  fences[1]->fence_id = 1;
+
+  set.number_of_fences = 2;
+  set.fences = fences;
+  set.hits = hits;
+
+  EXPECT_TRUE(geofence_set_contains(&set, &in_both, fences[0]));
+  EXPECT_EQ(2, set.number_of_hits);
+  EXPECT_TRUE(geofence_set_contains(&set, &in_both, fences[1]));
+
+  EXPECT_TRUE(geofence_set_contains(&set, &in_outer, fences[1]));
+  EXPECT_EQ(1, set.number_of_hits);
+  EXPECT_FALSE(geofence_set_contains(&set, &in_outer, fences[0]));
+}
+
+TEST_F(Geofence, Benchmark)
+{
+  const int nfences = 32;
+  const int npoints = 512;
+  const int nqueries = 5000;
+  std::vector<struct poly *> fences;
+  std::vector<struct point> queries;
+  std::vector<uint16_t> hits(nfences);
+  struct geofence_set set = {};
+  double start;
+  double plain_time;
+  double index_time;
+  long plain_hits = 0;
+  long index_hits = 0;
+
+  /* Overlapping detailed fences over a city sized area */
+
+  srand(5);
+  for (int i = 0; i < nfences; i++)
+    {
+      fences.push_back(MakeStar(60.1 + 0.01 * (i % 8), 24.9 + 0.01 * (i / 8),
+                                0.02, npoints));
+    }
+
+  for (int i = 0; i < nqueries; i++)
+    {
+      queries.push_back(RandomPoint(60.05, 24.85, 60.2, 25.0));
+    }
+
+  set.number_of_fences = nfences;
+  set.fences = &fences[0];
+
+  start = now_sec();
+  for (int q = 0; q < nqueries; q++)
+    {
+      for (int i = 0; i < nfences; i++)
+        {
+          plain_hits += ray_cast(&queries[q], fences[i]);
+        }
+    }
+  plain_time = now_sec() - start;
+
+  start = now_sec();
+  for (int q = 0; q < nqueries; q++)
+    {
+      index_hits += geofence_set_query(&set, &queries[q], &hits[0], nfences);
+    }
+  index_time = now_sec() - start;
+
+  EXPECT_EQ(plain_hits, index_hits);
+  EXPECT_GT(plain_hits, 0);
+  EXPECT_LT(index_time, plain_time);
+
+  printf("%d fences x %d points: ray cast %8.0f fixes/s, "
+         "indexed %8.0f fixes/s (%.1fx)\n", nfences, npoints,
+         nqueries / plain_time, nqueries / index_time,
+         plain_time / index_time);
+  RecordProperty("ray_cast_fixes_per_sec", (int)(nqueries / plain_time));
+  RecordProperty("indexed_fixes_per_sec", (int)(nqueries / index_time));
+}
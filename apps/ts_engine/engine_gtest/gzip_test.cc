@@ -0,0 +1,223 @@
+/****************************************************************************
+ * apps/ts_engine/engine_gtest/gzip_test.cc
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <zlib.h>
+#include "gtest/gtest.h"
+
+extern "C" {
+#include <nuttx/config.h>
+#include "log_record.h"
+#include "connectors/conn_gzip.h"
+#include "connectors/conn_payload.h"
+}
+
+#define BATCH_PAYLOADS 60
+
+static void append_putc(char c, void *priv)
+{
+  ((std::string *)priv)->push_back(c);
+}
+
+class Gzip : public testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    gz = (struct conn_gzip_s *)malloc(sizeof(*gz));
+  }
+
+  virtual void TearDown()
+  {
+    free(gz);
+  }
+
+  std::string Compress(const std::string &in)
+  {
+    std::string out;
+    size_t i;
+
+    conn_gzip_init(gz, append_putc, &out);
+    for (i = 0; i < in.size(); i++)
+      conn_gzip_putc(in[i], gz);
+    conn_gzip_finish(gz);
+    return out;
+  }
+
+  static uint32_t GetU32(const std::string &in, size_t pos)
+  {
+    return (uint8_t)in[pos] | ((uint8_t)in[pos + 1] << 8) |
+           ((uint8_t)in[pos + 2] << 16) |
+           ((uint32_t)(uint8_t)in[pos + 3] << 24);
+  }
+
+  /* Decompress with zlib. Raw inflate, as zlib's crc32() is shadowed by
+   * the NuttX one here; test Trailer checks the CRC instead.
+   */
+
+  static bool Inflate(const std::string &in, std::string &out)
+  {
+    z_stream strm;
+    char buf[1024];
+    int ret;
+
+    if (in.size() < 18 || in.compare(0, 4, "\x1f\x8b\x08\x00", 4))
+      return false;
+
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, -MAX_WBITS) != Z_OK)
+      return false;
+
+    strm.next_in = (Bytef *)in.data() + 10;
+    strm.avail_in = in.size() - 18;
+    out.clear();
+
+    do
+      {
+        strm.next_out = (Bytef *)buf;
+        strm.avail_out = sizeof(buf);
+        ret = inflate(&strm, Z_NO_FLUSH);
+        out.append(buf, sizeof(buf) - strm.avail_out);
+      }
+    while (ret == Z_OK);
+
+    inflateEnd(&strm);
+    return ret == Z_STREAM_END && strm.avail_in == 0 &&
+           GetU32(in, in.size() - 4) == (uint32_t)out.size();
+  }
+
+  void ExpectRoundTrip(const std::string &in)
+  {
+    std::string out;
+
+    ASSERT_TRUE(Inflate(Compress(in), out));
+    EXPECT_EQ(in, out);
+  }
+
+  struct conn_gzip_s *gz;
+};
+
+TEST_F(Gzip, RoundTrip)
+{
+  std::string data;
+  int i;
+
+  ExpectRoundTrip("");
+  ExpectRoundTrip("a");
+  ExpectRoundTrip("abcabcabcabcabcabcabcabc");
+  ExpectRoundTrip(std::string(100000, 'x'));
+
+  /* Incompressible, and longer than 2^16 to wrap positions. */
+
+  srand(1);
+  for (i = 0; i < 100000; i++)
+    data.push_back(rand());
+  ExpectRoundTrip(data);
+
+  /* Repeats at all distances. */
+
+  data.clear();
+  for (i = 0; i < 40000; i++)
+    data.push_back('a' + (rand() % 4) + (i % 7 ? 0 : 4));
+  ExpectRoundTrip(data);
+}
+
+TEST_F(Gzip, Trailer)
+{
+  std::string out;
+
+  out = Compress("123456789");
+  EXPECT_EQ(0xcbf43926u, GetU32(out, out.size() - 8));
+  EXPECT_EQ(9u, GetU32(out, out.size() - 4));
+
+  out = Compress("");
+  EXPECT_EQ(0u, GetU32(out, out.size() - 8));
+}
+
+TEST_F(Gzip, CompressesPayloadBatch)
+{
+  struct ts_payload *payload;
+  std::string records;
+  std::string json;
+  std::string out;
+  std::string gzip;
+  uint8_t buf[512];
+  int len;
+  int i;
+
+  payload = (struct ts_payload *)calloc(1, sizeof(*payload) +
+      3 * sizeof(struct ts_sense_value));
+  payload->state.pId = "5d4c1a4e-profile-id";
+  payload->state.puId = 1;
+  payload->state.stId = 2;
+  payload->number_of_senses = 3;
+  payload->senses[0].sId = 0x00060100;
+  payload->senses[0].value.valuetype = VALUEDOUBLE;
+  payload->senses[1].sId = 0x00060200;
+  payload->senses[1].value.valuetype = VALUEDOUBLE;
+  payload->senses[2].sId = 0x00030200;
+  payload->senses[2].value.valuetype = VALUEINT32;
+
+  for (i = 0; i < BATCH_PAYLOADS; i++)
+    {
+      payload->state.evId = i % 3;
+      payload->state.ts.tv_sec = 1450000000 + i * 600;
+      payload->state.ts.tv_nsec = (i * 7919 % 1000) * 1000000;
+      payload->senses[0].value.valuedouble = 21.5 + (i % 9) * 0.1;
+      payload->senses[1].value.valuedouble = 40.25 - (i % 5) * 0.5;
+      payload->senses[2].value.valueint32 = 1000 - i;
+      len = __ts_engine_log_record_encode(payload, buf, sizeof(buf));
+      ASSERT_GT(len, 0);
+      records.append((const char *)buf, len);
+    }
+
+  free(payload);
+
+  conn_gzip_init(gz, append_putc, &gzip);
+  ASSERT_EQ(OK, conn_payload_put_json((const uint8_t *)records.data(),
+                                      records.size(), conn_gzip_putc, gz));
+  conn_gzip_finish(gz);
+
+  ASSERT_EQ(OK, conn_payload_put_json((const uint8_t *)records.data(),
+                                      records.size(), append_putc, &json));
+  ASSERT_TRUE(Inflate(gzip, out));
+  EXPECT_EQ(json, out);
+
+  printf("batch of %d payloads: JSON %zu bytes, gzip %zu bytes (%.1fx)\n",
+         BATCH_PAYLOADS, json.size(), gzip.size(),
+         (double)json.size() / gzip.size());
+  EXPECT_GE(json.size(), 3 * gzip.size());
+}
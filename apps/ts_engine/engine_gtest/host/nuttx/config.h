@@ -0,0 +1,62 @@
+/****************************************************************************
+ * apps/ts_engine/engine_gtest/host/nuttx/config.h
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+/* Minimal stand-in for the generated NuttX configuration when compiling
+ * engine sources for the host.
+ */
+
+#ifndef __APPS_TS_ENGINE_ENGINE_GTEST_HOST_NUTTX_CONFIG_H
+#define __APPS_TS_ENGINE_ENGINE_GTEST_HOST_NUTTX_CONFIG_H
+
+#include <assert.h>
+#include <stdint.h>
+
+#ifndef DEBUGASSERT
+#  define DEBUGASSERT(f) assert(f)
+#endif
+
+#ifndef ASSERT
+#  define ASSERT(f) assert(f)
+#endif
+
+typedef uint8_t pollevent_t;
+
+/* cJSON */
+
+#define CONFIG_MM_REGIONS 1
+
+#ifndef packed_struct
+#  define packed_struct __attribute__((packed))
+#endif
+
+#endif
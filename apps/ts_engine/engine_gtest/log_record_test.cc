@@ -0,0 +1,348 @@
+/****************************************************************************
+ * apps/ts_engine/engine_gtest/log_record_test.cc
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <string>
+#include "gtest/gtest.h"
+
+extern "C" {
+#include <nuttx/config.h>
+#include "log_record.h"
+}
+
+#define BENCH_RECORDS 5000
+
+static double now_sec(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+class LogRecord : public testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    char name[] = "/tmp/ts_log_XXXXXX";
+
+    fd = mkstemp(name);
+    ASSERT_GE(fd, 0);
+    unlink(name);
+
+    payload = (struct ts_payload *)calloc(1, sizeof(*payload) +
+        4 * sizeof(struct ts_sense_value));
+
+    items[0].valuetype = VALUEDOUBLE;
+    items[0].valuedouble = 1.5;
+    items[1].valuetype = VALUEDOUBLE;
+    items[1].valuedouble = -2.25;
+
+    payload->state.pId = "profile-id";
+    payload->state.puId = 1;
+    payload->state.stId = 2;
+    payload->state.evId = 3;
+    payload->state.ts.tv_sec = 1450000000;
+    payload->state.ts.tv_nsec = 123;
+    payload->number_of_senses = 4;
+
+    SetSense(0, 0x00060100, "temperature", 21.5);
+    SetSense(1, 0x00060200, "humidity", 40.25);
+
+    payload->senses[2].sId = 0x00020300;
+    payload->senses[2].name = "battery";
+    payload->senses[2].value.valuetype = VALUEINT32;
+    payload->senses[2].value.valueint32 = -42;
+
+    payload->senses[3].sId = 0x00030100;
+    payload->senses[3].name = "accel";
+    payload->senses[3].value.valuetype = VALUEARRAY;
+    payload->senses[3].value.valuearray.number_of_items = 2;
+    payload->senses[3].value.valuearray.items = items;
+  }
+
+  virtual void TearDown()
+  {
+    free(payload);
+    close(fd);
+  }
+
+  void SetSense(int i, uint32_t sId, const char *name, double value)
+  {
+    payload->senses[i].sId = sId;
+    payload->senses[i].name = name;
+    payload->senses[i].value.valuetype = VALUEDOUBLE;
+    payload->senses[i].value.valuedouble = value;
+    payload->senses[i].ts.tv_sec = 1450000000 + i;
+    payload->senses[i].ts.tv_nsec = i;
+  }
+
+  void AppendRecord(void)
+  {
+    uint8_t buf[512];
+    int len;
+
+    len = __ts_engine_log_record_encode(payload, buf, sizeof(buf));
+    ASSERT_GT(len, 0);
+    ASSERT_EQ(len, write(fd, buf, len));
+  }
+
+  /* Same format as the text log written by earlier firmware. */
+
+  std::string LegacyLine(void)
+  {
+    char buf[512];
+    char valuebuf[VALUE_STR_MAX_LEN];
+    std::string line;
+    int i;
+
+    snprintf(buf, sizeof(buf), "%s,%d,%d,%d,%d,%d", payload->state.pId,
+             payload->state.puId, payload->state.stId, payload->state.evId,
+             (int)payload->state.ts.tv_sec, (int)payload->state.ts.tv_nsec);
+    line = buf;
+
+    for (i = 0; i < payload->number_of_senses; i++)
+      {
+        __value_serialize(valuebuf, sizeof(valuebuf),
+                          &payload->senses[i].value);
+        snprintf(buf, sizeof(buf), ";%s,0x%08x,%s,%d,%d",
+                 payload->senses[i].name, payload->senses[i].sId, valuebuf,
+                 (int)payload->senses[i].ts.tv_sec,
+                 (int)payload->senses[i].ts.tv_nsec);
+        line += buf;
+      }
+
+    return line + "\n";
+  }
+
+  void ExpectSame(const struct ts_payload *out)
+  {
+    int i;
+
+    ASSERT_TRUE(out != NULL);
+    EXPECT_STREQ(payload->state.pId, out->state.pId);
+    EXPECT_EQ(payload->state.puId, out->state.puId);
+    EXPECT_EQ(payload->state.stId, out->state.stId);
+    EXPECT_EQ(payload->state.evId, out->state.evId);
+    EXPECT_EQ(payload->state.ts.tv_sec, out->state.ts.tv_sec);
+    ASSERT_EQ(payload->number_of_senses, out->number_of_senses);
+
+    for (i = 0; i < out->number_of_senses; i++)
+      {
+        EXPECT_EQ(payload->senses[i].sId, out->senses[i].sId);
+        EXPECT_STREQ(payload->senses[i].name, out->senses[i].name);
+        EXPECT_EQ(payload->senses[i].value.valuetype,
+                  out->senses[i].value.valuetype);
+      }
+
+    EXPECT_DOUBLE_EQ(21.5, out->senses[0].value.valuedouble);
+    EXPECT_EQ(-42, out->senses[2].value.valueint32);
+    ASSERT_EQ(2, out->senses[3].value.valuearray.number_of_items);
+    EXPECT_DOUBLE_EQ(-2.25,
+                     out->senses[3].value.valuearray.items[1].valuedouble);
+  }
+
+protected:
+  int fd;
+  struct ts_payload *payload;
+  struct ts_value items[2];
+};
+
+TEST_F(LogRecord, RoundTrip)
+{
+  uint8_t buf[512];
+  struct ts_payload *out;
+  int len;
+
+  len = __ts_engine_log_record_encode(payload, buf, sizeof(buf));
+  ASSERT_EQ((int)__ts_engine_log_record_size(payload), len);
+
+  EXPECT_EQ(0, __ts_engine_log_record_decode(buf, len - 1, &out));
+  ASSERT_EQ(len, __ts_engine_log_record_decode(buf, len, &out));
+  ExpectSame(out);
+  free(out);
+}
+
+TEST_F(LogRecord, CorruptRecordIsSkipped)
+{
+  struct ts_payload *out[4];
+  uint8_t byte;
+
+  AppendRecord();
+  AppendRecord();
+  AppendRecord();
+
+  /* Flip one byte inside the second record. */
+
+  ASSERT_EQ(1, pread(fd, &byte, 1, __ts_engine_log_record_size(payload) + 20));
+  byte ^= 0xff;
+  ASSERT_EQ(1, pwrite(fd, &byte, 1, __ts_engine_log_record_size(payload) + 20));
+
+  lseek(fd, 0, SEEK_SET);
+  ASSERT_EQ(2, __ts_engine_log_record_read_batch(fd, out, 4, 4096));
+  ExpectSame(out[0]);
+  ExpectSame(out[1]);
+  free(out[0]);
+  free(out[1]);
+
+  EXPECT_EQ(0, __ts_engine_log_record_read_batch(fd, out, 4, 4096));
+}
+
+TEST_F(LogRecord, LegacyTextMigration)
+{
+  struct ts_payload *out[4];
+  std::string line = LegacyLine();
+  int i;
+
+  ASSERT_EQ((ssize_t)line.size(), write(fd, line.c_str(), line.size()));
+  AppendRecord();
+  ASSERT_EQ((ssize_t)line.size(), write(fd, line.c_str(), line.size()));
+
+  lseek(fd, 0, SEEK_SET);
+  ASSERT_EQ(3, __ts_engine_log_record_read_batch(fd, out, 4, 4096));
+  for (i = 0; i < 3; i++)
+    {
+      ExpectSame(out[i]);
+      free(out[i]);
+    }
+}
+
+TEST_F(LogRecord, BatchLimits)
+{
+  struct ts_payload *out[20];
+  size_t reclen = __ts_engine_log_record_size(payload);
+  int total = 0;
+  int n;
+  int i;
+
+  for (i = 0; i < 50; i++)
+    {
+      AppendRecord();
+    }
+
+  lseek(fd, 0, SEEK_SET);
+
+  /* Byte limit allows three records, position stays at the fourth. */
+
+  n = __ts_engine_log_record_read_batch(fd, out, 20, 3 * reclen + 1);
+  ASSERT_EQ(3, n);
+  EXPECT_EQ((off_t)(3 * reclen), lseek(fd, 0, SEEK_CUR));
+  for (i = 0; i < n; i++)
+    {
+      free(out[i]);
+    }
+  total += n;
+
+  while ((n = __ts_engine_log_record_read_batch(fd, out, 20, 65536)) > 0)
+    {
+      EXPECT_LE(n, 20);
+      for (i = 0; i < n; i++)
+        {
+          ExpectSame(out[i]);
+          free(out[i]);
+        }
+      total += n;
+    }
+
+  EXPECT_EQ(0, n);
+  EXPECT_EQ(50, total);
+}
+
+TEST_F(LogRecord, Benchmark)
+{
+  struct ts_payload *out[20];
+  std::string line = LegacyLine();
+  char text[512];
+  double start;
+  double text_rate;
+  double bin_rate;
+  off_t text_bytes;
+  off_t bin_bytes;
+  int count;
+  int n;
+  int i;
+
+  for (i = 0; i < BENCH_RECORDS; i++)
+    {
+      ASSERT_EQ((ssize_t)line.size(), write(fd, line.c_str(), line.size()));
+    }
+  text_bytes = lseek(fd, 0, SEEK_CUR);
+
+  /* Text log as it was read before: one read() per byte, then parse. */
+
+  lseek(fd, 0, SEEK_SET);
+  start = now_sec();
+  for (count = 0; ; count++)
+    {
+      for (n = 0; read(fd, &text[n], 1) == 1 && text[n] != '\n'; n++);
+      if (n == 0)
+        {
+          break;
+        }
+      text[n] = '\0';
+      free(__ts_engine_log_record_from_text(text));
+    }
+  text_rate = count / (now_sec() - start);
+  EXPECT_EQ(BENCH_RECORDS, count);
+
+  ASSERT_EQ(0, ftruncate(fd, 0));
+  lseek(fd, 0, SEEK_SET);
+  for (i = 0; i < BENCH_RECORDS; i++)
+    {
+      AppendRecord();
+    }
+  bin_bytes = lseek(fd, 0, SEEK_CUR);
+
+  lseek(fd, 0, SEEK_SET);
+  start = now_sec();
+  count = 0;
+  while ((n = __ts_engine_log_record_read_batch(fd, out, 20, 65536)) > 0)
+    {
+      for (i = 0; i < n; i++)
+        {
+          free(out[i]);
+        }
+      count += n;
+    }
+  bin_rate = count / (now_sec() - start);
+  EXPECT_EQ(BENCH_RECORDS, count);
+
+  printf("text:   %8.0f records/s, %ld bytes\n", text_rate, (long)text_bytes);
+  printf("binary: %8.0f records/s, %ld bytes\n", bin_rate, (long)bin_bytes);
+}
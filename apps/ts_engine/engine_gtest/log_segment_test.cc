@@ -0,0 +1,234 @@
+/****************************************************************************
+ * apps/ts_engine/engine_gtest/log_segment_test.cc
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include "gtest/gtest.h"
+
+extern "C" {
+#include <nuttx/config.h>
+#include "log_record.h"
+#include "log_segment.h"
+}
+
+class LogSegment : public testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    char name[] = "/tmp/ts_seg_XXXXXX";
+
+    ASSERT_TRUE(mkdtemp(name) != NULL);
+    dir = name;
+    cursor = dir + "/" + "SEND.CUR";
+    active = dir + "/" + "EVENTS.LOG";
+  }
+
+  virtual void TearDown()
+  {
+    std::string cmd = "rm -rf " + dir;
+
+    ASSERT_EQ(0, system(cmd.c_str()));
+  }
+
+  void WriteRecords(const std::string &path, int count)
+  {
+    struct ts_payload *payload;
+    uint8_t buf[256];
+    int fd;
+    int len;
+    int i;
+
+    payload = (struct ts_payload *)calloc(1, sizeof(*payload) +
+        sizeof(struct ts_sense_value));
+    payload->state.pId = "profile-id";
+    payload->number_of_senses = 1;
+    payload->senses[0].sId = 0x00060100;
+    payload->senses[0].value.valuetype = VALUEINT32;
+
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0666);
+    ASSERT_GE(fd, 0);
+
+    for (i = 0; i < count; i++)
+      {
+        payload->state.evId = i;
+        len = __ts_engine_log_record_encode(payload, buf, sizeof(buf));
+        ASSERT_GT(len, 0);
+        ASSERT_EQ(len, write(fd, buf, len));
+      }
+
+    close(fd);
+    free(payload);
+  }
+
+protected:
+  std::string dir;
+  std::string cursor;
+  std::string active;
+};
+
+TEST_F(LogSegment, Index)
+{
+  EXPECT_EQ(0, __ts_engine_log_segment_index("/media/sd0/LOGSEG.0"));
+  EXPECT_EQ(17, __ts_engine_log_segment_index("LOGSEG.17"));
+  EXPECT_EQ(ERROR, __ts_engine_log_segment_index("/media/sd0/LOGSEG."));
+  EXPECT_EQ(ERROR, __ts_engine_log_segment_index("/media/sd0/LOGSEG.1a"));
+  EXPECT_EQ(ERROR, __ts_engine_log_segment_index("/media/sd0/EVENTS.LOG"));
+}
+
+TEST_F(LogSegment, SealMovesWithoutCopy)
+{
+  std::string segment = dir + "/LOGSEG.3";
+  struct stat before;
+  struct stat after;
+
+  WriteRecords(active, 10);
+  ASSERT_EQ(0, stat(active.c_str(), &before));
+
+  ASSERT_EQ(OK, __ts_engine_log_segment_seal(active.c_str(),
+                                             segment.c_str()));
+
+  EXPECT_NE(0, access(active.c_str(), F_OK));
+  ASSERT_EQ(0, stat(segment.c_str(), &after));
+  EXPECT_EQ(before.st_ino, after.st_ino);
+  EXPECT_EQ(before.st_size, after.st_size);
+
+  EXPECT_EQ(ERROR, __ts_engine_log_segment_seal(active.c_str(),
+                                                segment.c_str()));
+}
+
+TEST_F(LogSegment, CursorRoundTrip)
+{
+  struct log_cursor in = { 5, 1234 };
+  struct log_cursor out = { 0, 0 };
+
+  EXPECT_EQ(ERROR, __ts_engine_log_cursor_load(cursor.c_str(), &out));
+
+  ASSERT_EQ(OK, __ts_engine_log_cursor_save(cursor.c_str(), &in));
+  ASSERT_EQ(OK, __ts_engine_log_cursor_load(cursor.c_str(), &out));
+  EXPECT_EQ(5, out.segment);
+  EXPECT_EQ(1234, out.offset);
+
+  /* Rewritten in place. */
+
+  in.offset = 99;
+  ASSERT_EQ(OK, __ts_engine_log_cursor_save(cursor.c_str(), &in));
+  ASSERT_EQ(OK, __ts_engine_log_cursor_load(cursor.c_str(), &out));
+  EXPECT_EQ(99, out.offset);
+}
+
+TEST_F(LogSegment, DamagedCursorIsRejected)
+{
+  struct log_cursor in = { 1, 200 };
+  struct log_cursor out;
+  uint8_t byte;
+  int fd;
+
+  ASSERT_EQ(OK, __ts_engine_log_cursor_save(cursor.c_str(), &in));
+
+  fd = open(cursor.c_str(), O_RDWR);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(1, pread(fd, &byte, 1, 9));
+  byte ^= 0x01;
+  ASSERT_EQ(1, pwrite(fd, &byte, 1, 9));
+  close(fd);
+
+  EXPECT_EQ(ERROR, __ts_engine_log_cursor_load(cursor.c_str(), &out));
+
+  ASSERT_EQ(0, truncate(cursor.c_str(), LOG_CURSOR_LEN / 2));
+  EXPECT_EQ(ERROR, __ts_engine_log_cursor_load(cursor.c_str(), &out));
+}
+
+TEST_F(LogSegment, ResumeAfterReset)
+{
+  std::string segment = dir + "/LOGSEG.0";
+  struct ts_payload *out[4];
+  struct log_cursor saved;
+  struct log_cursor loaded;
+  int fd;
+  int n;
+  int i;
+
+  WriteRecords(active, 10);
+  ASSERT_EQ(OK, __ts_engine_log_segment_seal(active.c_str(),
+                                             segment.c_str()));
+
+  /* Deliver two batches, persisting the cursor after each one. */
+
+  fd = open(segment.c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+
+  for (i = 0; i < 2; i++)
+    {
+      n = __ts_engine_log_record_read_batch(fd, out, 4, 4096);
+      ASSERT_EQ(4, n);
+      while (n--)
+        {
+          free(out[n]);
+        }
+
+      saved.segment = __ts_engine_log_segment_index(segment.c_str());
+      saved.offset = lseek(fd, 0, SEEK_CUR);
+      ASSERT_EQ(OK, __ts_engine_log_cursor_save(cursor.c_str(), &saved));
+    }
+
+  /* Third batch is read but never acknowledged. */
+
+  n = __ts_engine_log_record_read_batch(fd, out, 4, 4096);
+  ASSERT_EQ(2, n);
+  while (n--)
+    {
+      free(out[n]);
+    }
+
+  close(fd);
+
+  fd = open(segment.c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(OK, __ts_engine_log_cursor_load(cursor.c_str(), &loaded));
+  ASSERT_EQ(0, loaded.segment);
+  lseek(fd, loaded.offset, SEEK_SET);
+
+  n = __ts_engine_log_record_read_batch(fd, out, 4, 4096);
+  ASSERT_EQ(2, n);
+  EXPECT_EQ(8, out[0]->state.evId);
+  EXPECT_EQ(9, out[1]->state.evId);
+  free(out[0]);
+  free(out[1]);
+
+  close(fd);
+}
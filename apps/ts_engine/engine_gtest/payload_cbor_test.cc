@@ -0,0 +1,533 @@
+/****************************************************************************
+ * apps/ts_engine/engine_gtest/payload_cbor_test.cc
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+
+extern "C" {
+#include <nuttx/config.h>
+#include <apps/netutils/cbor.h>
+#include "log_record.h"
+#include "connectors/conn_payload.h"
+}
+
+#define BATCH_PAYLOADS 10
+
+static void append_putc(char c, void *priv)
+{
+  ((std::string *)priv)->push_back(c);
+}
+
+/* CBOR to JSON, as backend would do it: "sId" integers back to text. */
+
+static cJSON *cbor_to_json(CborValue *it, bool sid)
+{
+  CborValue inner;
+  cJSON *item = NULL;
+  cJSON *child;
+  char key[16];
+  char *str;
+  size_t len;
+  int64_t i64;
+  float f;
+  double d;
+
+  switch (cbor_value_get_type(it))
+    {
+    case CborIntegerType:
+      cbor_value_get_int64(it, &i64);
+      if (sid)
+        {
+          snprintf(key, sizeof(key), "0x%08x", (unsigned)i64);
+          item = cJSON_CreateString(key);
+        }
+      else
+        {
+          item = cJSON_CreateNumber(i64);
+        }
+      break;
+
+    case CborFloatType:
+      cbor_value_get_float(it, &f);
+      item = cJSON_CreateNumber(f);
+      break;
+
+    case CborDoubleType:
+      cbor_value_get_double(it, &d);
+      item = cJSON_CreateNumber(d);
+      break;
+
+    case CborTextStringType:
+      if (cbor_value_dup_text_string(it, &str, &len, it) != CborNoError)
+        return NULL;
+      item = cJSON_CreateString(str);
+      free(str);
+      return item;
+
+    case CborArrayType:
+    case CborMapType:
+      item = cbor_value_is_map(it) ? cJSON_CreateObject() :
+                                     cJSON_CreateArray();
+      cbor_value_enter_container(it, &inner);
+      while (item && !cbor_value_at_end(&inner))
+        {
+          key[0] = '\0';
+          if (cbor_value_is_map(it))
+            {
+              len = sizeof(key);
+              if (!cbor_value_is_text_string(&inner) ||
+                  cbor_value_copy_text_string(&inner, key, &len, &inner))
+                break;
+            }
+
+          child = cbor_to_json(&inner, !strcmp(key, "sId"));
+          if (!child)
+            break;
+
+          if (cbor_value_is_map(it))
+            cJSON_AddItemToObject(item, key, child);
+          else
+            cJSON_AddItemToArray(item, child);
+        }
+
+      if (!item || !cbor_value_at_end(&inner))
+        {
+          cJSON_Delete(item);
+          return NULL;
+        }
+
+      cbor_value_leave_container(it, &inner);
+      return item;
+
+    default:
+      return NULL;
+    }
+
+  cbor_value_advance_fixed(it);
+  return item;
+}
+
+static std::string cbor_to_json_string(const std::string &cbor)
+{
+  CborParser parser;
+  CborValue it;
+  std::string out;
+  cJSON *json;
+  char *str;
+
+  if (cbor_parser_init((const uint8_t *)cbor.data(), cbor.size(), 0,
+                       &parser, &it) != CborNoError)
+    return out;
+
+  json = cbor_to_json(&it, false);
+  if (!json || !cbor_value_at_end(&it))
+    {
+      cJSON_Delete(json);
+      return out;
+    }
+
+  str = cJSON_PrintUnformatted(json);
+  out = str;
+  free(str);
+  cJSON_Delete(json);
+  return out;
+}
+
+/* Loopback HTTP server standing in for the backend: stores request
+ * Content-Type and body of each POST and replies 200.
+ */
+
+class StandInServer
+{
+public:
+  struct request
+  {
+    std::string content_type;
+    std::string body;
+  };
+
+  std::vector<request> requests;
+
+  bool Start(int count)
+  {
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+      return false;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(fd, 4) < 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &addrlen) < 0)
+      return false;
+
+    port = ntohs(addr.sin_port);
+    nexpected = count;
+    return pthread_create(&thread, NULL, Serve, this) == 0;
+  }
+
+  void Stop(void)
+  {
+    pthread_join(thread, NULL);
+    close(fd);
+  }
+
+  /* Client side: returns HTTP status code of the reply or -1. */
+
+  int Post(const char *content_type, const std::string &body)
+  {
+    struct sockaddr_in addr;
+    std::string req;
+    char buf[64];
+    int status = -1;
+    int sd;
+    int ret;
+
+    sd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sd < 0)
+      return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (connect(sd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+      {
+        close(sd);
+        return -1;
+      }
+
+    snprintf(buf, sizeof(buf), "%zu", body.size());
+    req = "POST /events HTTP/1.1\r\nHost: localhost\r\nContent-Type: ";
+    req += content_type;
+    req += "\r\nContent-Length: ";
+    req += buf;
+    req += "\r\nConnection: close\r\n\r\n";
+    req += body;
+
+    if (write(sd, req.data(), req.size()) == (ssize_t)req.size())
+      {
+        ret = read(sd, buf, sizeof(buf) - 1);
+        if (ret > 0)
+          {
+            buf[ret] = '\0';
+            sscanf(buf, "HTTP/1.1 %d", &status);
+          }
+      }
+
+    close(sd);
+    return status;
+  }
+
+private:
+  int nexpected;
+  int fd;
+  int port;
+  pthread_t thread;
+
+  static std::string Header(const std::string &head, const char *name)
+  {
+    size_t pos = head.find(name);
+    size_t end;
+
+    if (pos == std::string::npos)
+      return "";
+
+    pos += strlen(name);
+    end = head.find("\r\n", pos);
+    return head.substr(pos, end - pos);
+  }
+
+  static void *Serve(void *arg)
+  {
+    StandInServer *self = (StandInServer *)arg;
+    static const char reply[] =
+      "HTTP/1.1 200 OK\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    int i;
+
+    for (i = 0; i < self->nexpected; i++)
+      {
+        std::string data;
+        request req;
+        size_t hdrend;
+        size_t len;
+        char buf[512];
+        int sd;
+        int ret;
+
+        sd = accept(self->fd, NULL, NULL);
+        if (sd < 0)
+          break;
+
+        while ((hdrend = data.find("\r\n\r\n")) == std::string::npos &&
+               (ret = read(sd, buf, sizeof(buf))) > 0)
+          data.append(buf, ret);
+
+        if (hdrend != std::string::npos)
+          {
+            len = strtoul(Header(data, "Content-Length: ").c_str(), NULL,
+                          10);
+            hdrend += 4;
+            while (data.size() < hdrend + len &&
+                   (ret = read(sd, buf, sizeof(buf))) > 0)
+              data.append(buf, ret);
+
+            req.content_type = Header(data, "Content-Type: ");
+            req.body = data.substr(hdrend, len);
+            self->requests.push_back(req);
+            ret = write(sd, reply, sizeof(reply) - 1);
+          }
+
+        close(sd);
+      }
+
+    return NULL;
+  }
+};
+
+class PayloadCbor : public testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    payload = (struct ts_payload *)calloc(1, sizeof(*payload) +
+        6 * sizeof(struct ts_sense_value));
+
+    items[0].valuetype = VALUEDOUBLE;
+    items[0].valuedouble = 0.5;
+    items[1].valuetype = VALUEDOUBLE;
+    items[1].valuedouble = -9.81;
+
+    payload->state.pId = "profile-id";
+    payload->state.puId = 1;
+    payload->state.stId = 2;
+    payload->state.evId = 3;
+    payload->state.ts.tv_sec = 1450000000;
+    payload->state.ts.tv_nsec = 123000000;
+    payload->number_of_senses = 6;
+
+    SetSense(0, 0x00060100, VALUEDOUBLE)->valuedouble = 21.5;
+    SetSense(1, 0x00060200, VALUEDOUBLE)->valuedouble = 40.1;
+    SetSense(2, 0x00020300, VALUEINT32)->valueint32 = -42;
+    SetSense(3, 0x00030100, VALUEARRAY)->valuearray.number_of_items = 2;
+    payload->senses[3].value.valuearray.items = items;
+    SetSense(4, 0x00010100, VALUEDOUBLE)->valuedouble = 60.169857;
+    SetSense(5, 0x00010200, VALUEDOUBLE)->valuedouble = 24.938379;
+  }
+
+  virtual void TearDown()
+  {
+    free(payload);
+  }
+
+  struct ts_value *SetSense(int i, uint32_t sId, enum ts_valuetype_t type)
+  {
+    payload->senses[i].sId = sId;
+    payload->senses[i].value.valuetype = type;
+    return &payload->senses[i].value;
+  }
+
+  std::string ToCbor(void)
+  {
+    uint8_t buf[512];
+    int len;
+
+    len = conn_payload_to_cbor(payload, buf, sizeof(buf));
+    EXPECT_GT(len, 0);
+    EXPECT_LE(len, (int)sizeof(buf));
+    return std::string((const char *)buf, len > 0 ? len : 0);
+  }
+
+  std::string ToJson(void)
+  {
+    std::string out;
+    cJSON *json;
+    char *str;
+
+    json = conn_payload_to_json(payload);
+    if (!json)
+      return out;
+
+    str = cJSON_PrintUnformatted(json);
+    out = str;
+    free(str);
+    cJSON_Delete(json);
+    return out;
+  }
+
+  /* Binary log records of a batch of payloads, as the Thingsee connector
+   * keeps them while sending. */
+
+  std::string Records(int count)
+  {
+    std::string records;
+    uint8_t buf[512];
+    int len;
+    int i;
+
+    for (i = 0; i < count; i++)
+      {
+        payload->state.evId = i;
+        payload->state.ts.tv_sec += 60;
+        payload->senses[0].value.valuedouble += 0.25;
+        len = __ts_engine_log_record_encode(payload, buf, sizeof(buf));
+        EXPECT_GT(len, 0);
+        records.append((const char *)buf, len > 0 ? len : 0);
+      }
+
+    return records;
+  }
+
+  struct ts_payload *payload;
+  struct ts_value items[2];
+};
+
+TEST_F(PayloadCbor, MatchesJson)
+{
+  std::string json = ToJson();
+  std::string cbor = ToCbor();
+
+  ASSERT_FALSE(json.empty());
+  EXPECT_EQ(json, cbor_to_json_string(cbor));
+  EXPECT_LT(cbor.size() * 3, json.size() * 2);
+
+  payload->number_of_senses = 0;
+  payload->state.pId = NULL;
+  EXPECT_EQ(ToJson(), cbor_to_json_string(ToCbor()));
+}
+
+TEST_F(PayloadCbor, PacksNumbers)
+{
+  CborParser parser;
+  CborValue it;
+  std::string cbor;
+  char *text;
+  size_t len;
+  FILE *out;
+
+  payload->number_of_senses = 2;
+  payload->senses[1].value.valuedouble = 1e6;
+
+  cbor = ToCbor();
+  ASSERT_EQ(CborNoError, cbor_parser_init((const uint8_t *)cbor.data(),
+                                          cbor.size(), 0, &parser, &it));
+
+  out = open_memstream(&text, &len);
+  ASSERT_TRUE(out != NULL);
+  EXPECT_EQ(CborNoError, cbor_value_to_pretty(out, &it));
+  fclose(out);
+
+  EXPECT_STREQ("{\"engine\": {\"pId\": \"profile-id\", \"puId\": 1, "
+               "\"stId\": 2, \"evId\": 3, \"ts\": 1450000000123}, "
+               "\"senses\": [{\"sId\": 393472, \"val\": 21.5f, "
+               "\"ts\": 1450000000123}, {\"sId\": 393728, \"val\": 1000000, "
+               "\"ts\": 1450000000123}]}", text);
+  free(text);
+}
+
+TEST_F(PayloadCbor, ReportsLengthNeeded)
+{
+  std::string cbor = ToCbor();
+  uint8_t small[16];
+  uint8_t *buf;
+  int len;
+
+  len = conn_payload_to_cbor(payload, small, sizeof(small));
+  ASSERT_EQ((int)cbor.size(), len);
+  EXPECT_EQ((int)cbor.size(), conn_payload_to_cbor(payload, NULL, 0));
+
+  buf = (uint8_t *)malloc(len);
+  ASSERT_EQ(len, conn_payload_to_cbor(payload, buf, len));
+  EXPECT_EQ(0, memcmp(cbor.data(), buf, len));
+  free(buf);
+}
+
+TEST_F(PayloadCbor, RejectsUnknownValueType)
+{
+  uint8_t buf[512];
+
+  payload->senses[2].value.valuetype = (enum ts_valuetype_t)100;
+  EXPECT_EQ(ERROR, conn_payload_to_cbor(payload, buf, sizeof(buf)));
+}
+
+TEST_F(PayloadCbor, StandInServer)
+{
+  std::string records = Records(BATCH_PAYLOADS);
+  std::string json;
+  std::string cbor;
+  StandInServer server;
+
+  ASSERT_EQ(OK, conn_payload_put_json((const uint8_t *)records.data(),
+                                      records.size(), append_putc, &json));
+  ASSERT_EQ(OK, conn_payload_put_cbor((const uint8_t *)records.data(),
+                                      records.size(), BATCH_PAYLOADS,
+                                      append_putc, &cbor));
+
+  ASSERT_TRUE(server.Start(2));
+  EXPECT_EQ(200, server.Post(CONN_PAYLOAD_JSON_CONTENT_TYPE, json));
+  EXPECT_EQ(200, server.Post(CONN_PAYLOAD_CBOR_CONTENT_TYPE, cbor));
+  server.Stop();
+
+  ASSERT_EQ(2u, server.requests.size());
+  EXPECT_EQ(CONN_PAYLOAD_JSON_CONTENT_TYPE, server.requests[0].content_type);
+  EXPECT_EQ(CONN_PAYLOAD_CBOR_CONTENT_TYPE, server.requests[1].content_type);
+  EXPECT_EQ(json, server.requests[0].body);
+  EXPECT_EQ(json, cbor_to_json_string(server.requests[1].body));
+
+  printf("batch of %d payloads: JSON %zu bytes, CBOR %zu bytes, "
+         "saved %zu bytes (%zu%%)\n", BATCH_PAYLOADS, json.size(),
+         cbor.size(), json.size() - cbor.size(),
+         100 * (json.size() - cbor.size()) / json.size());
+  RecordProperty("json_bytes", json.size());
+  RecordProperty("cbor_bytes", cbor.size());
+
+  /* Count must match the records. */
+
+  cbor.clear();
+  EXPECT_EQ(ERROR, conn_payload_put_cbor((const uint8_t *)records.data(),
+                                         records.size(), BATCH_PAYLOADS + 1,
+                                         append_putc, &cbor));
+}
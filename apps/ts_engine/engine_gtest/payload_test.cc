@@ -0,0 +1,108 @@
+/****************************************************************************
+ * apps/ts_engine/engine_gtest/payload_test.cc
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+
+#include <string.h>
+#include "gtest/gtest.h"
+
+extern "C" {
+#include <nuttx/config.h>
+#include "payload.h"
+}
+
+TEST(Payload, SlotsAreReused)
+{
+  struct ts_payload_stats before;
+  struct ts_payload_stats after;
+  struct ts_payload *a;
+  struct ts_payload *b;
+
+  __ts_engine_payload_stats(&before);
+
+  a = __ts_engine_payload_alloc(sizeof(*a));
+  ASSERT_TRUE(a != NULL);
+  EXPECT_EQ(0u, (uintptr_t)a % sizeof(uint64_t));
+  memset(a, 0xff, CONFIG_THINGSEE_ENGINE_PAYLOAD_SLOT_SIZE);
+  __ts_engine_payload_free(a);
+
+  b = __ts_engine_payload_alloc(CONFIG_THINGSEE_ENGINE_PAYLOAD_SLOT_SIZE);
+  EXPECT_EQ(a, b);
+  __ts_engine_payload_free(b);
+
+  __ts_engine_payload_stats(&after);
+  EXPECT_EQ(before.pooled + 2, after.pooled);
+  EXPECT_EQ(before.heap, after.heap);
+  EXPECT_EQ(before.in_use, after.in_use);
+}
+
+TEST(Payload, FallsBackToHeap)
+{
+  struct ts_payload *pooled[CONFIG_THINGSEE_ENGINE_PAYLOAD_SLOTS];
+  struct ts_payload_stats before;
+  struct ts_payload_stats stats;
+  struct ts_payload *big;
+  struct ts_payload *extra;
+  int i;
+
+  __ts_engine_payload_stats(&before);
+
+  big = __ts_engine_payload_alloc(CONFIG_THINGSEE_ENGINE_PAYLOAD_SLOT_SIZE + 1);
+  ASSERT_TRUE(big != NULL);
+  memset(big, 0, CONFIG_THINGSEE_ENGINE_PAYLOAD_SLOT_SIZE + 1);
+
+  for (i = 0; i < CONFIG_THINGSEE_ENGINE_PAYLOAD_SLOTS; i++)
+    {
+      pooled[i] = __ts_engine_payload_alloc(sizeof(struct ts_payload));
+      ASSERT_TRUE(pooled[i] != NULL);
+    }
+
+  extra = __ts_engine_payload_alloc(sizeof(struct ts_payload));
+  ASSERT_TRUE(extra != NULL);
+
+  __ts_engine_payload_stats(&stats);
+  EXPECT_EQ(before.heap + 2, stats.heap);
+  EXPECT_EQ((unsigned)CONFIG_THINGSEE_ENGINE_PAYLOAD_SLOTS, stats.in_use);
+
+  __ts_engine_payload_free(extra);
+  __ts_engine_payload_free(big);
+
+  for (i = 0; i < CONFIG_THINGSEE_ENGINE_PAYLOAD_SLOTS; i++)
+    {
+      __ts_engine_payload_free(pooled[i]);
+    }
+
+  __ts_engine_payload_free(NULL);
+
+  __ts_engine_payload_stats(&stats);
+  EXPECT_EQ(0u, stats.in_use);
+}
@@ -0,0 +1,222 @@
+/****************************************************************************
+ * apps/ts_engine/engine_gtest/threshold_test.cc
+ *
+ *   Copyright (C) 2016 Haltian Ltd. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 3. Neither the name NuttX nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+
+
+#include <stdlib.h>
+#include "gtest/gtest.h"
+
+extern "C" {
+#include <nuttx/config.h>
+#include "parse.h"
+#include "threshold.h"
+}
+
+class Threshold : public testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    memset(&cause, 0, sizeof(cause));
+    sq_init(&cause.conf.thresholds);
+    cause.conf.measurement.interval = -1;
+    nthresholds = 0;
+    ASSERT_EQ(OK, __ts_engine_arena_init(&arena, 1024));
+  }
+
+  virtual void TearDown()
+  {
+    int i;
+
+    __ts_engine_arena_release(&arena);
+
+    for (i = 0; i < nthresholds; i++)
+      {
+        if (thresholds[i].conf.value.valuetype == VALUEARRAY)
+          {
+            free(thresholds[i].conf.value.valuearray.items);
+          }
+      }
+  }
+
+  struct ts_threshold *Add(enum ts_threshold_t type)
+  {
+    struct ts_threshold *thr = &thresholds[nthresholds++];
+
+    memset(thr, 0, sizeof(*thr));
+    thr->conf.type = type;
+    thr->parent = &cause;
+
+    /* Linked by hand, libc/queue is not part of the host build. */
+
+    if (nthresholds > 1)
+      {
+        thresholds[nthresholds - 2].entry.flink = &thr->entry;
+      }
+    else
+      {
+        cause.conf.thresholds.head = &thr->entry;
+      }
+
+    cause.conf.thresholds.tail = &thr->entry;
+
+    return thr;
+  }
+
+  void AddLimit(enum ts_threshold_t type, double limit)
+  {
+    struct ts_threshold *thr = Add(type);
+
+    thr->conf.value.valuetype = VALUEDOUBLE;
+    thr->conf.value.valuedouble = limit;
+  }
+
+  void AddSet(enum ts_threshold_t type, const double *items, int n)
+  {
+    struct ts_threshold *thr = Add(type);
+    int i;
+
+    thr->conf.value.valuetype = VALUEARRAY;
+    thr->conf.value.valuearray.number_of_items = n;
+    thr->conf.value.valuearray.items =
+        (struct ts_value *)calloc(n, sizeof(struct ts_value));
+
+    for (i = 0; i < n; i++)
+      {
+        thr->conf.value.valuearray.items[i].valuetype = VALUEDOUBLE;
+        thr->conf.value.valuearray.items[i].valuedouble = items[i];
+      }
+  }
+
+  int EvalDouble(double d)
+  {
+    struct ts_value value = { };
+
+    value.valuetype = VALUEDOUBLE;
+    value.valuedouble = d;
+
+    return __ts_engine_threshold_eval(cause.conf.compiled, &value, &bias);
+  }
+
+  int EvalInt32(int32_t i)
+  {
+    struct ts_value value = { };
+
+    value.valuetype = VALUEINT32;
+    value.valueint32 = i;
+
+    return __ts_engine_threshold_eval(cause.conf.compiled, &value, &bias);
+  }
+
+  struct ts_cause cause;
+  struct ts_threshold thresholds[5];
+  struct ts_value bias;
+  struct ts_arena arena;
+  int nthresholds;
+};
+
+TEST_F(Threshold, Range)
+{
+  AddLimit(isGt, 10.0);
+  AddLimit(isLt, 20.0);
+  ASSERT_EQ(OK, __ts_engine_threshold_compile(&cause, VALUEDOUBLE, &arena));
+  ASSERT_TRUE(cause.conf.compiled != NULL);
+
+  EXPECT_EQ(false, EvalDouble(10.0));
+  EXPECT_EQ(true, EvalDouble(10.5));
+  EXPECT_EQ(true, EvalDouble(19.9));
+  EXPECT_EQ(false, EvalDouble(20.0));
+  EXPECT_EQ(false, EvalDouble(0.0 / 0.0));
+}
+
+TEST_F(Threshold, Sets)
+{
+  static const double oneof[] = { 7, 3, 5, 1, 9 };
+  static const double notin[] = { 5 };
+
+  AddSet(isOneOf, oneof, 5);
+  AddSet(isNotIn, notin, 1);
+  AddLimit(isAny, 0);
+  ASSERT_EQ(OK, __ts_engine_threshold_compile(&cause, VALUEINT32, &arena));
+  ASSERT_TRUE(cause.conf.compiled != NULL);
+
+  EXPECT_EQ(true, EvalInt32(1));
+  EXPECT_EQ(true, EvalInt32(3));
+  EXPECT_EQ(false, EvalInt32(4));
+  EXPECT_EQ(false, EvalInt32(5));
+  EXPECT_EQ(true, EvalInt32(9));
+  EXPECT_EQ(false, EvalInt32(10));
+}
+
+TEST_F(Threshold, LimitsCastToSenseType)
+{
+  AddLimit(isGt, 2.7);
+  ASSERT_EQ(OK, __ts_engine_threshold_compile(&cause, VALUEINT32, &arena));
+
+  /* (int32_t)2.7 == 2, as in the generic evaluation. */
+
+  EXPECT_EQ(false, EvalInt32(2));
+  EXPECT_EQ(true, EvalInt32(3));
+}
+
+TEST_F(Threshold, Relative)
+{
+  AddLimit(isGt, 5.0);
+  cause.conf.threshold.relative = true;
+  cause.conf.measurement.interval = 1000;
+  ASSERT_EQ(OK, __ts_engine_threshold_compile(&cause, VALUEINT32, &arena));
+
+  bias.valuetype = VALUEINT32;
+  bias.valueint32 = 100;
+
+  EXPECT_EQ(false, EvalInt32(105));
+  EXPECT_EQ(true, EvalInt32(106));
+}
+
+TEST_F(Threshold, Fallback)
+{
+  struct ts_threshold *thr;
+
+  /* Samples of another type than compiled for. */
+
+  AddLimit(isLt, 1.0);
+  ASSERT_EQ(OK, __ts_engine_threshold_compile(&cause, VALUEDOUBLE, &arena));
+  EXPECT_EQ(ERROR, EvalInt32(0));
+
+  /* String limits are left to the generic evaluation. */
+
+  thr = Add(isOneOf);
+  thr->conf.value.valuetype = VALUESTRING;
+  thr->conf.value.valuestring = (char *)"foo";
+  ASSERT_EQ(OK, __ts_engine_threshold_compile(&cause, VALUEDOUBLE, &arena));
+  EXPECT_TRUE(cause.conf.compiled == NULL);
+}